@@ -1,7 +1,28 @@
+/* Multiple lights
+ *  - a directional light plus any number of point lights
+ *  - the point lights are assigned to view frustum clusters on the CPU
+ *    (light_grid.hpp) every frame, each fragment only loops over the lights
+ *    of its own cluster
+ *  - depth prepass: the containers are drawn first into depth only, from a
+ *    position only stream with an empty fragment shader. the lighting pass
+ *    then tests GL_EQUAL with depth writes off, so every pixel runs the light
+ *    loop once instead of once per overlapping surface
+ *
+ *  keys:
+ *    P : depth prepass on / off
+ *
+ *  prints the fragments the lighting pass shaded, and with the prepass on
+ *  how many it would have shaded without it
+ *
+ *  usage: ./multiple [number of extra orbiting lights]
+ */
+
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstdlib>
 #include <math.h>
 
 #include <glad/glad.h>
@@ -15,6 +36,12 @@
 #include <stb_image.h>                
 
 #include <shader.hpp>
+#include <mesh.hpp>
+#include <lights.hpp>
+#include <light_grid.hpp>
+#include <job_system.hpp>
+#include <gpu_timer.hpp>
+#include <sample_counter.hpp>
 
 // for adjusting camera speed
 float delta_time = 0.0f;
@@ -77,6 +104,14 @@ void process_input(GLFWwindow *window) {
       camera_pos += glm::normalize(glm::cross(camera_front, camera_up)) * camera_speed;
 }
 
+bool prepass = true;
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+   if (action == GLFW_PRESS && key == GLFW_KEY_P) {
+      prepass = !prepass;
+      std::cout << "depth prepass: " << (prepass ? "on" : "off") << std::endl;
+   }
+}
+
 float fov = 45.0f;
 void scroll_callback(GLFWwindow *window, double dx, double dy) {
    if (fov >= 1.0f && fov <= 45.0f)
@@ -87,7 +122,9 @@ void scroll_callback(GLFWwindow *window, double dx, double dy) {
       fov = 45.0f;
 }
 
-int main() {
+int main(int argc, char **argv) {
+   unsigned int n_extra = argc > 1 ? std::atoi(argv[1]) : 0;
+
    int s_width = 800, s_height = 600;
    glfwInit();
    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -111,11 +148,16 @@ int main() {
    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
    glfwSetCursorPosCallback(window, mouse_callback);
    glfwSetScrollCallback(window, scroll_callback);
+   glfwSetKeyCallback(window, key_callback);
 
    // Generate shader programs
    Shader obj_shader("../shaders/02/multiple_lights/obj_shader.vs",
                      "../shaders/02/multiple_lights/obj_shader.fs"
                     );
+   Shader depth_shader("../shaders/02/multiple_lights/depth_prepass.vs",
+                       "../shaders/02/multiple_lights/depth_prepass.fs",
+                       NULL, glsl_inputs<position_vertex>().c_str()
+                      );
    Shader light_shader("../shaders/02/multiple_lights/light_shader.vs",
                        "../shaders/02/multiple_lights/light_shader.fs"
                       );
@@ -217,6 +259,10 @@ int main() {
    glBindBuffer(GL_ARRAY_BUFFER, 0);
    glBindVertexArray(0);
 
+   // For the depth prepass: positions alone, tightly packed (12 bytes a vertex instead of 32)
+   unsigned int VBO3, VAO3;
+   VAO3 = position_stream(vertices, 36, 8, VBO3);
+
    // Texture for diffuse lighting
    unsigned int TEX1;
    glGenTextures(1, &TEX1);
@@ -267,16 +313,50 @@ int main() {
    glActiveTexture(GL_TEXTURE1);
    glBindTexture(GL_TEXTURE_2D, TEX2);
 
-   glm::vec3 light_ambience(0.05f);
-   glm::vec3 light_diffuse(0.8f);
-   glm::vec3 light_specular(0.5f);
-
-   float c = 1.0;
-   float l = 0.09;
-   float q = 0.032;
+   // the four lamps, then the extra lights orbiting the containers
+   std::vector<PointLight> lights(4);
+   for (int i = 0; i < 4; ++i) {
+      lights[i].position = point_light_positions[i];
+      lights[i].radius = 10.0f;
+      lights[i].color = glm::vec3(0.8f);
+      lights[i].intensity = 2.0f;
+   }
+   std::vector<LightOrbit> orbits;
+   std::vector<PointLight> extra_lights;
+   glm::vec3 orbit_center(0.0f, -1.5f, -6.0f);
+   srand(11);
+   make_light_orbits(orbits, extra_lights, n_extra, 8.0f, 3.0f);
+   lights.insert(lights.end(), extra_lights.begin(), extra_lights.end());
+
+   LightBuffer light_buffer(lights.size());
+   LightGrid light_grid;
+   ThreadPool pool;
+   obj_shader.seti("lights", 2);
 
    glm::mat4 projection;
    projection = glm::perspective(glm::radians(45.0f), (float)s_width/s_height, 0.1f, 100.0f);
+   light_grid.set_projection(projection, 0.1f, 100.0f);
+
+   // counters: fragments shaded by the lighting pass, and those passing the prepass
+   GpuTimer gpu_timer;
+   SampleCounter shaded_counter, prepass_counter;
+   unsigned long long shaded = 0, prepass_samples = 0;
+   unsigned int n_shaded = 0, n_prepass = 0;
+   double gpu_ms = 0.0;
+   unsigned int n_gpu = 0;
+   double last_report = glfwGetTime();
+
+   // the containers, `shader` is in use and the VAO bound
+   auto draw_containers = [&](Shader &shader) {
+      for (int i = 0; i < 10; ++i) {
+         glm::mat4 model;
+         model = glm::translate(model, cube_positions[i]);
+         model = glm::rotate(model, glm::radians(20.0f * i), glm::vec3(1.0f, 0.3f, 0.5f));
+         shader.setmat4("model", model);
+         
+         glDrawArrays(GL_TRIANGLES, 0, 36);            
+      }
+   };
 
    while (!glfwWindowShouldClose(window)) {
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -285,22 +365,41 @@ int main() {
       glm::mat4 view;
       view = glm::lookAt(camera_pos, camera_pos + camera_front, camera_up);
 
+      gpu_timer.begin();
+      // depth of the containers only: no color, no textures, trivial fragment shader
+      if (prepass) {
+         depth_shader.use();
+         depth_shader.setmat4("view", view);
+         depth_shader.setmat4("projection", projection);
+         glBindVertexArray(VAO3);
+         glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+         prepass_counter.begin();
+         draw_containers(depth_shader);
+         prepass_counter.end();
+         glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+         glBindVertexArray(0);
+      }
+
+      update_light_orbits(orbits, extra_lights, glfwGetTime());
+      for (size_t i = 0; i < extra_lights.size(); ++i)
+         lights[4 + i].position = extra_lights[i].position + orbit_center;
+
       // Render all light sources
       light_shader.use();
       glBindVertexArray(VAO1);
 
       light_shader.setmat4("view", view);
       light_shader.setmat4("projection", projection);
-      for (int i = 0; i < 4; ++i) {
+      for (size_t i = 0; i < lights.size(); ++i) {
          glm::mat4 model;
          if (i == 2) {
             float radius = 3.0f;
             float posX = sin(glfwGetTime()) * radius;
             float posZ = cos(glfwGetTime()) * radius;
             model = glm::translate(model, glm::vec3(posX, 0, posZ));
-            point_light_positions[2] = glm::vec3(posX, 0, posZ);
+            lights[2].position = glm::vec3(posX, 0, posZ);
          } else {
-            model = glm::translate(model, point_light_positions[i]);
+            model = glm::translate(model, lights[i].position);
          }
          model = glm::scale(model, glm::vec3(0.09f));
          light_shader.setmat4("model", model);
@@ -312,41 +411,13 @@ int main() {
       obj_shader.use();
       glBindVertexArray(VAO2);
 
-      obj_shader.setvec3("_point_sources[0].position", point_light_positions[0]);
-      obj_shader.setvec3("_point_sources[1].position", point_light_positions[1]);
-      obj_shader.setvec3("_point_sources[2].position", point_light_positions[2]);
-      obj_shader.setvec3("_point_sources[3].position", point_light_positions[3]);
-   
-      obj_shader.setf("_point_sources[0].constant", 1.0f);
-      obj_shader.setf("_point_sources[1].constant", 1.0f);
-      obj_shader.setf("_point_sources[2].constant", 1.0f);
-      obj_shader.setf("_point_sources[3].constant", 1.0f);
-
-      obj_shader.setf("_point_sources[0].linear", l);
-      obj_shader.setf("_point_sources[1].linear", l);
-      obj_shader.setf("_point_sources[2].linear", l);
-      obj_shader.setf("_point_sources[3].linear", l);
-
-      obj_shader.setf("_point_sources[0].quadratic", q);
-      obj_shader.setf("_point_sources[1].quadratic", q);
-      obj_shader.setf("_point_sources[2].quadratic", q);
-      obj_shader.setf("_point_sources[3].quadratic", q);
-
-      obj_shader.setvec3("_point_sources[0].ambient", light_ambience);
-      obj_shader.setvec3("_point_sources[1].ambient", light_ambience);
-      obj_shader.setvec3("_point_sources[2].ambient", light_ambience);
-      obj_shader.setvec3("_point_sources[3].ambient", light_ambience);
-
-      obj_shader.setvec3("_point_sources[0].diffuse", light_diffuse);
-      obj_shader.setvec3("_point_sources[1].diffuse", light_diffuse);
-      obj_shader.setvec3("_point_sources[2].diffuse", light_diffuse);
-      obj_shader.setvec3("_point_sources[3].diffuse", light_diffuse);
-
-      obj_shader.setvec3("_point_sources[0].specular", light_specular);
-      obj_shader.setvec3("_point_sources[1].specular", light_specular);
-      obj_shader.setvec3("_point_sources[2].specular", light_specular);
-      obj_shader.setvec3("_point_sources[3].specular", light_specular);
-   
+      // lights sorted into clusters for this view
+      light_buffer.upload(&lights[0], lights.size());
+      light_buffer.bind(2);
+      light_grid.build(&lights[0], lights.size(), view, pool);
+      light_grid.upload();
+      light_grid.bind(obj_shader, 3, glm::vec2(s_width, s_height));
+
       obj_shader.setvec3("_dir_source.direction", glm::vec3(-0.2f, -1.0f, -0.3f));
       obj_shader.setvec3("_dir_source.ambient", glm::vec3(0.05f));
       obj_shader.setvec3("_dir_source.diffuse", glm::vec3(0.4f));
@@ -355,13 +426,49 @@ int main() {
       obj_shader.setvec3("view_pos", camera_pos);
       obj_shader.setmat4("view", view);
       obj_shader.setmat4("projection", projection);
-      for (int i = 0; i < 10; ++i) {
-         glm::mat4 model;
-         model = glm::translate(model, cube_positions[i]);
-         model = glm::rotate(model, glm::radians(20.0f * i), glm::vec3(1.0f, 0.3f, 0.5f));
-         obj_shader.setmat4("model", model);
-         
-         glDrawArrays(GL_TRIANGLES, 0, 36);            
+      // after a prepass only the closest surface of each pixel passes, and the depth is already there
+      if (prepass) {
+         glDepthFunc(GL_EQUAL);
+         glDepthMask(GL_FALSE);
+      }
+      shaded_counter.begin();
+      draw_containers(obj_shader);
+      shaded_counter.end();
+      glDepthFunc(GL_LESS);
+      glDepthMask(GL_TRUE);
+      glBindVertexArray(0);
+      gpu_timer.end();
+
+      unsigned long long samples;
+      while (shaded_counter.result(samples)) {
+         shaded += samples;
+         n_shaded++;
+      }
+      while (prepass_counter.result(samples)) {
+         prepass_samples += samples;
+         n_prepass++;
+      }
+      double ms;
+      while (gpu_timer.result(ms)) {
+         gpu_ms += ms;
+         n_gpu++;
+      }
+      double now = glfwGetTime();
+      if (now - last_report >= 1.0) {
+         std::cout << "prepass: " << (prepass ? "on" : "off")
+                   << " shaded fragments: " << (n_shaded ? shaded / n_shaded : 0);
+         // the prepass counts what a lighting pass without it would have shaded
+         if (prepass && n_prepass && n_shaded) {
+            unsigned long long without = prepass_samples / n_prepass;
+            unsigned long long with = shaded / n_shaded;
+            std::cout << " without prepass: " << without
+                      << " saved: " << (without ? 100.0 * (1.0 - (double)with / without) : 0.0) << "%";
+         }
+         std::cout << " gpu: " << (n_gpu ? gpu_ms / n_gpu : 0.0) << " ms" << std::endl;
+         shaded = prepass_samples = 0;
+         n_shaded = n_prepass = n_gpu = 0;
+         gpu_ms = 0.0;
+         last_report = now;
       }
 
       glfwSwapBuffers(window);
@@ -372,6 +479,8 @@ int main() {
    glDeleteBuffers(1, &VBO1);
    glDeleteVertexArrays(1, &VAO2);
    glDeleteBuffers(1, &VBO2);
+   glDeleteVertexArrays(1, &VAO3);
+   glDeleteBuffers(1, &VBO3);
    glfwTerminate();
 
    return 0;
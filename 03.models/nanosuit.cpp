@@ -2,6 +2,7 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <chrono>
 #include <math.h>
 
 #include <glad/glad.h>
@@ -17,6 +18,8 @@
 #include <shader.hpp>
 #include <mesh.hpp>
 #include <model.hpp>
+#include <material_batch.hpp>
+#include <scene_graph.hpp>
 
 // for adjusting camera speed
 float delta_time = 0.0f;
@@ -79,6 +82,52 @@ void process_input(GLFWwindow *window) {
       camera_pos += glm::normalize(glm::cross(camera_front, camera_up)) * camera_speed;
 }
 
+// B toggles between one draw per mesh and a single multi-draw
+bool batched = false;
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+   if (action == GLFW_PRESS && key == GLFW_KEY_B)
+      batched = !batched;
+}
+
+// the left button picks the triangle under the screen center (the cursor is hidden)
+bool pick = false;
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods) {
+   if (action == GLFW_PRESS && button == GLFW_MOUSE_BUTTON_LEFT)
+      pick = true;
+}
+
+// reference for the BVH: every triangle of every mesh, Moller-Trumbore
+bool raycast_brute_force(const Model &model, const SceneGraph &scene, unsigned int first_node,
+                         const Ray &ray, RayHit &hit) {
+   bool found = false;
+   for (size_t m = 0; m < model.meshes.size(); ++m) {
+      const Mesh &mesh = model.meshes[m];
+      const glm::mat4 &world = scene.world[first_node + model.mesh_nodes[m]];
+      for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+         glm::vec3 v0 = glm::vec3(world * glm::vec4(mesh.vertices[mesh.indices[i]].position, 1.0f));
+         glm::vec3 e1 = glm::vec3(world * glm::vec4(mesh.vertices[mesh.indices[i + 1]].position, 1.0f)) - v0;
+         glm::vec3 e2 = glm::vec3(world * glm::vec4(mesh.vertices[mesh.indices[i + 2]].position, 1.0f)) - v0;
+         glm::vec3 p = glm::cross(ray.dir, e2);
+         float det = glm::dot(e1, p);
+         if (fabs(det) <= 1e-8f)
+            continue;
+         glm::vec3 s = ray.origin - v0;
+         float u = glm::dot(s, p) / det;
+         glm::vec3 q = glm::cross(s, e1);
+         float v = glm::dot(ray.dir, q) / det;
+         float t = glm::dot(e2, q) / det;
+         if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > 0.0f && t < hit.t) {
+            hit.mesh = m;
+            hit.triangle = i / 3;
+            hit.barycentric = glm::vec2(u, v);
+            hit.t = t;
+            found = true;
+         }
+      }
+   }
+   return found;
+}
+
 float fov = 45.0f;
 void scroll_callback(GLFWwindow *window, double dx, double dy) {
    if (fov >= 1.0f && fov <= 45.0f)
@@ -113,10 +162,13 @@ int main() {
    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
    glfwSetCursorPosCallback(window, mouse_callback);
    glfwSetScrollCallback(window, scroll_callback);
+   glfwSetKeyCallback(window, key_callback);
+   glfwSetMouseButtonCallback(window, mouse_button_callback);
 
-   Shader shader("../shaders/03/shader.vs",
-                 "../shaders/03/shader.fs"
-                 );
+   // the model's textures are packed, both paths sample the texture array
+   Shader batched_shader("../shaders/03/batched.vs",
+                         "../shaders/03/batched.fs"
+                         );
    Shader light_shader("../shaders/03/light_shader.vs",
                        "../shaders/03/light_shader.fs"
                       );
@@ -182,25 +234,37 @@ int main() {
    glBindBuffer(GL_ARRAY_BUFFER, 0);
    glBindVertexArray(0);
 
-   Model model("../models/nanosuit/nanosuit.obj");
+   Model model("../models/nanosuit/nanosuit.obj", MODEL_PACK_TEXTURES | MODEL_RAYCAST);
+   MaterialBatch batch(model);
+   std::cout << "B toggles batching: " << model.meshes.size() << " draws per frame, "
+             << "batched: 1 multi-draw of " << batch.draw_count() << " meshes"
+             << std::endl;
+
+   // the suit's imported node hierarchy hangs below a placement node
+   SceneGraph scene;
+   glm::mat4 placement;
+   placement = glm::translate(placement, glm::vec3(0.0f, -1.75f, 0.0f));
+   placement = glm::scale(placement, glm::vec3(0.2f));
+   unsigned int suit = scene.add_node(-1, placement, "suit");
+   unsigned int suit_nodes = scene.append(model.nodes, suit);
 
    glm::vec3 light_ambience(0.05f);
    glm::vec3 light_diffuse(0.8f);
    glm::vec3 light_specular(0.5f);
    glm::vec3 light_position(0.7f, 0.2f, 2.0f);
 
-   shader.use();
-   shader.setvec3("_dir_source.direction", glm::vec3(-0.2f, -1.0f, -0.3f));
-   shader.setvec3("_dir_source.ambient", glm::vec3(0.05f));
-   shader.setvec3("_dir_source.diffuse", glm::vec3(0.4f));
-   shader.setvec3("_dir_source.specular", glm::vec3(1.0f));
+   batched_shader.use();
+   batched_shader.setvec3("_dir_source.direction", glm::vec3(-0.2f, -1.0f, -0.3f));
+   batched_shader.setvec3("_dir_source.ambient", glm::vec3(0.05f));
+   batched_shader.setvec3("_dir_source.diffuse", glm::vec3(0.4f));
+   batched_shader.setvec3("_dir_source.specular", glm::vec3(1.0f));
 
-   shader.setf("_point_source.constant", 1.0f);
-   shader.setf("_point_source.linear", 0.09);
-   shader.setf("_point_source.quadratic", 0.032);
-   shader.setvec3("_point_source.ambient", light_ambience);
-   shader.setvec3("_point_source.diffuse", light_diffuse);
-   shader.setvec3("_point_source.specular", light_specular);
+   batched_shader.setf("_point_source.constant", 1.0f);
+   batched_shader.setf("_point_source.linear", 0.09);
+   batched_shader.setf("_point_source.quadratic", 0.032);
+   batched_shader.setvec3("_point_source.ambient", light_ambience);
+   batched_shader.setvec3("_point_source.diffuse", light_diffuse);
+   batched_shader.setvec3("_point_source.specular", light_specular);
 
    while (!glfwWindowShouldClose(window)) {
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -227,21 +291,47 @@ int main() {
       // glBindVertexArray(0);
 
       // crysis model
-      shader.use();
-      shader.setvec3("view_pos", camera_pos);
+      batched_shader.use();
+      batched_shader.setvec3("view_pos", camera_pos);
       process_input(window);
 
-      shader.setmat4("projection", projection);
-      shader.setmat4("view", view);
-      shader.setvec3("_point_source.position", light_position);
-
-      glm::mat4 wmodel;
-      // wmodel = glm::rotate(wmodel, (float)glfwGetTime(), glm::vec3(0.0f, 1.0f, 0.0f));
-      wmodel = glm::translate(wmodel, glm::vec3(0.0f, -1.75f, 0.0f));
-      wmodel = glm::scale(wmodel, glm::vec3(0.2f));
-      shader.setmat4("model", wmodel);
-
-      model.draw(shader);
+      batched_shader.setmat4("projection", projection);
+      batched_shader.setmat4("view", view);
+      batched_shader.setvec3("_point_source.position", light_position);
+
+      // scene.set_local(suit, glm::rotate(placement, (float)glfwGetTime(), glm::vec3(0.0f, 1.0f, 0.0f)));
+      scene.update();
+
+      if (pick) {
+         typedef std::chrono::high_resolution_clock clock;
+         Ray ray(camera_pos, camera_front);
+         RayHit hit, reference;
+         clock::time_point start = clock::now();
+         bool found = model.raycast(ray, scene, suit_nodes, hit);
+         std::chrono::duration<double, std::micro> bvh_us = clock::now() - start;
+         start = clock::now();
+         raycast_brute_force(model, scene, suit_nodes, ray, reference);
+         std::chrono::duration<double, std::micro> brute_us = clock::now() - start;
+
+         if (found)
+            std::cout << "picked mesh " << hit.mesh << " triangle " << hit.triangle
+                      << " barycentric (" << hit.barycentric.x << ", " << hit.barycentric.y << ")"
+                      << " at " << hit.t;
+         else
+            std::cout << "picked nothing";
+         std::cout << " in " << bvh_us.count() << " us (brute force " << brute_us.count()
+                   << " us, mesh " << reference.mesh << " triangle " << reference.triangle << ")"
+                   << std::endl;
+         pick = false;
+      }
+
+      // the batch has the node transforms baked in, it only needs the placement
+      if (batched) {
+         batched_shader.setmat4("model", scene.world[suit]);
+         batch.draw(batched_shader);
+      } else {
+         batch.draw_meshes(batched_shader, model, scene, suit_nodes);
+      }
 
 
       glfwSwapBuffers(window);
@@ -1,7 +1,15 @@
 /*
   0. This stencil test has the possibility of discarding fragments similar to depth test
   1. This test is based on a buffer called the stencil buffer that one can update during rendering
-  2. 
+  2. Outlining selected objects with it means drawing each of them a second time, scaled up,
+     where the stencil isn't set: twice the vertex work, growing with the selection
+  3. Instead the selected objects write an id next to their color and one full screen pass
+     draws an outline wherever another id is close (outline.hpp), the same cost for any selection
+
+  keys:
+    1 - 9 : select / deselect a container
+    0 : select / deselect all
+    O : outline on / off
 */
 
 #include <string>
@@ -24,6 +32,7 @@
 #include <mesh.hpp>
 #include <model.hpp>
 #include <camera.hpp>
+#include <outline.hpp>
 
 // for adjusting camera speed
 float delta_time = 0.0f;
@@ -70,6 +79,27 @@ void scroll_callback(GLFWwindow *window, double dx, double dy) {
   camera.process_scroll(dy);
 }
 
+// a 3x3 grid of containers, any of them can be selected
+const int N_CONTAINERS = 9;
+bool selected[N_CONTAINERS] = { true, false, false, false, true, false, false, false, false };
+bool outline_on = true;
+
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+   if (action != GLFW_PRESS)
+      return;
+   if (key >= GLFW_KEY_1 && key < GLFW_KEY_1 + N_CONTAINERS) {
+      selected[key - GLFW_KEY_1] = !selected[key - GLFW_KEY_1];
+   } else if (key == GLFW_KEY_0) {
+      bool all = true;
+      for (int i = 0; i < N_CONTAINERS; ++i)
+         all = all && selected[i];
+      for (int i = 0; i < N_CONTAINERS; ++i)
+         selected[i] = !all;
+   } else if (key == GLFW_KEY_O) {
+      outline_on = !outline_on;
+   }
+}
+
 unsigned int texture_from_file(
    const char *path) {
    
@@ -136,9 +166,11 @@ int main() {
    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
    glfwSetCursorPosCallback(window, mouse_callback);
    glfwSetScrollCallback(window, scroll_callback);
+   glfwSetKeyCallback(window, key_callback);
 
+   // shaders/04/shader.fs that also writes the selection id
    Shader shader("../shaders/04/shader.vs",
-                 "../shaders/04/shader.fs"
+                 "../shaders/04.advanced/02_outline_id.fs"
                  );
 
     float cube_vertices[] = {
@@ -229,8 +261,18 @@ int main() {
     unsigned int floor_texture = texture_from_file("../texture/metal.png");
     unsigned int container_texture = texture_from_file("../texture/marble.jpg");
 
+   glfwGetFramebufferSize(window, &s_width, &s_height);
+   SelectionOutline outline("../shaders/04.advanced/", s_width, s_height);
+
    while (!glfwWindowShouldClose(window)) {
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+      glfwGetFramebufferSize(window, &s_width, &s_height);
+      if (s_width == 0 || s_height == 0) {
+         glfwPollEvents();
+         continue;
+      }
+      outline.resize(s_width, s_height);
+      outline.enabled = outline_on;
+      outline.begin();
 
         process_input(window);
 
@@ -247,6 +289,7 @@ int main() {
       shader.setmat4("view", view);
       shader.setmat4("projection", projection);
       shader.setmat4("model", glm::mat4());
+      SelectionOutline::set_id(shader, 0);
       glDrawArrays(GL_TRIANGLES, 0, 6);
       glBindVertexArray(0);
 
@@ -256,16 +299,18 @@ int main() {
       glBindTexture(GL_TEXTURE_2D, container_texture);
       shader.setmat4("view", view);
       shader.setmat4("projection", projection);
-      glm::mat4 model;
-      model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
-      shader.setmat4("model", model);
-      glDrawArrays(GL_TRIANGLES, 0, 36);
-      model = glm::mat4();
-      model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
-      shader.setmat4("model", model);
-      glDrawArrays(GL_TRIANGLES, 0, 36);
+      for (int i = 0; i < N_CONTAINERS; ++i) {
+         glm::mat4 model;
+         model = glm::translate(model, glm::vec3((i % 3 - 1) * 2.0f, 0.0f, (i / 3 - 1) * 2.0f));
+         shader.setmat4("model", model);
+         SelectionOutline::set_id(shader, selected[i] ? i + 1 : 0);
+         glDrawArrays(GL_TRIANGLES, 0, 36);
+      }
       glBindVertexArray(0);
 
+      // one pass over the ids, however many containers are selected
+      outline.present(0);
+
       glfwSwapBuffers(window);
       glfwPollEvents();
    }
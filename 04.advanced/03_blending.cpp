@@ -10,11 +10,21 @@
      Initially nothing is rendered. when the first fragment is rendered (it becomes the source)
      Setting glBlendFunc(GL_ONE, GL_ZERO); => properly renders
      Setting glBlendFunc(GL_ZERO, GL_ONE); => nothing is rendered
+
+  1. Transparent objects have to be drawn back to front. They are sorted with a
+     radix sort on quantised distances (transparency.hpp) and drawn as instances
+     in that order; 15_transparency.cpp scales the same path to 100k+ quads.
+
+  2. Weighted blended OIT (oit.hpp) needs no sort at all: transparent surfaces
+     are accumulated in any order and resolved in a full screen pass.
+
+     keys:
+       1 : sorted blending
+       2 : weighted blended OIT
 */
 
 #include <string>
 #include <vector>
-#include <map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -34,6 +44,9 @@
 #include <mesh.hpp>
 #include <model.hpp>
 #include <camera.hpp>
+#include <gl_ext.hpp>
+#include <transparency.hpp>
+#include <oit.hpp>
 
 // for adjusting camera speed
 float delta_time = 0.0f;
@@ -45,6 +58,7 @@ double x_last = 400.0f;
 double y_last = 300.0f;
 
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+bool use_oit = false;
 
 void mouse_callback(GLFWwindow *window, double x_new, double y_new) {
    if (first_mouse) {
@@ -80,6 +94,15 @@ void scroll_callback(GLFWwindow *window, double dx, double dy) {
   camera.process_scroll(dy);
 }
 
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+  if (action != GLFW_PRESS)
+    return;
+  if (key == GLFW_KEY_1)
+    use_oit = false;
+  else if (key == GLFW_KEY_2)
+    use_oit = true;
+}
+
 unsigned int texture_from_file(
    const char *path) {
    
@@ -141,6 +164,7 @@ int main() {
       std::cout << "Failed to initialize GLAD" << std::endl;
       return -1;
    }
+   glext::load((GLADloadproc)glfwGetProcAddress);
 
    // Enable the depth buffer
    glEnable(GL_DEPTH_TEST);
@@ -153,10 +177,21 @@ int main() {
    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
    glfwSetCursorPosCallback(window, mouse_callback);
    glfwSetScrollCallback(window, scroll_callback);
+   glfwSetKeyCallback(window, key_callback);
 
    Shader shader("../shaders/04.advanced/04_blending.vs",
                  "../shaders/04.advanced/04_blending.fs"
                  );
+   Shader shader_sorted("../shaders/04.advanced/15_transparent.vs",
+                        "../shaders/04.advanced/04_blending.fs"
+                        );
+   Shader shader_oit("../shaders/04.advanced/15_transparent.vs",
+                     "../shaders/04.advanced/16_oit.fs"
+                     );
+   Shader shader_composite("../shaders/04.advanced/13_hiz.vs",
+                           "../shaders/04.advanced/16_oit_composite.fs"
+                           );
+   WeightedOIT oit(s_width, s_height);
 
     float cube_vertices[] = {
         // positions          // texture Coords
@@ -232,6 +267,13 @@ int main() {
    vegetation.push_back(glm::vec3(-0.3f, 0.0f, -2.30f));
    vegetation.push_back(glm::vec3( 0.5f, 0.0f, -0.60f));
 
+   // per instance: position and scale
+   std::vector<glm::vec4> vegetation_instances;
+   for (size_t i = 0; i < vegetation.size(); ++i)
+      vegetation_instances.push_back(glm::vec4(vegetation[i], 1.0f));
+   TransparencySorter sorter(vegetation.size());
+   TransparentInstances sorted_instances(vegetation.size());
+
    // containers
    unsigned int VAO_container, VBO_container;
    glGenVertexArrays(1, &VAO_container);
@@ -273,9 +315,14 @@ int main() {
    glEnableVertexAttribArray(1);
    glBindBuffer(GL_ARRAY_BUFFER, 0);
    glBindVertexArray(0);
+   sorted_instances.setup(VAO_grass, 2);
 
     shader.use();
     shader.seti("texture_sampler", 0);
+    shader_sorted.use();
+    shader_sorted.seti("texture_sampler", 0);
+    shader_oit.use();
+    shader_oit.seti("texture_sampler", 0);
 
     unsigned int floor_texture = texture_from_file("../texture/metal.png");
     unsigned int container_texture = texture_from_file("../texture/marble.jpg");
@@ -283,7 +330,10 @@ int main() {
     unsigned int grass_texture = texture_from_file("../texture/blending_transparent_window.png");
 
    while (!glfwWindowShouldClose(window)) {
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      if (use_oit)
+         oit.begin_opaque();
+      else
+         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         process_input(window);
 
@@ -319,33 +369,37 @@ int main() {
       glDrawArrays(GL_TRIANGLES, 0, 36);
       glBindVertexArray(0);
 
-      // grass
-      glBindVertexArray(VAO_grass);
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, grass_texture);
-      shader.setmat4("view", view);
-      shader.setmat4("projection", projection);
-      // for (int i = 0; i < vegetation.size(); ++i) {
-      //   glm::mat4 model = glm::mat4();
-      //   model = glm::translate(model, vegetation[i]);
-      //   shader.setmat4("model", model);
-      //   glDrawArrays(GL_TRIANGLES, 0, 6);
-      // }
-      // glBindVertexArray(0);
-
-      std::map<float, glm::vec3> sorted;
-      for (size_t i = 0; i < vegetation.size(); ++i) {
-        float distance = glm::length(camera.position - vegetation[i]);
-        sorted[distance] = vegetation[i];
-      }
-
-      for(std::map<float, glm::vec3>::reverse_iterator itr = sorted.rbegin();
-        itr != sorted.rend(); ++itr) {
-        glm::mat4 model = glm::mat4();
-        model = glm::translate(model, itr->second);
-        shader.setmat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+      if (use_oit) {
+         // windows, in any order
+         oit.begin_transparent();
+         shader_oit.use();
+         shader_oit.setmat4("view", view);
+         shader_oit.setmat4("projection", projection);
+         glActiveTexture(GL_TEXTURE0);
+         glBindTexture(GL_TEXTURE_2D, grass_texture);
+         sorter.identity(vegetation.size());
+         if (sorted_instances.upload(sorter, &vegetation_instances[0])) {
+            sorted_instances.draw(VAO_grass, 2, sorter.runs[0], GL_TRIANGLES, 0, 6);
+            glBindVertexArray(0);
+         }
+         oit.composite(shader_composite);
+         oit.present(0);
+         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      } else {
+         // windows, farthest first
+         sorter.sort(&vegetation[0], NULL, vegetation.size(), camera.position);
+         if (sorted_instances.upload(sorter, &vegetation_instances[0])) {
+            shader_sorted.use();
+            shader_sorted.setmat4("view", view);
+            shader_sorted.setmat4("projection", projection);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, grass_texture);
+            for (size_t i = 0; i < sorter.runs.size(); ++i)
+               sorted_instances.draw(VAO_grass, 2, sorter.runs[i], GL_TRIANGLES, 0, 6);
+            glBindVertexArray(0);
+         }
       }
+      sorted_instances.end_frame();
 
       glfwSwapBuffers(window);
       glfwPollEvents();
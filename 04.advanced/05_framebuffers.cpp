@@ -11,6 +11,24 @@
  *  2. all the subsequent rendering will influence the currently bound frame buffer
  *  3. if the depth and stencil buffers are not attached to the framebuffer object, they'll not work
  *  4. so make sure there are all the basics buffers attached to the currently bound framebuffer object
+ *
+ * post processing: the scene goes into a pooled render target (render_target_pool.hpp)
+ * and through a chain of full screen passes (post_process.hpp) on its way to the window.
+ * targets are handed out per frame by size, so resizing the window just works.
+ *
+ * frame graph: the frame is declared as passes and the targets they read and write
+ * (frame_graph.hpp). the graph orders them, culls the ones whose results nobody uses
+ * (the rear view mirror when it's hidden) and hands the targets out of the pool only
+ * for as long as they're needed.
+ *
+ *  keys:
+ *    1 / 2 / 3 / 4 : toggle blur / sharpen / edge / grayscale
+ *    5             : toggle FXAA
+ *    N             : 4x MSAA on / off (the scene is drawn multisampled, then resolved)
+ *    UP / DOWN     : blur radius
+ *    H             : blur at full / half resolution
+ *    M             : rear view mirror
+ *    G             : print the frame graph
  */
 
 
@@ -34,6 +52,9 @@
 #include <mesh.hpp>
 #include <model.hpp>
 #include <camera.hpp>
+#include <render_target_pool.hpp>
+#include <post_process.hpp>
+#include <frame_graph.hpp>
 
 // for adjusting camera speed
 float delta_time = 0.0f;
@@ -46,6 +67,64 @@ double y_last = 300.0f;
 
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 
+int s_width = 1400, s_height = 720;
+
+// post chain, indices of the passes in `post.passes`
+PostChain *post = NULL;
+size_t blur_pass, sharpen_pass, edge_pass, grayscale_pass, fxaa_pass;
+int msaa_samples = 0, max_samples = 0;
+bool show_mirror = true;
+bool print_graph = true;
+
+void frame_buffer_size_callback(GLFWwindow *window, int width, int height) {
+   s_width = width;
+   s_height = height;
+   print_graph = true;
+}
+
+void print_chain() {
+   const char *names[] = { "blur", "sharpen", "edge", "grayscale", "fxaa" };
+   std::cout << "msaa: " << msaa_samples << "x post:";
+   for (size_t i = 0; i < post->passes.size(); ++i) {
+      const PostPass &pass = post->passes[i];
+      if (pass.enabled)
+         std::cout << " " << names[pass.effect] << "(x" << pass.scale << ", " << pass.param << ")";
+   }
+   std::cout << std::endl;
+}
+
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+   if (action != GLFW_PRESS)
+      return;
+   std::vector<PostPass> &passes = post->passes;
+   if (key == GLFW_KEY_1)
+      passes[blur_pass].enabled = !passes[blur_pass].enabled;
+   else if (key == GLFW_KEY_2)
+      passes[sharpen_pass].enabled = !passes[sharpen_pass].enabled;
+   else if (key == GLFW_KEY_3)
+      passes[edge_pass].enabled = !passes[edge_pass].enabled;
+   else if (key == GLFW_KEY_4)
+      passes[grayscale_pass].enabled = !passes[grayscale_pass].enabled;
+   else if (key == GLFW_KEY_5)
+      passes[fxaa_pass].enabled = !passes[fxaa_pass].enabled;
+   else if (key == GLFW_KEY_N)
+      msaa_samples = msaa_samples == 0 ? std::min(4, max_samples) : 0;
+   else if (key == GLFW_KEY_UP && passes[blur_pass].param < 31.0f)
+      passes[blur_pass].param += 1.0f;
+   else if (key == GLFW_KEY_DOWN && passes[blur_pass].param > 1.0f)
+      passes[blur_pass].param -= 1.0f;
+   else if (key == GLFW_KEY_H)
+      passes[blur_pass].scale = passes[blur_pass].scale < 1.0f ? 1.0f : 0.5f;
+   else if (key == GLFW_KEY_M)
+      show_mirror = !show_mirror;
+   else if (key == GLFW_KEY_G)
+      print_graph = true;
+   else
+      return;
+   print_chain();
+   print_graph = true;
+}
+
 void mouse_callback(GLFWwindow *window, double x_new, double y_new) {
    if (first_mouse) {
       x_last = x_new;
@@ -117,7 +196,6 @@ unsigned int texture_from_file(
 }
 
 int main() {
-   int s_width = 1400, s_height = 720;
    glfwInit();
    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -141,44 +219,43 @@ int main() {
    // Manually control the depth test function
    glDepthFunc(GL_LESS);
 
-   // framebuffer object
-   unsigned int fbo;
-   glGenFramebuffers(1, &fbo);
-   glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-
-   // texture attachment
-   unsigned int tex;
-   glGenTextures(1, &tex);
-   glBindTexture(GL_TEXTURE_2D, tex);
-   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, s_width, s_height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-   glBindTexture(GL_TEXTURE_2D, 0);
-   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
-
-   // depth and stencil attachment (good when using write-only buffers)
-   unsigned int rbo;
-   glGenRenderbuffers(1, &rbo);
-   glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-   glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, s_width, s_height);
-   glBindRenderbuffer(GL_RENDERBUFFER, 0);
-   glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
-
-   if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-   	   std::cerr << "ERROR: Framebuffer not complete." << std::endl;
-   glBindFramebuffer(GL_FRAMEBUFFER, 0); 
-   //be sure to unbind the framebuffer to make sure we're not rendering to the wrong buffer
-
    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
    glfwSetCursorPosCallback(window, mouse_callback);
    glfwSetScrollCallback(window, scroll_callback);
+   glfwSetKeyCallback(window, key_callback);
+   glfwSetFramebufferSizeCallback(window, frame_buffer_size_callback);
+   // the framebuffer can be larger than the window (high dpi screens)
+   glfwGetFramebufferSize(window, &s_width, &s_height);
 
    Shader shader("../shaders/04.advanced/05_normal.vs",
                  "../shaders/04.advanced/05_normal.fs"
                  );
-   Shader screen_shader("../shaders/04.advanced/05_screen.vs",
-                 		"../shaders/04.advanced/05_screen.fs"
-                 		);
+
+   // draws a texture over the viewport, for the mirror
+   Shader quad_shader("../shaders/04.advanced/05_post.vs",
+                      "../shaders/04.advanced/05_normal.fs"
+                      );
+   quad_shader.use();
+   quad_shader.seti("texture_sampler", 0);
+   unsigned int empty_VAO;
+   glGenVertexArrays(1, &empty_VAO);
+
+   // every target of the frame comes from here, released ones are reused by the next pass
+   RenderTargetPool pool;
+   FrameGraph graph(pool);
+   post = new PostChain("../shaders/04.advanced/");
+   blur_pass = post->add(POST_BLUR, 0.5f, 6.0f);
+   sharpen_pass = post->add(POST_SHARPEN, 1.0f, 1.0f);
+   edge_pass = post->add(POST_EDGE, 1.0f);
+   grayscale_pass = post->add(POST_GRAYSCALE, 1.0f, 1.0f);
+   // antialiasing goes last, on the colors that end up on screen
+   fxaa_pass = post->add(POST_FXAA);
+   post->passes[fxaa_pass].enabled = false;
+   glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+   post->passes[sharpen_pass].enabled = false;
+   post->passes[edge_pass].enabled = false;
+   post->passes[grayscale_pass].enabled = false;
+   print_chain();
 
     float cube_vertices[] = {
         // positions          // texture Coords
@@ -236,17 +313,6 @@ int main() {
          5.0f, -0.52f, -5.0f,  2.0f, 2.0f
     };
 
-    float quad_vertices[] = {
-		// positions 		// texture coords
-	   -1.0f,  1.0f, 0.0f,   0.0f, 1.0f,
-	   -1.0f, -1.0f, 0.0f,   0.0f, 0.0f,
-		1.0f, -1.0f, 0.0f, 	1.0f, 0.0f,
-
-	   -1.0f,  1.0f, 0.0f,   0.0f, 1.0f,
-		1.0f, -1.0f, 0.0f, 	1.0f, 0.0f,
-		1.0f,  1.0f, 0.0f, 	1.0f, 1.0f,
-    };
-
    // container
    unsigned int VAO_container, VBO_container;
    glGenVertexArrays(1, &VAO_container);
@@ -273,36 +339,16 @@ int main() {
    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(3 * sizeof(float)));
    glEnableVertexAttribArray(1);
    glBindBuffer(GL_ARRAY_BUFFER, 0);
-   glBindVertexArray(0);
-
-   // quad
-   unsigned int VAO_quad, VBO_quad;
-   glGenVertexArrays(1, &VAO_quad);
-   glGenBuffers(1, &VBO_quad);
-   glBindVertexArray(VAO_quad);
-   glBindBuffer(GL_ARRAY_BUFFER, VBO_quad);
-   glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertices), &quad_vertices, GL_STATIC_DRAW);
-   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
-   glEnableVertexAttribArray(0);
-   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(3 * sizeof(float)));
-   glEnableVertexAttribArray(1);
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
    glBindVertexArray(0);
 
     shader.use();
     shader.seti("texture_sampler", 0);
 
-    screen_shader.use();
-    screen_shader.seti("texture_sampler", 0);
-
     unsigned int floor_texture = texture_from_file("../texture/metal.png");
     unsigned int container_texture = texture_from_file("../texture/container.jpg");
 
-   while (!glfwWindowShouldClose(window)) {
-      process_input(window);
-
-      // Make our custom framebuffer object as the active framebuffer object
-      glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+   // draws into whatever framebuffer is bound
+   auto draw_scene = [&](const glm::mat4 &view, const glm::mat4 &projection) {
       glEnable(GL_DEPTH_TEST);
       glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -312,12 +358,6 @@ int main() {
       // case was an emply memory initialized buffer.
       // That (empty) color buffer will now be filled with the objects' color as 2D image
       shader.use();
-      glEnable(GL_DEPTH_TEST);
-      glm::mat4 projection;
-      projection = glm::perspective(glm::radians(camera.zoom), 
-      								(float)s_width/s_height, 
-      								0.1f, 100.0f);
-      glm::mat4 view = camera.get_view_matrix();
       // floor
       glBindVertexArray(VAO_plane);
       glActiveTexture(GL_TEXTURE0);
@@ -332,8 +372,6 @@ int main() {
       glBindVertexArray(VAO_container);
       glActiveTexture(GL_TEXTURE0);
       glBindTexture(GL_TEXTURE_2D, container_texture);
-      shader.setmat4("view", view);
-      shader.setmat4("projection", projection);
       glm::mat4 model;
       model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
       shader.setmat4("model", model);
@@ -343,29 +381,92 @@ int main() {
       shader.setmat4("model", model);
       glDrawArrays(GL_TRIANGLES, 0, 36);
       glBindVertexArray(0);
+   };
 
-      // make our framebuffer object as the default framebuffer object
-      glBindFramebuffer(GL_FRAMEBUFFER, 0);
-      glDisable(GL_DEPTH_TEST); // TODO: i think this shouldn't have any effect. but it seems to have look out.
-      glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-      glClear(GL_COLOR_BUFFER_BIT);
+   while (!glfwWindowShouldClose(window)) {
+      process_input(window);
+      glfwPollEvents();
+      // minimized
+      if (s_width == 0 || s_height == 0)
+         continue;
 
-      screen_shader.use();
-      glBindVertexArray(VAO_quad);
-      glBindTexture(GL_TEXTURE_2D, tex);
-      glDrawArrays(GL_TRIANGLES, 0, 6);
+      glm::mat4 projection;
+      projection = glm::perspective(glm::radians(camera.zoom), 
+      								(float)s_width/s_height, 
+      								0.1f, 100.0f);
+      glm::mat4 view = camera.get_view_matrix();
+      // the mirror looks backwards, flipped left to right like a real one
+      glm::mat4 mirror_view = glm::scale(glm::mat4(), glm::vec3(-1.0f, 1.0f, 1.0f)) *
+                              glm::lookAt(camera.position, camera.position - camera.front, camera.up);
+
+      // the frame as a graph: what each pass reads and writes, the graph does the rest.
+      // the mirror pass is always declared, it's culled when nothing reads its target
+      graph.reset();
+      FgResource backbuffer = graph.import_target("backbuffer", 0, 0, s_width, s_height);
+      // with MSAA the scene is drawn multisampled and resolved into the target the post chain reads
+      FgResource scene = graph.create("scene", s_width, s_height, GL_RGBA8, msaa_samples == 0);
+      FgResource scene_ms = graph.create("scene msaa", s_width, s_height, GL_RGBA8, true, msaa_samples);
+      FgResource mirror = graph.create("mirror", std::max(1, s_width / 3), std::max(1, s_height / 5),
+                                       GL_RGBA8, true);
+      graph.add_pass("scene", FgReads(), msaa_samples ? scene_ms : scene, [&]() {
+         draw_scene(view, projection);
+      });
+      if (msaa_samples) {
+         graph.add_pass("resolve", FgReads(1, scene_ms), scene, [&]() {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, graph.fbo(scene_ms));
+            glBlitFramebuffer(0, 0, s_width, s_height, 0, 0, s_width, s_height,
+                              GL_COLOR_BUFFER_BIT, GL_NEAREST);
+         });
+      }
+      graph.add_pass("mirror", FgReads(), mirror, [&]() {
+         draw_scene(mirror_view, glm::perspective(glm::radians(camera.zoom),
+                                                  (float)graph.width(mirror) / graph.height(mirror),
+                                                  0.1f, 100.0f));
+      });
+      // the post chain reads the scene and writes the window
+      graph.add_pass("post", FgReads(1, scene), backbuffer, [&]() {
+         post->run(pool, graph.texture(scene), s_width, s_height, 0, s_width, s_height);
+      });
+      if (show_mirror) {
+         // same target as "post", so no framebuffer switch in between
+         graph.add_pass("mirror composite", FgReads(1, mirror), backbuffer, [&]() {
+            int w = graph.width(mirror), h = graph.height(mirror);
+            glViewport((s_width - w) / 2, s_height - h - 10, w, h);
+            glDisable(GL_DEPTH_TEST);
+            quad_shader.use();
+            glBindVertexArray(empty_VAO);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, graph.texture(mirror));
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(0);
+            glViewport(0, 0, s_width, s_height);
+         });
+      }
+      graph.output(backbuffer);
+      graph.compile();
+      graph.execute();
+      pool.end_frame();
+
+      if (print_graph) {
+         std::cout << "graph: " << graph.describe()
+                   << " (" << graph.n_culled << " culled, " << graph.n_fbo_binds << " fbo binds)"
+                   << " transient: " << graph.transient_bytes / 1048576.0 << " MB"
+                   << " peak: " << graph.peak_bytes / 1048576.0 << " MB"
+                   << " pool: " << pool.bytes() / 1048576.0 << " MB" << std::endl;
+         print_graph = false;
+      }
 
       glfwSwapBuffers(window);
-      glfwPollEvents();
    }
    
    glDeleteVertexArrays(1, &VAO_container);
-   glDeleteVertexArrays(1, &VAO_quad);
    glDeleteVertexArrays(1, &VAO_plane);
+   glDeleteVertexArrays(1, &empty_VAO);
    glDeleteBuffers(1, &VBO_container);
-   glDeleteBuffers(1, &VBO_quad);
    glDeleteBuffers(1, &VBO_plane);
 
+   delete post;
+   pool.clear();
    glfwTerminate();
    return 0;
 }
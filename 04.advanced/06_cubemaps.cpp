@@ -19,10 +19,34 @@
  *         - you should disable the translation for the skybox which gives as illusion
  *              that even though we are moving close to the sceen, we are not moving at all
  *
+ * image based lighting: - the faces are decoded on all cores and filtered once on the
+ *              CPU (environment_map.hpp): a mip chain prefiltered for growing roughness
+ *              and 9 spherical harmonics coefficients for the diffuse ambient
+ *         - the results are cached in skybox_nature.env next to the binary, delete
+ *              it to filter again (changed faces are picked up on their own)
+ *         - the boxes go from a mirror (-x) to fully rough (+x), each one is
+ *              a textureLod and a few multiply-adds
+ *         - M toggles between metal and a white dielectric
+ *
+ * reflection probes: - each box reflects a cube map rendered from its center
+ *              (reflection_probe.hpp), so the cubes flying around show up in it
+ *         - the scene goes into all the faces a probe needs in one draw: 06_probe.gs
+ *              sends every triangle to the faces it is seen from with gl_Layer
+ *         - faces are updated round robin, as many per frame as fit in 1 ms of GPU
+ *              time, instead of 5 probes x 6 faces of scene each frame
+ *         - probe mips are only box filtered (glGenerateMipmap), sampled at the
+ *              same roughness levels as the prefiltered environment: the rough
+ *              boxes blur the probe approximately, not with a GGX lobe
+ *         - P toggles probes / static environment, B the budget (off: every face of
+ *              every probe each frame), I prints the probe timings
+ *
  */
 
 #include "shader.hpp"
 #include "camera.hpp"
+#include "job_system.hpp"
+#include "environment_map.hpp"
+#include "reflection_probe.hpp"
 
 #include <string>
 #include <fstream>
@@ -87,8 +111,24 @@ void scroll_callback(GLFWwindow *window, double dx, double dy) {
   camera.process_scroll(dy);
 }
 
-unsigned int load_cubemap(std::vector<std::string> );
-unsigned int texture_from_file(const char *);
+bool metallic = true;
+bool use_probes = true;
+bool probe_budget = true;
+bool print_probes = false;
+
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+   if (action != GLFW_PRESS)
+      return;
+   if (key == GLFW_KEY_M)
+      metallic = !metallic;
+   else if (key == GLFW_KEY_P)
+      use_probes = !use_probes;
+   else if (key == GLFW_KEY_B)
+      probe_budget = !probe_budget;
+   else if (key == GLFW_KEY_I)
+      print_probes = true;
+}
+
 
 int main() {
    int s_width = 1400, s_height = 720;
@@ -114,6 +154,7 @@ int main() {
    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
    glfwSetCursorPosCallback(window, mouse_callback);
    glfwSetScrollCallback(window, scroll_callback);
+   glfwSetKeyCallback(window, key_callback);
 
    Shader shader_skybox("../shaders/04.advanced/06_skybox.vs",
                         "../shaders/04.advanced/06_skybox.fs"
@@ -317,12 +358,59 @@ int main() {
     // shader_box.use();
     // shader_box.seti("texture_sampler", 0);
 
+    ThreadPool pool;
+    EnvironmentMap env;
+    if (env.load(faces, "skybox_nature.env", pool))
+       std::cout << "environment: decoded in " << env.decode_ms << " ms on " << pool.size()
+                 << " threads, " << (env.from_cache ? "read from cache in " : "prefiltered in ")
+                 << env.filter_ms << " ms" << std::endl;
+
     // for reflective rendering
     shader_box.use();
-    shader_box.seti("skybox", 0);
+    shader_box.seti("environment", 0);
+    env.set_uniforms(shader_box);
+
+    // moving objects, drawn to the screen and into the probes
+    Shader shader_object("../shaders/04.advanced/06_object.vs",
+                         "../shaders/04.advanced/06_object.fs");
+    Shader shader_probe("../shaders/04.advanced/06_object.vs",
+                        "../shaders/04.advanced/06_object.fs",
+                        "../shaders/04.advanced/06_probe.gs");
+    glm::vec3 sun_dir = glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f));
+    Shader *object_shaders[] = { &shader_object, &shader_probe };
+    for (int i = 0; i < 2; ++i) {
+       object_shaders[i]->use();
+       object_shaders[i]->seti("skybox", 0);
+       object_shaders[i]->seti("sky", 0);
+       object_shaders[i]->setvec3("sun_dir", sun_dir);
+       env.set_uniforms(*object_shaders[i]);
+    }
 
-    unsigned int cubemap_texture = load_cubemap(faces);
-    unsigned int bbox_texture = texture_from_file("../texture/marble.jpg");
+    const int n_boxes = 5, n_movers = 6;
+    const glm::vec3 mover_colors[n_movers] = {
+       glm::vec3(0.8f, 0.1f, 0.1f), glm::vec3(0.1f, 0.6f, 0.1f), glm::vec3(0.1f, 0.2f, 0.8f),
+       glm::vec3(0.8f, 0.7f, 0.1f), glm::vec3(0.6f, 0.1f, 0.7f), glm::vec3(0.1f, 0.7f, 0.7f)
+    };
+    ProbeSet probes(128, 1.0f);
+    for (int i = 0; i < n_boxes; ++i)
+       probes.add(glm::vec3((i - 2) * 3.5f, 0.0f, 0.0f));
+
+    auto draw_movers = [&](Shader &shader) {
+       float t = glfwGetTime();
+       glBindVertexArray(VAO_container);
+       for (int i = 0; i < n_movers; ++i) {
+          float angle = 0.7f * t + i * 2.0f * 3.14159265f / n_movers;
+          glm::mat4 model;
+          model = glm::translate(model, glm::vec3(4.5f * cos(angle), 2.2f + 0.5f * sin(1.3f * t + i), 4.5f * sin(angle)));
+          model = glm::rotate(model, t + i, glm::vec3(0.3f, 1.0f, 0.5f));
+          model = glm::scale(model, glm::vec3(0.8f));
+          shader.setmat4("model", model);
+          shader.setvec3("color", mover_colors[i]);
+          glDrawArrays(GL_TRIANGLES, 0, 36);
+       }
+       glBindVertexArray(0);
+    };
+    glm::vec3 albedo;
 
    while (!glfwWindowShouldClose(window)) {
 
@@ -341,20 +429,82 @@ int main() {
                                     (float)s_width/s_height, 
                                     0.1f, 100.0f);
       glm::mat4 view = camera.get_view_matrix(MOVING);
-
-      // render container
+      albedo = metallic ? glm::vec3(1.0f, 0.78f, 0.34f) : glm::vec3(0.9f);
+
+      // refresh the faces of the probes due this frame
+      if (use_probes) {
+         probes.adapt = probe_budget;
+         if (!probe_budget)
+            probes.faces_per_frame = 6 * n_boxes;
+         probes.update([&](size_t probe, const glm::mat4 faces[6], int face_mask) {
+            shader_probe.use();
+            glUniformMatrix4fv(glGetUniformLocation(shader_probe.id(), "face_matrices"), 6, GL_FALSE,
+                               glm::value_ptr(faces[0]));
+            shader_probe.seti("face_mask", face_mask);
+
+            // the sky covers every texel of the faces, drawn first it also clears color and depth
+            glm::vec3 eye = probes.probes[probe].position;
+            glm::mat4 model;
+            model = glm::translate(model, eye);
+            model = glm::scale(model, glm::vec3(50.0f));
+            shader_probe.seti("sky", 1);
+            shader_probe.setvec3("eye", eye);
+            shader_probe.setmat4("model", model);
+            glDepthFunc(GL_ALWAYS);
+            glBindVertexArray(VAO);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, env.skybox);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            glDepthFunc(GL_LESS);
+            shader_probe.seti("sky", 0);
+
+            draw_movers(shader_probe);
+
+            // the other boxes, lit flat: reflections of reflections aren't worth it
+            shader_probe.setvec3("color", albedo);
+            glBindVertexArray(VAO_container);
+            for (int i = 0; i < n_boxes; ++i) {
+               if (i == (int)probe)
+                  continue;
+               model = glm::mat4();
+               model = glm::translate(model, probes.probes[i].position);
+               model = glm::scale(model, glm::vec3(2.2f));
+               shader_probe.setmat4("model", model);
+               glDrawArrays(GL_TRIANGLES, 0, 36);
+            }
+            glBindVertexArray(0);
+         });
+      }
+      if (print_probes) {
+         std::cout << "probes: " << probes.n_faces << " faces/frame, " << probes.last_ms << " ms, "
+                   << probes.face_ms << " ms/face, budget " << (probe_budget ? probes.budget_ms : 0.0f)
+                   << " ms" << std::endl;
+         print_probes = false;
+      }
+
+      shader_object.use();
+      shader_object.setmat4("view_projection", projection * view);
+      draw_movers(shader_object);
+
+      // render containers, roughness from 0 to 1
       shader_box.use();
       shader_box.setmat4("view", view);
-      glm::mat4 model;
-      model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-      model = glm::scale(model, glm::vec3(2.2f));
-      shader_box.setmat4("model", model);
       shader_box.setmat4("projection", projection);
       shader_box.setvec3("cam_pos", camera.position);
+      shader_box.setvec3("albedo", albedo);
+      shader_box.setf("metallic", metallic ? 1.0f : 0.0f);
       glBindVertexArray(VAO_container);
       glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, bbox_texture);
-      glDrawArrays(GL_TRIANGLES, 0, 36);
+      for (int i = 0; i < n_boxes; ++i) {
+         const ReflectionProbe &probe = probes.probes[i];
+         glBindTexture(GL_TEXTURE_CUBE_MAP, use_probes && probe.complete() ? probe.cubemap : env.specular);
+         glm::mat4 model;
+         model = glm::translate(model, probe.position);
+         model = glm::scale(model, glm::vec3(2.2f));
+         shader_box.setmat4("model", model);
+         shader_box.setf("roughness", i / 4.0f);
+         glDrawArrays(GL_TRIANGLES, 0, 36);
+      }
       glBindVertexArray(0);
 
       // render skybox
@@ -365,7 +515,7 @@ int main() {
       shader_skybox.setmat4("projection", projection);
       glBindVertexArray(VAO);
       glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap_texture);
+      glBindTexture(GL_TEXTURE_CUBE_MAP, env.skybox);
       glDrawArrays(GL_TRIANGLES, 0, 36);
       glBindVertexArray(0);
       glDepthFunc(GL_LESS);
@@ -376,75 +526,9 @@ int main() {
    
    glDeleteVertexArrays(1, &VAO);
    glDeleteBuffers(1, &VBO);
+   env.release();
+   probes.release();
 
    glfwTerminate();
    return 0;
 }
-
-/**************************** LOAD TEXTURE FROM FILE ****************************/
-unsigned int texture_from_file(
-   const char *path) {
-   
-   std::string file_name = std::string(path);
-   
-   unsigned int texture_id;
-   glGenTextures(1, &texture_id);
-   glBindTexture(GL_TEXTURE_2D, texture_id);
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-   int width, height, n_channels;      
-   unsigned char *data = stbi_load(file_name.c_str(), &width, &height, &n_channels, 0);
-   if (data) {
-      GLenum format;
-      if (n_channels == 1)
-         format = GL_RED;
-      else if (n_channels == 3)
-         format = GL_RGB;
-      else if (n_channels == 4)
-         format = GL_RGBA;
-
-      glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-      glGenerateMipmap(GL_TEXTURE_2D);
-   } else {
-      std::cout << "Couldn't load the texture image with path: "
-                << path
-                << std::endl;
-   }
-   stbi_image_free(data);
-  
-   return texture_id;
-}
-
-/**************************** LOAD SKYBOX FROM FILE ****************************/
-unsigned int load_cubemap(std::vector<std::string> faces) {
-    unsigned int texture_id;
-    glGenTextures(1, &texture_id);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, texture_id);
-
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    int width, height, n_channels;
-    for (size_t i = 0; i < faces.size(); ++i) {
-        unsigned char *data;
-        data = stbi_load(faces[i].c_str(), &width, &height, &n_channels, 0);
-        if (data) {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                         0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data
-                        );
-            stbi_image_free(data);
-        } else {
-            std::cout << "Couldn't load the texture cube map path: "
-                      << faces[i]
-                      << std::endl;
-        }
-    }
-
-    return texture_id;
-}
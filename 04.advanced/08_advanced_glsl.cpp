@@ -30,6 +30,8 @@
 #include "shader.hpp"
 #include "camera.hpp"
 #include "utils.hpp"
+#include "gl_ext.hpp"
+#include "stream_buffer.hpp"
 
 #include <string>
 #include <fstream>
@@ -100,6 +102,7 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    glext::load((GLADloadproc)glfwGetProcAddress);
 
     glEnable(GL_DEPTH_TEST);
 
@@ -177,16 +180,16 @@ int main() {
     shader3.setuniform("matrices", binding_point);
     shader4.setuniform("matrices", binding_point);
 
-    // create the actual uniform buffer object and binding it
-    // to the previously used binding point
-    unsigned int ubo;
-    glGenBuffers(1, &ubo);
-    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
-    glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), NULL, GL_STATIC_DRAW);
-    glBindBufferRange(GL_UNIFORM_BUFFER, binding_point, ubo, 0, 2 * sizeof(glm::mat4));
+    // the uniform block is rewritten every frame, so it lives in a stream buffer:
+    // persistently mapped regions guarded by fences, or orphaning on GL 3.3
+    StreamBuffer ubo(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4));
+    std::cout << "uniform stream: "
+              << (ubo.persistent ? "persistent mapping" : "orphaning")
+              << std::endl;
 
     // fill the buffer data
     glm::mat4 projection, view, model;
+    double last_report = glfwGetTime();
 
     while (!glfwWindowShouldClose(window)) {
         utils::process_input(window, last_frame, delta_time, camera);
@@ -197,14 +200,17 @@ int main() {
         projection = glm::perspective(glm::radians(camera.zoom), 
                                     (float)s_width/s_height, 
                                     0.1f, 100.0f);
-        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
         view = camera.get_view_matrix();
-        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
-        glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        ubo.begin_frame();
+        size_t offset = 0;
+        glm::mat4 *matrices = (glm::mat4 *)ubo.alloc(2 * sizeof(glm::mat4), offset);
+        if (matrices) {
+            matrices[0] = projection;
+            matrices[1] = view;
+        }
+        ubo.commit();
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding_point, ubo.buffer, offset, 2 * sizeof(glm::mat4));
 
         glBindVertexArray(VAO);
 
@@ -232,6 +238,14 @@ int main() {
         shader4.setmat4("model", model);
         glDrawArrays(GL_TRIANGLES, 0, 36);
 
+        ubo.end_frame();
+        double now = glfwGetTime();
+        if (now - last_report >= 1.0) {
+            ubo.stats.pprint("uniform stream");
+            ubo.stats.reset();
+            last_report = now;
+        }
+
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
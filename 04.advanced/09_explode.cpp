@@ -1,3 +1,18 @@
+/* Explode
+ *  - every triangle moves out along its normal, which needs the whole triangle
+ *  - 09_explode.gs: a geometry shader sees the three corners and emits them moved
+ *  - vertex pulling (pulled_mesh.hpp, 09_explode_pull.vs): the mesh is drawn without
+ *    indices, each vertex fetches its corner and the precomputed face normal from
+ *    texture buffers. no geometry stage, which many drivers run slowly
+ *  - both move triangles along their world space normal by the same distance,
+ *    whatever the model scale
+ *
+ *  keys:
+ *    G : geometry shader / vertex pulling
+ *
+ *  10_normals has a benchmark of both on this model (./normals bench)
+ */
+
 // #include <string>
 #include <fstream>
 #include <sstream>
@@ -14,6 +29,7 @@
 #include <shader.hpp>
 #include <mesh.hpp>
 #include <model.hpp>
+#include <pulled_mesh.hpp>
 
 // for adjusting camera speed
 float delta_time = 0.0f;
@@ -76,6 +92,14 @@ void process_input(GLFWwindow *window) {
       camera_pos += glm::normalize(glm::cross(camera_front, camera_up)) * camera_speed;
 }
 
+bool use_gs = false;
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+   if (action == GLFW_PRESS && key == GLFW_KEY_G) {
+      use_gs = !use_gs;
+      std::cout << (use_gs ? "geometry shader" : "vertex pulling") << std::endl;
+   }
+}
+
 float fov = 45.0f;
 void scroll_callback(GLFWwindow *window, double dx, double dy) {
    if (fov >= 1.0f && fov <= 45.0f)
@@ -109,13 +133,19 @@ int main() {
    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
    glfwSetCursorPosCallback(window, mouse_callback);
    glfwSetScrollCallback(window, scroll_callback);
+   glfwSetKeyCallback(window, key_callback);
 
    Shader shader("../shaders/04.advanced/09_explode.vs",
                  "../shaders/04.advanced/09_explode.fs",
                  "../shaders/04.advanced/09_explode.gs"
                  );
 
+   Shader shader_pull("../shaders/04.advanced/09_explode_pull.vs",
+                      "../shaders/04.advanced/09_explode.fs"
+                      );
+
    Model model("../models/nanosuit/nanosuit.obj");
+   PulledModel pulled(model);
 
    while (!glfwWindowShouldClose(window)) {
       glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
@@ -128,18 +158,24 @@ int main() {
       view = glm::lookAt(camera_pos, camera_pos + camera_front, camera_up);
 
       // crysis model
-      shader.use();
-      shader.setf("time", glfwGetTime());
+      Shader &explode = use_gs ? shader : shader_pull;
+      explode.use();
+      explode.setf("time", glfwGetTime());
 
-      shader.setmat4("projection", projection);
-      shader.setmat4("view", view);
+      explode.setmat4("projection", projection);
+      explode.setmat4("view", view);
 
       glm::mat4 wmodel;
       wmodel = glm::translate(wmodel, glm::vec3(0.0f, -1.75f, 0.0f));
       wmodel = glm::scale(wmodel, glm::vec3(0.2f));
-      shader.setmat4("model", wmodel);
-
-      model.draw(shader);
+      explode.setmat4("model", wmodel);
+      glUniformMatrix4fv(glGetUniformLocation(explode.id(), "normal_model"), 1, GL_FALSE,
+                         glm::value_ptr(glm::transpose(glm::inverse(wmodel))));
+
+      if (use_gs)
+         model.draw(shader);
+      else
+         pulled.draw_triangles(shader_pull);
 
       glfwSwapBuffers(window);
       glfwPollEvents();
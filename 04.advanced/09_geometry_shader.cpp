@@ -1,7 +1,11 @@
-/*
- *
- *
+/* Geometry shader
+ *  - four points, 09_house.gs turns each into a house (a 5 vertex strip)
+ *  - the same houses without a geometry stage: one instance per point, the
+ *    points become per instance attributes and 09_house_instanced.vs places the
+ *    5 corners by gl_VertexID
  *
+ *  keys:
+ *    G : geometry shader / instancing
  */
 
 #include "shader.hpp"
@@ -38,6 +42,16 @@ double y_old = 300.0f;
 
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 
+bool use_gs = false;
+
+/**************************** KEY CALLBACK ****************************/
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    if (action == GLFW_PRESS && key == GLFW_KEY_G) {
+        use_gs = !use_gs;
+        std::cout << (use_gs ? "geometry shader" : "instancing") << std::endl;
+    }
+}
+
 /**************************** MOUSE CALLBACK ****************************/
 void mouse_callback(GLFWwindow *window, 
                     double x_new, double y_new) {
@@ -84,6 +98,7 @@ int main() {
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetKeyCallback(window, key_callback);
 
     // Naive geometry shader
     // Shader shader("../shaders/04.advanced/09.vs", 
@@ -95,6 +110,10 @@ int main() {
                   "../shaders/04.advanced/09.fs",
                   "../shaders/04.advanced/09_house.gs");
 
+    // 4 houses, instanced
+    Shader shader_instanced("../shaders/04.advanced/09_house_instanced.vs",
+                            "../shaders/04.advanced/09.fs");
+
     // naive
     // float points[] = {
     //     -0.5f,  0.5f,
@@ -123,21 +142,41 @@ int main() {
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(2 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
+    // same buffer, one point per instance
+    unsigned int instanced_VAO;
+    glGenVertexArrays(1, &instanced_VAO);
+    glBindVertexArray(instanced_VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribDivisor(0, 1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glBindVertexArray(0);
+
     while (!glfwWindowShouldClose(window)) {
         utils::process_input(window, last_frame, delta_time, camera);
 
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glBindVertexArray(VAO);
-        shader.use();
-        glDrawArrays(GL_POINTS, 0, 4);
+        if (use_gs) {
+            glBindVertexArray(VAO);
+            shader.use();
+            glDrawArrays(GL_POINTS, 0, 4);
+        } else {
+            glBindVertexArray(instanced_VAO);
+            shader_instanced.use();
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 5, 4);
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
     glDeleteVertexArrays(1, &VAO);
+    glDeleteVertexArrays(1, &instanced_VAO);
     glDeleteBuffers(1, &VBO);
 
     glfwTerminate();
@@ -1,7 +1,30 @@
+/* Normals
+ *  - the nanosuit with its vertex normals drawn as lines, or exploding along
+ *    its face normals (09_explode)
+ *  - each effect three ways: with a geometry shader, with vertex pulling
+ *    (pulled_mesh.hpp), where a plain vertex shader fetches the mesh from
+ *    texture buffers by gl_VertexID / gl_InstanceID, and cached: the geometry
+ *    shader output is captured in world space with transform feedback
+ *    (feedback_cache.hpp) and replayed by every pass that needs it
+ *  - the scene is drawn twice, by the main camera and a side view in the corner.
+ *    cached, the geometry shader runs once for both, and not at all while its
+ *    inputs (time, model matrix) stay the same
+ *
+ *  keys:
+ *    1 / 2 / 3 : explode, geometry shader / vertex pulling / cached
+ *    4 / 5 / 6 : normals, geometry shader / instanced lines / cached
+ *    F : face normals instead of vertex normals (instanced lines only)
+ *    P : pause time
+ *
+ *  usage: ./normals
+ *         ./normals bench     (GPU time of every mode, fixed camera and time)
+ */
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstring>
 #include <math.h>
 
 #include <glad/glad.h>
@@ -14,6 +37,9 @@
 #include <shader.hpp>
 #include <mesh.hpp>
 #include <model.hpp>
+#include <pulled_mesh.hpp>
+#include <gpu_timer.hpp>
+#include <feedback_cache.hpp>
 
 // for adjusting camera speed
 float delta_time = 0.0f;
@@ -76,6 +102,37 @@ void process_input(GLFWwindow *window) {
       camera_pos += glm::normalize(glm::cross(camera_front, camera_up)) * camera_speed;
 }
 
+enum draw_mode {
+   EXPLODE_GS, EXPLODE_PULLED, EXPLODE_CACHED,
+   NORMALS_GS, NORMALS_PULLED, NORMALS_CACHED,
+   N_DRAW_MODES
+};
+const char *mode_names[N_DRAW_MODES] = {
+   "explode gs", "explode pulled", "explode cached",
+   "normals gs", "normals instanced", "normals cached"
+};
+int mode = NORMALS_PULLED;
+bool face_normals = false;
+bool paused = false;
+
+// benchmark: every mode runs WARMUP + MEASURE frames
+const unsigned int WARMUP = 30;
+const unsigned int MEASURE = 120;
+
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+   if (action != GLFW_PRESS)
+      return;
+   if (key >= GLFW_KEY_1 && key < GLFW_KEY_1 + N_DRAW_MODES) {
+      mode = key - GLFW_KEY_1;
+      std::cout << "mode: " << mode_names[mode] << std::endl;
+   } else if (key == GLFW_KEY_F) {
+      face_normals = !face_normals;
+      std::cout << (face_normals ? "face normals" : "vertex normals") << std::endl;
+   } else if (key == GLFW_KEY_P) {
+      paused = !paused;
+   }
+}
+
 float fov = 45.0f;
 void scroll_callback(GLFWwindow *window, double dx, double dy) {
    if (fov >= 1.0f && fov <= 45.0f)
@@ -86,7 +143,8 @@ void scroll_callback(GLFWwindow *window, double dx, double dy) {
       fov = 45.0f;
 }
 
-int main() {
+int main(int argc, char **argv) {
+   bool bench = argc > 1 && std::strcmp(argv[1], "bench") == 0;
    int s_width = 800, s_height = 1000;
    glfwInit();
    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -106,9 +164,12 @@ int main() {
 
    glEnable(GL_DEPTH_TEST);
    glfwMakeContextCurrent(window);
-   glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-   glfwSetCursorPosCallback(window, mouse_callback);
-   glfwSetScrollCallback(window, scroll_callback);
+   if (!bench) {
+      glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+      glfwSetCursorPosCallback(window, mouse_callback);
+      glfwSetScrollCallback(window, scroll_callback);
+      glfwSetKeyCallback(window, key_callback);
+   }
 
    Shader shader("../shaders/04.advanced/10_explode.vs",
                  "../shaders/04.advanced/10_explode.fs"
@@ -124,45 +185,257 @@ int main() {
                           "../shaders/04.advanced/10_normals2.gs"
                           );
 
+   Shader shader_explode("../shaders/04.advanced/09_explode.vs",
+                         "../shaders/04.advanced/09_explode.fs",
+                         "../shaders/04.advanced/09_explode.gs"
+                         );
+
+   // the same effects without a geometry shader
+   Shader shader_explode_pull("../shaders/04.advanced/09_explode_pull.vs",
+                              "../shaders/04.advanced/09_explode.fs"
+                              );
+
+   Shader shader_normals_pull("../shaders/04.advanced/10_normals_pull.vs",
+                              "../shaders/04.advanced/10_normals.fs"
+                              );
+
+   Shader shader_face_normals_pull("../shaders/04.advanced/10_normals_pull.vs",
+                                   "../shaders/04.advanced/10_normals.fs",
+                                   NULL, "#define FACE_NORMALS\n"
+                                   );
+
+   // the geometry shaders again, capturing world space output instead of drawing
+   Shader shader_explode_capture("../shaders/04.advanced/09_explode.vs",
+                                 "../shaders/04.advanced/09_explode.fs",
+                                 "../shaders/04.advanced/09_explode.gs"
+                                 );
+   const char *explode_varyings[] = { "gl_Position", "texf" };
+   shader_explode_capture.set_feedback_varyings(explode_varyings, 2);
+
+   Shader shader_normals_capture("../shaders/04.advanced/10_normals.vs",
+                                 "../shaders/04.advanced/10_normals.fs",
+                                 "../shaders/04.advanced/10_normals.gs"
+                                 );
+   const char *normals_varyings[] = { "gl_Position" };
+   shader_normals_capture.set_feedback_varyings(normals_varyings, 1);
+
+   // and what draws the captures, from any view
+   Shader shader_explode_replay("../shaders/04.advanced/10_replay.vs",
+                                "../shaders/04.advanced/09_explode.fs"
+                                );
+
+   Shader shader_normals_replay("../shaders/04.advanced/10_replay.vs",
+                                "../shaders/04.advanced/10_normals.fs"
+                                );
+
    Model model("../models/nanosuit/nanosuit.obj");
+   PulledModel pulled(model);
+   GpuTimer gpu_timer;
+
+   // explode emits a triangle per triangle, normals a line per corner
+   size_t n_triangles = 0;
+   for (size_t i = 0; i < model.meshes.size(); ++i)
+      n_triangles += model.meshes[i].indices.size() / 3;
+   FeedbackCache explode_cache(3 * n_triangles, std::vector<int>({ 4, 2 }));
+   FeedbackCache normals_cache(6 * n_triangles, std::vector<int>(1, 4));
+   std::vector<unsigned int> diffuse(model.meshes.size(), 0);
+   for (size_t i = 0; i < model.meshes.size(); ++i)
+      for (size_t t = 0; t < model.meshes[i].textures.size() && !diffuse[i]; ++t)
+         if (model.meshes[i].textures[t].type == "texture_diffuse")
+            diffuse[i] = model.meshes[i].textures[t].id;
+
+   // captures run the geometry shader on every mesh with identity view and projection,
+   // so the explode capture is in world space and moves as far as the other two paths
+   auto capture = [&](FeedbackCache &cache, Shader &capture_shader, GLenum primitive,
+                      unsigned int per_triangle, const std::vector<float> &inputs) {
+      capture_shader.use();
+      capture_shader.setmat4("projection", glm::mat4());
+      capture_shader.setmat4("view", glm::mat4());
+      cache.begin(primitive, inputs);
+      for (size_t i = 0; i < model.meshes.size(); ++i) {
+         const Mesh &mesh = model.meshes[i];
+         glBindVertexArray(mesh.VAO);
+         glDrawElements(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, 0);
+         cache.mark(per_triangle * (mesh.indices.size() / 3));
+      }
+      glBindVertexArray(0);
+      cache.end();
+   };
+
+   // bench state
+   unsigned int bench_frame = 0, bench_samples = 0;
+   double bench_gpu = 0.0;
+   if (bench) {
+      mode = 0;
+      std::cout << "mode\tgpu ms" << std::endl;
+   }
+
+   double gpu_ms = 0.0;
+   unsigned int n_frames = 0, n_gpu = 0;
+   double last_report = glfwGetTime();
+
+   float time = 0.0f;
+   double last_time = glfwGetTime();
+
+   glm::mat4 wmodel;
+   wmodel = glm::translate(wmodel, glm::vec3(0.0f, -1.75f, 0.0f));
+   wmodel = glm::scale(wmodel, glm::vec3(0.2f));
+
+   // one view of the current mode, the captures are already up to date
+   auto draw_view = [&](const glm::mat4 &projection, const glm::mat4 &view) {
+      if (mode == EXPLODE_CACHED) {
+         shader_explode_replay.use();
+         shader_explode_replay.setmat4("projection", projection);
+         shader_explode_replay.setmat4("view", view);
+         shader_explode_replay.seti("texture_diffuse", 0);
+         glActiveTexture(GL_TEXTURE0);
+         for (size_t i = 0; i < explode_cache.n_ranges(); ++i) {
+            glBindTexture(GL_TEXTURE_2D, diffuse[i]);
+            explode_cache.draw(GL_TRIANGLES, i);
+         }
+      } else if (mode == EXPLODE_GS || mode == EXPLODE_PULLED) {
+         Shader &explode = mode == EXPLODE_GS ? shader_explode : shader_explode_pull;
+         explode.use();
+         explode.setf("time", time);
+         explode.setmat4("projection", projection);
+         explode.setmat4("view", view);
+         explode.setmat4("model", wmodel);
+         glUniformMatrix4fv(glGetUniformLocation(explode.id(), "normal_model"), 1, GL_FALSE,
+                            glm::value_ptr(glm::transpose(glm::inverse(wmodel))));
+         if (mode == EXPLODE_GS)
+            model.draw(shader_explode);
+         else
+            pulled.draw_triangles(shader_explode_pull);
+      } else {
+         shader.use();
+         shader.setmat4("projection", projection);
+         shader.setmat4("view", view);
+         shader.setmat4("model", wmodel);
+         model.draw(shader);
+      }
+
+      // shader_normals2.use();
+      // shader_normals2.setmat4("projection", projection);
+      // shader_normals2.setmat4("view", view);
+      // shader_normals2.setmat4("model", wmodel);
+      // model.draw(shader_normals2);
+
+      if (mode == NORMALS_GS) {
+         shader_normals.use();
+         shader_normals.setmat4("projection", projection);
+         shader_normals.setmat4("view", view);
+         shader_normals.setmat4("model", wmodel);
+         model.draw(shader_normals);
+      } else if (mode == NORMALS_PULLED) {
+         Shader &normals = face_normals ? shader_face_normals_pull : shader_normals_pull;
+         normals.use();
+         normals.setmat4("projection", projection);
+         normals.setmat4("view", view);
+         normals.setmat4("model", wmodel);
+         glUniformMatrix4fv(glGetUniformLocation(normals.id(), "normal_model"), 1, GL_FALSE,
+                            glm::value_ptr(glm::transpose(glm::inverse(wmodel))));
+         if (face_normals)
+            pulled.draw_face_lines(normals);
+         else
+            pulled.draw_vertex_lines(normals);
+      } else if (mode == NORMALS_CACHED) {
+         shader_normals_replay.use();
+         shader_normals_replay.setmat4("projection", projection);
+         shader_normals_replay.setmat4("view", view);
+         for (size_t i = 0; i < normals_cache.n_ranges(); ++i)
+            normals_cache.draw(GL_LINES, i);
+      }
+   };
 
    while (!glfwWindowShouldClose(window)) {
+      double now_time = glfwGetTime();
+      if (bench) {
+         time = bench_frame / 60.0f;
+      } else {
+         if (!paused)
+            time += now_time - last_time;
+         process_input(window);
+      }
+      last_time = now_time;
+
+      gpu_timer.begin();
+
+      // what the captures depend on: view and projection aren't in it, they are applied on replay
+      std::vector<float> inputs(glm::value_ptr(wmodel), glm::value_ptr(wmodel) + 16);
+      if (mode == EXPLODE_CACHED) {
+         inputs.push_back(time);
+         if (explode_cache.stale(inputs)) {
+            shader_explode_capture.use();
+            shader_explode_capture.setf("time", time);
+            shader_explode_capture.setmat4("model", wmodel);
+            capture(explode_cache, shader_explode_capture, GL_TRIANGLES, 3, inputs);
+         }
+      } else if (mode == NORMALS_CACHED) {
+         if (normals_cache.stale(inputs)) {
+            shader_normals_capture.use();
+            shader_normals_capture.setmat4("model", wmodel);
+            capture(normals_cache, shader_normals_capture, GL_LINES, 6, inputs);
+         }
+      }
+
       glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-      process_input(window);
 
       glm::mat4 projection;
       projection = glm::perspective(glm::radians(fov), (float)s_width/s_height, 0.1f, 100.0f);
       glm::mat4 view;
       view = glm::lookAt(camera_pos, camera_pos + camera_front, camera_up);
+      draw_view(projection, view);
 
-      shader.use();
-      shader.setmat4("projection", projection);
-      shader.setmat4("view", view);
-      glm::mat4 wmodel;
-      wmodel = glm::translate(wmodel, glm::vec3(0.0f, -1.75f, 0.0f));
-      wmodel = glm::scale(wmodel, glm::vec3(0.2f));
-      shader.setmat4("model", wmodel);
-      model.draw(shader);
-
-      // shader_normals2.use();
-      // shader_normals2.setmat4("projection", projection);
-      // shader_normals2.setmat4("view", view);
-      // wmodel = glm::mat4();
-      // wmodel = glm::translate(wmodel, glm::vec3(0.0f, -1.75f, 0.0f));
-      // wmodel = glm::scale(wmodel, glm::vec3(0.2f));
-      // shader_normals2.setmat4("model", wmodel);
-      // model.draw(shader_normals2);
+      // side view in the bottom right corner
+      int inset_width = s_width / 3, inset_height = s_height / 3;
+      glEnable(GL_SCISSOR_TEST);
+      glScissor(s_width - inset_width, 0, inset_width, inset_height);
+      glViewport(s_width - inset_width, 0, inset_width, inset_height);
+      glClearColor(0.9f, 0.9f, 0.9f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      glDisable(GL_SCISSOR_TEST);
+      projection = glm::perspective(glm::radians(45.0f), (float)inset_width/inset_height, 0.1f, 100.0f);
+      view = glm::lookAt(glm::vec3(4.0f, 0.0f, 0.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+      draw_view(projection, view);
+      glViewport(0, 0, s_width, s_height);
+      gpu_timer.end();
 
-      shader_normals.use();
-      shader_normals.setmat4("projection", projection);
-      shader_normals.setmat4("view", view);
-      wmodel = glm::mat4();
-      wmodel = glm::translate(wmodel, glm::vec3(0.0f, -1.75f, 0.0f));
-      wmodel = glm::scale(wmodel, glm::vec3(0.2f));
-      shader_normals.setmat4("model", wmodel);
-      model.draw(shader_normals);
+      double ms;
+      while (gpu_timer.result(ms)) {
+         gpu_ms += ms;
+         n_gpu++;
+         if (bench && bench_frame >= WARMUP) {
+            bench_gpu += ms;
+            bench_samples++;
+         }
+      }
+      n_frames++;
 
+      if (bench) {
+         if (++bench_frame == WARMUP + MEASURE) {
+            std::cout << mode_names[mode]
+                      << "\t" << (bench_samples ? bench_gpu / bench_samples : 0.0)
+                      << std::endl;
+            bench_frame = bench_samples = 0;
+            bench_gpu = 0.0;
+            if (++mode == N_DRAW_MODES)
+               break;
+         }
+      } else {
+         double now = glfwGetTime();
+         if (now - last_report >= 1.0) {
+            std::cout << "mode: " << mode_names[mode]
+                      << " fps: " << n_frames / (now - last_report)
+                      << " gpu: " << (n_gpu ? gpu_ms / n_gpu : 0.0) << " ms"
+                      << " captures: " << explode_cache.n_captures + normals_cache.n_captures
+                      << " skipped: " << explode_cache.n_skipped + normals_cache.n_skipped
+                      << std::endl;
+            gpu_ms = 0.0;
+            n_frames = n_gpu = 0;
+            last_report = now;
+         }
+      }
 
       glfwSwapBuffers(window);
       glfwPollEvents();
@@ -1,7 +1,20 @@
+/* Asteroid belt, one instanced draw per rock mesh
+ *  - instance transforms can be stored in several encodings (instance_buffer.hpp),
+ *    the vertex shader is compiled with the matching decode
+ *
+ *  keys:
+ *    1 : mat4, 64 bytes per instance
+ *    2 : 3x4 affine, 48 bytes per instance
+ *    3 : position + uniform scale + quaternion, 32 bytes per instance
+ *
+ *  usage: ./instance4 [number of asteroids]
+ */
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstdlib>
 #include <math.h>
 
 #include <glad/glad.h>
@@ -16,6 +29,7 @@
 #include <camera.hpp>
 #include <utils.hpp>
 #include <model.hpp>
+#include <instance_buffer.hpp>
 
 // for adjusting camera speed
 float delta_time = 0.0f;
@@ -27,6 +41,7 @@ double x_old = 400.0f;
 double y_old = 300.0f;
 
 Camera camera(glm::vec3(0.0f, 0.0f, 200.0f));
+instance_format format = INSTANCE_QUAT;
 
 /**************************** MOUSE CALLBACK ****************************/
 void mouse_callback(GLFWwindow *window, 
@@ -49,7 +64,23 @@ void scroll_callback(GLFWwindow *window, double dx, double dy) {
     camera.process_scroll(dy);
 }
 
-int main() {
+/**************************** KEY CALLBACK ****************************/
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    if (action != GLFW_PRESS)
+        return;
+    if (key == GLFW_KEY_1)
+        format = INSTANCE_MAT4;
+    else if (key == GLFW_KEY_2)
+        format = INSTANCE_AFFINE;
+    else if (key == GLFW_KEY_3)
+        format = INSTANCE_QUAT;
+}
+
+int main(int argc, char **argv) {
+   unsigned int amount = 10000;
+   if (argc > 1)
+      amount = std::atoi(argv[1]);
+
    int s_width = 1800, s_height = 1000;
    glfwInit();
    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -72,10 +103,17 @@ int main() {
    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
    glfwSetCursorPosCallback(window, mouse_callback);
    glfwSetScrollCallback(window, scroll_callback);
-
-   Shader shader_rock("../shaders/04.advanced/11_instance4_rock.vs",
-                      "../shaders/04.advanced/11_instance4_rock.fs"
-                      );
+   glfwSetKeyCallback(window, key_callback);
+
+   // one variant of the rock shader per instance encoding
+   const instance_format formats[] = { INSTANCE_MAT4, INSTANCE_AFFINE, INSTANCE_QUAT };
+   Shader *shader_rocks[3];
+   for (int i = 0; i < 3; ++i)
+      shader_rocks[i] = new Shader("../shaders/04.advanced/11_instance4_rock.vs",
+                                   "../shaders/04.advanced/11_instance4_rock.fs",
+                                   NULL,
+                                   InstanceBuffer::shader_defines(formats[i])
+                                   );
    Shader shader_planet("../shaders/04.advanced/11_instance4_planet.vs",
                         "../shaders/04.advanced/11_instance4_planet.fs"
                         );
@@ -83,14 +121,14 @@ int main() {
    Model model_planet("../models/planet/planet.obj");
    Model model_rock("../models/rock/rock.obj");
 
-   unsigned int amount = 10000;
-   glm::mat4 *model_matrices = new glm::mat4[amount];
+   std::vector<InstanceTransform> transforms(amount);
    srand(glfwGetTime());
    float radius = 150.0f;
    float offset = 25.0f;
+   glm::vec3 axis = glm::normalize(glm::vec3(0.4f, 0.6f, 0.8f));
 
    for (unsigned int i = 0; i < amount; ++i) {
-      glm::mat4 model;
+      InstanceTransform &t = transforms[i];
 
       // 1. Translate
       float displacement;
@@ -101,46 +139,31 @@ int main() {
       float y = displacement * 0.4f;
       displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
       float z = cos(angle) * radius + displacement;
-      model = glm::translate(model, glm::vec3(x, y, z));
+      t.position = glm::vec3(x, y, z);
 
       // 2. Scale
-      float scale = (rand() % 20) / 100.0f + 0.05f;
-      model = glm::scale(model, glm::vec3(scale));
+      t.scale = (rand() % 20) / 100.0f + 0.05f;
 
       // 3. Rotation
-      float r_angle = (rand() % 360);
-      model = glm::rotate(model, r_angle, glm::vec3(0.4f, 0.6f, 0.8f));
-
-      model_matrices[i] = model;
+      float r_angle = glm::radians((float)(rand() % 360));
+      t.rotation = axis_angle(axis, r_angle);
    }
 
-   unsigned int vbo;
-   glGenBuffers(1, &vbo);
-   glBindBuffer(GL_ARRAY_BUFFER, vbo);
-   glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &model_matrices[0], GL_STATIC_DRAW);
+   // all encodings are uploaded so switching doesn't hitch, only one is bound
+   InstanceBuffer *buffers[3];
+   for (int i = 0; i < 3; ++i) {
+      buffers[i] = new InstanceBuffer(formats[i]);
+      buffers[i]->upload(transforms);
+      std::cout << InstanceBuffer::name(formats[i]) << ": "
+                << InstanceBuffer::stride(formats[i]) << " bytes per instance, "
+                << buffers[i]->bytes() / 1024 << " KiB"
+                << std::endl;
+   }
 
    std::vector<Mesh> meshes = model_rock.meshes;
-   GLsizei v4size = sizeof(glm::vec4);
-   for (unsigned int i = 0; i < meshes.size(); ++i) {
-      unsigned int _VAO = meshes[i].VAO;
-      glBindVertexArray(_VAO);
-
-      glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4), (void *)(0*v4size));
-      glEnableVertexAttribArray(3);
-      glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4), (void *)(1*v4size));
-      glEnableVertexAttribArray(4);
-      glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4), (void *)(2*v4size));
-      glEnableVertexAttribArray(5);
-      glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4), (void *)(3*v4size));
-      glEnableVertexAttribArray(6);
-
-      glVertexAttribDivisor(3, 1);
-      glVertexAttribDivisor(4, 1);
-      glVertexAttribDivisor(5, 1);
-      glVertexAttribDivisor(6, 1);
-
-      glBindVertexArray(0);
-   }
+   instance_format bound = format;
+   for (unsigned int i = 0; i < meshes.size(); ++i)
+      buffers[bound]->setup(meshes[i].VAO);
 
    while (!glfwWindowShouldClose(window)) {
       glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
@@ -172,6 +195,13 @@ int main() {
       model_planet.draw(shader_planet);
 
       // draw asteroids
+      if (format != bound) {
+         bound = format;
+         for (unsigned int i = 0; i < meshes.size(); ++i)
+            buffers[bound]->setup(meshes[i].VAO);
+         std::cout << "instances: " << InstanceBuffer::name(bound) << std::endl;
+      }
+      Shader &shader_rock = *shader_rocks[bound];
       shader_rock.use();
       shader_rock.setmat4("projection", projection);
       shader_rock.setmat4("view", view);
@@ -186,7 +216,11 @@ int main() {
       glfwSwapBuffers(window);
       glfwPollEvents();
    }
-   
+
+   for (int i = 0; i < 3; ++i) {
+      delete shader_rocks[i];
+      delete buffers[i];
+   }
    glfwTerminate();
    return 0;
 }
@@ -1,11 +1,26 @@
-#include "shader.hpp"
-#include "camera.hpp"
-#include "utils.hpp"
+/* Anti-aliasing
+ *  - the scene is drawn offscreen into targets from a pool (render_target_pool.hpp),
+ *    so antialiasing doesn't depend on the window and works with a post chain
+ *  - MSAA: the scene goes into a multisampled target, `glBlitFramebuffer` resolves
+ *    it into the texture the post chain (post_process.hpp) reads. memory and
+ *    bandwidth grow with the sample count
+ *  - FXAA: no extra samples, a post pass finds edges in the final image and
+ *    blends across them (05_fxaa.fs). cheap, but softer and blind to sub pixel detail
+ *
+ *  keys:
+ *    1 : no antialiasing
+ *    2 / 3 / 4 : 2x / 4x / 8x MSAA
+ *    5 : FXAA
+ *
+ *  usage: ./anti
+ *         ./anti bench     (GPU time and target memory of every mode at 1080p and 4K)
+ */
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <cstring>
 #include <math.h>
 
 #include <glad/glad.h>
@@ -16,11 +31,38 @@
 #include <glm/glm/gtc/matrix_transform.hpp>
 #include <glm/glm/gtc/type_ptr.hpp>
 
+#include "shader.hpp"
+#include "camera.hpp"
+#include "utils.hpp"
+#include "render_target_pool.hpp"
+#include "post_process.hpp"
+#include "gpu_timer.hpp"
+
 #ifndef STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>                
 #endif
 
+struct aa_mode {
+    const char *name;
+    int samples;    // MSAA samples, 0 for none
+    bool fxaa;
+};
+
+const aa_mode aa_modes[] = {
+    { "none",     0, false },
+    { "2x msaa",  2, false },
+    { "4x msaa",  4, false },
+    { "8x msaa",  8, false },
+    { "fxaa",     0, true  }
+};
+const int N_AA_MODES = sizeof(aa_modes) / sizeof(aa_modes[0]);
+
+// benchmark: every mode runs WARMUP + MEASURE frames at every resolution
+const int bench_sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+const unsigned int WARMUP = 30;
+const unsigned int MEASURE = 120;
+
 // for adjusting camera speed
 float delta_time = 0.0f;
 float last_frame = 0.0f;
@@ -31,6 +73,18 @@ double x_old = 400.0f;
 double y_old = 300.0f;
 
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+int mode = 2;
+int max_samples = 0;
+
+// the name with the sample count actually used, MSAA is clamped to GL_MAX_SAMPLES
+std::string mode_name(const aa_mode &aa) {
+    int samples = std::min(aa.samples, max_samples);
+    if (!aa.samples)
+        return aa.name;
+    if (!samples)
+        return "none";
+    return std::to_string(samples) + "x msaa";
+}
 
 /**************************** MOUSE CALLBACK ****************************/
 void mouse_callback(GLFWwindow *window, 
@@ -53,14 +107,24 @@ void scroll_callback(GLFWwindow *window, double dx, double dy) {
     camera.process_scroll(dy);
 }
 
-int main() {
+/**************************** KEY CALLBACK ****************************/
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    if (action != GLFW_PRESS || key < GLFW_KEY_1 || key >= GLFW_KEY_1 + N_AA_MODES)
+        return;
+    mode = key - GLFW_KEY_1;
+    if (aa_modes[mode].samples > max_samples)
+        std::cout << aa_modes[mode].name << " not supported, at most " << max_samples << " samples" << std::endl;
+    std::cout << "antialiasing: " << mode_name(aa_modes[mode]) << std::endl;
+}
+
+int main(int argc, char **argv) {
+    bool bench = argc > 1 && std::strcmp(argv[1], "bench") == 0;
     int s_width = 1400, s_height = 720;
     glfwInit();
-    glfwWindowHint(GLFW_SAMPLES, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    GLFWwindow *window = glfwCreateWindow(s_width, s_height, "CubeMaps", NULL, NULL);
+    GLFWwindow *window = glfwCreateWindow(s_width, s_height, "Anti-aliasing", NULL, NULL);
     if (window == NULL) {
         std::cout << "Couldn't create window!";
         glfwTerminate();
@@ -74,11 +138,16 @@ int main() {
     }
 
     glEnable(GL_DEPTH_TEST);
+    // only affects multisampled targets, the window itself has a single sample
     glEnable(GL_MULTISAMPLE);
+    glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
 
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
+    if (!bench) {
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetKeyCallback(window, key_callback);
+    }
 
     Shader shader("../shaders/04.advanced/12.vs",
                   "../shaders/04.advanced/08_1.fs");
@@ -137,26 +206,144 @@ int main() {
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
     glEnableVertexAttribArray(0);
 
-    // fill the buffer data
+    RenderTargetPool pool;
+    PostChain post("../shaders/04.advanced/");
+    size_t fxaa_pass = post.add(POST_FXAA);
+    GpuTimer gpu_timer;
+
+    // a field of spinning cubes, lots of silhouette edges
+    const int GRID = 15;
+    const float SPACING = 1.6f;
+    float extent = GRID * SPACING * 0.5f;
+    camera.update_position(glm::vec3(0.0f, 0.0f, extent * 1.5f));
+
+    // bench state
+    size_t n_bench_sizes = sizeof(bench_sizes) / sizeof(bench_sizes[0]);
+    size_t bench_step = 0;
+    unsigned int bench_frame = 0, bench_samples = 0;
+    double bench_gpu = 0.0;
+    if (bench) {
+        mode = 0;
+        std::cout << "resolution\tmode\tgpu ms\ttargets MB" << std::endl;
+    }
+
+    double gpu_ms = 0.0;
+    unsigned int n_frames = 0, n_gpu = 0;
+    double last_report = glfwGetTime();
+
     glm::mat4 projection, view, model;
 
     while (!glfwWindowShouldClose(window)) {
-        utils::process_input(window, last_frame, delta_time, camera);
+        float time;
+        if (bench) {
+            time = bench_frame / 60.0f;
+            camera.update_position(glm::vec3(sin(time * 0.3f) * 0.3f * extent, 0.2f * extent,
+                                             extent * 1.5f));
+        } else {
+            time = glfwGetTime();
+            utils::process_input(window, last_frame, delta_time, camera);
+        }
+        glfwGetFramebufferSize(window, &s_width, &s_height);
+        if (s_width == 0 || s_height == 0) {
+            glfwPollEvents();
+            continue;
+        }
+
+        // the benchmark renders at its own resolution, whatever the window size
+        int r_width = bench ? bench_sizes[bench_step / N_AA_MODES][0] : s_width;
+        int r_height = bench ? bench_sizes[bench_step / N_AA_MODES][1] : s_height;
+        const aa_mode &aa = aa_modes[mode];
+        int samples = std::min(aa.samples, max_samples);
+        post.passes[fxaa_pass].enabled = aa.fxaa;
 
+        gpu_timer.begin();
+        // the image the post chain reads, a multisampled scene is resolved into it
+        RenderTarget *color = pool.acquire(r_width, r_height, GL_RGBA8, samples == 0);
+        RenderTarget *scene = samples ? pool.acquire(r_width, r_height, GL_RGBA8, true, samples) : color;
+        scene->bind();
+        glEnable(GL_DEPTH_TEST);
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         projection = glm::perspective(glm::radians(camera.zoom), 
-                                    (float)s_width/s_height, 
+                                    (float)r_width/r_height, 
                                     0.1f, 100.0f);
-        view = camera.get_view_matrix();
+        view = camera.get_view_matrix(bench ? MOVING : STATIC);
 
         glBindVertexArray(VAO);
         shader.use();
-        shader.setmat4("model", glm::mat4());
         shader.setmat4("projection", projection);
         shader.setmat4("view", view);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        for (int x = 0; x < GRID; ++x) {
+            for (int y = 0; y < GRID; ++y) {
+                model = glm::translate(glm::mat4(), glm::vec3((x + 0.5f) * SPACING - extent,
+                                                              (y + 0.5f) * SPACING - extent, 0.0f));
+                model = glm::rotate(model, time * 0.4f + x * 0.3f + y * 0.2f, glm::vec3(0.3f, 1.0f, 0.5f));
+                shader.setmat4("model", model);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            }
+        }
+        glBindVertexArray(0);
+
+        if (samples) {
+            scene->resolve(*color);
+            pool.release(scene);
+        }
+        // benchmark output stays offscreen at full resolution so the window size doesn't change the cost
+        RenderTarget *output = bench ? pool.acquire(r_width, r_height, GL_RGBA8) : NULL;
+        if (output)
+            post.run(pool, color->texture, r_width, r_height, output->fbo, r_width, r_height);
+        else
+            post.run(pool, color->texture, r_width, r_height, 0, s_width, s_height);
+        gpu_timer.end();
+        size_t target_bytes = pool.bytes();
+        pool.release(color);
+
+        if (output) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, output->fbo);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, r_width, r_height, 0, 0, s_width, s_height,
+                              GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            pool.release(output);
+        }
+        pool.end_frame();
+
+        double ms;
+        while (gpu_timer.result(ms)) {
+            gpu_ms += ms;
+            n_gpu++;
+            if (bench && bench_frame >= WARMUP) {
+                bench_gpu += ms;
+                bench_samples++;
+            }
+        }
+        n_frames++;
+
+        if (bench) {
+            if (++bench_frame == WARMUP + MEASURE) {
+                std::cout << r_width << "x" << r_height << "\t" << mode_name(aa)
+                          << "\t" << (bench_samples ? bench_gpu / bench_samples : 0.0)
+                          << "\t" << target_bytes / 1048576.0
+                          << std::endl;
+                bench_frame = bench_samples = 0;
+                bench_gpu = 0.0;
+                if (++bench_step == n_bench_sizes * N_AA_MODES)
+                    break;
+                mode = bench_step % N_AA_MODES;
+            }
+        } else {
+            double now = glfwGetTime();
+            if (now - last_report >= 1.0) {
+                std::cout << "mode: " << mode_name(aa)
+                          << " fps: " << n_frames / (now - last_report)
+                          << " gpu: " << (n_gpu ? gpu_ms / n_gpu : 0.0) << " ms"
+                          << std::endl;
+                gpu_ms = 0.0;
+                n_frames = n_gpu = 0;
+                last_report = now;
+            }
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -165,6 +352,7 @@ int main() {
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
 
+    pool.clear();
     glfwTerminate();
     return 0;
 }
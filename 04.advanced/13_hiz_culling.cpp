@@ -0,0 +1,363 @@
+/* Hierarchical-Z occlusion culling
+ *  - the planet is rendered first into a depth only framebuffer (occluder prepass)
+ *  - that depth buffer is reduced into a max-depth pyramid (see hiz.hpp)
+ *  - every asteroid's world space box is tested against the frustum and the pyramid
+ *    before it is submitted, only the visible transforms reach the instanced draw
+ *
+ *  keys:
+ *    1 : no culling (all instances are drawn)
+ *    2 : cpu culling against the pyramid read back from a previous frame
+ *    3 : gpu culling in a vertex shader, visible transforms written with transform feedback,
+ *        culled slots drawn as null transforms (no stall on the visible count query)
+ *
+ *  usage: ./hiz [number of asteroids]
+ */
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <math.h>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/matrix_transform.hpp>
+#include <glm/glm/gtc/type_ptr.hpp>
+
+#include <shader.hpp>
+#include <mesh.hpp>
+#include <camera.hpp>
+#include <utils.hpp>
+#include <model.hpp>
+#include <bounds.hpp>
+#include <hiz.hpp>
+
+enum cull_mode {
+   CULL_NONE,
+   CULL_CPU,
+   CULL_GPU
+};
+
+const char *cull_mode_names[] = { "none", "cpu", "gpu" };
+
+// for adjusting camera speed
+float delta_time = 0.0f;
+float last_frame = 0.0f;
+
+// callbacks
+bool first_mouse = true;
+double x_old = 400.0f;
+double y_old = 300.0f;
+
+Camera camera(glm::vec3(0.0f, 0.0f, 200.0f));
+cull_mode mode = CULL_GPU;
+
+/**************************** MOUSE CALLBACK ****************************/
+void mouse_callback(GLFWwindow *window,
+                    double x_new, double y_new) {
+    if (first_mouse) {
+        x_old = x_new;
+        y_old = y_new;
+        first_mouse = false;
+    }
+    float dx = x_new - x_old;
+    float dy = y_old - y_new;
+    x_old = x_new;
+    y_old = y_new;
+
+    camera.process_mouse_movement(dx, dy);
+}
+
+/**************************** SCROLL CALLBACK ****************************/
+void scroll_callback(GLFWwindow *window, double dx, double dy) {
+    camera.process_scroll(dy);
+}
+
+/**************************** KEY CALLBACK ****************************/
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    if (action != GLFW_PRESS)
+        return;
+    if (key == GLFW_KEY_1)
+        mode = CULL_NONE;
+    else if (key == GLFW_KEY_2)
+        mode = CULL_CPU;
+    else if (key == GLFW_KEY_3)
+        mode = CULL_GPU;
+}
+
+int main(int argc, char **argv) {
+   unsigned int amount = 20000;
+   if (argc > 1)
+      amount = std::atoi(argv[1]);
+
+   int s_width = 1800, s_height = 1000;
+   glfwInit();
+   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+   GLFWwindow *window = glfwCreateWindow(s_width, s_height, "Hi-Z Culling", NULL, NULL);
+   if (window == NULL) {
+      std::cout << "Couldn't create window!";
+      glfwTerminate();
+      return -1;
+   }
+   glfwMakeContextCurrent(window);
+   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+      std::cout << "Failed to initialize GLAD" << std::endl;
+      return -1;
+   }
+
+   glEnable(GL_DEPTH_TEST);
+   glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+   glfwSetCursorPosCallback(window, mouse_callback);
+   glfwSetScrollCallback(window, scroll_callback);
+   glfwSetKeyCallback(window, key_callback);
+
+   Shader shader_rock("../shaders/04.advanced/11_instance4_rock.vs",
+                      "../shaders/04.advanced/11_instance4_rock.fs"
+                      );
+   Shader shader_planet("../shaders/04.advanced/11_instance4_planet.vs",
+                        "../shaders/04.advanced/11_instance4_planet.fs"
+                        );
+   Shader shader_reduce("../shaders/04.advanced/13_hiz.vs",
+                        "../shaders/04.advanced/13_hiz_reduce.fs"
+                        );
+   Shader shader_cull("../shaders/04.advanced/13_hiz_cull.vs",
+                      "../shaders/04.advanced/13_hiz_cull.fs",
+                      "../shaders/04.advanced/13_hiz_cull.gs"
+                      );
+   const char *cull_varyings[] = { "visible_trans" };
+   shader_cull.set_feedback_varyings(cull_varyings, 1);
+
+   Model model_planet("../models/planet/planet.obj");
+   Model model_rock("../models/rock/rock.obj");
+
+   std::vector<glm::mat4> model_matrices(amount);
+   std::vector<CullInstance> instances(amount);
+   srand(glfwGetTime());
+   float radius = 150.0f;
+   float offset = 25.0f;
+
+   for (unsigned int i = 0; i < amount; ++i) {
+      glm::mat4 model;
+
+      // 1. Translate
+      float displacement;
+      float angle = (float)i / (float)amount * 360.0f;
+      displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
+      float x = sin(angle) * radius + displacement;
+      displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
+      float y = displacement * 0.4f;
+      displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
+      float z = cos(angle) * radius + displacement;
+      model = glm::translate(model, glm::vec3(x, y, z));
+
+      // 2. Scale
+      float scale = (rand() % 20) / 100.0f + 0.05f;
+      model = glm::scale(model, glm::vec3(scale));
+
+      // 3. Rotation
+      float r_angle = (rand() % 360);
+      model = glm::rotate(model, r_angle, glm::vec3(0.4f, 0.6f, 0.8f));
+
+      model_matrices[i] = model;
+
+      AABB box = model_rock.bounds.transform(model);
+      instances[i].transform = model;
+      instances[i].box_min = box.min;
+      instances[i].box_max = box.max;
+   }
+
+   // all instances along with their bounds, input of the gpu culling pass
+   unsigned int cull_vbo;
+   glGenBuffers(1, &cull_vbo);
+   glBindBuffer(GL_ARRAY_BUFFER, cull_vbo);
+   glBufferData(GL_ARRAY_BUFFER, amount * sizeof(CullInstance), &instances[0], GL_STATIC_DRAW);
+
+   // transforms that are actually drawn, refilled by whichever culling mode is active
+   unsigned int vbo;
+   glGenBuffers(1, &vbo);
+   glBindBuffer(GL_ARRAY_BUFFER, vbo);
+   glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &model_matrices[0], GL_DYNAMIC_DRAW);
+
+   std::vector<Mesh> meshes = model_rock.meshes;
+   GLsizei v4size = sizeof(glm::vec4);
+   for (unsigned int i = 0; i < meshes.size(); ++i) {
+      unsigned int _VAO = meshes[i].VAO;
+      glBindVertexArray(_VAO);
+
+      glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4), (void *)(0*v4size));
+      glEnableVertexAttribArray(3);
+      glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4), (void *)(1*v4size));
+      glEnableVertexAttribArray(4);
+      glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4), (void *)(2*v4size));
+      glEnableVertexAttribArray(5);
+      glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(glm::vec4), (void *)(3*v4size));
+      glEnableVertexAttribArray(6);
+
+      glVertexAttribDivisor(3, 1);
+      glVertexAttribDivisor(4, 1);
+      glVertexAttribDivisor(5, 1);
+      glVertexAttribDivisor(6, 1);
+
+      glBindVertexArray(0);
+   }
+
+   // occluder prepass target, depth only
+   unsigned int occluder_fbo, occluder_depth;
+   glGenFramebuffers(1, &occluder_fbo);
+   glBindFramebuffer(GL_FRAMEBUFFER, occluder_fbo);
+   glGenTextures(1, &occluder_depth);
+   glBindTexture(GL_TEXTURE_2D, occluder_depth);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, s_width, s_height, 0,
+                GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+   glBindTexture(GL_TEXTURE_2D, 0);
+   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, occluder_depth, 0);
+   glDrawBuffer(GL_NONE);
+   glReadBuffer(GL_NONE);
+   if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+      std::cerr << "ERROR: Framebuffer not complete." << std::endl;
+   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+   HiZ hiz(s_width, s_height);
+   HiZCuller culler(cull_vbo);
+
+   std::vector<glm::mat4> visible_matrices;
+   visible_matrices.reserve(amount);
+   cull_mode uploaded_mode = CULL_NONE;
+
+   CullStats stats;
+   unsigned int n_frames = 0;
+   double last_report = glfwGetTime();
+
+   while (!glfwWindowShouldClose(window)) {
+      utils::process_input(window, last_frame, delta_time, camera);
+
+      glm::mat4 projection;
+      projection = glm::perspective(glm::radians(camera.zoom),
+                                    (float)s_width/s_height,
+                                    0.1f, 1000.0f);
+
+      float _R = 200.0f;
+      float _x = sin(glfwGetTime() / 3.14) * _R;
+      float _z = cos(glfwGetTime() / 3.14) * _R;
+      camera.update_position(glm::vec3(_x, 80.0f, _z));
+      glm::mat4 view = camera.get_view_matrix(MOVING);
+      glm::mat4 view_projection = projection * view;
+      Frustum frustum(view_projection);
+
+      glm::mat4 wmodel;
+      wmodel = glm::scale(wmodel, glm::vec3(4.0f));
+
+      // planet meshes are only frustum tested, they are the occluders
+      std::vector<Mesh> &planet_meshes = model_planet.meshes;
+      std::vector<bool> planet_visible(planet_meshes.size());
+      for (size_t i = 0; i < planet_meshes.size(); ++i) {
+         planet_visible[i] = frustum.intersects(planet_meshes[i].bounds.transform(wmodel));
+         stats.tested++;
+         if (!planet_visible[i])
+            stats.frustum_rejected++;
+      }
+
+      // 1. occluder prepass
+      shader_planet.use();
+      shader_planet.setmat4("projection", projection);
+      shader_planet.setmat4("view", view);
+      shader_planet.setmat4("model", wmodel);
+      unsigned int n_visible = amount;
+      if (mode != CULL_NONE) {
+         glBindFramebuffer(GL_FRAMEBUFFER, occluder_fbo);
+         glClear(GL_DEPTH_BUFFER_BIT);
+         for (size_t i = 0; i < planet_meshes.size(); ++i)
+            if (planet_visible[i])
+               planet_meshes[i].draw(shader_planet);
+         glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+         // 2. depth pyramid
+         hiz.build(shader_reduce, occluder_depth, s_width, s_height, view_projection);
+      }
+
+      // 3. cull the asteroids
+      if (mode == CULL_NONE) {
+         if (uploaded_mode != CULL_NONE) {
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, amount * sizeof(glm::mat4), &model_matrices[0]);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+         }
+         stats.tested += amount;
+      } else if (mode == CULL_CPU) {
+         hiz.update_cpu();
+         hiz.read_back();
+
+         visible_matrices.clear();
+         for (unsigned int i = 0; i < amount; ++i) {
+            AABB box(instances[i].box_min, instances[i].box_max);
+            stats.tested++;
+            if (!frustum.intersects(box)) {
+               stats.frustum_rejected++;
+            } else if (hiz.occluded_cpu(box, view_projection)) {
+               stats.occlusion_rejected++;
+            } else {
+               visible_matrices.push_back(model_matrices[i]);
+            }
+         }
+         n_visible = visible_matrices.size();
+         if (n_visible) {
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, n_visible * sizeof(glm::mat4), &visible_matrices[0]);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+         }
+      } else {
+         // every slot is drawn, the culled ones collapse to a point
+         n_visible = culler.cull(shader_cull, hiz, amount, vbo, stats);
+      }
+      uploaded_mode = mode;
+
+      // 4. draw
+      glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+      shader_planet.use();
+      for (size_t i = 0; i < planet_meshes.size(); ++i)
+         if (planet_visible[i])
+            planet_meshes[i].draw(shader_planet);
+
+      shader_rock.use();
+      shader_rock.setmat4("projection", projection);
+      shader_rock.setmat4("view", view);
+      if (n_visible) {
+         for (size_t i = 0; i < meshes.size(); ++i) {
+           glBindVertexArray(meshes[i].VAO);
+           glDrawElementsInstanced(
+               GL_TRIANGLES, meshes[i].indices.size(), GL_UNSIGNED_INT, 0, n_visible
+           );
+           glBindVertexArray(0);
+         }
+      }
+
+      // share of rejected instances, averaged over a second
+      ++n_frames;
+      double now = glfwGetTime();
+      if (now - last_report >= 1.0) {
+         std::cout << "mode: " << cull_mode_names[mode]
+                   << " fps: " << n_frames / (now - last_report)
+                   << std::endl;
+         stats.pprint("   ");
+         stats.reset();
+         n_frames = 0;
+         last_report = now;
+      }
+
+      glfwSwapBuffers(window);
+      glfwPollEvents();
+   }
+
+   glfwTerminate();
+   return 0;
+}
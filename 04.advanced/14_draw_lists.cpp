@@ -0,0 +1,317 @@
+/* Multithreaded draw list recording
+ *  - every frame all the asteroids move along their orbit and spin, so their model
+ *    matrices have to be rebuilt on the CPU
+ *  - the belt is split into chunks and worker threads (job_system.hpp) build the
+ *    matrices, cull them against every view and record draw commands (draw_list.hpp)
+ *  - matrices go straight into a persistently mapped texture buffer (stream_buffer.hpp),
+ *    the GL thread only maps it, merges the per-chunk command lists and replays them
+ *  - two views are recorded: the orbiting camera and an overhead map in the corner
+ *
+ *  keys:
+ *    T : toggle between the thread pool and a single thread to compare frame CPU time
+ *
+ *  usage: ./draw_lists [number of asteroids] [number of threads]
+ */
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <math.h>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/matrix_transform.hpp>
+#include <glm/glm/gtc/type_ptr.hpp>
+
+#include <shader.hpp>
+#include <mesh.hpp>
+#include <camera.hpp>
+#include <utils.hpp>
+#include <model.hpp>
+#include <bounds.hpp>
+#include <job_system.hpp>
+#include <draw_list.hpp>
+#include <gl_ext.hpp>
+#include <stream_buffer.hpp>
+
+const unsigned int N_VIEWS = 2;
+const size_t CHUNK_SIZE = 2048;
+
+// for adjusting camera speed
+float delta_time = 0.0f;
+float last_frame = 0.0f;
+
+Camera camera(glm::vec3(0.0f, 0.0f, 200.0f));
+bool use_pool = true;
+
+// asteroid state, stored per field so a chunk only streams what it uses
+struct Asteroids {
+   std::vector<float> orbit_radius;
+   std::vector<float> orbit_angle;
+   std::vector<float> orbit_speed;
+   std::vector<float> height;
+   std::vector<float> scale;
+   std::vector<float> spin;
+   std::vector<glm::vec3> axis;
+
+   void resize(size_t n) {
+      orbit_radius.resize(n);
+      orbit_angle.resize(n);
+      orbit_speed.resize(n);
+      height.resize(n);
+      scale.resize(n);
+      spin.resize(n);
+      axis.resize(n);
+   }
+};
+
+struct View {
+   glm::mat4 projection;
+   glm::mat4 view;
+   Frustum frustum;
+   int viewport[4];
+   DrawList list;
+   std::vector<DrawList> chunk_lists;
+};
+
+/**************************** KEY CALLBACK ****************************/
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    if (action == GLFW_PRESS && key == GLFW_KEY_T)
+        use_pool = !use_pool;
+}
+
+int main(int argc, char **argv) {
+   unsigned int amount = 100000;
+   unsigned int n_threads = 0;
+   if (argc > 1)
+      amount = std::atoi(argv[1]);
+   if (argc > 2)
+      n_threads = std::atoi(argv[2]);
+
+   int s_width = 1800, s_height = 1000;
+   glfwInit();
+   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+   GLFWwindow *window = glfwCreateWindow(s_width, s_height, "Draw Lists", NULL, NULL);
+   if (window == NULL) {
+      std::cout << "Couldn't create window!";
+      glfwTerminate();
+      return -1;
+   }
+   glfwMakeContextCurrent(window);
+   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+      std::cout << "Failed to initialize GLAD" << std::endl;
+      return -1;
+   }
+   glext::load((GLADloadproc)glfwGetProcAddress);
+
+   glEnable(GL_DEPTH_TEST);
+   glEnable(GL_SCISSOR_TEST);
+   glfwSetKeyCallback(window, key_callback);
+
+   Shader shader("../shaders/04.advanced/14_draw_list.vs",
+                 "../shaders/04.advanced/11_instance4_rock.fs"
+                 );
+   shader.setuniform("matrices", 0);
+   GLint base_location = glGetUniformLocation(shader.id(), "base_instance");
+
+   Model model_planet("../models/planet/planet.obj");
+   Model model_rock("../models/rock/rock.obj");
+
+   std::vector<DrawItem> items;
+   unsigned int planet_first = add_draw_items(items, model_planet.meshes);
+   unsigned int rock_first = add_draw_items(items, model_rock.meshes);
+   unsigned int n_rock_items = model_rock.meshes.size();
+   float rock_radius = glm::length(model_rock.bounds.extents())
+                     + glm::length(model_rock.bounds.center());
+
+   Asteroids rocks;
+   rocks.resize(amount);
+   srand(glfwGetTime());
+   for (unsigned int i = 0; i < amount; ++i) {
+      float offset = (rand() % 5000) / 100.0f - 25.0f;
+      rocks.orbit_radius[i] = 150.0f + offset;
+      rocks.orbit_angle[i] = (float)i / (float)amount * 2.0f * 3.14159265f;
+      rocks.orbit_speed[i] = 2.0f / rocks.orbit_radius[i];
+      rocks.height[i] = ((rand() % 5000) / 100.0f - 25.0f) * 0.4f;
+      rocks.scale[i] = (rand() % 20) / 100.0f + 0.05f;
+      rocks.spin[i] = (rand() % 100) / 100.0f;
+      rocks.axis[i] = glm::normalize(glm::vec3(0.4f, 0.6f, 0.8f)
+                                     + glm::vec3(rand() % 10, rand() % 10, rand() % 10) * 0.05f);
+   }
+
+   // every view owns `amount + 1` slots: the asteroids then the planet
+   unsigned int view_slots = amount + 1;
+   TransformBuffer transforms(N_VIEWS * view_slots);
+
+   size_t n_chunks = ThreadPool::n_chunks(amount, CHUNK_SIZE);
+   View views[N_VIEWS];
+   for (unsigned int v = 0; v < N_VIEWS; ++v)
+      views[v].chunk_lists.resize(n_chunks);
+
+   // per-view uniform blocks, one aligned pair of matrices each
+   GLint ubo_align;
+   glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ubo_align);
+   size_t block_size = (2 * sizeof(glm::mat4) + ubo_align - 1) / ubo_align * ubo_align;
+   StreamBuffer view_ubo(GL_UNIFORM_BUFFER, N_VIEWS * block_size);
+
+   int map_size = s_height / 3;
+   views[0].viewport[0] = 0;
+   views[0].viewport[1] = 0;
+   views[0].viewport[2] = s_width;
+   views[0].viewport[3] = s_height;
+   views[1].viewport[0] = s_width - map_size;
+   views[1].viewport[1] = s_height - map_size;
+   views[1].viewport[2] = map_size;
+   views[1].viewport[3] = map_size;
+   views[1].projection = glm::perspective(glm::radians(45.0f), 1.0f, 1.0f, 1000.0f);
+   views[1].view = glm::lookAt(glm::vec3(0.0f, 450.0f, 0.0f), glm::vec3(0.0f),
+                               glm::vec3(0.0f, 0.0f, -1.0f));
+
+   ThreadPool pool(n_threads);
+   ThreadPool serial(1);
+   std::cout << "recording with " << pool.size() << " threads" << std::endl;
+
+   ReplayStats stats;
+   double record_ms = 0.0;
+   unsigned int n_frames = 0;
+   double last_report = glfwGetTime();
+
+   while (!glfwWindowShouldClose(window)) {
+      utils::process_input(window, last_frame, delta_time, camera);
+      float time = glfwGetTime();
+
+      float _R = 200.0f;
+      camera.update_position(glm::vec3(sin(time / 3.14) * _R, 80.0f, cos(time / 3.14) * _R));
+      views[0].projection = glm::perspective(glm::radians(camera.zoom),
+                                             (float)s_width/s_height,
+                                             0.1f, 1000.0f);
+      views[0].view = camera.get_view_matrix(MOVING);
+      for (unsigned int v = 0; v < N_VIEWS; ++v)
+         views[v].frustum = Frustum(views[v].projection * views[v].view);
+
+      // record: GL thread maps, workers fill, GL thread unmaps
+      std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+      glm::mat4 *slots = transforms.map();
+      if (!slots)
+         break;
+
+      ThreadPool &jobs = use_pool ? pool : serial;
+      jobs.parallel_for(amount, CHUNK_SIZE, [&](size_t begin, size_t end, unsigned int worker) {
+         size_t chunk = begin / CHUNK_SIZE;
+         unsigned int n_visible[N_VIEWS] = { 0 };
+
+         for (size_t i = begin; i < end; ++i) {
+            float angle = rocks.orbit_angle[i] + time * rocks.orbit_speed[i];
+            glm::vec3 position(sin(angle) * rocks.orbit_radius[i],
+                               rocks.height[i],
+                               cos(angle) * rocks.orbit_radius[i]);
+            Sphere bound(position, rock_radius * rocks.scale[i]);
+
+            glm::mat4 model;
+            bool built = false;
+            for (unsigned int v = 0; v < N_VIEWS; ++v) {
+               if (!views[v].frustum.intersects(bound))
+                  continue;
+               if (!built) {
+                  model = glm::translate(model, position);
+                  model = glm::scale(model, glm::vec3(rocks.scale[i]));
+                  model = glm::rotate(model, time * rocks.spin[i], rocks.axis[i]);
+                  built = true;
+               }
+               // visible asteroids of a chunk are packed from the chunk's first slot
+               slots[v * view_slots + begin + n_visible[v]++] = model;
+            }
+         }
+
+         for (unsigned int v = 0; v < N_VIEWS; ++v) {
+            DrawList &list = views[v].chunk_lists[chunk];
+            list.clear();
+            if (n_visible[v] == 0)
+               continue;
+            for (unsigned int m = 0; m < n_rock_items; ++m)
+               list.add(rock_first + m, v * view_slots + begin, n_visible[v]);
+         }
+      });
+
+      // planet plus the per-view merge and sort
+      glm::mat4 planet = glm::scale(glm::mat4(), glm::vec3(4.0f));
+      jobs.parallel_for(N_VIEWS, 1, [&](size_t begin, size_t end, unsigned int worker) {
+         for (size_t v = begin; v < end; ++v) {
+            View &view = views[v];
+            view.list.clear();
+            unsigned int planet_slot = v * view_slots + amount;
+            slots[planet_slot] = planet;
+            for (size_t m = 0; m < model_planet.meshes.size(); ++m)
+               view.list.add(planet_first + m, planet_slot);
+            for (size_t c = 0; c < view.chunk_lists.size(); ++c)
+               view.list.append(view.chunk_lists[c]);
+            view.list.sort();
+         }
+      });
+      transforms.unmap();
+      std::chrono::duration<double, std::milli> elapsed =
+         std::chrono::high_resolution_clock::now() - start;
+      record_ms += elapsed.count();
+
+      // pack the per-view uniforms
+      size_t view_offsets[N_VIEWS] = { 0 };
+      view_ubo.begin_frame();
+      for (unsigned int v = 0; v < N_VIEWS; ++v) {
+         glm::mat4 *matrices = (glm::mat4 *)view_ubo.alloc(2 * sizeof(glm::mat4), view_offsets[v]);
+         if (matrices) {
+            matrices[0] = views[v].projection;
+            matrices[1] = views[v].view;
+         }
+      }
+      view_ubo.commit();
+
+      // submit: replay the compact command streams
+      glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+      shader.use();
+      transforms.bind(shader, 1);
+      for (unsigned int v = 0; v < N_VIEWS; ++v) {
+         View &view = views[v];
+         glViewport(view.viewport[0], view.viewport[1], view.viewport[2], view.viewport[3]);
+         glScissor(view.viewport[0], view.viewport[1], view.viewport[2], view.viewport[3]);
+         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+         glBindBufferRange(GL_UNIFORM_BUFFER, 0, view_ubo.buffer,
+                           view_offsets[v], 2 * sizeof(glm::mat4));
+
+         view.list.replay(items, base_location, transforms.base, stats);
+      }
+      transforms.end_frame();
+      view_ubo.end_frame();
+
+      ++n_frames;
+      double now = glfwGetTime();
+      if (now - last_report >= 1.0) {
+         std::cout << (use_pool ? pool.size() : 1) << " threads"
+                   << " fps: " << n_frames / (now - last_report)
+                   << " record: " << record_ms / n_frames << " ms"
+                   << " commands: " << stats.commands / n_frames
+                   << " instances: " << stats.instances / n_frames
+                   << std::endl;
+         transforms.stream.stats.pprint("   transforms");
+         transforms.stream.stats.reset();
+         stats.reset();
+         record_ms = 0.0;
+         n_frames = 0;
+         last_report = now;
+      }
+
+      glfwSwapBuffers(window);
+      glfwPollEvents();
+   }
+
+   glfwTerminate();
+   return 0;
+}
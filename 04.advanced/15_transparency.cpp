@@ -0,0 +1,328 @@
+/* Sorted transparency at scale
+ *  - a cloud of textured, semi transparent quads, every one of them blended
+ *  - each frame the quads are sorted back to front by a radix sort on quantised
+ *    distances (transparency.hpp), no per-frame allocation and no lost quads
+ *    when two of them are at the same distance
+ *  - the sorted instance data is streamed into a buffer and drawn with a single
+ *    instanced draw per batch
+ *  - alternatively weighted blended OIT (oit.hpp) draws the quads unsorted and
+ *    resolves them in a full screen pass
+ *
+ *  keys:
+ *    1 : sorted back to front
+ *    2 : unsorted, in creation order (shows the artifacts the sort removes)
+ *    3 : weighted blended OIT
+ *
+ *  usage: ./transparency [number of quads]
+ *         ./transparency bench     (sorted vs OIT, CPU and GPU time per quad count)
+ */
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <math.h>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/matrix_transform.hpp>
+#include <glm/glm/gtc/type_ptr.hpp>
+
+#include <shader.hpp>
+#include <mesh.hpp>
+#include <camera.hpp>
+#include <utils.hpp>
+#include <gl_ext.hpp>
+#include <transparency.hpp>
+#include <oit.hpp>
+#include <gpu_timer.hpp>
+
+enum blend_mode {
+   BLEND_SORTED,
+   BLEND_UNSORTED,
+   BLEND_OIT
+};
+
+const char *blend_mode_names[] = { "sorted", "unsorted", "oit" };
+
+// benchmark: every mode runs WARMUP + MEASURE frames for every quad count
+const unsigned int bench_counts[] = { 1000, 10000, 100000, 1000000 };
+const blend_mode bench_modes[] = { BLEND_SORTED, BLEND_OIT };
+const unsigned int WARMUP = 30;
+const unsigned int MEASURE = 120;
+
+// for adjusting camera speed
+float delta_time = 0.0f;
+float last_frame = 0.0f;
+
+// callbacks
+bool first_mouse = true;
+double x_old = 400.0f;
+double y_old = 300.0f;
+
+Camera camera(glm::vec3(0.0f, 0.0f, 80.0f));
+blend_mode mode = BLEND_SORTED;
+
+/**************************** MOUSE CALLBACK ****************************/
+void mouse_callback(GLFWwindow *window,
+                    double x_new, double y_new) {
+    if (first_mouse) {
+        x_old = x_new;
+        y_old = y_new;
+        first_mouse = false;
+    }
+    float dx = x_new - x_old;
+    float dy = y_old - y_new;
+    x_old = x_new;
+    y_old = y_new;
+
+    camera.process_mouse_movement(dx, dy);
+}
+
+/**************************** SCROLL CALLBACK ****************************/
+void scroll_callback(GLFWwindow *window, double dx, double dy) {
+    camera.process_scroll(dy);
+}
+
+/**************************** KEY CALLBACK ****************************/
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    if (action != GLFW_PRESS)
+        return;
+    if (key == GLFW_KEY_1)
+        mode = BLEND_SORTED;
+    else if (key == GLFW_KEY_2)
+        mode = BLEND_UNSORTED;
+    else if (key == GLFW_KEY_3)
+        mode = BLEND_OIT;
+}
+
+int main(int argc, char **argv) {
+   unsigned int amount = 100000;
+   bool bench = argc > 1 && std::strcmp(argv[1], "bench") == 0;
+   if (bench)
+      amount = bench_counts[sizeof(bench_counts) / sizeof(bench_counts[0]) - 1];
+   else if (argc > 1)
+      amount = std::atoi(argv[1]);
+   if (amount == 0)
+      amount = 1;
+
+   int s_width = 1800, s_height = 1000;
+   glfwInit();
+   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+   GLFWwindow *window = glfwCreateWindow(s_width, s_height, "Transparency", NULL, NULL);
+   if (window == NULL) {
+      std::cout << "Couldn't create window!";
+      glfwTerminate();
+      return -1;
+   }
+   glfwMakeContextCurrent(window);
+   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+      std::cout << "Failed to initialize GLAD" << std::endl;
+      return -1;
+   }
+   glext::load((GLADloadproc)glfwGetProcAddress);
+
+   glEnable(GL_DEPTH_TEST);
+   glEnable(GL_BLEND);
+   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+   if (!bench) {
+      glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+      glfwSetCursorPosCallback(window, mouse_callback);
+      glfwSetScrollCallback(window, scroll_callback);
+      glfwSetKeyCallback(window, key_callback);
+   }
+
+   Shader shader("../shaders/04.advanced/15_transparent.vs",
+                 "../shaders/04.advanced/15_transparent.fs"
+                 );
+   Shader shader_oit("../shaders/04.advanced/15_transparent.vs",
+                     "../shaders/04.advanced/16_oit.fs"
+                     );
+   Shader shader_composite("../shaders/04.advanced/13_hiz.vs",
+                           "../shaders/04.advanced/16_oit_composite.fs"
+                           );
+   shader.use();
+   shader.seti("texture_sampler", 0);
+   shader.setf("tint_amount", 1.0f);
+   shader_oit.use();
+   shader_oit.seti("texture_sampler", 0);
+   shader_oit.setf("tint_amount", 1.0f);
+
+   WeightedOIT oit(s_width, s_height);
+   GpuTimer gpu_timer;
+
+   float quad_vertices[] = {
+       // positions          // texture Coords
+       -0.5f,  0.5f,  0.0f,  0.0f,  0.0f,
+       -0.5f, -0.5f,  0.0f,  0.0f,  1.0f,
+        0.5f, -0.5f,  0.0f,  1.0f,  1.0f,
+
+       -0.5f,  0.5f,  0.0f,  0.0f,  0.0f,
+        0.5f, -0.5f,  0.0f,  1.0f,  1.0f,
+        0.5f,  0.5f,  0.0f,  1.0f,  0.0f
+   };
+
+   unsigned int VAO, VBO;
+   glGenVertexArrays(1, &VAO);
+   glGenBuffers(1, &VBO);
+   glBindVertexArray(VAO);
+   glBindBuffer(GL_ARRAY_BUFFER, VBO);
+   glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertices), &quad_vertices, GL_STATIC_DRAW);
+   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
+   glEnableVertexAttribArray(0);
+   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(3 * sizeof(float)));
+   glEnableVertexAttribArray(1);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   glBindVertexArray(0);
+
+   unsigned int window_texture = utils::texture_from_file("../texture/blending_transparent_window.png");
+
+   // quads scattered in a cube, denser scenes get a bigger cube
+   float extent = 10.0f * cbrtf(amount / 1000.0f) + 5.0f;
+   std::vector<glm::vec3> positions(amount);
+   std::vector<glm::vec4> instances(amount);
+   srand(glfwGetTime());
+   for (unsigned int i = 0; i < amount; ++i) {
+      glm::vec3 p = glm::vec3(rand() % 10000, rand() % 10000, rand() % 10000) / 5000.0f - 1.0f;
+      positions[i] = p * extent;
+      instances[i] = glm::vec4(positions[i], (rand() % 100) / 100.0f + 0.5f);
+   }
+
+   // farthest quad seen from the (bench) camera, keys are quantised over that range
+   TransparencySorter sorter(amount, 4.0f * extent + glm::length(camera.position));
+   TransparentInstances sorted_instances(amount);
+   sorted_instances.setup(VAO, 2);
+
+   // bench state
+   size_t n_bench_counts = sizeof(bench_counts) / sizeof(bench_counts[0]);
+   size_t n_bench_modes = sizeof(bench_modes) / sizeof(bench_modes[0]);
+   size_t bench_step = 0;
+   unsigned int bench_frame = 0, bench_samples = 0;
+   double bench_cpu = 0.0, bench_gpu = 0.0;
+   unsigned int n = amount;
+   if (bench) {
+      n = bench_counts[0];
+      mode = bench_modes[0];
+      std::cout << "quads\tmode\tcpu ms\tgpu ms" << std::endl;
+   }
+
+   double cpu_ms = 0.0, gpu_ms = 0.0;
+   unsigned int n_frames = 0, n_draws = 0, n_gpu = 0;
+   double last_report = glfwGetTime();
+
+   while (!glfwWindowShouldClose(window)) {
+      if (bench) {
+         // fixed orbit so every step sees the same views
+         float time = bench_frame / 60.0f;
+         camera.update_position(glm::vec3(sin(time) * 2.0f * extent, 0.3f * extent,
+                                          cos(time) * 2.0f * extent));
+      } else {
+         utils::process_input(window, last_frame, delta_time, camera);
+      }
+
+      glm::mat4 projection = glm::perspective(glm::radians(camera.zoom),
+                                              (float)s_width/s_height,
+                                              0.1f, 1000.0f);
+      glm::mat4 view = camera.get_view_matrix(bench ? MOVING : STATIC);
+
+      // cpu side: ordering and streaming the instances
+      std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+      if (mode == BLEND_SORTED)
+         sorter.sort(&positions[0], NULL, n, camera.position);
+      else
+         sorter.identity(n);
+      bool uploaded = sorted_instances.upload(sorter, &instances[0]);
+      std::chrono::duration<double, std::milli> elapsed =
+         std::chrono::high_resolution_clock::now() - start;
+      cpu_ms += elapsed.count();
+
+      Shader &active = mode == BLEND_OIT ? shader_oit : shader;
+      glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+      if (mode == BLEND_OIT) {
+         oit.begin_opaque();
+      } else {
+         glBindFramebuffer(GL_FRAMEBUFFER, 0);
+         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      }
+
+      gpu_timer.begin();
+      if (mode == BLEND_OIT)
+         oit.begin_transparent();
+      active.use();
+      active.setmat4("view", view);
+      active.setmat4("projection", projection);
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, window_texture);
+      if (uploaded) {
+         for (size_t i = 0; i < sorter.runs.size(); ++i)
+            sorted_instances.draw(VAO, 2, sorter.runs[i], GL_TRIANGLES, 0, 6);
+         n_draws += sorter.runs.size();
+         glBindVertexArray(0);
+      }
+      if (mode == BLEND_OIT) {
+         oit.composite(shader_composite);
+         oit.present(0);
+         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      }
+      gpu_timer.end();
+      sorted_instances.end_frame();
+
+      double ms;
+      while (gpu_timer.result(ms)) {
+         gpu_ms += ms;
+         n_gpu++;
+         if (bench && bench_frame >= WARMUP) {
+            bench_gpu += ms;
+            bench_samples++;
+         }
+      }
+      n_frames++;
+
+      if (bench) {
+         if (bench_frame >= WARMUP)
+            bench_cpu += elapsed.count();
+         if (++bench_frame == WARMUP + MEASURE) {
+            std::cout << n << "\t" << blend_mode_names[mode]
+                      << "\t" << bench_cpu / MEASURE
+                      << "\t" << (bench_samples ? bench_gpu / bench_samples : 0.0)
+                      << std::endl;
+            bench_frame = bench_samples = 0;
+            bench_cpu = bench_gpu = 0.0;
+            if (++bench_step == n_bench_counts * n_bench_modes)
+               break;
+            n = bench_counts[bench_step / n_bench_modes];
+            mode = bench_modes[bench_step % n_bench_modes];
+         }
+      } else {
+         double now = glfwGetTime();
+         if (now - last_report >= 1.0) {
+            std::cout << "mode: " << blend_mode_names[mode]
+                      << " quads: " << n
+                      << " fps: " << n_frames / (now - last_report)
+                      << " cpu: " << cpu_ms / n_frames << " ms"
+                      << " gpu: " << (n_gpu ? gpu_ms / n_gpu : 0.0) << " ms"
+                      << " draws/frame: " << n_draws / n_frames
+                      << std::endl;
+            sorted_instances.stream.stats.pprint("   instances");
+            sorted_instances.stream.stats.reset();
+            cpu_ms = gpu_ms = 0.0;
+            n_frames = n_draws = n_gpu = 0;
+            last_report = now;
+         }
+      }
+
+      glfwSwapBuffers(window);
+      glfwPollEvents();
+   }
+
+   glfwTerminate();
+   return 0;
+}
@@ -0,0 +1,595 @@
+/* BVH spatial index
+ *  - every asteroid of the belt is an object with a world space box, the boxes
+ *    are indexed by a BVH built with binned SAH (bvh.hpp)
+ *  - asteroids orbit the planet, each frame the BVH is refit to the new boxes
+ *    and rebuilt once refitting has degraded its SAH cost too much
+ *  - frustum culling, the pick ray along the view direction and the proximity
+ *    sphere around the camera are all BVH queries
+ *  - the planet is placed in a scene graph, a second BVH indexes the world
+ *    boxes of its meshes (Model::mesh_bounds) and only the meshes in the
+ *    frustum are drawn
+ *
+ *  keys:
+ *    1 : brute force, every box is tested
+ *    2 : BVH queries
+ *
+ *  usage: ./bvh [number of asteroids]
+ *         ./bvh bench     (build, refit and queries vs brute force at 10k, 100k and 1M,
+ *                          then the same over the meshes of a field of nanosuits,
+ *                          a hidden window only loads the model)
+ */
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cfloat>
+#include <chrono>
+#include <algorithm>
+#include <math.h>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/matrix_transform.hpp>
+#include <glm/glm/gtc/type_ptr.hpp>
+
+#include <shader.hpp>
+#include <mesh.hpp>
+#include <camera.hpp>
+#include <utils.hpp>
+#include <model.hpp>
+#include <bounds.hpp>
+#include <bvh.hpp>
+#include <scene_graph.hpp>
+
+enum query_mode {
+   QUERY_BRUTE_FORCE,
+   QUERY_BVH
+};
+
+const char *query_mode_names[] = { "brute force", "bvh" };
+
+// benchmark sizes, and queries of each kind per size
+const unsigned int bench_counts[] = { 10000, 100000, 1000000 };
+const unsigned int BENCH_QUERIES = 200;
+// nanosuits placed for the mesh level benchmark, every one adds all its meshes
+const unsigned int bench_suits[] = { 1000, 10000, 100000 };
+
+// rebuild once refitting made the tree this much more expensive than fresh
+const float REBUILD_RATIO = 1.5f;
+const float PROXIMITY_RADIUS = 20.0f;
+
+// for adjusting camera speed
+float delta_time = 0.0f;
+float last_frame = 0.0f;
+
+// callbacks
+bool first_mouse = true;
+double x_old = 400.0f;
+double y_old = 300.0f;
+
+Camera camera(glm::vec3(0.0f, 0.0f, 200.0f));
+query_mode mode = QUERY_BVH;
+
+/**************************** MOUSE CALLBACK ****************************/
+void mouse_callback(GLFWwindow *window,
+                    double x_new, double y_new) {
+    if (first_mouse) {
+        x_old = x_new;
+        y_old = y_new;
+        first_mouse = false;
+    }
+    float dx = x_new - x_old;
+    float dy = y_old - y_new;
+    x_old = x_new;
+    y_old = y_new;
+
+    camera.process_mouse_movement(dx, dy);
+}
+
+/**************************** SCROLL CALLBACK ****************************/
+void scroll_callback(GLFWwindow *window, double dx, double dy) {
+    camera.process_scroll(dy);
+}
+
+/**************************** KEY CALLBACK ****************************/
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    if (action != GLFW_PRESS)
+        return;
+    if (key == GLFW_KEY_1)
+        mode = QUERY_BRUTE_FORCE;
+    else if (key == GLFW_KEY_2)
+        mode = QUERY_BVH;
+}
+
+/**************************** ASTEROID BELT ****************************/
+// orbit parameters, the transform at time t is derived from them
+struct Asteroid {
+   float angle, radius, height;
+   float scale, spin, speed;
+};
+
+float random_float(float lo, float hi) {
+   return lo + (hi - lo) * (rand() % 10000) / 10000.0f;
+}
+
+// the belt grows with the count so density stays about the same
+void make_belt(std::vector<Asteroid> &belt, unsigned int amount) {
+   float grow = cbrtf(amount / 20000.0f);
+   float width = 25.0f * grow;
+   belt.resize(amount);
+   for (unsigned int i = 0; i < amount; ++i) {
+      Asteroid &a = belt[i];
+      a.angle = random_float(0.0f, 2.0f * M_PI);
+      a.radius = 150.0f + random_float(-width, width);
+      a.height = random_float(-10.0f, 10.0f) * grow;
+      a.scale = random_float(0.05f, 0.25f);
+      a.spin = random_float(0.0f, 360.0f);
+      a.speed = 0.1f * 150.0f / a.radius;
+   }
+}
+
+glm::mat4 asteroid_transform(const Asteroid &a, float time) {
+   float angle = a.angle + a.speed * time;
+   glm::mat4 model;
+   model = glm::translate(model, glm::vec3(sinf(angle) * a.radius, a.height, cosf(angle) * a.radius));
+   model = glm::scale(model, glm::vec3(a.scale));
+   model = glm::rotate(model, a.spin, glm::vec3(0.4f, 0.6f, 0.8f));
+   return model;
+}
+
+void update_belt(const std::vector<Asteroid> &belt, const AABB &local, float time,
+                 std::vector<glm::mat4> &transforms, std::vector<AABB> &boxes) {
+   transforms.resize(belt.size());
+   boxes.resize(belt.size());
+   for (size_t i = 0; i < belt.size(); ++i) {
+      transforms[i] = asteroid_transform(belt[i], time);
+      boxes[i] = local.transform(transforms[i]);
+   }
+}
+
+/**************************** BRUTE FORCE QUERIES ****************************/
+void brute_frustum(const Frustum &frustum, const std::vector<AABB> &boxes,
+                   std::vector<unsigned int> &out) {
+   for (size_t i = 0; i < boxes.size(); ++i)
+      if (frustum.intersects(boxes[i]))
+         out.push_back(i);
+}
+
+void brute_sphere(const Sphere &sphere, const std::vector<AABB> &boxes,
+                  std::vector<unsigned int> &out) {
+   for (size_t i = 0; i < boxes.size(); ++i)
+      if (overlaps(sphere, boxes[i]))
+         out.push_back(i);
+}
+
+bool brute_raycast(const Ray &ray, const std::vector<AABB> &boxes, float &t, unsigned int &object) {
+   bool found = false;
+   for (size_t i = 0; i < boxes.size(); ++i) {
+      float t_box;
+      if (intersect(ray, boxes[i], t, t_box) && t_box < t) {
+         t = t_box;
+         object = i;
+         found = true;
+      }
+   }
+   return found;
+}
+
+/**************************** BENCHMARK ****************************/
+double elapsed_ms(std::chrono::high_resolution_clock::time_point start) {
+   std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::high_resolution_clock::now() - start;
+   return elapsed.count();
+}
+
+bool same_objects(std::vector<unsigned int> a, std::vector<unsigned int> b) {
+   std::sort(a.begin(), a.end());
+   std::sort(b.begin(), b.end());
+   return a == b;
+}
+
+// CPU only, the boxes use a unit cube instead of the rock model
+int bench() {
+   typedef std::chrono::high_resolution_clock clock;
+   AABB local(glm::vec3(-1.0f), glm::vec3(1.0f));
+   glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.8f, 0.1f, 1000.0f);
+
+   std::cout << "objects\tbuild\trefit\trebuild\tcost\tfrustum(bvh/brute)\tray(bvh/brute)\tsphere(bvh/brute)\tmatch"
+             << std::endl;
+   srand(1);
+   for (size_t c = 0; c < sizeof(bench_counts) / sizeof(bench_counts[0]); ++c) {
+      unsigned int n = bench_counts[c];
+      std::vector<Asteroid> belt;
+      std::vector<glm::mat4> transforms;
+      std::vector<AABB> boxes;
+      make_belt(belt, n);
+      update_belt(belt, local, 0.0f, transforms, boxes);
+
+      BVH bvh;
+      clock::time_point start = clock::now();
+      bvh.build(&boxes[0], n);
+      double build_ms = elapsed_ms(start);
+      float built_cost = bvh.cost();
+
+      // a second of motion, refit vs building again
+      update_belt(belt, local, 1.0f, transforms, boxes);
+      start = clock::now();
+      bvh.refit(&boxes[0]);
+      double refit_ms = elapsed_ms(start);
+      float refit_cost = bvh.cost();
+      BVH fresh;
+      start = clock::now();
+      fresh.build(&boxes[0], n);
+      double rebuild_ms = elapsed_ms(start);
+
+      // views from the belt's rim, rays and spheres at random asteroids
+      std::vector<Frustum> frustums(BENCH_QUERIES);
+      std::vector<Ray> rays(BENCH_QUERIES);
+      std::vector<Sphere> spheres(BENCH_QUERIES);
+      for (unsigned int q = 0; q < BENCH_QUERIES; ++q) {
+         float angle = 2.0f * M_PI * q / BENCH_QUERIES;
+         glm::vec3 eye(sinf(angle) * 250.0f, 40.0f, cosf(angle) * 250.0f);
+         frustums[q] = Frustum(projection * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+         glm::vec3 target = boxes[rand() % n].center();
+         rays[q] = Ray(eye, glm::normalize(target - eye));
+         spheres[q] = Sphere(boxes[rand() % n].center(), PROXIMITY_RADIUS);
+      }
+
+      bool match = true;
+      std::vector<unsigned int> a, b;
+      double frustum_ms[2] = { 0.0, 0.0 }, ray_ms[2] = { 0.0, 0.0 }, sphere_ms[2] = { 0.0, 0.0 };
+      for (unsigned int q = 0; q < BENCH_QUERIES; ++q) {
+         a.clear();
+         b.clear();
+         start = clock::now();
+         bvh.query_frustum(frustums[q], &boxes[0], a);
+         frustum_ms[0] += elapsed_ms(start);
+         start = clock::now();
+         brute_frustum(frustums[q], boxes, b);
+         frustum_ms[1] += elapsed_ms(start);
+         match = match && same_objects(a, b);
+
+         float t_bvh = FLT_MAX, t_brute = FLT_MAX;
+         unsigned int hit_bvh = 0, hit_brute = 0;
+         start = clock::now();
+         bvh.raycast(rays[q], &boxes[0], t_bvh, hit_bvh);
+         ray_ms[0] += elapsed_ms(start);
+         start = clock::now();
+         brute_raycast(rays[q], boxes, t_brute, hit_brute);
+         ray_ms[1] += elapsed_ms(start);
+         match = match && t_bvh == t_brute;
+
+         a.clear();
+         b.clear();
+         start = clock::now();
+         bvh.query_sphere(spheres[q], &boxes[0], a);
+         sphere_ms[0] += elapsed_ms(start);
+         start = clock::now();
+         brute_sphere(spheres[q], boxes, b);
+         sphere_ms[1] += elapsed_ms(start);
+         match = match && same_objects(a, b);
+      }
+
+      // per query times in ms
+      std::cout << n << "\t" << build_ms << "\t" << refit_ms << "\t" << rebuild_ms
+                << "\t" << built_cost << "->" << refit_cost
+                << "\t" << frustum_ms[0] / BENCH_QUERIES << "/" << frustum_ms[1] / BENCH_QUERIES
+                << "\t" << ray_ms[0] / BENCH_QUERIES << "/" << ray_ms[1] / BENCH_QUERIES
+                << "\t" << sphere_ms[0] / BENCH_QUERIES << "/" << sphere_ms[1] / BENCH_QUERIES
+                << "\t" << (match ? "yes" : "NO")
+                << std::endl;
+   }
+   return 0;
+}
+
+/* Boxes from Model::mesh_bounds instead of one box per object: a grid of
+ * nanosuits, each appended to a scene graph below its own placement node.
+ * Loading the model needs a context, the window stays hidden.
+ */
+int bench_meshes() {
+   typedef std::chrono::high_resolution_clock clock;
+   glfwInit();
+   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+   glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+   GLFWwindow *window = glfwCreateWindow(64, 64, "BVH bench", NULL, NULL);
+   if (window == NULL) {
+      std::cout << "Couldn't create window!";
+      glfwTerminate();
+      return -1;
+   }
+   glfwMakeContextCurrent(window);
+   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+      std::cout << "Failed to initialize GLAD" << std::endl;
+      return -1;
+   }
+   Model model("../models/nanosuit/nanosuit.obj");
+   glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.8f, 0.1f, 1000.0f);
+
+   std::cout << "suits	meshes	bounds	build	frustum(bvh/brute)	ray(bvh/brute)	match" << std::endl;
+   srand(1);
+   for (size_t c = 0; c < sizeof(bench_suits) / sizeof(bench_suits[0]); ++c) {
+      unsigned int n = bench_suits[c];
+      unsigned int side = (unsigned int)ceilf(sqrtf((float)n));
+      SceneGraph scene;
+      std::vector<unsigned int> first_nodes(n);
+      for (unsigned int i = 0; i < n; ++i) {
+         glm::mat4 placement;
+         placement = glm::translate(placement, glm::vec3(4.0f * (i % side) - 2.0f * side, 0.0f,
+                                                         4.0f * (i / side) - 2.0f * side));
+         placement = glm::rotate(placement, random_float(0.0f, 2.0f * M_PI), glm::vec3(0.0f, 1.0f, 0.0f));
+         placement = glm::scale(placement, glm::vec3(0.2f));
+         first_nodes[i] = scene.append(model.nodes, scene.add_node(-1, placement, "suit"));
+      }
+      scene.update();
+
+      std::vector<AABB> boxes, suit_boxes;
+      clock::time_point start = clock::now();
+      for (unsigned int i = 0; i < n; ++i) {
+         model.mesh_bounds(scene, first_nodes[i], suit_boxes);
+         boxes.insert(boxes.end(), suit_boxes.begin(), suit_boxes.end());
+      }
+      double bounds_ms = elapsed_ms(start);
+
+      BVH bvh;
+      start = clock::now();
+      bvh.build(&boxes[0], boxes.size());
+      double build_ms = elapsed_ms(start);
+
+      // views from above the field's edge, rays at random meshes
+      bool match = true;
+      std::vector<unsigned int> a, b;
+      double frustum_ms[2] = { 0.0, 0.0 }, ray_ms[2] = { 0.0, 0.0 };
+      for (unsigned int q = 0; q < BENCH_QUERIES; ++q) {
+         float angle = 2.0f * M_PI * q / BENCH_QUERIES;
+         glm::vec3 eye(sinf(angle) * 2.0f * side, 10.0f, cosf(angle) * 2.0f * side);
+         Frustum frustum(projection * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+         Ray ray(eye, glm::normalize(boxes[rand() % boxes.size()].center() - eye));
+
+         a.clear();
+         b.clear();
+         start = clock::now();
+         bvh.query_frustum(frustum, &boxes[0], a);
+         frustum_ms[0] += elapsed_ms(start);
+         start = clock::now();
+         brute_frustum(frustum, boxes, b);
+         frustum_ms[1] += elapsed_ms(start);
+         match = match && same_objects(a, b);
+
+         float t_bvh = FLT_MAX, t_brute = FLT_MAX;
+         unsigned int hit_bvh = 0, hit_brute = 0;
+         start = clock::now();
+         bvh.raycast(ray, &boxes[0], t_bvh, hit_bvh);
+         ray_ms[0] += elapsed_ms(start);
+         start = clock::now();
+         brute_raycast(ray, boxes, t_brute, hit_brute);
+         ray_ms[1] += elapsed_ms(start);
+         match = match && t_bvh == t_brute;
+      }
+
+      std::cout << n << "\t" << boxes.size() << "\t" << bounds_ms << "\t" << build_ms
+                << "\t" << frustum_ms[0] / BENCH_QUERIES << "/" << frustum_ms[1] / BENCH_QUERIES
+                << "\t" << ray_ms[0] / BENCH_QUERIES << "/" << ray_ms[1] / BENCH_QUERIES
+                << "\t" << (match ? "yes" : "NO")
+                << std::endl;
+   }
+   glfwTerminate();
+   return 0;
+}
+
+int main(int argc, char **argv) {
+   if (argc > 1 && std::strcmp(argv[1], "bench") == 0) {
+      bench();
+      return bench_meshes();
+   }
+
+   unsigned int amount = 20000;
+   if (argc > 1)
+      amount = std::atoi(argv[1]);
+   if (amount == 0)
+      amount = 1;
+
+   int s_width = 1800, s_height = 1000;
+   glfwInit();
+   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+   GLFWwindow *window = glfwCreateWindow(s_width, s_height, "BVH", NULL, NULL);
+   if (window == NULL) {
+      std::cout << "Couldn't create window!";
+      glfwTerminate();
+      return -1;
+   }
+   glfwMakeContextCurrent(window);
+   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+      std::cout << "Failed to initialize GLAD" << std::endl;
+      return -1;
+   }
+
+   glEnable(GL_DEPTH_TEST);
+   glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+   glfwSetCursorPosCallback(window, mouse_callback);
+   glfwSetScrollCallback(window, scroll_callback);
+   glfwSetKeyCallback(window, key_callback);
+
+   Shader shader_rock("../shaders/04.advanced/11_instance4_rock.vs",
+                      "../shaders/04.advanced/11_instance4_rock.fs"
+                      );
+   Shader shader_planet("../shaders/04.advanced/11_instance4_planet.vs",
+                        "../shaders/04.advanced/11_instance4_planet.fs"
+                        );
+
+   Model model_planet("../models/planet/planet.obj");
+   Model model_rock("../models/rock/rock.obj");
+
+   std::vector<Asteroid> belt;
+   std::vector<glm::mat4> transforms;
+   std::vector<AABB> boxes;
+   srand(glfwGetTime());
+   make_belt(belt, amount);
+   update_belt(belt, model_rock.bounds, 0.0f, transforms, boxes);
+
+   BVH bvh;
+   bvh.build(&boxes[0], amount);
+   float built_cost = bvh.cost();
+
+   // the planet doesn't move, its mesh boxes are indexed once
+   SceneGraph scene;
+   unsigned int planet = scene.add_node(-1, glm::scale(glm::mat4(), glm::vec3(4.0f)), "planet");
+   unsigned int planet_nodes = scene.append(model_planet.nodes, planet);
+   scene.update();
+   std::vector<AABB> planet_boxes;
+   model_planet.mesh_bounds(scene, planet_nodes, planet_boxes);
+   BVH planet_bvh;
+   planet_bvh.build(&planet_boxes[0], planet_boxes.size());
+
+   // visible transforms, refilled every frame
+   unsigned int vbo;
+   glGenBuffers(1, &vbo);
+   glBindBuffer(GL_ARRAY_BUFFER, vbo);
+   glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+
+   std::vector<Mesh> &meshes = model_rock.meshes;
+   GLsizei v4size = sizeof(glm::vec4);
+   for (unsigned int i = 0; i < meshes.size(); ++i) {
+      glBindVertexArray(meshes[i].VAO);
+      for (unsigned int c = 0; c < 4; ++c) {
+         glVertexAttribPointer(3 + c, 4, GL_FLOAT, GL_FALSE, 4 * v4size, (void *)(c * v4size));
+         glEnableVertexAttribArray(3 + c);
+         glVertexAttribDivisor(3 + c, 1);
+      }
+      glBindVertexArray(0);
+   }
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+   std::vector<unsigned int> visible, nearby, visible_meshes;
+   std::vector<glm::mat4> visible_matrices;
+   visible.reserve(amount);
+   visible_matrices.reserve(amount);
+
+   double update_ms = 0.0, query_ms = 0.0;
+   unsigned int n_frames = 0, n_rebuilds = 0, n_nearby = 0;
+   int picked = -1;
+   double last_report = glfwGetTime();
+
+   while (!glfwWindowShouldClose(window)) {
+      utils::process_input(window, last_frame, delta_time, camera);
+      typedef std::chrono::high_resolution_clock clock;
+
+      glm::mat4 projection;
+      projection = glm::perspective(glm::radians(camera.zoom),
+                                    (float)s_width/s_height,
+                                    0.1f, 1000.0f);
+      glm::mat4 view = camera.get_view_matrix();
+      Frustum frustum(projection * view);
+
+      // 1. move the asteroids and keep the index in sync
+      clock::time_point start = clock::now();
+      update_belt(belt, model_rock.bounds, glfwGetTime(), transforms, boxes);
+      if (mode == QUERY_BVH) {
+         bvh.refit(&boxes[0]);
+         if (bvh.cost() > REBUILD_RATIO * built_cost) {
+            bvh.build(&boxes[0], amount);
+            built_cost = bvh.cost();
+            ++n_rebuilds;
+         }
+      }
+      std::chrono::duration<double, std::milli> elapsed = clock::now() - start;
+      update_ms += elapsed.count();
+
+      // 2. visible set, pick ray and proximity query
+      start = clock::now();
+      visible.clear();
+      nearby.clear();
+      visible_meshes.clear();
+      Ray ray(camera.position, camera.front);
+      Sphere proximity(camera.position, PROXIMITY_RADIUS);
+      float t = FLT_MAX;
+      unsigned int hit = 0;
+      bool found;
+      if (mode == QUERY_BVH) {
+         bvh.query_frustum(frustum, &boxes[0], visible);
+         found = bvh.raycast(ray, &boxes[0], t, hit);
+         bvh.query_sphere(proximity, &boxes[0], nearby);
+         planet_bvh.query_frustum(frustum, &planet_boxes[0], visible_meshes);
+      } else {
+         brute_frustum(frustum, boxes, visible);
+         found = brute_raycast(ray, boxes, t, hit);
+         brute_sphere(proximity, boxes, nearby);
+         brute_frustum(frustum, planet_boxes, visible_meshes);
+      }
+      elapsed = clock::now() - start;
+      query_ms += elapsed.count();
+      n_nearby += nearby.size();
+      picked = found ? (int)hit : -1;
+
+      visible_matrices.clear();
+      for (size_t i = 0; i < visible.size(); ++i)
+         visible_matrices.push_back(transforms[visible[i]]);
+      if (!visible_matrices.empty()) {
+         glBindBuffer(GL_ARRAY_BUFFER, vbo);
+         glBufferSubData(GL_ARRAY_BUFFER, 0, visible_matrices.size() * sizeof(glm::mat4),
+                         &visible_matrices[0]);
+         glBindBuffer(GL_ARRAY_BUFFER, 0);
+      }
+
+      // 3. draw
+      glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+      shader_planet.use();
+      shader_planet.setmat4("projection", projection);
+      shader_planet.setmat4("view", view);
+      for (size_t i = 0; i < visible_meshes.size(); ++i) {
+         unsigned int m = visible_meshes[i];
+         shader_planet.setmat4("model", scene.world[planet_nodes + model_planet.mesh_nodes[m]]);
+         model_planet.meshes[m].draw(shader_planet);
+      }
+
+      shader_rock.use();
+      shader_rock.setmat4("projection", projection);
+      shader_rock.setmat4("view", view);
+      if (!visible_matrices.empty()) {
+         for (size_t i = 0; i < meshes.size(); ++i) {
+            glBindVertexArray(meshes[i].VAO);
+            glDrawElementsInstanced(GL_TRIANGLES, meshes[i].indices.size(), GL_UNSIGNED_INT, 0,
+                                    visible_matrices.size());
+            glBindVertexArray(0);
+         }
+      }
+
+      // averaged over a second
+      ++n_frames;
+      double now = glfwGetTime();
+      if (now - last_report >= 1.0) {
+         std::cout << "mode: " << query_mode_names[mode]
+                   << " fps: " << n_frames / (now - last_report)
+                   << " update: " << update_ms / n_frames << " ms"
+                   << " queries: " << query_ms / n_frames << " ms"
+                   << std::endl;
+         std::cout << "   visible: " << visible.size() << "/" << amount
+                   << " nearby: " << n_nearby / n_frames
+                   << " picked: " << picked
+                   << " rebuilds: " << n_rebuilds
+                   << " nodes: " << bvh.nodes.size()
+                   << " planet meshes: " << visible_meshes.size() << "/" << planet_boxes.size()
+                   << std::endl;
+         update_ms = query_ms = 0.0;
+         n_frames = n_rebuilds = n_nearby = 0;
+         last_report = now;
+      }
+
+      glfwSwapBuffers(window);
+      glfwPollEvents();
+   }
+
+   glfwTerminate();
+   return 0;
+}
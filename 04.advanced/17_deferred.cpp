@@ -0,0 +1,433 @@
+/* Deferred shading
+ *  - a field of textured containers lit by a sun and many moving point lights
+ *  - forward: one pass, every fragment loops over every light. It is the
+ *    baseline the bench compares deferred against: same scene, same lights,
+ *    kept here so it doesn't move with 02.lighting/06.multiple_lights, which
+ *    now bins its lights in a tiled grid
+ *  - deferred: the scene writes albedo/specular, normals and depth into a
+ *    G-buffer (deferred.hpp), then a full screen pass adds the sun and one
+ *    sphere per point light adds that light to the pixels it covers
+ *  - the lights live in a texture buffer (lights.hpp) read by both paths
+ *  - dynamic resolution (dynamic_resolution.hpp): both paths render into a corner of
+ *    the lighting target whose size follows the measured GPU frame time (50% - 100%
+ *    of the window), and a bicubic upscale fills the window
+ *
+ *  keys:
+ *    1 : forward
+ *    2 : deferred
+ *    UP / DOWN : double / halve the number of lights (1 - 1024)
+ *    R : dynamic resolution on / off
+ *
+ *  usage: ./deferred [number of lights]
+ *         ./deferred bench     (forward vs deferred, GPU time per light count, full resolution)
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <math.h>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/matrix_transform.hpp>
+#include <glm/glm/gtc/type_ptr.hpp>
+
+#include <shader.hpp>
+#include <mesh.hpp>
+#include <camera.hpp>
+#include <utils.hpp>
+#include <lights.hpp>
+#include <deferred.hpp>
+#include <gpu_timer.hpp>
+#include <dynamic_resolution.hpp>
+
+enum shading_mode {
+   SHADING_FORWARD,
+   SHADING_DEFERRED
+};
+
+const char *shading_mode_names[] = { "forward", "deferred" };
+
+const unsigned int MAX_LIGHTS = 1024;
+
+// GPU budget of a frame with dynamic resolution, leaves room for the rest of a 60 Hz frame
+const float TARGET_GPU_MS = 12.0f;
+
+// benchmark: every mode runs WARMUP + MEASURE frames for every light count
+const unsigned int bench_counts[] = { 16, 64, 256, 1024 };
+const shading_mode bench_modes[] = { SHADING_FORWARD, SHADING_DEFERRED };
+const unsigned int WARMUP = 30;
+const unsigned int MEASURE = 120;
+
+// for adjusting camera speed
+float delta_time = 0.0f;
+float last_frame = 0.0f;
+
+// callbacks
+bool first_mouse = true;
+double x_old = 400.0f;
+double y_old = 300.0f;
+
+Camera camera(glm::vec3(0.0f, 6.0f, 30.0f));
+shading_mode mode = SHADING_DEFERRED;
+unsigned int n_lights = 256;
+DynamicResolution dynres(TARGET_GPU_MS);
+
+/**************************** MOUSE CALLBACK ****************************/
+void mouse_callback(GLFWwindow *window,
+                    double x_new, double y_new) {
+    if (first_mouse) {
+        x_old = x_new;
+        y_old = y_new;
+        first_mouse = false;
+    }
+    float dx = x_new - x_old;
+    float dy = y_old - y_new;
+    x_old = x_new;
+    y_old = y_new;
+
+    camera.process_mouse_movement(dx, dy);
+}
+
+/**************************** SCROLL CALLBACK ****************************/
+void scroll_callback(GLFWwindow *window, double dx, double dy) {
+    camera.process_scroll(dy);
+}
+
+/**************************** KEY CALLBACK ****************************/
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    if (action != GLFW_PRESS)
+        return;
+    if (key == GLFW_KEY_1)
+        mode = SHADING_FORWARD;
+    else if (key == GLFW_KEY_2)
+        mode = SHADING_DEFERRED;
+    else if (key == GLFW_KEY_UP && n_lights < MAX_LIGHTS)
+        n_lights *= 2;
+    else if (key == GLFW_KEY_DOWN && n_lights > 1)
+        n_lights /= 2;
+    else if (key == GLFW_KEY_R)
+        dynres.enabled = !dynres.enabled;
+}
+
+int main(int argc, char **argv) {
+   bool bench = argc > 1 && std::strcmp(argv[1], "bench") == 0;
+   if (!bench && argc > 1)
+      n_lights = std::atoi(argv[1]);
+   if (n_lights == 0)
+      n_lights = 1;
+   if (n_lights > MAX_LIGHTS)
+      n_lights = MAX_LIGHTS;
+
+   int s_width = 1800, s_height = 1000;
+   glfwInit();
+   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+   GLFWwindow *window = glfwCreateWindow(s_width, s_height, "Deferred shading", NULL, NULL);
+   if (window == NULL) {
+      std::cout << "Couldn't create window!";
+      glfwTerminate();
+      return -1;
+   }
+   glfwMakeContextCurrent(window);
+   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+      std::cout << "Failed to initialize GLAD" << std::endl;
+      return -1;
+   }
+
+   glEnable(GL_DEPTH_TEST);
+   if (!bench) {
+      glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+      glfwSetCursorPosCallback(window, mouse_callback);
+      glfwSetScrollCallback(window, scroll_callback);
+      glfwSetKeyCallback(window, key_callback);
+   }
+
+   Shader shader_forward("../shaders/04.advanced/17_scene.vs",
+                         "../shaders/04.advanced/17_forward.fs"
+                         );
+   Shader shader_gbuffer("../shaders/04.advanced/17_scene.vs",
+                         "../shaders/04.advanced/17_gbuffer.fs"
+                         );
+   Shader shader_ambient("../shaders/04.advanced/05_post.vs",
+                         "../shaders/04.advanced/17_deferred_ambient.fs"
+                         );
+   Shader shader_light("../shaders/04.advanced/17_deferred_light.vs",
+                       "../shaders/04.advanced/17_deferred_light.fs"
+                       );
+
+   // lighting shared by both paths
+   glm::vec3 sun_direction = glm::normalize(glm::vec3(-0.3f, -1.0f, -0.4f));
+   glm::vec3 sun_color(0.08f);
+   glm::vec3 ambient(0.03f);
+   glm::vec3 clear_color(0.05f);
+   shader_forward.use();
+   shader_forward.seti("diffuse", 0);
+   shader_forward.seti("specular", 1);
+   shader_forward.seti("lights", 2);
+   shader_forward.setvec3("sun_direction", sun_direction);
+   shader_forward.setvec3("sun_color", sun_color);
+   shader_forward.setvec3("ambient", ambient);
+   shader_gbuffer.use();
+   shader_gbuffer.seti("diffuse", 0);
+   shader_gbuffer.seti("specular", 1);
+   shader_ambient.use();
+   shader_ambient.setvec3("sun_direction", sun_direction);
+   shader_ambient.setvec3("sun_color", sun_color);
+   shader_ambient.setvec3("ambient", ambient);
+   shader_ambient.setvec3("clear_color", clear_color);
+   shader_light.use();
+   shader_light.seti("lights", 3);
+
+   float vertices[] = {
+       // positions          // normals           // texture coords
+       -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+        0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+        0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
+        0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+       -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+       -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
+
+       -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+        0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
+        0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
+        0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
+       -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 1.0f,
+       -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+
+       -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+       -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+       -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+       -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+       -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+       -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+
+        0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+        0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+        0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+        0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+        0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+        0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+
+       -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+        0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
+        0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+        0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+       -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
+       -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+
+       -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
+        0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+        0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
+        0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+       -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
+       -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f
+   };
+
+   // a floor and a grid of containers, one instanced draw for all of them
+   const int GRID = 12;
+   const float SPACING = 3.0f;
+   float extent = GRID * SPACING * 0.5f;
+   std::vector<glm::vec3> instances;   // offset, scale pairs
+   instances.push_back(glm::vec3(0.0f, -0.05f, 0.0f));
+   instances.push_back(glm::vec3(2.0f * extent + 4.0f, 0.1f, 2.0f * extent + 4.0f));
+   srand(7);
+   for (int x = 0; x < GRID; ++x) {
+      for (int z = 0; z < GRID; ++z) {
+         float size = 0.6f + (rand() % 100) / 100.0f;
+         instances.push_back(glm::vec3((x + 0.5f) * SPACING - extent, 0.5f * size,
+                                       (z + 0.5f) * SPACING - extent));
+         instances.push_back(glm::vec3(size));
+      }
+   }
+   unsigned int n_instances = instances.size() / 2;
+
+   unsigned int VAO, VBO, instance_VBO;
+   glGenVertexArrays(1, &VAO);
+   glGenBuffers(1, &VBO);
+   glGenBuffers(1, &instance_VBO);
+   glBindVertexArray(VAO);
+   glBindBuffer(GL_ARRAY_BUFFER, VBO);
+   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), &vertices, GL_STATIC_DRAW);
+   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
+   glEnableVertexAttribArray(0);
+   glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(3 * sizeof(float)));
+   glEnableVertexAttribArray(1);
+   glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
+   glEnableVertexAttribArray(2);
+   glBindBuffer(GL_ARRAY_BUFFER, instance_VBO);
+   glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::vec3), &instances[0], GL_STATIC_DRAW);
+   glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), (void *)0);
+   glEnableVertexAttribArray(3);
+   glVertexAttribDivisor(3, 1);
+   glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), (void *)sizeof(glm::vec3));
+   glEnableVertexAttribArray(4);
+   glVertexAttribDivisor(4, 1);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   glBindVertexArray(0);
+
+   // the full screen pass takes its vertices from gl_VertexID
+   unsigned int empty_VAO;
+   glGenVertexArrays(1, &empty_VAO);
+
+   unsigned int diffuse_map = utils::texture_from_file("../imgs/container2.png");
+   unsigned int specular_map = utils::texture_from_file("../imgs/container2_specular.png");
+
+   std::vector<LightOrbit> orbits;
+   std::vector<PointLight> lights;
+   make_light_orbits(orbits, lights, MAX_LIGHTS, extent, 4.0f);
+   LightBuffer light_buffer(MAX_LIGHTS);
+
+   GBuffer gbuffer(s_width, s_height);
+   LightVolumes volumes;
+   GpuTimer gpu_timer;
+   Upscaler upscaler("../shaders/04.advanced/");
+   // the benchmark compares the paths at full resolution
+   dynres.enabled = !bench;
+
+   // bench state
+   size_t n_bench_counts = sizeof(bench_counts) / sizeof(bench_counts[0]);
+   size_t n_bench_modes = sizeof(bench_modes) / sizeof(bench_modes[0]);
+   size_t bench_step = 0;
+   unsigned int bench_frame = 0, bench_samples = 0;
+   double bench_gpu = 0.0;
+   if (bench) {
+      n_lights = bench_counts[0];
+      mode = bench_modes[0];
+      std::cout << "lights\tmode\tgpu ms" << std::endl;
+   }
+
+   double gpu_ms = 0.0;
+   unsigned int n_frames = 0, n_gpu = 0;
+   double last_report = glfwGetTime();
+
+   while (!glfwWindowShouldClose(window)) {
+      float time;
+      if (bench) {
+         // fixed orbit and light motion so every step sees the same frames
+         time = bench_frame / 60.0f;
+         camera.update_position(glm::vec3(sin(time * 0.5f) * 1.2f * extent, 0.5f * extent,
+                                          cos(time * 0.5f) * 1.2f * extent));
+      } else {
+         time = glfwGetTime();
+         utils::process_input(window, last_frame, delta_time, camera);
+      }
+
+      // the aspect ratio stays the window's, only the pixel count changes
+      gbuffer.set_render_size(dynres.width(s_width), dynres.height(s_height));
+      glm::mat4 projection = glm::perspective(glm::radians(camera.zoom),
+                                              (float)s_width/s_height,
+                                              0.1f, 100.0f);
+      glm::mat4 view = camera.get_view_matrix(bench ? MOVING : STATIC);
+      glm::mat4 inv_view_projection = glm::inverse(projection * view);
+
+      update_light_orbits(orbits, lights, time);
+      light_buffer.upload(&lights[0], n_lights);
+
+      gpu_timer.begin();
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, diffuse_map);
+      glActiveTexture(GL_TEXTURE1);
+      glBindTexture(GL_TEXTURE_2D, specular_map);
+      if (mode == SHADING_FORWARD) {
+         // straight into the lighting target, at the same resolution as the deferred path
+         glBindFramebuffer(GL_FRAMEBUFFER, gbuffer.light_fbo);
+         glViewport(0, 0, gbuffer.render_width, gbuffer.render_height);
+         glEnable(GL_DEPTH_TEST);
+         glClearColor(clear_color.x, clear_color.y, clear_color.z, 1.0f);
+         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+         light_buffer.bind(2);
+         shader_forward.use();
+         shader_forward.setmat4("view", view);
+         shader_forward.setmat4("projection", projection);
+         shader_forward.setvec3("view_pos", camera.position);
+         shader_forward.seti("n_lights", light_buffer.count);
+         glBindVertexArray(VAO);
+         glDrawArraysInstanced(GL_TRIANGLES, 0, 36, n_instances);
+         glBindVertexArray(0);
+      } else {
+         gbuffer.begin_geometry();
+         shader_gbuffer.use();
+         shader_gbuffer.setmat4("view", view);
+         shader_gbuffer.setmat4("projection", projection);
+         glBindVertexArray(VAO);
+         glDrawArraysInstanced(GL_TRIANGLES, 0, 36, n_instances);
+         glBindVertexArray(0);
+
+         gbuffer.begin_lighting();
+         glDisable(GL_DEPTH_TEST);
+         shader_ambient.use();
+         gbuffer.bind_textures(shader_ambient, 0);
+         shader_ambient.setmat4("inv_view_projection", inv_view_projection);
+         shader_ambient.setvec3("view_pos", camera.position);
+         glBindVertexArray(empty_VAO);
+         glDrawArrays(GL_TRIANGLES, 0, 3);
+         glBindVertexArray(0);
+
+         light_buffer.bind(3);
+         shader_light.use();
+         gbuffer.bind_textures(shader_light, 0);
+         shader_light.setmat4("view", view);
+         shader_light.setmat4("projection", projection);
+         shader_light.setmat4("inv_view_projection", inv_view_projection);
+         shader_light.setvec3("view_pos", camera.position);
+         volumes.draw(light_buffer);
+      }
+      // native resolution from here on
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glViewport(0, 0, s_width, s_height);
+      upscaler.draw(gbuffer.light_color, gbuffer.width, gbuffer.height,
+                    gbuffer.render_width, gbuffer.render_height);
+      gpu_timer.end();
+
+      double ms;
+      while (gpu_timer.result(ms)) {
+         dynres.update(ms);
+         gpu_ms += ms;
+         n_gpu++;
+         if (bench && bench_frame >= WARMUP) {
+            bench_gpu += ms;
+            bench_samples++;
+         }
+      }
+      n_frames++;
+
+      if (bench) {
+         if (++bench_frame == WARMUP + MEASURE) {
+            std::cout << n_lights << "\t" << shading_mode_names[mode]
+                      << "\t" << (bench_samples ? bench_gpu / bench_samples : 0.0)
+                      << std::endl;
+            bench_frame = bench_samples = 0;
+            bench_gpu = 0.0;
+            if (++bench_step == n_bench_counts * n_bench_modes)
+               break;
+            n_lights = bench_counts[bench_step / n_bench_modes];
+            mode = bench_modes[bench_step % n_bench_modes];
+         }
+      } else {
+         double now = glfwGetTime();
+         if (now - last_report >= 1.0) {
+            std::cout << "mode: " << shading_mode_names[mode]
+                      << " lights: " << n_lights
+                      << " scale: " << (dynres.enabled ? dynres.scale : 1.0f)
+                      << " fps: " << n_frames / (now - last_report)
+                      << " gpu: " << (n_gpu ? gpu_ms / n_gpu : 0.0) << " ms"
+                      << std::endl;
+            gpu_ms = 0.0;
+            n_frames = n_gpu = 0;
+            last_report = now;
+         }
+      }
+
+      glfwSwapBuffers(window);
+      glfwPollEvents();
+   }
+
+   glfwTerminate();
+   return 0;
+}
@@ -0,0 +1,412 @@
+/* Cascaded shadow maps
+ *  - a field of containers on a floor, a handful of them moving, lit by a
+ *    directional light with 4 shadow cascades (shadows.hpp)
+ *  - cascades are texel snapped, shadow edges don't crawl when the camera moves
+ *  - casters are culled against each cascade's light frustum
+ *  - static casters are cached per cascade and only redrawn when the cascade
+ *    moves by a texel, the moving containers are drawn over a copy every frame
+ *
+ *  keys:
+ *    C : show the cascades
+ *    X : static caster cache on / off
+ *    P : pause the moving containers
+ *
+ *  usage: ./shadows
+ *         ./shadows bench      (shadow pass GPU time, cache on vs off)
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <math.h>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/matrix_transform.hpp>
+#include <glm/glm/gtc/type_ptr.hpp>
+
+#include <shader.hpp>
+#include <mesh.hpp>
+#include <camera.hpp>
+#include <utils.hpp>
+#include <bounds.hpp>
+#include <shadows.hpp>
+#include <gpu_timer.hpp>
+
+// benchmark: each cache setting runs WARMUP + MEASURE frames
+const bool bench_cache[] = { true, false };
+const unsigned int WARMUP = 30;
+const unsigned int MEASURE = 300;
+
+// for adjusting camera speed
+float delta_time = 0.0f;
+float last_frame = 0.0f;
+
+// callbacks
+bool first_mouse = true;
+double x_old = 400.0f;
+double y_old = 300.0f;
+
+Camera camera(glm::vec3(0.0f, 8.0f, 40.0f));
+bool show_cascades = false;
+bool use_cache = true;
+bool paused = false;
+
+// a unit cube drawn with `model`
+struct Caster {
+   glm::mat4 model;
+   AABB bounds;
+   glm::vec2 tex_scale;
+};
+
+/**************************** MOUSE CALLBACK ****************************/
+void mouse_callback(GLFWwindow *window,
+                    double x_new, double y_new) {
+    if (first_mouse) {
+        x_old = x_new;
+        y_old = y_new;
+        first_mouse = false;
+    }
+    float dx = x_new - x_old;
+    float dy = y_old - y_new;
+    x_old = x_new;
+    y_old = y_new;
+
+    camera.process_mouse_movement(dx, dy);
+}
+
+/**************************** SCROLL CALLBACK ****************************/
+void scroll_callback(GLFWwindow *window, double dx, double dy) {
+    camera.process_scroll(dy);
+}
+
+/**************************** KEY CALLBACK ****************************/
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    if (action != GLFW_PRESS)
+        return;
+    if (key == GLFW_KEY_C)
+        show_cascades = !show_cascades;
+    else if (key == GLFW_KEY_X)
+        use_cache = !use_cache;
+    else if (key == GLFW_KEY_P)
+        paused = !paused;
+}
+
+/**************************** CASTERS ****************************/
+Caster make_caster(const glm::mat4 &model, glm::vec2 tex_scale) {
+   Caster caster;
+   caster.model = model;
+   caster.bounds = AABB(glm::vec3(-0.5f), glm::vec3(0.5f)).transform(model);
+   caster.tex_scale = tex_scale;
+   return caster;
+}
+
+bool any_visible(const std::vector<Caster> &casters, const Frustum &frustum) {
+   for (size_t i = 0; i < casters.size(); ++i)
+      if (frustum.intersects(casters[i].bounds))
+         return true;
+   return false;
+}
+
+// the cube VAO is bound by the caller, returns the number of draws
+unsigned int draw_casters(Shader &shader, const std::vector<Caster> &casters, const Frustum &frustum) {
+   unsigned int n = 0;
+   for (size_t i = 0; i < casters.size(); ++i) {
+      if (!frustum.intersects(casters[i].bounds))
+         continue;
+      shader.setmat4("model", casters[i].model);
+      shader.setvec2("tex_scale", casters[i].tex_scale);
+      glDrawArrays(GL_TRIANGLES, 0, 36);
+      n++;
+   }
+   return n;
+}
+
+int main(int argc, char **argv) {
+   bool bench = argc > 1 && std::strcmp(argv[1], "bench") == 0;
+
+   int s_width = 1800, s_height = 1000;
+   glfwInit();
+   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+   GLFWwindow *window = glfwCreateWindow(s_width, s_height, "Cascaded shadow maps", NULL, NULL);
+   if (window == NULL) {
+      std::cout << "Couldn't create window!";
+      glfwTerminate();
+      return -1;
+   }
+   glfwMakeContextCurrent(window);
+   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+      std::cout << "Failed to initialize GLAD" << std::endl;
+      return -1;
+   }
+
+   glEnable(GL_DEPTH_TEST);
+   if (!bench) {
+      glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+      glfwSetCursorPosCallback(window, mouse_callback);
+      glfwSetScrollCallback(window, scroll_callback);
+      glfwSetKeyCallback(window, key_callback);
+   }
+
+   // vertex shader inputs come from the layouts in mesh.hpp
+   Shader shader("../shaders/04.advanced/18_shadows.vs",
+                 "../shaders/04.advanced/18_shadows.fs",
+                 NULL, glsl_inputs<vertex>().c_str()
+                 );
+   Shader shader_depth("../shaders/04.advanced/18_shadow_depth.vs",
+                       "../shaders/04.advanced/18_shadow_depth.fs",
+                       NULL, glsl_inputs<position_vertex>().c_str()
+                       );
+
+   glm::vec3 light_direction = glm::normalize(glm::vec3(-0.4f, -1.0f, -0.3f));
+   shader.use();
+   shader.seti("material.diffuse", 0);
+   shader.seti("material.specular", 1);
+   shader.setf("material.shininess", 64.0f);
+   shader.setvec3("_dir_source.direction", light_direction);
+   shader.setvec3("_dir_source.ambient", glm::vec3(0.15f));
+   shader.setvec3("_dir_source.diffuse", glm::vec3(0.8f));
+   shader.setvec3("_dir_source.specular", glm::vec3(0.5f));
+
+   float vertices[] = {
+       // positions          // normals           // texture coords
+       -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+        0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+        0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
+        0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+       -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+       -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
+
+       -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+        0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
+        0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
+        0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
+       -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 1.0f,
+       -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+
+       -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+       -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+       -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+       -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+       -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+       -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+
+        0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+        0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+        0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+        0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+        0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+        0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+
+       -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+        0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
+        0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+        0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+       -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
+       -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+
+       -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
+        0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+        0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
+        0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+       -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
+       -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f
+   };
+
+   // the rows above are `vertex`es (mesh.hpp)
+   static_assert(sizeof(vertex) == 8 * sizeof(float), "cube rows don't match vertex");
+   unsigned int VAO, VBO;
+   glGenVertexArrays(1, &VAO);
+   glGenBuffers(1, &VBO);
+   glBindVertexArray(VAO);
+   glBindBuffer(GL_ARRAY_BUFFER, VBO);
+   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), &vertices, GL_STATIC_DRAW);
+   setup_attributes<vertex>(VBO);
+   glBindVertexArray(0);
+
+   // positions alone for the shadow pass, a third of the bytes per vertex
+   unsigned int depth_VAO, position_VBO;
+   depth_VAO = position_stream(vertices, 36, 8, position_VBO);
+
+   unsigned int diffuse_map = utils::texture_from_file("../imgs/container2.png");
+   unsigned int specular_map = utils::texture_from_file("../imgs/container2_specular.png");
+
+   // static: the floor and a grid of containers and pillars
+   const int GRID = 24;
+   const float SPACING = 6.0f;
+   float extent = GRID * SPACING * 0.5f;
+   std::vector<Caster> static_casters;
+   glm::mat4 floor_model;
+   floor_model = glm::translate(floor_model, glm::vec3(0.0f, -0.1f, 0.0f));
+   floor_model = glm::scale(floor_model, glm::vec3(2.0f * extent, 0.2f, 2.0f * extent));
+   static_casters.push_back(make_caster(floor_model, glm::vec2(extent)));
+   srand(5);
+   for (int x = 0; x < GRID; ++x) {
+      for (int z = 0; z < GRID; ++z) {
+         glm::vec3 size(1.0f + (rand() % 100) / 50.0f);
+         if (rand() % 5 == 0)
+            size.y *= 3.0f;
+         glm::mat4 model;
+         model = glm::translate(model, glm::vec3((x + 0.5f) * SPACING - extent, 0.5f * size.y,
+                                                 (z + 0.5f) * SPACING - extent));
+         model = glm::rotate(model, glm::radians((float)(rand() % 90)), glm::vec3(0.0f, 1.0f, 0.0f));
+         model = glm::scale(model, size);
+         static_casters.push_back(make_caster(model, glm::vec2(1.0f)));
+      }
+   }
+
+   // moving: containers circling the middle of the field
+   const unsigned int N_DYNAMIC = 16;
+   std::vector<Caster> dynamic_casters(N_DYNAMIC);
+
+   AABB scene;
+   for (size_t i = 0; i < static_casters.size(); ++i)
+      scene.expand(static_casters[i].bounds);
+   // room for the moving containers
+   scene.expand(glm::vec3(0.0f, 12.0f, 0.0f));
+
+   CascadedShadowMap csm(4, 2048);
+   GpuTimer gpu_timer;
+
+   // bench state
+   size_t n_bench_modes = sizeof(bench_cache) / sizeof(bench_cache[0]);
+   size_t bench_step = 0;
+   unsigned int bench_frame = 0, bench_samples = 0, bench_static = 0;
+   double bench_gpu = 0.0;
+   if (bench) {
+      use_cache = bench_cache[0];
+      std::cout << "cache\tshadow gpu ms\tstatic cascade redraws/frame" << std::endl;
+   }
+
+   double gpu_ms = 0.0;
+   unsigned int n_frames = 0, n_gpu = 0, n_static = 0, n_copies = 0, n_shadow_draws = 0;
+   double last_report = glfwGetTime();
+   float dynamic_time = 0.0f;
+
+   while (!glfwWindowShouldClose(window)) {
+      float time;
+      if (bench) {
+         // a slow fixed path, the cascades move every few frames
+         time = bench_frame / 60.0f;
+         camera.update_position(glm::vec3(sin(time * 0.1f) * 30.0f, 10.0f, cos(time * 0.1f) * 30.0f));
+      } else {
+         time = glfwGetTime();
+         utils::process_input(window, last_frame, delta_time, camera);
+      }
+      if (!paused || bench)
+         dynamic_time = time;
+
+      for (unsigned int i = 0; i < N_DYNAMIC; ++i) {
+         float angle = dynamic_time * 0.3f + 6.2831853f * i / N_DYNAMIC;
+         float radius = 10.0f + 4.0f * (i % 3);
+         glm::mat4 model;
+         model = glm::translate(model, glm::vec3(sinf(angle) * radius, 3.0f + 2.0f * sinf(dynamic_time + i),
+                                                 cosf(angle) * radius));
+         model = glm::rotate(model, dynamic_time + i, glm::vec3(1.0f, 0.3f, 0.5f));
+         model = glm::scale(model, glm::vec3(1.5f));
+         dynamic_casters[i] = make_caster(model, glm::vec2(1.0f));
+      }
+
+      float near_plane = 0.1f, far_plane = 150.0f;
+      float aspect = (float)s_width / s_height;
+      glm::mat4 projection = glm::perspective(glm::radians(camera.zoom), aspect, near_plane, far_plane);
+      glm::mat4 view = camera.get_view_matrix(bench ? MOVING : STATIC);
+
+      // shadow pass
+      gpu_timer.begin();
+      if (!use_cache)
+         csm.invalidate_static();
+      csm.update(view, glm::radians(camera.zoom), aspect, near_plane, far_plane, light_direction, scene);
+      glEnable(GL_POLYGON_OFFSET_FILL);
+      glPolygonOffset(1.5f, 3.0f);
+      shader_depth.use();
+      glBindVertexArray(depth_VAO);
+      for (int c = 0; c < csm.n_cascades; ++c) {
+         if (csm.static_stale(c)) {
+            csm.begin_static(c);
+            shader_depth.setmat4("light_view_projection", csm.light_view_projection[c]);
+            n_shadow_draws += draw_casters(shader_depth, static_casters, csm.frustums[c]);
+         }
+         if (csm.begin_dynamic(c, any_visible(dynamic_casters, csm.frustums[c]))) {
+            shader_depth.setmat4("light_view_projection", csm.light_view_projection[c]);
+            n_shadow_draws += draw_casters(shader_depth, dynamic_casters, csm.frustums[c]);
+         }
+      }
+      glDisable(GL_POLYGON_OFFSET_FILL);
+      csm.end(s_width, s_height);
+      gpu_timer.end();
+      n_static += csm.n_static_renders;
+      n_copies += csm.n_copies;
+
+      // lighting pass
+      glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      shader.use();
+      shader.setmat4("view", view);
+      shader.setmat4("projection", projection);
+      shader.setvec3("view_pos", camera.position);
+      shader.seti("show_cascades", show_cascades);
+      csm.bind(shader, 2);
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, diffuse_map);
+      glActiveTexture(GL_TEXTURE1);
+      glBindTexture(GL_TEXTURE_2D, specular_map);
+      Frustum camera_frustum(projection * view);
+      draw_casters(shader, static_casters, camera_frustum);
+      draw_casters(shader, dynamic_casters, camera_frustum);
+      glBindVertexArray(0);
+
+      double ms;
+      while (gpu_timer.result(ms)) {
+         gpu_ms += ms;
+         n_gpu++;
+         if (bench && bench_frame >= WARMUP) {
+            bench_gpu += ms;
+            bench_samples++;
+         }
+      }
+      n_frames++;
+
+      if (bench) {
+         if (bench_frame >= WARMUP)
+            bench_static += csm.n_static_renders;
+         if (++bench_frame == WARMUP + MEASURE) {
+            std::cout << (use_cache ? "on" : "off")
+                      << "\t" << (bench_samples ? bench_gpu / bench_samples : 0.0)
+                      << "\t" << (float)bench_static / MEASURE
+                      << std::endl;
+            bench_frame = bench_samples = bench_static = 0;
+            bench_gpu = 0.0;
+            if (++bench_step == n_bench_modes)
+               break;
+            use_cache = bench_cache[bench_step];
+         }
+      } else {
+         double now = glfwGetTime();
+         if (now - last_report >= 1.0) {
+            std::cout << "cache: " << (use_cache ? "on" : "off")
+                      << " fps: " << n_frames / (now - last_report)
+                      << " shadow gpu: " << (n_gpu ? gpu_ms / n_gpu : 0.0) << " ms"
+                      << " static cascade redraws/s: " << n_static
+                      << " copies/s: " << n_copies
+                      << " shadow draws/frame: " << n_shadow_draws / n_frames
+                      << std::endl;
+            gpu_ms = 0.0;
+            n_frames = n_gpu = n_static = n_copies = n_shadow_draws = 0;
+            last_report = now;
+         }
+      }
+
+      glfwSwapBuffers(window);
+      glfwPollEvents();
+   }
+
+   glfwTerminate();
+   return 0;
+}
@@ -0,0 +1,395 @@
+/* Shadow atlas
+ *  - point and spot lights over a field of containers, every light casts shadows
+ *  - the shadow maps share one depth atlas (shadow_atlas.hpp), each light gets
+ *    a tile sized by how big it is on screen, point lights get six
+ *  - a point light's six faces are drawn in one pass by a geometry shader
+ *  - tiles are kept across frames, a light is only redrawn when it moved or a
+ *    moving container came near it
+ *
+ *  keys:
+ *    X : shadows on / off
+ *    M : lights moving / still (still lights are not redrawn)
+ *
+ *  usage: ./shadow_atlas [number of lights]   (half point, half spot)
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+#include <math.h>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/matrix_transform.hpp>
+#include <glm/glm/gtc/type_ptr.hpp>
+
+#include <shader.hpp>
+#include <mesh.hpp>
+#include <camera.hpp>
+#include <utils.hpp>
+#include <bounds.hpp>
+#include <lights.hpp>
+#include <shadow_atlas.hpp>
+#include <gpu_timer.hpp>
+
+// for adjusting camera speed
+float delta_time = 0.0f;
+float last_frame = 0.0f;
+
+// callbacks
+bool first_mouse = true;
+double x_old = 400.0f;
+double y_old = 300.0f;
+
+Camera camera(glm::vec3(0.0f, 10.0f, 35.0f));
+bool shadows = true;
+bool moving = true;
+
+// a unit cube drawn with `model`
+struct Caster {
+   glm::mat4 model;
+   AABB bounds;
+   glm::vec2 tex_scale;
+};
+
+/**************************** MOUSE CALLBACK ****************************/
+void mouse_callback(GLFWwindow *window,
+                    double x_new, double y_new) {
+    if (first_mouse) {
+        x_old = x_new;
+        y_old = y_new;
+        first_mouse = false;
+    }
+    float dx = x_new - x_old;
+    float dy = y_old - y_new;
+    x_old = x_new;
+    y_old = y_new;
+
+    camera.process_mouse_movement(dx, dy);
+}
+
+/**************************** SCROLL CALLBACK ****************************/
+void scroll_callback(GLFWwindow *window, double dx, double dy) {
+    camera.process_scroll(dy);
+}
+
+/**************************** KEY CALLBACK ****************************/
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    if (action != GLFW_PRESS)
+        return;
+    if (key == GLFW_KEY_X)
+        shadows = !shadows;
+    else if (key == GLFW_KEY_M)
+        moving = !moving;
+}
+
+/**************************** CASTERS ****************************/
+Caster make_caster(const glm::mat4 &model, glm::vec2 tex_scale) {
+   Caster caster;
+   caster.model = model;
+   caster.bounds = AABB(glm::vec3(-0.5f), glm::vec3(0.5f)).transform(model);
+   caster.tex_scale = tex_scale;
+   return caster;
+}
+
+// the cube VAO is bound by the caller, returns the number of draws
+unsigned int draw_casters(Shader &shader, const std::vector<Caster> &casters, const Frustum &frustum) {
+   unsigned int n = 0;
+   for (size_t i = 0; i < casters.size(); ++i) {
+      if (!frustum.intersects(casters[i].bounds))
+         continue;
+      shader.setmat4("model", casters[i].model);
+      shader.setvec2("tex_scale", casters[i].tex_scale);
+      glDrawArrays(GL_TRIANGLES, 0, 36);
+      n++;
+   }
+   return n;
+}
+
+// casters inside a light's sphere
+unsigned int draw_casters(Shader &shader, const std::vector<Caster> &casters, const Sphere &sphere) {
+   unsigned int n = 0;
+   for (size_t i = 0; i < casters.size(); ++i) {
+      if (!overlaps(sphere, casters[i].bounds))
+         continue;
+      shader.setmat4("model", casters[i].model);
+      glDrawArrays(GL_TRIANGLES, 0, 36);
+      n++;
+   }
+   return n;
+}
+
+int main(int argc, char **argv) {
+   unsigned int n_lights = argc > 1 ? std::atoi(argv[1]) : 48;
+   if (n_lights == 0)
+      n_lights = 1;
+
+   int s_width = 1800, s_height = 1000;
+   glfwInit();
+   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+   GLFWwindow *window = glfwCreateWindow(s_width, s_height, "Shadow atlas", NULL, NULL);
+   if (window == NULL) {
+      std::cout << "Couldn't create window!";
+      glfwTerminate();
+      return -1;
+   }
+   glfwMakeContextCurrent(window);
+   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+      std::cout << "Failed to initialize GLAD" << std::endl;
+      return -1;
+   }
+
+   glEnable(GL_DEPTH_TEST);
+   glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+   glfwSetCursorPosCallback(window, mouse_callback);
+   glfwSetScrollCallback(window, scroll_callback);
+   glfwSetKeyCallback(window, key_callback);
+
+   // vertex shader inputs come from the layouts in mesh.hpp
+   Shader shader("../shaders/04.advanced/18_shadows.vs",
+                 "../shaders/04.advanced/19_atlas.fs",
+                 NULL, glsl_inputs<vertex>().c_str()
+                 );
+   Shader shader_depth("../shaders/04.advanced/19_atlas_depth.vs",
+                       "../shaders/04.advanced/19_atlas_depth.fs",
+                       "../shaders/04.advanced/19_atlas_depth.gs",
+                       glsl_inputs<position_vertex>().c_str()
+                       );
+
+   shader.use();
+   shader.seti("material.diffuse", 0);
+   shader.seti("material.specular", 1);
+   shader.setf("material.shininess", 64.0f);
+   shader.setvec3("ambient", glm::vec3(0.03f));
+   shader.seti("lights", 2);
+
+   float vertices[] = {
+       // positions          // normals           // texture coords
+       -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+        0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+        0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
+        0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+       -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+       -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
+
+       -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+        0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
+        0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
+        0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
+       -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 1.0f,
+       -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+
+       -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+       -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+       -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+       -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+       -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+       -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+
+        0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+        0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+        0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+        0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+        0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+        0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+
+       -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+        0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
+        0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+        0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+       -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
+       -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+
+       -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
+        0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+        0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
+        0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+       -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
+       -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f, 0.0f
+   };
+
+   // the rows above are `vertex`es (mesh.hpp)
+   static_assert(sizeof(vertex) == 8 * sizeof(float), "cube rows don't match vertex");
+   unsigned int VAO, VBO;
+   glGenVertexArrays(1, &VAO);
+   glGenBuffers(1, &VBO);
+   glBindVertexArray(VAO);
+   glBindBuffer(GL_ARRAY_BUFFER, VBO);
+   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), &vertices, GL_STATIC_DRAW);
+   setup_attributes<vertex>(VBO);
+   glBindVertexArray(0);
+
+   // positions alone for the shadow pass, a third of the bytes per vertex
+   unsigned int depth_VAO, position_VBO;
+   depth_VAO = position_stream(vertices, 36, 8, position_VBO);
+
+   unsigned int diffuse_map = utils::texture_from_file("../imgs/container2.png");
+   unsigned int specular_map = utils::texture_from_file("../imgs/container2_specular.png");
+
+   // static: the floor and a grid of containers
+   const int GRID = 16;
+   const float SPACING = 5.0f;
+   float extent = GRID * SPACING * 0.5f;
+   std::vector<Caster> static_casters;
+   glm::mat4 floor_model;
+   floor_model = glm::translate(floor_model, glm::vec3(0.0f, -0.1f, 0.0f));
+   floor_model = glm::scale(floor_model, glm::vec3(2.0f * extent, 0.2f, 2.0f * extent));
+   static_casters.push_back(make_caster(floor_model, glm::vec2(extent)));
+   srand(3);
+   for (int x = 0; x < GRID; ++x) {
+      for (int z = 0; z < GRID; ++z) {
+         if (rand() % 3 == 0)
+            continue;
+         glm::vec3 size(1.0f + (rand() % 100) / 60.0f);
+         glm::mat4 model;
+         model = glm::translate(model, glm::vec3((x + 0.5f) * SPACING - extent, 0.5f * size.y,
+                                                 (z + 0.5f) * SPACING - extent));
+         model = glm::rotate(model, glm::radians((float)(rand() % 90)), glm::vec3(0.0f, 1.0f, 0.0f));
+         model = glm::scale(model, size);
+         static_casters.push_back(make_caster(model, glm::vec2(1.0f)));
+      }
+   }
+
+   // moving: a few containers crossing the field
+   const unsigned int N_DYNAMIC = 4;
+   std::vector<Caster> dynamic_casters(N_DYNAMIC);
+   std::vector<AABB> dynamic_bounds(N_DYNAMIC);
+
+   // point lights and spot lights pointing down, alternating
+   std::vector<SpotLight> lights(n_lights);
+   std::vector<glm::vec3> anchors(n_lights);
+   for (unsigned int i = 0; i < n_lights; ++i) {
+      SpotLight &l = lights[i];
+      anchors[i] = glm::vec3((rand() % 1000) / 500.0f - 1.0f, 0.0f, (rand() % 1000) / 500.0f - 1.0f) * extent * 0.9f;
+      l.light.color = glm::vec3((rand() % 1000) / 1000.0f, (rand() % 1000) / 1000.0f, (rand() % 1000) / 1000.0f);
+      l.light.color[rand() % 3] = 1.0f;
+      if (i % 2 == 0) {
+         anchors[i].y = 2.5f;
+         l.light.radius = 9.0f;
+         l.light.intensity = 6.0f;
+         l.cos_cutoff = -1.0f;
+         l.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+      } else {
+         anchors[i].y = 7.0f;
+         l.light.radius = 16.0f;
+         l.light.intensity = 20.0f;
+         l.cos_cutoff = cosf(glm::radians(30.0f));
+      }
+   }
+   LightBuffer light_buffer(n_lights, sizeof(SpotLight));
+
+   ShadowAtlas atlas(4096, 64, 1024);
+   GpuTimer gpu_timer;
+
+   double gpu_ms = 0.0;
+   unsigned int n_frames = 0, n_gpu = 0, n_redraws = 0, n_shadow_draws = 0;
+   double last_report = glfwGetTime();
+   float light_time = 0.0f;
+
+   while (!glfwWindowShouldClose(window)) {
+      float time = glfwGetTime();
+      utils::process_input(window, last_frame, delta_time, camera);
+      if (moving)
+         light_time += delta_time;
+
+      for (unsigned int i = 0; i < N_DYNAMIC; ++i) {
+         float t = time * 0.15f + (float)i / N_DYNAMIC;
+         float x = (t - floorf(t)) * 2.0f * extent - extent;
+         glm::mat4 model;
+         model = glm::translate(model, glm::vec3(x, 1.0f, (i + 0.5f) / N_DYNAMIC * 2.0f * extent - extent));
+         model = glm::scale(model, glm::vec3(2.0f));
+         dynamic_casters[i] = make_caster(model, glm::vec2(1.0f));
+         dynamic_bounds[i] = dynamic_casters[i].bounds;
+      }
+
+      for (unsigned int i = 0; i < n_lights; ++i) {
+         // lights 2 and 3 of every 4 wander around, the others stay put
+         float t = i % 4 >= 2 ? light_time : 0.0f;
+         lights[i].light.position = anchors[i] + glm::vec3(sinf(t * 0.7f + i), 0.0f, cosf(t * 0.5f + i)) * 3.0f;
+         if (!lights[i].is_point())
+            lights[i].direction = glm::normalize(glm::vec3(0.4f * sinf(t * 0.3f + i), -1.0f,
+                                                           0.4f * cosf(t * 0.3f + i)));
+      }
+      light_buffer.upload(&lights[0], n_lights);
+
+      float fov = glm::radians(camera.zoom);
+      glm::mat4 projection = glm::perspective(fov, (float)s_width / s_height, 0.1f, 200.0f);
+      glm::mat4 view = camera.get_view_matrix();
+
+      // shadow pass, only the lights that changed
+      gpu_timer.begin();
+      if (shadows) {
+         atlas.update(&lights[0], n_lights, projection * view, camera.position, fov, s_height,
+                      dynamic_bounds);
+         atlas.begin();
+         glEnable(GL_POLYGON_OFFSET_FILL);
+         glPolygonOffset(1.5f, 3.0f);
+         shader_depth.use();
+         glBindVertexArray(depth_VAO);
+         for (size_t k = 0; k < atlas.pending.size(); ++k) {
+            unsigned int i = atlas.pending[k];
+            atlas.set_light(shader_depth, i);
+            Sphere sphere = atlas.light_sphere(i);
+            n_shadow_draws += draw_casters(shader_depth, static_casters, sphere);
+            n_shadow_draws += draw_casters(shader_depth, dynamic_casters, sphere);
+         }
+         glDisable(GL_POLYGON_OFFSET_FILL);
+         atlas.end(s_width, s_height);
+         n_redraws += atlas.pending.size();
+      }
+      gpu_timer.end();
+
+      // lighting pass
+      glClearColor(0.02f, 0.02f, 0.02f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      shader.use();
+      shader.setmat4("view", view);
+      shader.setmat4("projection", projection);
+      shader.setvec3("view_pos", camera.position);
+      shader.seti("n_lights", n_lights);
+      shader.seti("shadows", shadows);
+      light_buffer.bind(2);
+      atlas.bind(shader, 3, 4);
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, diffuse_map);
+      glActiveTexture(GL_TEXTURE1);
+      glBindTexture(GL_TEXTURE_2D, specular_map);
+      glBindVertexArray(VAO);
+      Frustum camera_frustum(projection * view);
+      draw_casters(shader, static_casters, camera_frustum);
+      draw_casters(shader, dynamic_casters, camera_frustum);
+      glBindVertexArray(0);
+
+      double ms;
+      while (gpu_timer.result(ms)) {
+         gpu_ms += ms;
+         n_gpu++;
+      }
+      n_frames++;
+
+      double now = glfwGetTime();
+      if (now - last_report >= 1.0) {
+         std::cout << "lights: " << n_lights
+                   << " fps: " << n_frames / (now - last_report)
+                   << " shadow gpu: " << (n_gpu ? gpu_ms / n_gpu : 0.0) << " ms"
+                   << " lights redrawn/frame: " << (float)n_redraws / n_frames
+                   << " shadow draws/frame: " << n_shadow_draws / n_frames
+                   << " atlas used: " << 100.0f * atlas.occupancy() << "%"
+                   << std::endl;
+         gpu_ms = 0.0;
+         n_frames = n_gpu = n_redraws = n_shadow_draws = 0;
+         last_report = now;
+      }
+
+      glfwSwapBuffers(window);
+      glfwPollEvents();
+   }
+
+   glfwTerminate();
+   return 0;
+}
@@ -0,0 +1,158 @@
+#ifndef _BOUNDS_HPP_
+#define _BOUNDS_HPP_
+
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/matrix_transform.hpp>
+
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+
+/**************************** AXIS ALIGNED BOUNDING BOX ****************************/
+struct AABB {
+   glm::vec3 min;
+   glm::vec3 max;
+
+   // an empty box; expanding it by any point makes it valid
+   AABB() : min(FLT_MAX), max(-FLT_MAX) {}
+   AABB(glm::vec3 min, glm::vec3 max) : min(min), max(max) {}
+
+   bool valid() const {
+      return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+   }
+
+   void expand(const glm::vec3 &p) {
+      min = glm::min(min, p);
+      max = glm::max(max, p);
+   }
+
+   void expand(const AABB &box) {
+      min = glm::min(min, box.min);
+      max = glm::max(max, box.max);
+   }
+
+   glm::vec3 center() const { return (min + max) * 0.5f; }
+   glm::vec3 extents() const { return (max - min) * 0.5f; }
+
+   glm::vec3 corner(int i) const {
+      return glm::vec3(i & 1 ? max.x : min.x,
+                       i & 2 ? max.y : min.y,
+                       i & 4 ? max.z : min.z);
+   }
+
+   float surface_area() const {
+      glm::vec3 d = max - min;
+      return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+   }
+
+   // box enclosing this box after an affine transform (Arvo's method)
+   AABB transform(const glm::mat4 &m) const {
+      glm::vec3 c = glm::vec3(m * glm::vec4(center(), 1.0f));
+      glm::vec3 e = extents();
+      glm::vec3 r;
+      for (int i = 0; i < 3; ++i)
+         r[i] = std::fabs(m[0][i]) * e.x + std::fabs(m[1][i]) * e.y + std::fabs(m[2][i]) * e.z;
+      return AABB(c - r, c + r);
+   }
+};
+
+/**************************** BOUNDING SPHERE ****************************/
+struct Sphere {
+   glm::vec3 center;
+   float radius;
+
+   Sphere() : center(0.0f), radius(0.0f) {}
+   Sphere(glm::vec3 center, float radius) : center(center), radius(radius) {}
+   explicit Sphere(const AABB &box)
+      : center(box.center()), radius(glm::length(box.extents())) {}
+};
+
+inline bool overlaps(const Sphere &s, const AABB &box) {
+   glm::vec3 closest = glm::clamp(s.center, box.min, box.max);
+   glm::vec3 d = closest - s.center;
+   return glm::dot(d, d) <= s.radius * s.radius;
+}
+
+/**************************** RAY ****************************/
+struct Ray {
+   glm::vec3 origin;
+   glm::vec3 dir;
+   glm::vec3 inv_dir;   // 1 / dir, infinite components are fine for the slab test
+
+   Ray() {}
+   Ray(glm::vec3 origin, glm::vec3 dir)
+      : origin(origin), dir(dir), inv_dir(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z) {}
+};
+
+// slab test, `t` is the entry distance when the ray hits the box within [0, t_max]
+inline bool intersect(const Ray &ray, const AABB &box, float t_max, float &t) {
+   glm::vec3 t0 = (box.min - ray.origin) * ray.inv_dir;
+   glm::vec3 t1 = (box.max - ray.origin) * ray.inv_dir;
+   glm::vec3 t_near = glm::min(t0, t1);
+   glm::vec3 t_far = glm::max(t0, t1);
+   float t_enter = std::max(std::max(t_near.x, t_near.y), std::max(t_near.z, 0.0f));
+   float t_exit = std::min(std::min(t_far.x, t_far.y), std::min(t_far.z, t_max));
+   t = t_enter;
+   return t_enter <= t_exit;
+}
+
+/**************************** VIEW FRUSTUM ****************************/
+// planes are extracted from a (projection * view) matrix, normals point inwards
+struct Frustum {
+   glm::vec4 planes[6];
+
+   Frustum() {}
+   explicit Frustum(const glm::mat4 &vp) {
+      glm::vec4 row0(vp[0][0], vp[1][0], vp[2][0], vp[3][0]);
+      glm::vec4 row1(vp[0][1], vp[1][1], vp[2][1], vp[3][1]);
+      glm::vec4 row2(vp[0][2], vp[1][2], vp[2][2], vp[3][2]);
+      glm::vec4 row3(vp[0][3], vp[1][3], vp[2][3], vp[3][3]);
+
+      planes[0] = row3 + row0; // left
+      planes[1] = row3 - row0; // right
+      planes[2] = row3 + row1; // bottom
+      planes[3] = row3 - row1; // top
+      planes[4] = row3 + row2; // near
+      planes[5] = row3 - row2; // far
+
+      for (int i = 0; i < 6; ++i)
+         planes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+   }
+
+   bool intersects(const AABB &box) const {
+      for (int i = 0; i < 6; ++i) {
+         const glm::vec4 &p = planes[i];
+         // the corner furthest along the plane normal
+         glm::vec3 v(p.x >= 0.0f ? box.max.x : box.min.x,
+                     p.y >= 0.0f ? box.max.y : box.min.y,
+                     p.z >= 0.0f ? box.max.z : box.min.z);
+         if (glm::dot(glm::vec3(p), v) + p.w < 0.0f)
+            return false;
+      }
+      return true;
+   }
+
+   // the whole box is inside, everything in it is visible
+   bool contains(const AABB &box) const {
+      for (int i = 0; i < 6; ++i) {
+         const glm::vec4 &p = planes[i];
+         // the corner furthest against the plane normal
+         glm::vec3 v(p.x >= 0.0f ? box.min.x : box.max.x,
+                     p.y >= 0.0f ? box.min.y : box.max.y,
+                     p.z >= 0.0f ? box.min.z : box.max.z);
+         if (glm::dot(glm::vec3(p), v) + p.w < 0.0f)
+            return false;
+      }
+      return true;
+   }
+
+   bool intersects(const Sphere &s) const {
+      for (int i = 0; i < 6; ++i) {
+         if (glm::dot(glm::vec3(planes[i]), s.center) + planes[i].w < -s.radius)
+            return false;
+      }
+      return true;
+   }
+};
+
+#endif
@@ -0,0 +1,399 @@
+#ifndef _BVH_HPP_
+#define _BVH_HPP_
+
+#include <glm/glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cfloat>
+
+#include <bounds.hpp>
+
+/**************************** BVH NODE ****************************/
+/* 32 bytes, two nodes per cache line. Children of a node are allocated next to
+ * each other (right = left + 1) and always after their parent. For a leaf
+ * `count` > 0 and `left_first` indexes `BVH::indices`, otherwise `left_first`
+ * is the left child.
+ */
+struct BVHNode {
+   glm::vec3 min;
+   unsigned int left_first;
+   glm::vec3 max;
+   unsigned int count;
+
+   bool leaf() const { return count > 0; }
+   AABB bounds() const { return AABB(min, max); }
+};
+
+/**************************** BVH ****************************/
+/* Bounding volume hierarchy over object boxes (meshes, instances, ...),
+ * built top down with binned SAH on the box centroids.
+ *
+ * `refit` updates the node boxes bottom up after objects moved, keeping the
+ * topology; it is much cheaper than a rebuild but the tree degrades when
+ * objects travel far, so rebuild now and then.
+ *
+ *    BVH bvh;
+ *    bvh.build(&boxes[0], boxes.size());
+ *    bvh.query_frustum(Frustum(projection * view), &boxes[0], visible);
+ *    float t = FLT_MAX;   // nearest hit distance in and out
+ *    if (bvh.raycast(Ray(origin, dir), &boxes[0], t, object)) ...
+ */
+class BVH {
+public:
+   std::vector<BVHNode> nodes;
+   std::vector<unsigned int> indices;   // object ids, grouped by leaf
+   unsigned int max_leaf_size;          // bigger nodes are always split
+   float traversal_cost;                // of one node visit, relative to one object test
+
+   BVH(unsigned int max_leaf_size = 4, float traversal_cost = 1.0f)
+      : max_leaf_size(max_leaf_size), traversal_cost(traversal_cost) {}
+
+   void build(const AABB *boxes, size_t count) {
+      nodes.clear();
+      indices.resize(count);
+      centroids.resize(count);
+      for (size_t i = 0; i < count; ++i) {
+         indices[i] = i;
+         centroids[i] = boxes[i].center();
+      }
+      if (count == 0)
+         return;
+
+      nodes.reserve(2 * count);
+      BVHNode root;
+      root.left_first = 0;
+      root.count = count;
+      nodes.push_back(root);
+      update_bounds(0, boxes);
+      subdivide(0, boxes);
+   }
+
+   // boxes are indexed by object id, as given to `build`
+   void refit(const AABB *boxes) {
+      for (size_t n = nodes.size(); n-- > 0;) {
+         BVHNode &node = nodes[n];
+         if (node.leaf()) {
+            update_bounds(n, boxes);
+         } else {
+            const BVHNode &l = nodes[node.left_first];
+            const BVHNode &r = nodes[node.left_first + 1];
+            node.min = glm::min(l.min, r.min);
+            node.max = glm::max(l.max, r.max);
+         }
+      }
+   }
+
+   /* SAH cost of the tree relative to its root box. Refitting keeps the
+    * topology, so as objects move this grows; compare against the value right
+    * after `build` to decide when a rebuild pays off.
+    */
+   float cost() const {
+      if (nodes.empty())
+         return 0.0f;
+      float sum = 0.0f;
+      for (size_t n = 0; n < nodes.size(); ++n) {
+         const BVHNode &node = nodes[n];
+         float area = node.bounds().surface_area();
+         sum += node.leaf() ? area * node.count : area;
+      }
+      return sum / std::max(nodes[0].bounds().surface_area(), FLT_MIN);
+   }
+
+   // appends the objects whose box intersects the frustum
+   void query_frustum(const Frustum &frustum, const AABB *boxes, std::vector<unsigned int> &out) const {
+      if (nodes.empty())
+         return;
+      unsigned int stack[STACK_SIZE];
+      unsigned int top = 0;
+      stack[top++] = 0;
+      while (top) {
+         const BVHNode &node = nodes[stack[--top]];
+         AABB box = node.bounds();
+         if (!frustum.intersects(box))
+            continue;
+         // fully inside: everything below is visible, no more plane tests
+         if (frustum.contains(box)) {
+            collect(node, out);
+            continue;
+         }
+         if (node.leaf()) {
+            for (unsigned int i = 0; i < node.count; ++i) {
+               unsigned int object = indices[node.left_first + i];
+               if (frustum.intersects(boxes[object]))
+                  out.push_back(object);
+            }
+         } else {
+            stack[top++] = node.left_first;
+            stack[top++] = node.left_first + 1;
+         }
+      }
+   }
+
+   // appends the objects whose box overlaps the sphere
+   void query_sphere(const Sphere &sphere, const AABB *boxes, std::vector<unsigned int> &out) const {
+      if (nodes.empty())
+         return;
+      unsigned int stack[STACK_SIZE];
+      unsigned int top = 0;
+      stack[top++] = 0;
+      while (top) {
+         const BVHNode &node = nodes[stack[--top]];
+         if (!overlaps(sphere, node.bounds()))
+            continue;
+         if (node.leaf()) {
+            for (unsigned int i = 0; i < node.count; ++i) {
+               unsigned int object = indices[node.left_first + i];
+               if (overlaps(sphere, boxes[object]))
+                  out.push_back(object);
+            }
+         } else {
+            stack[top++] = node.left_first;
+            stack[top++] = node.left_first + 1;
+         }
+      }
+   }
+
+   /* Closest hit along the ray. `leaf(node, ray, t)` tests the objects of one
+    * leaf and, on a hit closer than `t`, lowers `t` and returns true; children
+    * are visited near first so far subtrees are mostly skipped.
+    */
+   template <typename LeafFn>
+   bool traverse(const Ray &ray, float &t, LeafFn &leaf) const {
+      if (nodes.empty())
+         return false;
+      bool found = false;
+      unsigned int stack[STACK_SIZE];
+      unsigned int top = 0;
+      stack[top++] = 0;
+      float t_root;
+      if (!intersect(ray, nodes[0].bounds(), t, t_root))
+         return false;
+      while (top) {
+         const BVHNode &node = nodes[stack[--top]];
+         if (node.leaf()) {
+            found = leaf(node, ray, t) || found;
+            continue;
+         }
+         unsigned int near_child = node.left_first, far_child = node.left_first + 1;
+         float t_near, t_far;
+         bool hit_near = intersect(ray, nodes[near_child].bounds(), t, t_near);
+         bool hit_far = intersect(ray, nodes[far_child].bounds(), t, t_far);
+         if (hit_near && hit_far) {
+            if (t_far < t_near)
+               std::swap(near_child, far_child);
+            // pushed far first so the near one is popped first
+            stack[top++] = far_child;
+            stack[top++] = near_child;
+         } else if (hit_near) {
+            stack[top++] = near_child;
+         } else if (hit_far) {
+            stack[top++] = far_child;
+         }
+      }
+      return found;
+   }
+
+   // as `traverse`, but `hit(object, ray, t)` tests a single object
+   template <typename HitFn>
+   bool raycast(const Ray &ray, float &t, unsigned int &object, HitFn hit) const {
+      ObjectLeaf<HitFn> leaf = { this, hit, &object };
+      return traverse(ray, t, leaf);
+   }
+
+   // closest object box along the ray
+   bool raycast(const Ray &ray, const AABB *boxes, float &t, unsigned int &object) const {
+      BoxHit hit = { boxes };
+      return raycast(ray, t, object, hit);
+   }
+
+   // leaves are forced below this depth, which bounds the traversal stacks
+   static const unsigned int MAX_DEPTH = 64;
+   static const unsigned int STACK_SIZE = MAX_DEPTH + 2;
+
+   /* Levels below the root of the deepest node, 0 for a single leaf. For trees
+    * that don't come from `build` (read from a file): anything deeper than
+    * MAX_DEPTH would overrun the traversal stacks. Children must come after
+    * their parent, as `build` lays them out.
+    */
+   unsigned int depth() const {
+      std::vector<unsigned int> level(nodes.size(), 0);
+      unsigned int deepest = 0;
+      for (size_t n = 0; n < nodes.size(); ++n) {
+         deepest = std::max(deepest, level[n]);
+         const BVHNode &node = nodes[n];
+         if (node.leaf())
+            continue;
+         level[node.left_first] = std::max(level[node.left_first], level[n] + 1);
+         level[node.left_first + 1] = std::max(level[node.left_first + 1], level[n] + 1);
+      }
+      return deepest;
+   }
+
+private:
+   static const unsigned int BINS = 16;
+
+   std::vector<glm::vec3> centroids;   // by object id, only used while building
+
+   struct BoxHit {
+      const AABB *boxes;
+      bool operator()(unsigned int object, const Ray &ray, float &t) const {
+         float t_box;
+         if (!intersect(ray, boxes[object], t, t_box) || t_box >= t)
+            return false;
+         t = t_box;
+         return true;
+      }
+   };
+
+   template <typename HitFn>
+   struct ObjectLeaf {
+      const BVH *bvh;
+      HitFn hit;
+      unsigned int *object;
+      bool operator()(const BVHNode &node, const Ray &ray, float &t) {
+         bool found = false;
+         for (unsigned int i = 0; i < node.count; ++i) {
+            unsigned int id = bvh->indices[node.left_first + i];
+            if (hit(id, ray, t)) {
+               *object = id;
+               found = true;
+            }
+         }
+         return found;
+      }
+   };
+
+   struct Bin {
+      AABB bounds;
+      unsigned int count;
+   };
+
+   void update_bounds(unsigned int n, const AABB *boxes) {
+      BVHNode &node = nodes[n];
+      AABB box;
+      for (unsigned int i = 0; i < node.count; ++i)
+         box.expand(boxes[indices[node.left_first + i]]);
+      node.min = box.min;
+      node.max = box.max;
+   }
+
+   void collect(const BVHNode &root, std::vector<unsigned int> &out) const {
+      unsigned int stack[STACK_SIZE];
+      unsigned int top = 0;
+      const BVHNode *node = &root;
+      for (;;) {
+         if (node->leaf()) {
+            out.insert(out.end(), indices.begin() + node->left_first,
+                       indices.begin() + node->left_first + node->count);
+         } else {
+            stack[top++] = node->left_first + 1;
+            stack[top++] = node->left_first;
+         }
+         if (!top)
+            break;
+         node = &nodes[stack[--top]];
+      }
+   }
+
+   // best binned SAH split of a node, returns its cost (FLT_MAX when there is none)
+   float find_split(const BVHNode &node, const AABB *boxes, int &axis, float &position) const {
+      AABB cbounds;
+      for (unsigned int i = 0; i < node.count; ++i)
+         cbounds.expand(centroids[indices[node.left_first + i]]);
+
+      // all three axes are binned in one pass over the objects
+      Bin bins[3][BINS];
+      glm::vec3 scale;
+      for (int a = 0; a < 3; ++a) {
+         float extent = cbounds.max[a] - cbounds.min[a];
+         scale[a] = extent > 0.0f ? BINS / extent : 0.0f;
+         for (unsigned int b = 0; b < BINS; ++b)
+            bins[a][b].count = 0;
+      }
+      for (unsigned int i = 0; i < node.count; ++i) {
+         unsigned int id = indices[node.left_first + i];
+         glm::vec3 offset = (centroids[id] - cbounds.min) * scale;
+         for (int a = 0; a < 3; ++a) {
+            Bin &bin = bins[a][std::min(BINS - 1, (unsigned int)offset[a])];
+            bin.count++;
+            bin.bounds.expand(boxes[id]);
+         }
+      }
+
+      float best = FLT_MAX;
+      for (int a = 0; a < 3; ++a) {
+         if (scale[a] == 0.0f)
+            continue;
+         // sweep from both sides, plane b sits between bins b and b + 1
+         float left_cost[BINS - 1];
+         AABB box;
+         unsigned int sum = 0;
+         for (unsigned int b = 0; b < BINS - 1; ++b) {
+            sum += bins[a][b].count;
+            box.expand(bins[a][b].bounds);
+            left_cost[b] = sum ? sum * box.surface_area() : 0.0f;
+         }
+         box = AABB();
+         sum = 0;
+         for (unsigned int b = BINS - 1; b > 0; --b) {
+            sum += bins[a][b].count;
+            box.expand(bins[a][b].bounds);
+            float cost = left_cost[b - 1] + (sum ? sum * box.surface_area() : 0.0f);
+            if (cost < best) {
+               best = cost;
+               axis = a;
+               position = cbounds.min[a] + b / scale[a];
+            }
+         }
+      }
+      return best;
+   }
+
+   void subdivide(unsigned int n, const AABB *boxes, unsigned int depth = 0) {
+      BVHNode node = nodes[n];
+      if (node.count <= 1 || depth >= MAX_DEPTH)
+         return;
+
+      int axis = 0;
+      float position = 0.0f;
+      float split_cost = find_split(node, boxes, axis, position);
+      // small nodes stay leaves unless splitting beats intersecting every
+      // object, the split pays for visiting one more node
+      float area = node.bounds().surface_area();
+      if (split_cost == FLT_MAX ||
+          (node.count <= max_leaf_size && split_cost + traversal_cost * area >= node.count * area))
+         return;
+
+      // partition the node's objects around the plane
+      unsigned int i = node.left_first;
+      unsigned int j = i + node.count;
+      while (i < j) {
+         if (centroids[indices[i]][axis] < position)
+            ++i;
+         else
+            std::swap(indices[i], indices[--j]);
+      }
+      unsigned int left_count = i - node.left_first;
+      if (left_count == 0 || left_count == node.count)
+         return;
+
+      unsigned int left = nodes.size();
+      BVHNode child;
+      child.left_first = node.left_first;
+      child.count = left_count;
+      nodes.push_back(child);
+      child.left_first = i;
+      child.count = node.count - left_count;
+      nodes.push_back(child);
+
+      nodes[n].left_first = left;
+      nodes[n].count = 0;
+      update_bounds(left, boxes);
+      update_bounds(left + 1, boxes);
+      subdivide(left, boxes, depth + 1);
+      subdivide(left + 1, boxes, depth + 1);
+   }
+};
+
+#endif
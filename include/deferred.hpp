@@ -0,0 +1,230 @@
+#ifndef _DEFERRED_HPP_
+#define _DEFERRED_HPP_
+
+#include <glad/glad.h>
+
+#include <glm/glm/glm.hpp>
+
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <math.h>
+
+#include <shader.hpp>
+#include <lights.hpp>
+
+/**************************** G-BUFFER ****************************/
+/* Targets of a deferred renderer:
+ *    albedo_spec (RGBA8)   rgb: diffuse albedo, a: specular intensity
+ *    normal      (RGB16F)  world space normal
+ *    depth       (DEPTH24_STENCIL8 texture) positions are rebuilt from it
+ *
+ * Lighting accumulates into `light_color` (RGBA16F). Its framebuffer has its
+ * own depth buffer, a copy of the G-buffer depth blitted in `begin_lighting`:
+ * the light volumes are depth tested against the scene while the lighting
+ * shaders sample the G-buffer depth, and a texture can't be both at once.
+ *
+ *    gbuffer.begin_geometry();   ... scene with the G-buffer shader ...
+ *    gbuffer.begin_lighting();   ... full screen pass, light volumes ...
+ *    gbuffer.present(0);
+ *
+ * The targets are allocated at `width` x `height`, but a frame can render
+ * into a smaller `render_width` x `render_height` corner of them
+ * (`set_render_size`) for dynamic resolution. The lighting shaders get the
+ * corner's size as `screen_size`, and `light_color` is linearly filtered for
+ * upscaling.
+ */
+class GBuffer {
+public:
+   int width, height;
+   int render_width, render_height;
+   unsigned int fbo, light_fbo;
+   unsigned int albedo_spec, normal, depth, light_color;   // textures
+   unsigned int light_depth;                               // renderbuffer
+
+   GBuffer(int width, int height)
+      : width(width), height(height), render_width(width), render_height(height) {
+      albedo_spec = make_texture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+      normal = make_texture(GL_RGB16F, GL_RGB, GL_FLOAT);
+      depth = make_texture(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8);
+      light_color = make_texture(GL_RGBA16F, GL_RGBA, GL_FLOAT);
+      glBindTexture(GL_TEXTURE_2D, light_color);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glBindTexture(GL_TEXTURE_2D, 0);
+
+      glGenFramebuffers(1, &fbo);
+      glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo_spec, 0);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal, 0);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+      GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+      glDrawBuffers(2, buffers);
+      check("G-buffer");
+
+      glGenRenderbuffers(1, &light_depth);
+      glBindRenderbuffer(GL_RENDERBUFFER, light_depth);
+      glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+      glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+      glGenFramebuffers(1, &light_fbo);
+      glBindFramebuffer(GL_FRAMEBUFFER, light_fbo);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, light_color, 0);
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, light_depth);
+      check("lighting");
+
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+   }
+
+   // clamped to the allocated size
+   void set_render_size(int w, int h) {
+      render_width = std::max(1, std::min(w, width));
+      render_height = std::max(1, std::min(h, height));
+   }
+
+   void begin_geometry() {
+      glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+      glViewport(0, 0, render_width, render_height);
+      glEnable(GL_DEPTH_TEST);
+      glDepthMask(GL_TRUE);
+      glDisable(GL_BLEND);
+      const GLfloat zero[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+      glClearBufferfv(GL_COLOR, 0, zero);
+      glClearBufferfv(GL_COLOR, 1, zero);
+      glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+   }
+
+   // copies the scene depth and binds the (uncleared) lighting target
+   void begin_lighting() {
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, light_fbo);
+      glBlitFramebuffer(0, 0, render_width, render_height, 0, 0, render_width, render_height,
+                        GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+      glBindFramebuffer(GL_FRAMEBUFFER, light_fbo);
+      glViewport(0, 0, render_width, render_height);
+   }
+
+   // G-buffer textures on `first_unit` and the two following units
+   void bind_textures(Shader &shader, int first_unit = 0) const {
+      glActiveTexture(GL_TEXTURE0 + first_unit);
+      glBindTexture(GL_TEXTURE_2D, albedo_spec);
+      glActiveTexture(GL_TEXTURE0 + first_unit + 1);
+      glBindTexture(GL_TEXTURE_2D, normal);
+      glActiveTexture(GL_TEXTURE0 + first_unit + 2);
+      glBindTexture(GL_TEXTURE_2D, depth);
+      shader.seti("g_albedo_spec", first_unit);
+      shader.seti("g_normal", first_unit + 1);
+      shader.seti("g_depth", first_unit + 2);
+      shader.setvec2("screen_size", glm::vec2(render_width, render_height));
+      glActiveTexture(GL_TEXTURE0);
+   }
+
+   // copies the lit image to `fbo` (0 for the window), stretched over `width` x `height`
+   void present(unsigned int dst) {
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, light_fbo);
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dst);
+      glBlitFramebuffer(0, 0, render_width, render_height, 0, 0, width, height,
+                        GL_COLOR_BUFFER_BIT, GL_LINEAR);
+      glBindFramebuffer(GL_FRAMEBUFFER, dst);
+   }
+
+private:
+   unsigned int make_texture(GLint internal_format, GLenum format, GLenum type) {
+      unsigned int tex;
+      glGenTextures(1, &tex);
+      glBindTexture(GL_TEXTURE_2D, tex);
+      glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, type, NULL);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glBindTexture(GL_TEXTURE_2D, 0);
+      return tex;
+   }
+
+   void check(const char *name) {
+      if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+         std::cerr << "ERROR: " << name << " framebuffer not complete." << std::endl;
+   }
+};
+
+/**************************** LIGHT VOLUMES ****************************/
+/* A low poly sphere drawn once per point light (instanced, the vertex shader
+ * fetches light gl_InstanceID from the light buffer), so lighting only runs
+ * on pixels a light can reach.
+ *
+ * Back faces are drawn with depth test GL_GEQUAL and no depth writes: a pixel
+ * is shaded when the scene surface lies in front of the volume's far side.
+ * That stays correct with the camera inside a volume, and pixels whose surface
+ * is behind the whole volume are rejected by the depth test. Additive blending
+ * sums the lights.
+ */
+class LightVolumes {
+public:
+   LightVolumes(unsigned int rings = 8, unsigned int sectors = 12) {
+      // the polygon sphere is scaled out so it encloses the true sphere
+      const float PI = 3.14159265f;
+      float scale = 1.0f / (cosf(PI / rings) * cosf(PI / sectors));
+      std::vector<glm::vec3> vertices;
+      for (unsigned int r = 0; r <= rings; ++r) {
+         float theta = PI * r / rings;
+         for (unsigned int s = 0; s <= sectors; ++s) {
+            float phi = 2.0f * PI * s / sectors;
+            vertices.push_back(scale * glm::vec3(sinf(theta) * cosf(phi), cosf(theta),
+                                                 sinf(theta) * sinf(phi)));
+         }
+      }
+      std::vector<unsigned int> indices;
+      for (unsigned int r = 0; r < rings; ++r) {
+         for (unsigned int s = 0; s < sectors; ++s) {
+            unsigned int a = r * (sectors + 1) + s, b = a + sectors + 1;
+            // counter clockwise seen from outside
+            indices.push_back(a); indices.push_back(a + 1); indices.push_back(b);
+            indices.push_back(a + 1); indices.push_back(b + 1); indices.push_back(b);
+         }
+      }
+      n_indices = indices.size();
+
+      glGenVertexArrays(1, &vao);
+      glGenBuffers(1, &vbo);
+      glGenBuffers(1, &ebo);
+      glBindVertexArray(vao);
+      glBindBuffer(GL_ARRAY_BUFFER, vbo);
+      glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
+      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+      glEnableVertexAttribArray(0);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+      glBindVertexArray(0);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+   }
+
+   // `shader` is set up by the caller, restores depth, cull and blend state
+   void draw(const LightBuffer &lights) const {
+      if (!lights.count)
+         return;
+      glEnable(GL_DEPTH_TEST);
+      glDepthFunc(GL_GEQUAL);
+      glDepthMask(GL_FALSE);
+      glEnable(GL_CULL_FACE);
+      glCullFace(GL_FRONT);
+      glEnable(GL_BLEND);
+      glBlendFunc(GL_ONE, GL_ONE);
+
+      glBindVertexArray(vao);
+      glDrawElementsInstanced(GL_TRIANGLES, n_indices, GL_UNSIGNED_INT, 0, lights.count);
+      glBindVertexArray(0);
+
+      glDisable(GL_BLEND);
+      glCullFace(GL_BACK);
+      glDisable(GL_CULL_FACE);
+      glDepthMask(GL_TRUE);
+      glDepthFunc(GL_LESS);
+   }
+
+private:
+   unsigned int vao, vbo, ebo;
+   unsigned int n_indices;
+};
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef _DRAW_LIST_HPP_
+#define _DRAW_LIST_HPP_
+
+#include <glad/glad.h>
+
+#include <glm/glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+#include <shader.hpp>
+#include <mesh.hpp>
+#include <stream_buffer.hpp>
+
+/**************************** DRAW ITEMS ****************************/
+// everything the GL thread needs to issue a draw for one mesh
+struct DrawItem {
+   unsigned int vao;
+   unsigned int index_count;
+   unsigned int diffuse;   // texture bound to unit 0, 0 for none
+};
+
+// registers every mesh of a model and returns the index of the first one
+unsigned int add_draw_items(std::vector<DrawItem> &items, std::vector<Mesh> &meshes) {
+   unsigned int first = items.size();
+   for (size_t i = 0; i < meshes.size(); ++i) {
+      DrawItem item;
+      item.vao = meshes[i].VAO;
+      item.index_count = meshes[i].indices.size();
+      item.diffuse = 0;
+      for (size_t j = 0; j < meshes[i].textures.size(); ++j) {
+         if (meshes[i].textures[j].type == "texture_diffuse") {
+            item.diffuse = meshes[i].textures[j].id;
+            break;
+         }
+      }
+      items.push_back(item);
+   }
+   return first;
+}
+
+/**************************** DRAW COMMANDS ****************************/
+/* A command draws `instance_count` instances of one item whose per-instance
+ * data starts at `base_instance` in the transform buffer. Commands are small
+ * and GL free, so worker threads can record them; only `replay` touches GL.
+ */
+struct DrawCommand {
+   unsigned int item;
+   unsigned int base_instance;
+   unsigned int instance_count;
+
+   bool operator<(const DrawCommand &o) const {
+      if (item != o.item)
+         return item < o.item;
+      return base_instance < o.base_instance;
+   }
+};
+
+struct ReplayStats {
+   unsigned int commands;
+   unsigned int draws;
+   unsigned int instances;
+   unsigned int state_changes;
+
+   ReplayStats() : commands(0), draws(0), instances(0), state_changes(0) {}
+   void reset() { commands = draws = instances = state_changes = 0; }
+};
+
+class DrawList {
+public:
+   std::vector<DrawCommand> commands;
+
+   void clear() { commands.clear(); }
+
+   // extends the previous command when it is the same item and the instances follow on
+   void add(unsigned int item, unsigned int base_instance, unsigned int instance_count = 1) {
+      if (!commands.empty()) {
+         DrawCommand &last = commands.back();
+         if (last.item == item && last.base_instance + last.instance_count == base_instance) {
+            last.instance_count += instance_count;
+            return;
+         }
+      }
+      DrawCommand cmd = { item, base_instance, instance_count };
+      commands.push_back(cmd);
+   }
+
+   void append(const DrawList &other) {
+      for (size_t i = 0; i < other.commands.size(); ++i) {
+         const DrawCommand &cmd = other.commands[i];
+         add(cmd.item, cmd.base_instance, cmd.instance_count);
+      }
+   }
+
+   // groups commands by item so state changes happen once per item
+   void sort() {
+      std::sort(commands.begin(), commands.end());
+      std::vector<DrawCommand> sorted;
+      sorted.swap(commands);
+      for (size_t i = 0; i < sorted.size(); ++i)
+         add(sorted[i].item, sorted[i].base_instance, sorted[i].instance_count);
+   }
+
+   // GL thread only: `base_location` is the location of the `base_instance` uniform,
+   // `base_offset` is added to every command's first instance
+   void replay(const std::vector<DrawItem> &items, GLint base_location,
+               unsigned int base_offset, ReplayStats &stats) const {
+      unsigned int bound_vao = 0, bound_texture = 0;
+      glActiveTexture(GL_TEXTURE0);
+      for (size_t i = 0; i < commands.size(); ++i) {
+         const DrawCommand &cmd = commands[i];
+         const DrawItem &item = items[cmd.item];
+         if (item.vao != bound_vao) {
+            glBindVertexArray(item.vao);
+            bound_vao = item.vao;
+            stats.state_changes++;
+         }
+         if (item.diffuse != bound_texture) {
+            glBindTexture(GL_TEXTURE_2D, item.diffuse);
+            bound_texture = item.diffuse;
+            stats.state_changes++;
+         }
+         glUniform1i(base_location, base_offset + cmd.base_instance);
+         glDrawElementsInstanced(GL_TRIANGLES, item.index_count, GL_UNSIGNED_INT,
+                                 0, cmd.instance_count);
+         stats.draws++;
+         stats.instances += cmd.instance_count;
+      }
+      stats.commands += commands.size();
+      glBindVertexArray(0);
+   }
+};
+
+/**************************** TRANSFORM BUFFER ****************************/
+/* Per-instance model matrices in a texture buffer, fetched in the vertex shader
+ * with `base_instance + gl_InstanceID`. Without base instance draws (GL 4.2)
+ * this is what lets every command start anywhere in the buffer. Workers write
+ * straight into the mapped storage between `map` and `unmap`.
+ *
+ * The storage is a stream buffer, so every frame writes a different region and
+ * `base` is the index of that region's first matrix.
+ */
+class TransformBuffer {
+public:
+   StreamBuffer stream;
+   unsigned int texture;
+   unsigned int capacity;   // in matrices, per frame
+   unsigned int base;
+
+   TransformBuffer(unsigned int capacity)
+      : stream(GL_TEXTURE_BUFFER, capacity * sizeof(glm::mat4)),
+        capacity(capacity), base(0) {
+      glGenTextures(1, &texture);
+      glBindTexture(GL_TEXTURE_BUFFER, texture);
+      glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, stream.buffer);
+      glBindTexture(GL_TEXTURE_BUFFER, 0);
+   }
+
+   glm::mat4 *map() {
+      stream.begin_frame();
+      size_t offset = 0;
+      glm::mat4 *mapped = (glm::mat4 *)stream.alloc(capacity * sizeof(glm::mat4), offset);
+      base = offset / sizeof(glm::mat4);
+      return mapped;
+   }
+
+   void unmap() { stream.commit(); }
+
+   // after the last draw reading this frame's matrices
+   void end_frame() { stream.end_frame(); }
+
+   void bind(Shader &shader, int unit) const {
+      glActiveTexture(GL_TEXTURE0 + unit);
+      glBindTexture(GL_TEXTURE_BUFFER, texture);
+      shader.seti("transforms", unit);
+   }
+};
+
+#endif
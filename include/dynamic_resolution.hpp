@@ -0,0 +1,129 @@
+#ifndef _DYNAMIC_RESOLUTION_HPP_
+#define _DYNAMIC_RESOLUTION_HPP_
+
+#include <glad/glad.h>
+
+#include <glm/glm/glm.hpp>
+
+#include <string>
+#include <algorithm>
+#include <math.h>
+
+#include <shader.hpp>
+
+/**************************** DYNAMIC RESOLUTION ****************************/
+/* Picks the resolution scale of the 3D pass from measured GPU frame times so
+ * the frame stays within `target_ms`. Feed it every GpuTimer result.
+ *
+ * The cost of the 3D pass is taken to grow with its pixel count, scale^2, so
+ * the scale that would just meet the target is scale * sqrt(target / average).
+ * It drops to that right away when over budget, and climbs back at most
+ * `max_step` at a time, only once there is real headroom (below `upper` times
+ * the target). Scales are multiples of `quantum`, so noise in the timings
+ * doesn't change the resolution every frame. Timer results lag a few frames
+ * behind: after a change the average is rescaled by the expected cost ratio
+ * and the next change waits `settle` results.
+ *
+ *    dynres.update(gpu_ms);
+ *    int w = dynres.width(s_width), h = dynres.height(s_height);
+ */
+class DynamicResolution {
+public:
+   float target_ms;
+   float min_scale, max_scale;
+   float scale;
+   bool enabled;
+
+   // tuning
+   double smoothing;            // weight of a new result in the average
+   float upper;
+   float max_step, quantum;
+   int settle;
+
+   DynamicResolution(float target_ms, float min_scale = 0.5f, float max_scale = 1.0f)
+      : target_ms(target_ms), min_scale(min_scale), max_scale(max_scale), scale(max_scale),
+        enabled(true), smoothing(0.1), upper(0.8f), max_step(0.05f), quantum(1.0f / 32.0f),
+        settle(8), average(0.0), n_results(0), settle_left(0) {}
+
+   void update(double gpu_ms) {
+      if (!enabled) {
+         scale = max_scale;
+         return;
+      }
+      // exponential moving average, seeded by the first result
+      average = n_results++ ? average + (gpu_ms - average) * smoothing : gpu_ms;
+      if (settle_left > 0) {
+         settle_left--;
+         return;
+      }
+
+      float wanted = scale * sqrtf((float)(target_ms / std::max(average, 1e-3)));
+      float next = scale;
+      if (average > target_ms)
+         next = wanted;
+      else if (average < upper * target_ms)
+         next = std::min(wanted, scale + max_step);
+      next = std::max(min_scale, std::min(max_scale, floorf(next / quantum) * quantum));
+      if (next != scale) {
+         // the next measurements still belong to the old resolution
+         average *= (next * next) / (scale * scale);
+         scale = next;
+         settle_left = settle;
+      }
+   }
+
+   int width(int full) const { return std::max(1, (int)(full * scale + 0.5f)); }
+   int height(int full) const { return std::max(1, (int)(full * scale + 0.5f)); }
+
+   double average_ms() const { return average; }
+
+private:
+   double average;
+   unsigned int n_results;
+   int settle_left;
+};
+
+/**************************** UPSCALER ****************************/
+/* Draws the `width` x `height` corner of a larger texture over the whole
+ * viewport with a Catmull-Rom (bicubic) filter. It keeps edges sharper than
+ * bilinear, and takes nine bilinear fetches instead of sixteen point ones
+ * (17_upscale.fs).
+ *
+ *    upscaler.draw(scene_texture, texture_width, texture_height, width, height);
+ */
+class Upscaler {
+public:
+   Upscaler(const std::string &shader_dir)
+      : shader((shader_dir + "05_post.vs").c_str(), (shader_dir + "17_upscale.fs").c_str()) {
+      shader.use();
+      shader.seti("source", 0);
+      glUseProgram(0);
+      glGenVertexArrays(1, &vao);
+   }
+
+   ~Upscaler() {
+      glDeleteVertexArrays(1, &vao);
+   }
+
+   // into the bound framebuffer and viewport, `texture` needs linear filtering
+   void draw(unsigned int texture, int texture_width, int texture_height, int width, int height) {
+      GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+      glDisable(GL_DEPTH_TEST);
+      shader.use();
+      shader.setvec2("texture_size", glm::vec2(texture_width, texture_height));
+      shader.setvec2("source_size", glm::vec2(width, height));
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, texture);
+      glBindVertexArray(vao);
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+      glBindVertexArray(0);
+      if (depth_test)
+         glEnable(GL_DEPTH_TEST);
+   }
+
+private:
+   Shader shader;
+   unsigned int vao;
+};
+
+#endif
@@ -0,0 +1,486 @@
+#ifndef _ENVIRONMENT_MAP_HPP_
+#define _ENVIRONMENT_MAP_HPP_
+
+#include <glad/glad.h>
+
+#include <glm/glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <stb_image.h>
+
+#include <shader.hpp>
+#include <job_system.hpp>
+
+/**************************** CUBE MAP TEXELS ****************************/
+/* Faces in GL order (+X -X +Y -Y +Z -Z), rows top to bottom as stbi_load
+ * returns them, which is the order glTexImage2D expects for cube map faces.
+ */
+
+// direction through the point (s, t) in [-1, 1] of `face`
+inline glm::vec3 cube_direction(int face, float s, float t) {
+   switch (face) {
+   case 0:  return glm::normalize(glm::vec3( 1.0f,   -t,   -s));
+   case 1:  return glm::normalize(glm::vec3(-1.0f,   -t,    s));
+   case 2:  return glm::normalize(glm::vec3(    s, 1.0f,    t));
+   case 3:  return glm::normalize(glm::vec3(    s,-1.0f,   -t));
+   case 4:  return glm::normalize(glm::vec3(    s,   -t, 1.0f));
+   default: return glm::normalize(glm::vec3(   -s,   -t,-1.0f));
+   }
+}
+
+// face hit by `d` and where, with s and t in [0, 1]
+inline void cube_coords(const glm::vec3 &d, int &face, float &s, float &t) {
+   glm::vec3 a = glm::abs(d);
+   float sc, tc, ma;
+   if (a.x >= a.y && a.x >= a.z) {
+      face = d.x > 0.0f ? 0 : 1;
+      sc = d.x > 0.0f ? -d.z : d.z;
+      tc = -d.y;
+      ma = a.x;
+   } else if (a.y >= a.z) {
+      face = d.y > 0.0f ? 2 : 3;
+      sc = d.x;
+      tc = d.y > 0.0f ? d.z : -d.z;
+      ma = a.y;
+   } else {
+      face = d.z > 0.0f ? 4 : 5;
+      sc = d.z > 0.0f ? d.x : -d.x;
+      tc = -d.y;
+      ma = a.z;
+   }
+   s = 0.5f * (sc / ma + 1.0f);
+   t = 0.5f * (tc / ma + 1.0f);
+}
+
+// exact solid angle of texel (x, y) on a face of `size` texels, they add up to 4 pi
+inline float cube_texel_solid_angle(int x, int y, int size) {
+   float x0 = 2.0f * x / size - 1.0f, x1 = 2.0f * (x + 1) / size - 1.0f;
+   float y0 = 2.0f * y / size - 1.0f, y1 = 2.0f * (y + 1) / size - 1.0f;
+   // integral of the solid angle from the face center to the corner (a, b)
+   auto area = [](float a, float b) { return atan2f(a * b, sqrtf(a * a + b * b + 1.0f)); };
+   return area(x0, y0) - area(x0, y1) - area(x1, y0) + area(x1, y1);
+}
+
+// one level of a cube map, linear RGB floats, face after face
+struct CubeLevel {
+   int size;
+   std::vector<float> texels;
+
+   CubeLevel(int size = 0) : size(size), texels((size_t)6 * size * size * 3, 0.0f) {}
+
+   float *at(int face, int x, int y) { return &texels[(((size_t)face * size + y) * size + x) * 3]; }
+   const float *at(int face, int x, int y) const {
+      return &texels[(((size_t)face * size + y) * size + x) * 3];
+   }
+   const float *face(int f) const { return &texels[(size_t)f * size * size * 3]; }
+
+   glm::vec3 texel(int face, int x, int y) const {
+      const float *p = at(face, x, y);
+      return glm::vec3(p[0], p[1], p[2]);
+   }
+
+   glm::vec3 bilinear(int face, float s, float t) const {
+      float fx = std::max(0.0f, std::min(s * size - 0.5f, size - 1.0f));
+      float fy = std::max(0.0f, std::min(t * size - 0.5f, size - 1.0f));
+      int x0 = (int)fx, y0 = (int)fy;
+      int x1 = std::min(x0 + 1, size - 1), y1 = std::min(y0 + 1, size - 1);
+      float tx = fx - x0, ty = fy - y0;
+      glm::vec3 top = glm::mix(texel(face, x0, y0), texel(face, x1, y0), tx);
+      glm::vec3 bottom = glm::mix(texel(face, x0, y1), texel(face, x1, y1), tx);
+      return glm::mix(top, bottom, ty);
+   }
+};
+
+/**************************** ENVIRONMENT MAP ****************************/
+/* Image based lighting from a skybox, computed once on the CPU instead of
+ * convolving the cube map every frame:
+ *
+ *  - `specular`: a cube map whose mip levels are the environment prefiltered
+ *    with a GGX lobe of growing roughness, level i for roughness
+ *    i / (N_LEVELS - 1). A glossy reflection is one textureLod.
+ *  - `sh`: the diffuse irradiance as 9 spherical harmonics coefficients
+ *    (bands 0-2), already convolved with the cosine lobe, divided by pi and
+ *    multiplied by the basis constants, so the ambient of a normal n is
+ *       sh[0] + sh[1] n.y + sh[2] n.z + sh[3] n.x + sh[4] n.x n.y + sh[5] n.y n.z
+ *             + sh[6] (3 n.z^2 - 1) + sh[7] n.x n.z + sh[8] (n.x^2 - n.y^2)
+ *
+ * The six faces are decoded in parallel on a ThreadPool and so is the
+ * filtering. The faces are taken as sRGB and everything is computed and
+ * stored in linear space. The results go to `cache_path` keyed by the size
+ * and modification time of the faces, a later run with the same images reads
+ * them back instead of filtering again.
+ *
+ * `load` enables GL_TEXTURE_CUBE_MAP_SEAMLESS so the blurry levels filter
+ * across face edges.
+ *
+ *    EnvironmentMap env;
+ *    env.load(faces, "skybox_nature.env", pool);
+ *    env.set_uniforms(shader);     // sh[9], max_lod
+ *    ... bind env.specular to the `environment` sampler, env.skybox for the background ...
+ *    env.release();
+ */
+class EnvironmentMap {
+public:
+   static const int BASE_SIZE = 128;      // face size of the sharpest prefiltered level
+   static const int N_LEVELS = 6;         // 128 down to 4 texels, rougher than that looks the same
+   static const int N_SAMPLES = 128;      // GGX samples per texel
+   static const int SOURCE_SIZE = 256;    // faces are averaged down to this before filtering
+
+   unsigned int skybox;       // the faces as loaded, for the background
+   unsigned int specular;     // prefiltered levels
+   glm::vec3 sh[9];
+
+   // how the last `load` went
+   bool from_cache;
+   double decode_ms, filter_ms;
+
+   EnvironmentMap() : skybox(0), specular(0), from_cache(false), decode_ms(0.0), filter_ms(0.0) {}
+
+   ~EnvironmentMap() {
+      release();
+   }
+
+   bool load(const std::vector<std::string> &faces, const std::string &cache_path, ThreadPool &pool) {
+      if (faces.size() != 6) {
+         std::cerr << "ERROR: a cube map needs 6 faces." << std::endl;
+         return false;
+      }
+      release();
+      typedef std::chrono::steady_clock clock;
+      clock::time_point start = clock::now();
+
+      // decode the faces in parallel, always as RGB
+      unsigned char *data[6];
+      int width[6], height[6];
+      pool.parallel_for(6, 1, [&](size_t begin, size_t end, unsigned int) {
+         for (size_t i = begin; i < end; ++i) {
+            int n_channels;
+            data[i] = stbi_load(faces[i].c_str(), &width[i], &height[i], &n_channels, 3);
+         }
+      });
+      bool ok = true;
+      for (int i = 0; i < 6; ++i) {
+         if (!data[i] || width[i] != height[i] || width[i] != width[0]) {
+            std::cout << "Couldn't load the texture cube map path: " << faces[i] << std::endl;
+            ok = false;
+         }
+      }
+      if (ok)
+         skybox = upload_skybox(data, width[0]);
+      clock::time_point decoded = clock::now();
+      decode_ms = std::chrono::duration<double, std::milli>(decoded - start).count();
+
+      if (ok) {
+         std::vector<int64_t> key = cache_key(faces, width[0]);
+         std::vector<CubeLevel> levels;
+         from_cache = read_cache(cache_path, key, levels);
+         if (!from_cache) {
+            prefilter(data, width[0], pool, levels);
+            write_cache(cache_path, key, levels);
+         }
+         specular = upload_levels(levels);
+      }
+      for (int i = 0; i < 6; ++i)
+         stbi_image_free(data[i]);
+      filter_ms = std::chrono::duration<double, std::milli>(clock::now() - decoded).count();
+      return ok;
+   }
+
+   // `sh` and `max_lod` (the level for roughness 1) of the bound shader
+   void set_uniforms(Shader &shader) const {
+      shader.use();
+      glUniform3fv(glGetUniformLocation(shader.id(), "sh"), 9, &sh[0].x);
+      shader.setf("max_lod", (float)(N_LEVELS - 1));
+   }
+
+   // deletes the textures (call before the context goes away)
+   void release() {
+      if (skybox)
+         glDeleteTextures(1, &skybox);
+      if (specular)
+         glDeleteTextures(1, &specular);
+      skybox = specular = 0;
+   }
+
+private:
+   static const uint32_t CACHE_MAGIC = 0x4d564e45;    // "ENVM"
+   static const uint32_t CACHE_VERSION = 1;
+
+   static unsigned int upload_skybox(unsigned char *data[6], int size) {
+      unsigned int id;
+      glGenTextures(1, &id);
+      glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      for (int i = 0; i < 6; ++i)
+         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, size, size, 0,
+                      GL_RGB, GL_UNSIGNED_BYTE, data[i]);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+      glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+      return id;
+   }
+
+   static unsigned int upload_levels(const std::vector<CubeLevel> &levels) {
+      unsigned int id;
+      glGenTextures(1, &id);
+      glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels.size() - 1);
+      for (size_t l = 0; l < levels.size(); ++l)
+         for (int i = 0; i < 6; ++i)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, l, GL_RGB16F, levels[l].size, levels[l].size,
+                         0, GL_RGB, GL_FLOAT, levels[l].face(i));
+      glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+      glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+      return id;
+   }
+
+   /**************************** FILTERING ****************************/
+   // trilinear lookup in a chain of levels, each half the size of the previous
+   static glm::vec3 sample(const std::vector<CubeLevel> &chain, const glm::vec3 &d, float lod) {
+      int face;
+      float s, t;
+      cube_coords(d, face, s, t);
+      lod = std::max(0.0f, std::min(lod, (float)(chain.size() - 1)));
+      int l0 = (int)lod;
+      int l1 = std::min(l0 + 1, (int)chain.size() - 1);
+      return glm::mix(chain[l0].bilinear(face, s, t), chain[l1].bilinear(face, s, t), lod - l0);
+   }
+
+   static float radical_inverse(unsigned int bits) {
+      bits = (bits << 16u) | (bits >> 16u);
+      bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+      bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+      bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+      bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+      return bits * 2.3283064365386963e-10f;
+   }
+
+   /* Light directions around the z axis for a GGX lobe of `roughness`, with
+    * the view along the normal (the usual split sum assumption). xyz is the
+    * direction, w the level of the source chain to read it from: each sample
+    * covers about 1 / (N_SAMPLES * pdf) steradians, reading the level whose
+    * texels are that big keeps the few samples from aliasing into speckles.
+    */
+   static std::vector<glm::vec4> ggx_samples(float roughness, int source_size) {
+      const float PI = 3.14159265f;
+      std::vector<glm::vec4> samples;
+      float a = roughness * roughness;
+      float texel_solid_angle = 4.0f * PI / (6.0f * source_size * source_size);
+      for (int i = 0; i < N_SAMPLES; ++i) {
+         float phi = 2.0f * PI * i / N_SAMPLES;
+         float u = radical_inverse(i);
+         float cos_h = sqrtf((1.0f - u) / (1.0f + (a * a - 1.0f) * u));
+         float sin_h = sqrtf(1.0f - cos_h * cos_h);
+         glm::vec3 h(sin_h * cosf(phi), sin_h * sinf(phi), cos_h);
+         glm::vec3 l = 2.0f * cos_h * h - glm::vec3(0.0f, 0.0f, 1.0f);
+         if (l.z <= 0.0f)
+            continue;
+         float k = cos_h * cos_h * (a * a - 1.0f) + 1.0f;
+         float pdf = a * a / (PI * k * k) / 4.0f;
+         float sample_solid_angle = 1.0f / (N_SAMPLES * pdf + 1e-4f);
+         float lod = 0.5f * log2f(sample_solid_angle / texel_solid_angle) + 1.0f;
+         samples.push_back(glm::vec4(l, lod));
+      }
+      return samples;
+   }
+
+   void prefilter(unsigned char *data[6], int face_size, ThreadPool &pool, std::vector<CubeLevel> &levels) {
+      // sRGB faces averaged down into linear floats, then halved down to 1x1
+      int size = std::min(face_size, (int)SOURCE_SIZE);
+      std::vector<CubeLevel> chain(1, CubeLevel(size));
+      float to_linear[256];
+      for (int i = 0; i < 256; ++i)
+         to_linear[i] = powf(i / 255.0f, 2.2f);
+      pool.parallel_for(6 * size, 8, [&](size_t begin, size_t end, unsigned int) {
+         for (size_t row = begin; row < end; ++row) {
+            int f = row / size, y = row % size;
+            int y0 = y * face_size / size, y1 = (y + 1) * face_size / size;
+            for (int x = 0; x < size; ++x) {
+               int x0 = x * face_size / size, x1 = (x + 1) * face_size / size;
+               float *out = chain[0].at(f, x, y);
+               for (int sy = y0; sy < y1; ++sy)
+                  for (int sx = x0; sx < x1; ++sx)
+                     for (int c = 0; c < 3; ++c)
+                        out[c] += to_linear[data[f][((size_t)sy * face_size + sx) * 3 + c]];
+               for (int c = 0; c < 3; ++c)
+                  out[c] /= (y1 - y0) * (x1 - x0);
+            }
+         }
+      });
+      while (chain.back().size > 1) {
+         const CubeLevel &src = chain.back();
+         CubeLevel dst(src.size / 2);
+         for (int f = 0; f < 6; ++f)
+            for (int y = 0; y < dst.size; ++y)
+               for (int x = 0; x < dst.size; ++x)
+                  for (int c = 0; c < 3; ++c)
+                     dst.at(f, x, y)[c] = 0.25f * (src.at(f, 2 * x, 2 * y)[c] + src.at(f, 2 * x + 1, 2 * y)[c] +
+                                                   src.at(f, 2 * x, 2 * y + 1)[c] + src.at(f, 2 * x + 1, 2 * y + 1)[c]);
+         chain.push_back(dst);
+      }
+
+      levels.clear();
+      for (int l = 0; l < N_LEVELS; ++l) {
+         CubeLevel level(std::max(1, BASE_SIZE >> l));
+         float roughness = (float)l / (N_LEVELS - 1);
+         std::vector<glm::vec4> samples = ggx_samples(roughness, size);
+         // a mirror reads the chain at the level's own resolution
+         float mirror_lod = log2f((float)size / level.size);
+         pool.parallel_for(6 * level.size, 4, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t row = begin; row < end; ++row) {
+               int f = row / level.size, y = row % level.size;
+               for (int x = 0; x < level.size; ++x) {
+                  glm::vec3 n = cube_direction(f, 2.0f * (x + 0.5f) / level.size - 1.0f,
+                                               2.0f * (y + 0.5f) / level.size - 1.0f);
+                  glm::vec3 color(0.0f);
+                  if (l == 0) {
+                     color = sample(chain, n, mirror_lod);
+                  } else {
+                     glm::vec3 up = fabsf(n.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+                     glm::vec3 tx = glm::normalize(glm::cross(up, n));
+                     glm::vec3 ty = glm::cross(n, tx);
+                     float weight = 0.0f;
+                     for (size_t i = 0; i < samples.size(); ++i) {
+                        const glm::vec4 &s = samples[i];
+                        glm::vec3 d = tx * s.x + ty * s.y + n * s.z;
+                        color += sample(chain, d, std::max(s.w, mirror_lod)) * s.z;
+                        weight += s.z;
+                     }
+                     color /= weight;
+                  }
+                  float *out = level.at(f, x, y);
+                  out[0] = color.x;
+                  out[1] = color.y;
+                  out[2] = color.z;
+               }
+            }
+         });
+         levels.push_back(level);
+      }
+
+      // irradiance from the 32x32 level, plenty for three bands
+      const CubeLevel &src = chain[std::min((int)chain.size() - 1, std::max(0, (int)log2f(size / 32.0f)))];
+      project_sh(src, pool);
+   }
+
+   /* Projects the radiance onto the 9 basis functions (texels weighted by
+    * their solid angle), then folds in the cosine convolution (pi, 2pi/3,
+    * pi/4 per band), 1/pi and the basis constants, see the class comment.
+    */
+   void project_sh(const CubeLevel &src, ThreadPool &pool) {
+      // one partial sum per face, added up in order so the result doesn't depend on the threads
+      std::vector<glm::vec3> partial(6 * 9, glm::vec3(0.0f));
+      pool.parallel_for(6, 1, [&](size_t begin, size_t end, unsigned int) {
+         for (size_t f = begin; f < end; ++f) {
+            glm::vec3 *c = &partial[f * 9];
+            for (int y = 0; y < src.size; ++y) {
+               for (int x = 0; x < src.size; ++x) {
+                  glm::vec3 d = cube_direction(f, 2.0f * (x + 0.5f) / src.size - 1.0f,
+                                               2.0f * (y + 0.5f) / src.size - 1.0f);
+                  glm::vec3 l = src.texel(f, x, y) * cube_texel_solid_angle(x, y, src.size);
+                  c[0] += l * 0.282095f;
+                  c[1] += l * (0.488603f * d.y);
+                  c[2] += l * (0.488603f * d.z);
+                  c[3] += l * (0.488603f * d.x);
+                  c[4] += l * (1.092548f * d.x * d.y);
+                  c[5] += l * (1.092548f * d.y * d.z);
+                  c[6] += l * (0.315392f * (3.0f * d.z * d.z - 1.0f));
+                  c[7] += l * (1.092548f * d.x * d.z);
+                  c[8] += l * (0.546274f * (d.x * d.x - d.y * d.y));
+               }
+            }
+         }
+      });
+      const float band[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+      const float basis[9] = { 0.282095f, 0.488603f, 0.488603f, 0.488603f,
+                               1.092548f, 1.092548f, 0.315392f, 1.092548f, 0.546274f };
+      for (int i = 0; i < 9; ++i) {
+         sh[i] = glm::vec3(0.0f);
+         for (int f = 0; f < 6; ++f)
+            sh[i] += partial[f * 9 + i];
+         sh[i] *= band[i] * basis[i];
+      }
+   }
+
+   /**************************** CACHE ****************************/
+   // what the cached results depend on: the faces on disk and the filter settings
+   static std::vector<int64_t> cache_key(const std::vector<std::string> &faces, int face_size) {
+      std::vector<int64_t> key;
+      key.push_back(face_size);
+      key.push_back(BASE_SIZE);
+      key.push_back(N_LEVELS);
+      key.push_back(N_SAMPLES);
+      key.push_back(SOURCE_SIZE);
+      for (size_t i = 0; i < faces.size(); ++i) {
+         struct stat st;
+         bool found = stat(faces[i].c_str(), &st) == 0;
+         key.push_back(found ? (int64_t)st.st_size : -1);
+         key.push_back(found ? (int64_t)st.st_mtime : -1);
+      }
+      return key;
+   }
+
+   bool read_cache(const std::string &path, const std::vector<int64_t> &key, std::vector<CubeLevel> &levels) {
+      std::ifstream in(path.c_str(), std::ios::binary);
+      if (!in)
+         return false;
+      uint32_t magic = 0, version = 0, n_key = 0;
+      in.read((char *)&magic, sizeof(magic));
+      in.read((char *)&version, sizeof(version));
+      in.read((char *)&n_key, sizeof(n_key));
+      if (!in || magic != CACHE_MAGIC || version != CACHE_VERSION || n_key != key.size())
+         return false;
+      std::vector<int64_t> cached(n_key);
+      in.read((char *)&cached[0], n_key * sizeof(int64_t));
+      if (!in || cached != key)
+         return false;
+
+      glm::vec3 coefficients[9];
+      in.read((char *)coefficients, sizeof(coefficients));
+      levels.clear();
+      for (int l = 0; l < N_LEVELS; ++l) {
+         levels.push_back(CubeLevel(std::max(1, BASE_SIZE >> l)));
+         in.read((char *)&levels[l].texels[0], levels[l].texels.size() * sizeof(float));
+      }
+      if (!in) {
+         std::cerr << "ERROR: environment cache " << path << " is truncated, filtering again." << std::endl;
+         return false;
+      }
+      std::copy(coefficients, coefficients + 9, sh);
+      return true;
+   }
+
+   void write_cache(const std::string &path, const std::vector<int64_t> &key,
+                    const std::vector<CubeLevel> &levels) const {
+      std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+      uint32_t header[3] = { CACHE_MAGIC, CACHE_VERSION, (uint32_t)key.size() };
+      out.write((const char *)header, sizeof(header));
+      out.write((const char *)&key[0], key.size() * sizeof(int64_t));
+      out.write((const char *)sh, sizeof(sh));
+      for (size_t l = 0; l < levels.size(); ++l)
+         out.write((const char *)&levels[l].texels[0], levels[l].texels.size() * sizeof(float));
+      if (!out)
+         std::cerr << "ERROR: couldn't write the environment cache " << path << "." << std::endl;
+   }
+};
+
+#endif
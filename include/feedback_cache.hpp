@@ -0,0 +1,177 @@
+#ifndef _FEEDBACK_CACHE_HPP_
+#define _FEEDBACK_CACHE_HPP_
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <iostream>
+
+/**************************** FEEDBACK CACHE ****************************/
+/* Keeps the output of a vertex (and geometry) shader in a buffer with
+ * transform feedback, so passes and views that need the same processed
+ * geometry replay it with a plain draw instead of running those stages again.
+ *
+ * Captured varyings are interleaved floats, `components` of them per varying,
+ * and come back as attributes 0, 1, ... of the replay VAO. Capture in a space
+ * that doesn't depend on the view (world space) and one capture serves every
+ * view. Several draws can go into one capture, each marked as a range that is
+ * replayed on its own (one per mesh, to bind its textures).
+ *
+ * `stale` compares the inputs of the capture (time, matrices, ...) with those
+ * of the last one: when nothing changed the capture is skipped altogether.
+ * The inputs handed to `begin` only count once `end` has run, a capture that
+ * never finishes leaves the cache stale.
+ *
+ *    if (cache.stale(inputs)) {
+ *       capture_shader.use();
+ *       cache.begin(GL_TRIANGLES, inputs);
+ *       ... draw mesh 0 (VAO + glDrawElements, no glUseProgram in between) ...
+ *       cache.mark(3 * n_triangles_0);
+ *       cache.end();
+ *    }
+ *    replay_shader.use();
+ *    cache.draw(GL_TRIANGLES, 0);
+ *
+ * The loader targets GL 3.3: there is no glDrawTransformFeedback or pausing,
+ * so ranges are sized from what the caller expects the shaders to emit. The
+ * number actually written is checked through a query once it is available,
+ * without waiting for it.
+ */
+class FeedbackCache {
+public:
+   // stats
+   unsigned int n_captures;     // captures done
+   unsigned int n_skipped;      // captures skipped because the inputs didn't change
+
+   FeedbackCache(size_t capacity, const std::vector<int> &components)
+      : n_captures(0), n_skipped(0), capacity(capacity), stride(0), total(0), written(0),
+        query_pending(false), valid(false) {
+      for (size_t i = 0; i < components.size(); ++i)
+         stride += components[i];
+
+      glGenBuffers(1, &buffer);
+      glBindBuffer(GL_ARRAY_BUFFER, buffer);
+      glBufferData(GL_ARRAY_BUFFER, capacity * stride * sizeof(float), NULL, GL_DYNAMIC_COPY);
+
+      glGenVertexArrays(1, &vao);
+      glBindVertexArray(vao);
+      size_t offset = 0;
+      for (size_t i = 0; i < components.size(); ++i) {
+         glVertexAttribPointer(i, components[i], GL_FLOAT, GL_FALSE, stride * sizeof(float),
+                               (void *)(offset * sizeof(float)));
+         glEnableVertexAttribArray(i);
+         offset += components[i];
+      }
+      glBindVertexArray(0);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+      glGenQueries(1, &query);
+   }
+
+   ~FeedbackCache() {
+      glDeleteQueries(1, &query);
+      glDeleteVertexArrays(1, &vao);
+      glDeleteBuffers(1, &buffer);
+   }
+
+   // true when `inputs` differ from those of the last finished capture
+   bool stale(const std::vector<float> &inputs) {
+      check_query();
+      if (valid && inputs == last_inputs) {
+         n_skipped++;
+         return false;
+      }
+      return true;
+   }
+
+   /* Starts a capture of `inputs` with the program already in use, `primitive`
+    * is GL_POINTS, GL_LINES or GL_TRIANGLES.
+    */
+   void begin(GLenum primitive, const std::vector<float> &inputs) {
+      check_query();
+      ranges.clear();
+      total = 0;
+      valid = false;
+      capture_inputs = inputs;
+      glEnable(GL_RASTERIZER_DISCARD);
+      glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffer);
+      glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, query);
+      glBeginTransformFeedback(primitive);
+      this->primitive = primitive;
+   }
+
+   // the draws since the last mark emitted `n_vertices`, they become the next range
+   void mark(unsigned int n_vertices) {
+      Range r = { total, n_vertices };
+      if (total + n_vertices > capacity) {
+         std::cerr << "ERROR: feedback cache is too small, range " << ranges.size()
+                   << " truncated." << std::endl;
+         r.count = total < capacity ? capacity - total : 0;
+      }
+      ranges.push_back(r);
+      total += r.count;
+   }
+
+   void end() {
+      glEndTransformFeedback();
+      glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+      glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+      glDisable(GL_RASTERIZER_DISCARD);
+      query_pending = true;
+      last_inputs.swap(capture_inputs);
+      valid = true;
+      n_captures++;
+   }
+
+   // replays range `range` of the last capture with the program in use
+   void draw(GLenum mode, size_t range) const {
+      if (range >= ranges.size())
+         return;
+      glBindVertexArray(vao);
+      glDrawArrays(mode, ranges[range].first, ranges[range].count);
+      glBindVertexArray(0);
+   }
+
+   size_t n_ranges() const { return ranges.size(); }
+
+   // vertices the GPU reported for the last capture whose query came back
+   unsigned int vertices_written() const { return written; }
+
+private:
+   struct Range {
+      unsigned int first, count;
+   };
+
+   unsigned int buffer, vao, query;
+   size_t capacity;                     // in vertices
+   int stride;                          // floats per vertex
+   std::vector<Range> ranges;
+   unsigned int total, written;
+   GLenum primitive;
+   bool query_pending, valid;
+   std::vector<float> last_inputs;      // of the last finished capture
+   std::vector<float> capture_inputs;   // of the one between begin and end
+
+   FeedbackCache(const FeedbackCache &);
+   FeedbackCache &operator=(const FeedbackCache &);
+
+   // the shaders emitting fewer vertices than marked leaves garbage in the ranges, say so
+   void check_query() {
+      if (!query_pending)
+         return;
+      GLuint available = 0;
+      glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available)
+         return;
+      GLuint primitives = 0;
+      glGetQueryObjectuiv(query, GL_QUERY_RESULT, &primitives);
+      query_pending = false;
+      int per_primitive = primitive == GL_TRIANGLES ? 3 : primitive == GL_LINES ? 2 : 1;
+      written = primitives * per_primitive;
+      if (written != total)
+         std::cerr << "ERROR: feedback capture wrote " << written << " vertices, "
+                   << total << " expected." << std::endl;
+   }
+};
+
+#endif
@@ -0,0 +1,302 @@
+#ifndef _FRAME_GRAPH_HPP_
+#define _FRAME_GRAPH_HPP_
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <iostream>
+#include <algorithm>
+
+#include <render_target_pool.hpp>
+
+/**************************** FRAME GRAPH ****************************/
+/* The frame described as passes and the render targets they read and write,
+ * rebuilt every frame. `compile` works out what to run and in which order,
+ * `execute` runs it:
+ *
+ *  - culling: only passes that (through any chain of reads) feed an output
+ *    run, a pass nobody reads from costs nothing and needs no `if` around it
+ *  - ordering: a pass runs after every writer of what it reads, and passes
+ *    writing the same target run in the order they were added. Among the
+ *    passes that are ready, one writing the target already bound goes first,
+ *    so the graph switches framebuffers as little as it can
+ *  - aliasing: transient targets come from a RenderTargetPool right before
+ *    their first use and go back right after their last, so targets whose
+ *    lifetimes don't overlap share the same texture
+ *
+ * A pass gets its target bound (with the viewport) before it runs and must
+ * leave it bound. It sees the textures it reads through `texture()`.
+ *
+ *    graph.reset();
+ *    FgResource back = graph.import_target("backbuffer", 0, 0, width, height);
+ *    FgResource scene = graph.create("scene", width, height, GL_RGBA8, true);
+ *    graph.add_pass("scene", FgReads(), scene, [&]() { ... });
+ *    graph.add_pass("present", FgReads(1, scene), back, [&]() { ... graph.texture(scene) ... });
+ *    graph.output(back);
+ *    graph.compile();
+ *    graph.execute();
+ */
+typedef int FgResource;
+typedef std::vector<FgResource> FgReads;
+
+class FrameGraph {
+public:
+   // per frame stats, valid after `execute`
+   unsigned int n_passes, n_culled, n_fbo_binds;
+   size_t transient_bytes;       // memory of all transient targets without aliasing
+   size_t peak_bytes;            // at most this much was acquired at once
+
+   FrameGraph(RenderTargetPool &pool) : pool(pool) {
+      reset();
+   }
+
+   // drops last frame's passes and resources
+   void reset() {
+      resources.clear();
+      passes.clear();
+      order.clear();
+      n_passes = n_culled = n_fbo_binds = 0;
+      transient_bytes = peak_bytes = 0;
+   }
+
+   // a target the graph allocates for this frame only
+   FgResource create(const char *name, int width, int height, GLenum format, bool depth = false,
+                     int samples = 0) {
+      Resource r;
+      r.name = name;
+      r.width = width;
+      r.height = height;
+      r.format = format;
+      r.depth = depth;
+      r.samples = samples;
+      r.imported = false;
+      r.fbo = r.texture = 0;
+      resources.push_back(r);
+      return resources.size() - 1;
+   }
+
+   // a framebuffer owned elsewhere, e.g. the window (fbo 0, no texture)
+   FgResource import_target(const char *name, unsigned int fbo, unsigned int texture,
+                            int width, int height) {
+      FgResource id = create(name, width, height, GL_NONE);
+      resources[id].imported = true;
+      resources[id].fbo = fbo;
+      resources[id].texture = texture;
+      return id;
+   }
+
+   void add_pass(const char *name, const FgReads &reads, FgResource write, std::function<void()> execute) {
+      Pass p;
+      p.name = name;
+      p.reads = reads;
+      p.write = write;
+      p.execute = execute;
+      passes.push_back(p);
+   }
+
+   // the frame exists to produce `r`, passes leading to it are kept
+   void output(FgResource r) {
+      resources[r].output = true;
+   }
+
+   void compile() {
+      size_t n = passes.size();
+      cull();
+
+      // edges: writers of a target in declaration order, every reader after every writer
+      std::vector<std::vector<size_t> > next(n);
+      std::vector<unsigned int> n_deps(n, 0);
+      for (size_t r = 0; r < resources.size(); ++r) {
+         int prev = -1;
+         for (size_t p = 0; p < n; ++p) {
+            if (!passes[p].live || passes[p].write != (int)r)
+               continue;
+            if (prev >= 0)
+               link(next, n_deps, prev, p);
+            prev = p;
+            for (size_t q = 0; q < n; ++q)
+               if (q != p && passes[q].live && reads(passes[q], r))
+                  link(next, n_deps, p, q);
+         }
+      }
+
+      // topological order, preferring the pass that keeps the bound target
+      order.clear();
+      std::vector<bool> done(n, false);
+      int bound = -1;
+      for (;;) {
+         int pick = -1;
+         for (size_t p = 0; p < n; ++p) {
+            if (!passes[p].live || done[p] || n_deps[p])
+               continue;
+            if (pick < 0)
+               pick = p;
+            if (passes[p].write == bound) {
+               pick = p;
+               break;
+            }
+         }
+         if (pick < 0)
+            break;
+         done[pick] = true;
+         order.push_back(pick);
+         bound = passes[pick].write;
+         for (size_t i = 0; i < next[pick].size(); ++i)
+            n_deps[next[pick][i]]--;
+      }
+      n_passes = order.size();
+      n_culled = 0;
+      for (size_t p = 0; p < n; ++p)
+         n_culled += !passes[p].live;
+      if (order.size() + n_culled != n)
+         std::cerr << "ERROR: frame graph has a cycle, some passes won't run." << std::endl;
+
+      // lifetimes in execution order
+      for (size_t r = 0; r < resources.size(); ++r)
+         resources[r].first = resources[r].last = -1;
+      for (size_t i = 0; i < order.size(); ++i) {
+         const Pass &p = passes[order[i]];
+         touch(p.write, i);
+         for (size_t k = 0; k < p.reads.size(); ++k)
+            touch(p.reads[k], i);
+      }
+   }
+
+   void execute() {
+      size_t in_use = 0;
+      transient_bytes = peak_bytes = 0;
+      for (size_t r = 0; r < resources.size(); ++r)
+         if (!resources[r].imported && resources[r].first >= 0)
+            transient_bytes += bytes(resources[r]);
+
+      int bound = -1;
+      n_fbo_binds = 0;
+      for (size_t i = 0; i < order.size(); ++i) {
+         Pass &p = passes[order[i]];
+         for (size_t r = 0; r < resources.size(); ++r) {
+            Resource &res = resources[r];
+            if (!res.imported && res.first == (int)i) {
+               res.target = pool.acquire(res.width, res.height, res.format, res.depth, res.samples);
+               res.fbo = res.target->fbo;
+               res.texture = res.target->texture;
+               in_use += bytes(res);
+            }
+         }
+         peak_bytes = std::max(peak_bytes, in_use);
+         Resource &w = resources[p.write];
+         if (p.write != bound) {
+            glBindFramebuffer(GL_FRAMEBUFFER, w.fbo);
+            glViewport(0, 0, w.width, w.height);
+            bound = p.write;
+            n_fbo_binds++;
+         }
+
+         p.execute();
+
+         // targets nobody reads after this pass go back to the pool for the next ones
+         for (size_t r = 0; r < resources.size(); ++r) {
+            Resource &res = resources[r];
+            if (!res.imported && res.last == (int)i) {
+               pool.release(res.target);
+               in_use -= bytes(res);
+            }
+         }
+      }
+   }
+
+   // texture of a resource, only valid while the passes run (0 for a multisampled one)
+   unsigned int texture(FgResource r) const {
+      return resources[r].texture;
+   }
+
+   // framebuffer of a resource, to blit from (resolving a multisampled target)
+   unsigned int fbo(FgResource r) const {
+      return resources[r].fbo;
+   }
+
+   int width(FgResource r) const { return resources[r].width; }
+   int height(FgResource r) const { return resources[r].height; }
+
+   // pass names in execution order
+   std::string describe() const {
+      std::string s;
+      for (size_t i = 0; i < order.size(); ++i)
+         s += (i ? " > " : "") + passes[order[i]].name;
+      return s;
+   }
+
+private:
+   struct Resource {
+      std::string name;
+      int width, height;
+      GLenum format;
+      bool depth, imported;
+      int samples;
+      bool output;
+      unsigned int fbo, texture;
+      RenderTarget *target;
+      int first, last;                 // execution indices of the first and last pass using it
+
+      Resource() : output(false), target(NULL), first(-1), last(-1) {}
+   };
+
+   struct Pass {
+      std::string name;
+      FgReads reads;
+      FgResource write;
+      std::function<void()> execute;
+      bool live;
+   };
+
+   RenderTargetPool &pool;
+   std::vector<Resource> resources;
+   std::vector<Pass> passes;
+   std::vector<size_t> order;
+
+   static bool reads(const Pass &p, size_t r) {
+      return std::find(p.reads.begin(), p.reads.end(), (FgResource)r) != p.reads.end();
+   }
+
+   // live resources are the outputs and whatever a live pass reads, to a fixed point
+   void cull() {
+      std::vector<bool> needed(resources.size(), false);
+      for (size_t r = 0; r < resources.size(); ++r)
+         needed[r] = resources[r].output;
+      for (size_t p = 0; p < passes.size(); ++p)
+         passes[p].live = false;
+      bool changed = true;
+      while (changed) {
+         changed = false;
+         for (size_t p = 0; p < passes.size(); ++p) {
+            Pass &pass = passes[p];
+            if (pass.live || !needed[pass.write])
+               continue;
+            pass.live = true;
+            changed = true;
+            for (size_t k = 0; k < pass.reads.size(); ++k)
+               needed[pass.reads[k]] = true;
+         }
+      }
+   }
+
+   static void link(std::vector<std::vector<size_t> > &next, std::vector<unsigned int> &n_deps,
+                    size_t from, size_t to) {
+      next[from].push_back(to);
+      n_deps[to]++;
+   }
+
+   void touch(FgResource r, size_t i) {
+      if (resources[r].first < 0)
+         resources[r].first = i;
+      resources[r].last = i;
+   }
+
+   static size_t bytes(const Resource &r) {
+      size_t texels = (size_t)r.width * r.height * std::max(1, r.samples);
+      return texels * (RenderTargetPool::bytes_per_texel(r.format) + (r.depth ? 4 : 0));
+   }
+};
+
+#endif
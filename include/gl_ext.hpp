@@ -0,0 +1,73 @@
+#ifndef _GL_EXT_HPP_
+#define _GL_EXT_HPP_
+
+/* glad was generated for core 3.3 without extensions. Entry points from newer
+ * versions are loaded here on demand, through the same loader that was handed
+ * to gladLoadGLLoader, and every feature has to be checked before use.
+ *
+ *    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+ *    glext::load((GLADloadproc)glfwGetProcAddress);
+ *    if (glext::has_buffer_storage()) ...
+ */
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+// GL 4.4 / ARB_buffer_storage
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT   0x0040
+#define GL_MAP_COHERENT_BIT     0x0080
+#define GL_DYNAMIC_STORAGE_BIT  0x0100
+#define GL_CLIENT_STORAGE_BIT   0x0200
+#endif
+
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC_EXT)(GLenum target, GLsizeiptr size,
+                                                     const void *data, GLbitfield flags);
+
+namespace glext {
+
+struct Functions {
+   bool loaded;
+   int major, minor;
+   PFNGLBUFFERSTORAGEPROC_EXT BufferStorage;
+};
+
+inline Functions &functions() {
+   static Functions f = { false, 0, 0, NULL };
+   return f;
+}
+
+inline bool has_extension(const char *name) {
+   GLint n = 0;
+   glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+   for (GLint i = 0; i < n; ++i) {
+      const char *ext = (const char *)glGetStringi(GL_EXTENSIONS, i);
+      if (ext && std::strcmp(ext, name) == 0)
+         return true;
+   }
+   return false;
+}
+
+inline bool version_at_least(int major, int minor) {
+   const Functions &f = functions();
+   return f.major > major || (f.major == major && f.minor >= minor);
+}
+
+// call once after gladLoadGLLoader, with the context current
+inline void load(GLADloadproc loader) {
+   Functions &f = functions();
+   glGetIntegerv(GL_MAJOR_VERSION, &f.major);
+   glGetIntegerv(GL_MINOR_VERSION, &f.minor);
+
+   if (version_at_least(4, 4) || has_extension("GL_ARB_buffer_storage"))
+      f.BufferStorage = (PFNGLBUFFERSTORAGEPROC_EXT)loader("glBufferStorage");
+
+   f.loaded = true;
+}
+
+inline bool has_buffer_storage() { return functions().BufferStorage != NULL; }
+
+} // namespace glext
+
+#endif
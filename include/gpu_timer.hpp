@@ -0,0 +1,37 @@
+#ifndef _GPU_TIMER_HPP_
+#define _GPU_TIMER_HPP_
+
+#include <glad/glad.h>
+
+#include <query_ring.hpp>
+
+/**************************** GPU TIMER ****************************/
+/* Measures GPU time of a section with GL_TIME_ELAPSED queries. The queries form
+ * a small ring (query_ring.hpp) so reading a result never waits for the GPU:
+ * `result` hands back the oldest finished measurement, a few frames old, or
+ * returns false. Only one timer may be running at a time.
+ *
+ *    timer.begin();
+ *    ... draw ...
+ *    timer.end();
+ *    double ms;
+ *    if (timer.result(ms)) ...
+ */
+class GpuTimer {
+public:
+   void begin() { ring.begin(); }
+   void end() { ring.end(); }
+
+   bool result(double &ms) {
+      GLuint64 ns = 0;
+      if (!ring.result(ns))
+         return false;
+      ms = ns / 1.0e6;
+      return true;
+   }
+
+private:
+   QueryRing<GL_TIME_ELAPSED> ring;
+};
+
+#endif
@@ -0,0 +1,447 @@
+#ifndef _HIZ_HPP_
+#define _HIZ_HPP_
+
+#include <glad/glad.h>
+
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstddef>
+#include <iostream>
+
+#include <shader.hpp>
+#include <bounds.hpp>
+#include <query_ring.hpp>
+
+/**************************** CULLING STATISTICS ****************************/
+struct CullStats {
+   unsigned int tested;
+   unsigned int frustum_rejected;
+   unsigned int occlusion_rejected;
+   unsigned int gpu_rejected;        // frustum or occlusion, the gpu pass doesn't say which
+
+   CullStats() : tested(0), frustum_rejected(0), occlusion_rejected(0), gpu_rejected(0) {}
+
+   void reset() { tested = frustum_rejected = occlusion_rejected = gpu_rejected = 0; }
+
+   unsigned int rejected() const { return frustum_rejected + occlusion_rejected + gpu_rejected; }
+   unsigned int visible() const { return tested - rejected(); }
+
+   float rejected_ratio() const {
+      return tested ? (float)rejected() / (float)tested : 0.0f;
+   }
+
+   void pprint(const char *label) const {
+      std::cout << label
+                << " tested: " << tested
+                << " frustum: " << frustum_rejected
+                << " occluded: " << occlusion_rejected
+                << " gpu: " << gpu_rejected
+                << " rejected: " << 100.0f * rejected_ratio() << "%"
+                << std::endl;
+   }
+};
+
+/**************************** PROJECTED BOX ****************************/
+enum projection_result {
+   PROJECT_OUTSIDE,  // box is outside the view frustum
+   PROJECT_CLIPPED,  // box crosses the near plane, no usable rect
+   PROJECT_INSIDE    // rect and depth are valid
+};
+
+// screen rect of a box in [0, 1] uv space along with its nearest window depth
+struct ScreenRect {
+   glm::vec2 min;
+   glm::vec2 max;
+   float depth;
+};
+
+projection_result project_box(const AABB &box, const glm::mat4 &vp, ScreenRect &rect) {
+   glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+   for (int i = 0; i < 8; ++i) {
+      glm::vec4 clip = vp * glm::vec4(box.corner(i), 1.0f);
+      if (clip.w <= 0.0f)
+         return PROJECT_CLIPPED;
+      glm::vec3 ndc = glm::vec3(clip) / clip.w;
+      lo = glm::min(lo, ndc);
+      hi = glm::max(hi, ndc);
+   }
+   if (hi.x < -1.0f || lo.x > 1.0f || hi.y < -1.0f || lo.y > 1.0f || lo.z > 1.0f)
+      return PROJECT_OUTSIDE;
+
+   rect.min = glm::clamp(glm::vec2(lo.x, lo.y) * 0.5f + 0.5f, 0.0f, 1.0f);
+   rect.max = glm::clamp(glm::vec2(hi.x, hi.y) * 0.5f + 0.5f, 0.0f, 1.0f);
+   rect.depth = lo.z * 0.5f + 0.5f;
+   return PROJECT_INSIDE;
+}
+
+/**************************** HIERARCHICAL DEPTH BUFFER ****************************/
+/* Max-depth pyramid of a depth buffer. Level 0 is the largest power of two that
+ * fits in the depth buffer, so every coarser level is an exact 2x2 reduction and
+ * a texel at level L always covers the same uv footprint as 2^L x 2^L texels of
+ * level 0. A box is occluded when its nearest depth is behind the farthest depth
+ * stored in the (at most 2x2) texels covering its screen rect.
+ *
+ * GPU tests read the pyramid directly. For CPU tests one coarse level is copied
+ * back through a PBO and is consumed a frame or more later, when the camera has
+ * moved. `occluded_cpu` projects the box with both the current matrix and the one
+ * the pyramid was built with, tests the union of the two rects and needs the box
+ * to be `cpu_depth_bias` behind the stored depth. That covers the camera motion
+ * between the two frames for moderate moves; it stays an approximation, a fast
+ * turn or an occluder that moved can still cull a visible box for a frame.
+ */
+class HiZ {
+public:
+   int width, height;
+   int levels;
+   unsigned int texture;
+   glm::mat4 view_projection;
+   float cpu_depth_bias;   // window depth a box must be behind the read back pyramid
+
+   HiZ(int screen_width, int screen_height)
+      : width(0), height(0), levels(0), texture(0), cpu_depth_bias(0.0001f),
+        fbo(0), vao(0), pbo(0),
+        fence(0), cpu_level(0), cpu_pending(false), cpu_valid(false) {
+      glGenFramebuffers(1, &fbo);
+      glGenVertexArrays(1, &vao);
+      glGenBuffers(1, &pbo);
+      resize(screen_width, screen_height);
+   }
+
+   void resize(int screen_width, int screen_height) {
+      width = floor_pow2(screen_width);
+      height = floor_pow2(screen_height);
+      levels = 1;
+      while ((width >> levels) > 0 || (height >> levels) > 0)
+         ++levels;
+
+      if (texture)
+         glDeleteTextures(1, &texture);
+      glGenTextures(1, &texture);
+      glBindTexture(GL_TEXTURE_2D, texture);
+      for (int i = 0; i < levels; ++i) {
+         glTexImage2D(GL_TEXTURE_2D, i, GL_R32F, level_width(i), level_height(i),
+                      0, GL_RED, GL_FLOAT, NULL);
+      }
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+      glBindTexture(GL_TEXTURE_2D, 0);
+
+      // the cpu copy starts at the first level that is at most 256 texels wide
+      cpu_level = 0;
+      while (cpu_level < levels - 1 && level_width(cpu_level) > 256)
+         ++cpu_level;
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+      glBufferData(GL_PIXEL_PACK_BUFFER,
+                   level_width(cpu_level) * level_height(cpu_level) * sizeof(float),
+                   NULL, GL_STREAM_READ);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+      cpu_levels.assign(levels - cpu_level, std::vector<float>());
+      for (int i = cpu_level; i < levels; ++i)
+         cpu_levels[i - cpu_level].assign(level_width(i) * level_height(i), 1.0f);
+      cpu_valid = false;
+   }
+
+   int level_width(int level) const { return std::max(1, width >> level); }
+   int level_height(int level) const { return std::max(1, height >> level); }
+
+   // reduce a depth texture of the given size into the pyramid
+   void build(Shader &reduce, unsigned int depth_texture,
+              int depth_width, int depth_height, const glm::mat4 &vp) {
+      view_projection = vp;
+
+      GLint viewport[4];
+      GLint prev_fbo;
+      glGetIntegerv(GL_VIEWPORT, viewport);
+      glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prev_fbo);
+      GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+      glDisable(GL_DEPTH_TEST);
+
+      reduce.use();
+      reduce.seti("src", 0);
+      glActiveTexture(GL_TEXTURE0);
+      glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+      glBindVertexArray(vao);
+
+      // level 0: conservative resample of the depth buffer
+      glBindTexture(GL_TEXTURE_2D, depth_texture);
+      reduce.setvec2("src_size", glm::vec2(depth_width, depth_height));
+      draw_level(reduce, 0);
+
+      // every other level reads only its parent, so clamp the sampled range
+      // to that level to avoid a feedback loop with the attached one
+      glBindTexture(GL_TEXTURE_2D, texture);
+      for (int i = 1; i < levels; ++i) {
+         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, i - 1);
+         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, i - 1);
+         reduce.setvec2("src_size", glm::vec2(level_width(i - 1), level_height(i - 1)));
+         draw_level(reduce, i);
+      }
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+      glBindTexture(GL_TEXTURE_2D, 0);
+
+      glBindVertexArray(0);
+      glBindFramebuffer(GL_FRAMEBUFFER, prev_fbo);
+      glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+      if (depth_test)
+         glEnable(GL_DEPTH_TEST);
+   }
+
+   // queue an asynchronous copy of the coarse levels for cpu tests
+   void read_back() {
+      if (cpu_pending)
+         return;
+
+      GLint prev_fbo;
+      glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prev_fbo);
+      glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                             GL_TEXTURE_2D, texture, cpu_level);
+      glReadBuffer(GL_COLOR_ATTACHMENT0);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+      glReadPixels(0, 0, level_width(cpu_level), level_height(cpu_level),
+                   GL_RED, GL_FLOAT, (void *)0);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      glBindFramebuffer(GL_FRAMEBUFFER, prev_fbo);
+
+      fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      pending_view_projection = view_projection;
+      cpu_pending = true;
+   }
+
+   // pick up a finished copy without waiting; true when the cpu pyramid changed
+   bool update_cpu() {
+      if (!cpu_pending)
+         return false;
+      GLenum status = glClientWaitSync(fence, 0, 0);
+      if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+         return false;
+      glDeleteSync(fence);
+      fence = 0;
+      cpu_pending = false;
+
+      std::vector<float> &base = cpu_levels[0];
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+      void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                    base.size() * sizeof(float), GL_MAP_READ_BIT);
+      if (data) {
+         std::memcpy(&base[0], data, base.size() * sizeof(float));
+         glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      }
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      if (!data)
+         return false;
+
+      for (int i = cpu_level + 1; i < levels; ++i) {
+         const std::vector<float> &src = cpu_levels[i - 1 - cpu_level];
+         std::vector<float> &dst = cpu_levels[i - cpu_level];
+         int sw = level_width(i - 1), sh = level_height(i - 1);
+         int dw = level_width(i), dh = level_height(i);
+         for (int y = 0; y < dh; ++y) {
+            for (int x = 0; x < dw; ++x) {
+               int x0 = std::min(2 * x, sw - 1), x1 = std::min(2 * x + 1, sw - 1);
+               int y0 = std::min(2 * y, sh - 1), y1 = std::min(2 * y + 1, sh - 1);
+               dst[y * dw + x] = std::max(std::max(src[y0 * sw + x0], src[y0 * sw + x1]),
+                                          std::max(src[y1 * sw + x0], src[y1 * sw + x1]));
+            }
+         }
+      }
+      cpu_view_projection = pending_view_projection;
+      cpu_valid = true;
+      return true;
+   }
+
+   bool cpu_ready() const { return cpu_valid; }
+
+   // true when the box is hidden behind the read back pyramid, `vp` is this frame's matrix
+   bool occluded_cpu(const AABB &box, const glm::mat4 &vp) const {
+      if (!cpu_valid)
+         return false;
+      // where the box is now and where it was for the pyramid
+      ScreenRect now, then;
+      if (project_box(box, vp, now) != PROJECT_INSIDE ||
+          project_box(box, cpu_view_projection, then) != PROJECT_INSIDE)
+         return false;
+      ScreenRect rect;
+      rect.min = glm::min(now.min, then.min);
+      rect.max = glm::max(now.max, then.max);
+      rect.depth = std::min(now.depth, then.depth) - cpu_depth_bias;
+
+      float extent = std::max((rect.max.x - rect.min.x) * width,
+                              (rect.max.y - rect.min.y) * height);
+      int level = (int)std::ceil(std::log2(std::max(extent, 1.0f)));
+      level = std::min(std::max(level, cpu_level), levels - 1);
+
+      const std::vector<float> &depth = cpu_levels[level - cpu_level];
+      int w = level_width(level), h = level_height(level);
+      int x0 = std::min((int)(rect.min.x * w), w - 1);
+      int y0 = std::min((int)(rect.min.y * h), h - 1);
+      int x1 = std::min((int)(rect.max.x * w), w - 1);
+      int y1 = std::min((int)(rect.max.y * h), h - 1);
+
+      float max_depth = 0.0f;
+      for (int y = y0; y <= y1; ++y)
+         for (int x = x0; x <= x1; ++x)
+            max_depth = std::max(max_depth, depth[y * w + x]);
+      return rect.depth > max_depth;
+   }
+
+   // uniforms used by the gpu visibility test
+   void bind(Shader &shader, int unit) const {
+      glActiveTexture(GL_TEXTURE0 + unit);
+      glBindTexture(GL_TEXTURE_2D, texture);
+      shader.seti("hiz", unit);
+      shader.setvec2("hiz_size", glm::vec2(width, height));
+      shader.seti("hiz_levels", levels);
+      shader.setmat4("view_projection", view_projection);
+   }
+
+private:
+   unsigned int fbo, vao, pbo;
+   GLsync fence;
+   int cpu_level;
+   bool cpu_pending;
+   bool cpu_valid;
+   glm::mat4 pending_view_projection;
+   glm::mat4 cpu_view_projection;
+   std::vector<std::vector<float> > cpu_levels;
+
+   static int floor_pow2(int v) {
+      int p = 1;
+      while (p * 2 <= v)
+         p *= 2;
+      return p;
+   }
+
+   void draw_level(Shader &reduce, int level) {
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                             GL_TEXTURE_2D, texture, level);
+      glViewport(0, 0, level_width(level), level_height(level));
+      reduce.setvec2("dst_size", glm::vec2(level_width(level), level_height(level)));
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+   }
+};
+
+/**************************** GPU INSTANCE CULLING ****************************/
+// per-instance input of the gpu culling pass
+struct CullInstance {
+   glm::mat4 transform;
+   glm::vec3 box_min;   // world space bounds
+   glm::vec3 box_max;
+};
+
+/* Tests every instance against the frustum and the pyramid in a vertex shader
+ * and streams the transforms of the visible ones into a buffer with transform
+ * feedback, ready to be used as an instanced mat4 attribute. The loader targets
+ * GL 3.3 so there are no compute shaders or indirect draws, and reading the
+ * visible count right away would stall until the GPU is done culling. The
+ * draw always covers all `count` instances instead: the destination is zeroed
+ * before the capture, so the slots past the visible ones hold a null transform,
+ * the vertex shader collapses them to a point and they rasterize nothing. The
+ * visible count only feeds the statistics, through a ring of queries
+ * (query_ring.hpp) a frame or two late.
+ */
+class HiZCuller {
+public:
+   HiZCuller(unsigned int instance_vbo)
+      : vao(0), zeros(0), zeros_size(0), known(0), known_valid(false) {
+      glGenVertexArrays(1, &vao);
+      glBindVertexArray(vao);
+      glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+      for (int i = 0; i < 4; ++i) {
+         glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, sizeof(CullInstance),
+                               (void *)(i * sizeof(glm::vec4)));
+         glEnableVertexAttribArray(i);
+      }
+      glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(CullInstance),
+                            (void *)offsetof(CullInstance, box_min));
+      glEnableVertexAttribArray(4);
+      glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(CullInstance),
+                            (void *)offsetof(CullInstance, box_max));
+      glEnableVertexAttribArray(5);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      glBindVertexArray(0);
+      glGenBuffers(1, &zeros);
+   }
+
+   ~HiZCuller() {
+      glDeleteBuffers(1, &zeros);
+      glDeleteVertexArrays(1, &vao);
+   }
+
+   // writes the visible transforms to the front of `dst_vbo`, null ones after them,
+   // and returns how many instances to draw (all of them)
+   unsigned int cull(Shader &shader, const HiZ &hiz, unsigned int count,
+                     unsigned int dst_vbo, CullStats &stats) {
+      // latest count the GPU is done with, nothing waits for it
+      GLuint64 visible = 0;
+      while (counts.result(visible)) {
+         known = (unsigned int)visible;
+         known_valid = true;
+      }
+
+      clear(dst_vbo, count);
+
+      shader.use();
+      hiz.bind(shader, 0);
+
+      glEnable(GL_RASTERIZER_DISCARD);
+      glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, dst_vbo);
+      counts.begin();
+      glBeginTransformFeedback(GL_POINTS);
+      glBindVertexArray(vao);
+      glDrawArrays(GL_POINTS, 0, count);
+      glBindVertexArray(0);
+      glEndTransformFeedback();
+      counts.end();
+      glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+      glDisable(GL_RASTERIZER_DISCARD);
+
+      // the shader doesn't report why an instance was dropped, and the count is a
+      // frame or two old
+      stats.tested += count;
+      if (known_valid)
+         stats.gpu_rejected += count - std::min(known, count);
+      return count;
+   }
+
+private:
+   unsigned int vao, zeros;
+   size_t zeros_size;
+   QueryRing<GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN> counts;
+   unsigned int known;
+   bool known_valid;
+
+   HiZCuller(const HiZCuller &);
+   HiZCuller &operator=(const HiZCuller &);
+
+   // null transforms for the first `n` instances of `dst_vbo`, copied on the GPU
+   void clear(unsigned int dst_vbo, unsigned int n) {
+      size_t size = n * sizeof(glm::mat4);
+      if (!size)
+         return;
+      if (zeros_size < size) {
+         std::vector<char> data(size, 0);
+         glBindBuffer(GL_COPY_READ_BUFFER, zeros);
+         glBufferData(GL_COPY_READ_BUFFER, size, &data[0], GL_STATIC_DRAW);
+         zeros_size = size;
+      }
+      glBindBuffer(GL_COPY_READ_BUFFER, zeros);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, dst_vbo);
+      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size);
+      glBindBuffer(GL_COPY_READ_BUFFER, 0);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+   }
+};
+
+#endif
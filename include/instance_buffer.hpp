@@ -0,0 +1,165 @@
+#ifndef _INSTANCE_BUFFER_HPP_
+#define _INSTANCE_BUFFER_HPP_
+
+#include <glad/glad.h>
+
+#include <glm/glm/glm.hpp>
+
+#include <vector>
+#include <math.h>
+
+/**************************** INSTANCE TRANSFORMS ****************************/
+// rotation is a unit quaternion stored as (x, y, z, w)
+struct InstanceTransform {
+   glm::vec3 position;
+   float scale;
+   glm::vec4 rotation;
+};
+
+// `angle` in radians, `axis` has to be normalized
+inline glm::vec4 axis_angle(const glm::vec3 &axis, float angle) {
+   float s = sinf(angle * 0.5f);
+   return glm::vec4(axis * s, cosf(angle * 0.5f));
+}
+
+// rotation * scale, in columns
+inline glm::mat3 rotation_scale(const InstanceTransform &t) {
+   const glm::vec4 &q = t.rotation;
+   float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+   float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+   float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+   glm::mat3 m;
+   m[0] = glm::vec3(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy)) * t.scale;
+   m[1] = glm::vec3(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx)) * t.scale;
+   m[2] = glm::vec3(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy)) * t.scale;
+   return m;
+}
+
+inline glm::mat4 to_mat4(const InstanceTransform &t) {
+   glm::mat3 r = rotation_scale(t);
+   glm::mat4 m;
+   m[0] = glm::vec4(r[0], 0.0f);
+   m[1] = glm::vec4(r[1], 0.0f);
+   m[2] = glm::vec4(r[2], 0.0f);
+   m[3] = glm::vec4(t.position, 1.0f);
+   return m;
+}
+
+/**************************** INSTANCE BUFFER ****************************/
+/* Per-instance transforms in one of several encodings. The vertex shader picks
+ * the matching decode with the define from `shader_defines`:
+ *
+ *    INSTANCE_MAT4   64 bytes  mat4 at locations 3-6
+ *    INSTANCE_AFFINE 48 bytes  the three rows of a 3x4 matrix at locations 3-5
+ *    INSTANCE_QUAT   32 bytes  (position, scale) at 3, rotation quaternion at 4
+ *
+ * The quaternion encoding only holds uniform scale.
+ *
+ *    InstanceBuffer instances(INSTANCE_QUAT);
+ *    instances.upload(transforms);
+ *    instances.setup(mesh.VAO);
+ *    Shader shader(vs, fs, NULL, InstanceBuffer::shader_defines(INSTANCE_QUAT));
+ */
+enum instance_format {
+   INSTANCE_MAT4,
+   INSTANCE_AFFINE,
+   INSTANCE_QUAT
+};
+
+class InstanceBuffer {
+public:
+   instance_format format;
+   unsigned int vbo;
+   unsigned int count;
+
+   InstanceBuffer(instance_format format = INSTANCE_MAT4) : format(format), count(0) {
+      glGenBuffers(1, &vbo);
+   }
+
+   ~InstanceBuffer() {
+      glDeleteBuffers(1, &vbo);
+   }
+
+   static size_t stride(instance_format format) {
+      switch (format) {
+      case INSTANCE_AFFINE: return 3 * sizeof(glm::vec4);
+      case INSTANCE_QUAT:   return 2 * sizeof(glm::vec4);
+      default:              return sizeof(glm::mat4);
+      }
+   }
+
+   static const char *name(instance_format format) {
+      switch (format) {
+      case INSTANCE_AFFINE: return "affine 3x4";
+      case INSTANCE_QUAT:   return "quat + position + scale";
+      default:              return "mat4";
+      }
+   }
+
+   static const char *shader_defines(instance_format format) {
+      switch (format) {
+      case INSTANCE_AFFINE: return "#define INSTANCE_AFFINE\n";
+      case INSTANCE_QUAT:   return "#define INSTANCE_QUAT\n";
+      default:              return "#define INSTANCE_MAT4\n";
+      }
+   }
+
+   size_t bytes() const { return count * stride(format); }
+
+   // writes `n` encoded transforms to `dst`, which holds n * stride(format) bytes
+   static void encode(instance_format format, const InstanceTransform *src, size_t n, void *dst) {
+      glm::vec4 *out = (glm::vec4 *)dst;
+      for (size_t i = 0; i < n; ++i) {
+         const InstanceTransform &t = src[i];
+         if (format == INSTANCE_QUAT) {
+            *out++ = glm::vec4(t.position, t.scale);
+            *out++ = t.rotation;
+         } else if (format == INSTANCE_AFFINE) {
+            glm::mat3 r = rotation_scale(t);
+            *out++ = glm::vec4(r[0].x, r[1].x, r[2].x, t.position.x);
+            *out++ = glm::vec4(r[0].y, r[1].y, r[2].y, t.position.y);
+            *out++ = glm::vec4(r[0].z, r[1].z, r[2].z, t.position.z);
+         } else {
+            glm::mat4 m = to_mat4(t);
+            for (int c = 0; c < 4; ++c)
+               *out++ = m[c];
+         }
+      }
+   }
+
+   void upload(const std::vector<InstanceTransform> &transforms, GLenum usage = GL_STATIC_DRAW) {
+      count = transforms.size();
+      std::vector<glm::vec4> data(count * stride(format) / sizeof(glm::vec4));
+      if (count)
+         encode(format, &transforms[0], count, &data[0]);
+      glBindBuffer(GL_ARRAY_BUFFER, vbo);
+      glBufferData(GL_ARRAY_BUFFER, bytes(), count ? &data[0] : NULL, usage);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+   }
+
+   // points the instance attributes of `vao` at this buffer, locations `first`..`first + 3`
+   void setup(unsigned int vao, unsigned int first = 3) const {
+      unsigned int n_vec4 = stride(format) / sizeof(glm::vec4);
+      glBindVertexArray(vao);
+      glBindBuffer(GL_ARRAY_BUFFER, vbo);
+      for (unsigned int i = 0; i < 4; ++i) {
+         if (i < n_vec4) {
+            glVertexAttribPointer(first + i, 4, GL_FLOAT, GL_FALSE, stride(format),
+                                  (void *)(i * sizeof(glm::vec4)));
+            glEnableVertexAttribArray(first + i);
+            glVertexAttribDivisor(first + i, 1);
+         } else {
+            glDisableVertexAttribArray(first + i);
+            glVertexAttribDivisor(first + i, 0);
+         }
+      }
+      glBindVertexArray(0);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+   }
+
+private:
+   InstanceBuffer(const InstanceBuffer &);
+   InstanceBuffer &operator=(const InstanceBuffer &);
+};
+
+#endif
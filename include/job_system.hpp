@@ -0,0 +1,124 @@
+#ifndef _JOB_SYSTEM_HPP_
+#define _JOB_SYSTEM_HPP_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+
+/**************************** THREAD POOL ****************************/
+/* Fixed set of worker threads for data parallel frame work. The calling thread
+ * takes part in every `parallel_for`, so a pool of size 1 runs everything
+ * inline. Work is handed out in chunks of `grain` items; chunk c always covers
+ * [c * grain, min(count, (c + 1) * grain)) so callers can keep per-chunk output
+ * and get the same result regardless of which thread ran which chunk.
+ *
+ * Jobs must not touch GL, the context only lives on the calling thread.
+ */
+class ThreadPool {
+public:
+   typedef std::function<void(size_t begin, size_t end, unsigned int worker)> range_fn;
+
+   // 0 picks one participant per hardware thread
+   explicit ThreadPool(unsigned int n_threads = 0)
+      : job(NULL), job_count(0), job_grain(1), generation(0), busy(0), quit(false) {
+      if (n_threads == 0)
+         n_threads = std::max(1u, std::thread::hardware_concurrency());
+      for (unsigned int i = 1; i < n_threads; ++i)
+         workers.push_back(std::thread(&ThreadPool::worker_loop, this, i));
+   }
+
+   ~ThreadPool() {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         quit = true;
+      }
+      wake.notify_all();
+      for (size_t i = 0; i < workers.size(); ++i)
+         workers[i].join();
+   }
+
+   // number of threads taking part in a job, including the caller
+   unsigned int size() const { return workers.size() + 1; }
+
+   static size_t n_chunks(size_t count, size_t grain) {
+      return (count + grain - 1) / grain;
+   }
+
+   void parallel_for(size_t count, size_t grain, const range_fn &fn) {
+      if (count == 0)
+         return;
+      grain = std::max<size_t>(grain, 1);
+      if (workers.empty() || count <= grain) {
+         for (size_t begin = 0; begin < count; begin += grain)
+            fn(begin, std::min(count, begin + grain), 0);
+         return;
+      }
+
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         job = &fn;
+         job_count = count;
+         job_grain = grain;
+         next_chunk = 0;
+         busy = workers.size();
+         ++generation;
+      }
+      wake.notify_all();
+
+      run_chunks(0);
+
+      std::unique_lock<std::mutex> lock(mutex);
+      done.wait(lock, [this] { return busy == 0; });
+      job = NULL;
+   }
+
+private:
+   std::vector<std::thread> workers;
+   std::mutex mutex;
+   std::condition_variable wake;
+   std::condition_variable done;
+
+   const range_fn *job;
+   size_t job_count;
+   size_t job_grain;
+   std::atomic<size_t> next_chunk;
+   unsigned long generation;
+   unsigned int busy;
+   bool quit;
+
+   void run_chunks(unsigned int worker) {
+      size_t chunks = n_chunks(job_count, job_grain);
+      for (;;) {
+         size_t c = next_chunk.fetch_add(1);
+         if (c >= chunks)
+            break;
+         size_t begin = c * job_grain;
+         (*job)(begin, std::min(job_count, begin + job_grain), worker);
+      }
+   }
+
+   void worker_loop(unsigned int worker) {
+      unsigned long seen = 0;
+      for (;;) {
+         {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, seen] { return quit || generation != seen; });
+            if (quit)
+               return;
+            seen = generation;
+         }
+
+         run_chunks(worker);
+
+         std::lock_guard<std::mutex> lock(mutex);
+         if (--busy == 0)
+            done.notify_one();
+      }
+   }
+};
+
+#endif
@@ -0,0 +1,264 @@
+#ifndef _LIGHT_GRID_HPP_
+#define _LIGHT_GRID_HPP_
+
+#include <glad/glad.h>
+
+#include <glm/glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include <shader.hpp>
+#include <lights.hpp>
+#include <job_system.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LIGHT_GRID_SSE
+#include <xmmintrin.h>
+#endif
+
+/**************************** LIGHT GRID ****************************/
+/* Clustered light assignment. The view frustum is cut into dim_x * dim_y
+ * screen tiles and dim_z depth slices, spaced exponentially between near and
+ * far so clusters stay roughly cubic:
+ *
+ *    slice = floor(log(depth) * z_scale + z_bias)
+ *
+ * `build` tests every light sphere against the view space box of every
+ * cluster it may touch and writes, per cluster, an (offset, count) pair into
+ * `grid` and the light indices into `indices`. Slices are independent jobs on
+ * a ThreadPool, inside a slice four lights are tested at once. The result does
+ * not depend on the number of threads.
+ *
+ * A fragment shader finds its cluster from gl_FragCoord and its view depth and
+ * loops over that cluster's lights only:
+ *
+ *    grid.set_projection(projection, near, far);     // when it changes
+ *    grid.build(&lights[0], n, view, pool);          // every frame
+ *    grid.upload();
+ *    grid.bind(shader, unit, screen_size);            // 2 texture units
+ */
+class LightGrid {
+public:
+   unsigned int dim_x, dim_y, dim_z;
+   float near_plane, far_plane;
+   float z_scale, z_bias;
+   std::vector<unsigned int> grid;      // offset, count per cluster, x fastest
+   std::vector<unsigned int> indices;   // light indices, cluster after cluster
+
+   LightGrid(unsigned int dim_x = 16, unsigned int dim_y = 9, unsigned int dim_z = 24)
+      : dim_x(dim_x), dim_y(dim_y), dim_z(dim_z), near_plane(0.1f), far_plane(100.0f),
+        z_scale(0.0f), z_bias(0.0f), grid_capacity(0), index_capacity(0) {
+      grid.resize(2 * n_clusters());
+      boxes.resize(n_clusters());
+      slices.resize(dim_z);
+
+      glGenBuffers(1, &grid_buffer);
+      glGenBuffers(1, &index_buffer);
+      glGenTextures(1, &grid_texture);
+      glGenTextures(1, &index_texture);
+      glBindBuffer(GL_TEXTURE_BUFFER, grid_buffer);
+      glBindTexture(GL_TEXTURE_BUFFER, grid_texture);
+      glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, grid_buffer);
+      glBindBuffer(GL_TEXTURE_BUFFER, index_buffer);
+      glBindTexture(GL_TEXTURE_BUFFER, index_texture);
+      glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, index_buffer);
+      glBindTexture(GL_TEXTURE_BUFFER, 0);
+      glBindBuffer(GL_TEXTURE_BUFFER, 0);
+   }
+
+   unsigned int n_clusters() const { return dim_x * dim_y * dim_z; }
+
+   // symmetric perspective projections only, the cluster boxes come from its scale terms
+   void set_projection(const glm::mat4 &projection, float near, float far) {
+      near_plane = near;
+      far_plane = far;
+      float log_range = logf(far / near);
+      z_scale = dim_z / log_range;
+      z_bias = -(dim_z * logf(near)) / log_range;
+
+      float sx = 1.0f / projection[0][0], sy = 1.0f / projection[1][1];
+      for (unsigned int z = 0; z < dim_z; ++z) {
+         float d0 = near * powf(far / near, (float)z / dim_z);
+         float d1 = near * powf(far / near, (float)(z + 1) / dim_z);
+         for (unsigned int y = 0; y < dim_y; ++y) {
+            float y0 = (2.0f * y / dim_y - 1.0f) * sy;
+            float y1 = (2.0f * (y + 1) / dim_y - 1.0f) * sy;
+            for (unsigned int x = 0; x < dim_x; ++x) {
+               float x0 = (2.0f * x / dim_x - 1.0f) * sx;
+               float x1 = (2.0f * (x + 1) / dim_x - 1.0f) * sx;
+               // the tile's side planes go through the eye, the extremes are on the near or far cap
+               ClusterBox &box = boxes[(z * dim_y + y) * dim_x + x];
+               box.min = glm::vec3(std::min(x0 * d0, x0 * d1), std::min(y0 * d0, y0 * d1), d0);
+               box.max = glm::vec3(std::max(x1 * d0, x1 * d1), std::max(y1 * d0, y1 * d1), d1);
+            }
+         }
+      }
+   }
+
+   void build(const PointLight *lights, unsigned int n, const glm::mat4 &view, ThreadPool &pool) {
+      // view space spheres as SoA, depth positive, padded with lights that never pass
+      unsigned int padded = (n + 3) & ~3u;
+      lx.resize(padded); ly.resize(padded); lz.resize(padded); lr.resize(padded);
+      for (unsigned int i = 0; i < padded; ++i) {
+         if (i < n) {
+            glm::vec4 p = view * glm::vec4(lights[i].position, 1.0f);
+            lx[i] = p.x; ly[i] = p.y; lz[i] = -p.z; lr[i] = lights[i].radius;
+         } else {
+            lx[i] = ly[i] = 0.0f; lz[i] = -1e6f; lr[i] = 0.0f;
+         }
+      }
+
+      pool.parallel_for(dim_z, 1, [this, padded](size_t begin, size_t end, unsigned int) {
+         for (size_t z = begin; z < end; ++z)
+            build_slice(z, padded);
+      });
+
+      // slices are concatenated in order
+      indices.clear();
+      for (unsigned int z = 0; z < dim_z; ++z) {
+         Slice &slice = slices[z];
+         unsigned int base = indices.size();
+         unsigned int first = z * dim_x * dim_y;
+         for (unsigned int c = 0; c < dim_x * dim_y; ++c) {
+            grid[2 * (first + c)] = base + slice.offsets[c];
+            grid[2 * (first + c) + 1] = slice.counts[c];
+         }
+         indices.insert(indices.end(), slice.indices.begin(), slice.indices.end());
+      }
+   }
+
+   void upload() {
+      grid_capacity = upload(grid_buffer, grid, grid_capacity);
+      index_capacity = upload(index_buffer, indices, index_capacity);
+   }
+
+   // grid on `first_unit`, light indices on the next one
+   void bind(Shader &shader, int first_unit, const glm::vec2 &screen_size) const {
+      glActiveTexture(GL_TEXTURE0 + first_unit);
+      glBindTexture(GL_TEXTURE_BUFFER, grid_texture);
+      glActiveTexture(GL_TEXTURE0 + first_unit + 1);
+      glBindTexture(GL_TEXTURE_BUFFER, index_texture);
+      glActiveTexture(GL_TEXTURE0);
+      shader.seti("cluster_grid", first_unit);
+      shader.seti("cluster_lights", first_unit + 1);
+      shader.setvec3("grid_dims", glm::vec3(dim_x, dim_y, dim_z));
+      shader.setvec2("grid_z", glm::vec2(z_scale, z_bias));
+      shader.setvec2("screen_size", screen_size);
+   }
+
+private:
+   struct ClusterBox {
+      glm::vec3 min, max;
+   };
+
+   // per slice output, written by one job
+   struct Slice {
+      std::vector<unsigned int> candidates;
+      std::vector<float> cx, cy, cz, cr;
+      std::vector<unsigned int> offsets, counts;
+      std::vector<unsigned int> indices;
+   };
+
+   std::vector<ClusterBox> boxes;
+   std::vector<Slice> slices;
+   std::vector<float> lx, ly, lz, lr;
+
+   unsigned int grid_buffer, grid_texture;
+   unsigned int index_buffer, index_texture;
+   size_t grid_capacity, index_capacity;
+
+   void build_slice(size_t z, unsigned int padded) {
+      Slice &slice = slices[z];
+      slice.candidates.clear();
+      slice.indices.clear();
+      slice.offsets.resize(dim_x * dim_y);
+      slice.counts.resize(dim_x * dim_y);
+
+      // lights whose depth range reaches the slice
+      const ClusterBox &first = boxes[z * dim_x * dim_y];
+      float d0 = first.min.z, d1 = first.max.z;
+#ifdef LIGHT_GRID_SSE
+      __m128 near4 = _mm_set1_ps(d0), far4 = _mm_set1_ps(d1);
+      for (unsigned int i = 0; i < padded; i += 4) {
+         __m128 z4 = _mm_loadu_ps(&lz[i]), r4 = _mm_loadu_ps(&lr[i]);
+         int mask = _mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(_mm_add_ps(z4, r4), near4),
+                                               _mm_cmplt_ps(_mm_sub_ps(z4, r4), far4)));
+         for (; mask; mask &= mask - 1)
+            slice.candidates.push_back(i + lowest_bit(mask));
+      }
+#else
+      for (unsigned int i = 0; i < padded; ++i)
+         if (lz[i] + lr[i] > d0 && lz[i] - lr[i] < d1)
+            slice.candidates.push_back(i);
+#endif
+
+      // gathered so the cluster loop streams through them
+      size_t n = slice.candidates.size(), n_padded = (n + 3) & ~(size_t)3;
+      slice.cx.resize(n_padded); slice.cy.resize(n_padded);
+      slice.cz.resize(n_padded); slice.cr.resize(n_padded);
+      for (size_t i = 0; i < n_padded; ++i) {
+         if (i < n) {
+            unsigned int l = slice.candidates[i];
+            slice.cx[i] = lx[l]; slice.cy[i] = ly[l]; slice.cz[i] = lz[l]; slice.cr[i] = lr[l];
+         } else {
+            slice.cx[i] = slice.cy[i] = 0.0f; slice.cz[i] = -1e6f; slice.cr[i] = 0.0f;
+         }
+      }
+
+      for (unsigned int c = 0; c < dim_x * dim_y; ++c) {
+         const ClusterBox &box = boxes[z * dim_x * dim_y + c];
+         slice.offsets[c] = slice.indices.size();
+#ifdef LIGHT_GRID_SSE
+         __m128 zero = _mm_setzero_ps();
+         __m128 min_x = _mm_set1_ps(box.min.x), max_x = _mm_set1_ps(box.max.x);
+         __m128 min_y = _mm_set1_ps(box.min.y), max_y = _mm_set1_ps(box.max.y);
+         __m128 min_z = _mm_set1_ps(box.min.z), max_z = _mm_set1_ps(box.max.z);
+         for (size_t i = 0; i < n_padded; i += 4) {
+            __m128 x = _mm_loadu_ps(&slice.cx[i]), y = _mm_loadu_ps(&slice.cy[i]);
+            __m128 zz = _mm_loadu_ps(&slice.cz[i]), r = _mm_loadu_ps(&slice.cr[i]);
+            // distance from the sphere center to the box, per axis
+            __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(min_x, x), _mm_sub_ps(x, max_x)), zero);
+            __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(min_y, y), _mm_sub_ps(y, max_y)), zero);
+            __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(min_z, zz), _mm_sub_ps(zz, max_z)), zero);
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            int mask = _mm_movemask_ps(_mm_cmple_ps(d2, _mm_mul_ps(r, r)));
+            for (; mask; mask &= mask - 1)
+               slice.indices.push_back(slice.candidates[i + lowest_bit(mask)]);
+         }
+#else
+         for (size_t i = 0; i < n; ++i) {
+            float dx = std::max(std::max(box.min.x - slice.cx[i], slice.cx[i] - box.max.x), 0.0f);
+            float dy = std::max(std::max(box.min.y - slice.cy[i], slice.cy[i] - box.max.y), 0.0f);
+            float dz = std::max(std::max(box.min.z - slice.cz[i], slice.cz[i] - box.max.z), 0.0f);
+            if (dx * dx + dy * dy + dz * dz <= slice.cr[i] * slice.cr[i])
+               slice.indices.push_back(slice.candidates[i]);
+         }
+#endif
+         slice.counts[c] = slice.indices.size() - slice.offsets[c];
+      }
+   }
+
+   static unsigned int lowest_bit(int mask) {
+      unsigned int bit = 0;
+      while (!(mask & (1 << bit)))
+         ++bit;
+      return bit;
+   }
+
+   // grows to the next power of two, orphans the old storage otherwise
+   static size_t upload(unsigned int buffer, const std::vector<unsigned int> &data, size_t capacity) {
+      size_t size = std::max<size_t>(data.size(), 1) * sizeof(unsigned int);
+      while (capacity < size)
+         capacity = capacity ? 2 * capacity : 1024;
+      glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+      glBufferData(GL_TEXTURE_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+      if (!data.empty())
+         glBufferSubData(GL_TEXTURE_BUFFER, 0, data.size() * sizeof(unsigned int), &data[0]);
+      glBindBuffer(GL_TEXTURE_BUFFER, 0);
+      return capacity;
+   }
+};
+
+#endif
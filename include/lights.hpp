@@ -0,0 +1,132 @@
+#ifndef _LIGHTS_HPP_
+#define _LIGHTS_HPP_
+
+#include <glad/glad.h>
+
+#include <glm/glm/glm.hpp>
+
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+#include <math.h>
+
+/**************************** POINT LIGHT ****************************/
+/* Two texels of an RGBA32F texture buffer: (position, radius), (color,
+ * intensity). The light fades to exactly zero at `radius`, so it only touches
+ * what is inside that sphere:
+ *
+ *    window = clamp(1 - (d / radius)^4, 0, 1)^2
+ *    attenuation = intensity * window / (1 + d^2)
+ */
+struct PointLight {
+   glm::vec3 position;
+   float radius;
+   glm::vec3 color;
+   float intensity;
+};
+
+/**************************** SPOT LIGHT ****************************/
+/* A point light limited to a cone, one more texel: (direction, cos of the
+ * cone's half angle). A cone of cos -1 covers the whole sphere, so point and
+ * spot lights can share one buffer.
+ */
+struct SpotLight {
+   PointLight light;
+   glm::vec3 direction;
+   float cos_cutoff;
+
+   bool is_point() const { return cos_cutoff <= -1.0f; }
+};
+
+/**************************** LIGHT BUFFER ****************************/
+/* All lights of a frame in a texture buffer, the shaders read texel j of
+ * light i with texelFetch(lights, texels * i + j) where `texels` is 2 for
+ * PointLight and 3 for SpotLight. GL 3.3 has no storage buffers and a
+ * uniform array would cap the light count.
+ */
+class LightBuffer {
+public:
+   unsigned int buffer, texture;
+   unsigned int capacity, count;
+   size_t light_size;
+
+   LightBuffer(unsigned int capacity, size_t light_size = sizeof(PointLight))
+      : capacity(capacity), count(0), light_size(light_size) {
+      glGenBuffers(1, &buffer);
+      glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+      glBufferData(GL_TEXTURE_BUFFER, capacity * light_size, NULL, GL_STREAM_DRAW);
+      glGenTextures(1, &texture);
+      glBindTexture(GL_TEXTURE_BUFFER, texture);
+      glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+      glBindTexture(GL_TEXTURE_BUFFER, 0);
+      glBindBuffer(GL_TEXTURE_BUFFER, 0);
+   }
+
+   // lights past `capacity` are dropped
+   void upload(const PointLight *lights, unsigned int n) {
+      upload_bytes(lights, n, sizeof(PointLight));
+   }
+
+   void upload(const SpotLight *lights, unsigned int n) {
+      upload_bytes(lights, n, sizeof(SpotLight));
+   }
+
+   void bind(int unit) const {
+      glActiveTexture(GL_TEXTURE0 + unit);
+      glBindTexture(GL_TEXTURE_BUFFER, texture);
+   }
+
+private:
+   void upload_bytes(const void *lights, unsigned int n, size_t size) {
+      if (size != light_size) {
+         std::cerr << "ERROR: light buffer holds lights of " << light_size << " bytes, not "
+                   << size << "." << std::endl;
+         return;
+      }
+      count = n < capacity ? n : capacity;
+      glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+      // orphaned, last frame's draws may still read the old storage
+      glBufferData(GL_TEXTURE_BUFFER, capacity * light_size, NULL, GL_STREAM_DRAW);
+      if (count)
+         glBufferSubData(GL_TEXTURE_BUFFER, 0, count * light_size, lights);
+      glBindBuffer(GL_TEXTURE_BUFFER, 0);
+   }
+};
+
+/**************************** LIGHT FIELD ****************************/
+// lights circling the y axis at random radii, heights and speeds, for the lighting demos
+struct LightOrbit {
+   float radius, height, angle, speed;
+};
+
+inline void make_light_orbits(std::vector<LightOrbit> &orbits, std::vector<PointLight> &lights,
+                              unsigned int n, float extent, float light_radius) {
+   orbits.resize(n);
+   lights.resize(n);
+   for (unsigned int i = 0; i < n; ++i) {
+      orbits[i].radius = extent * (rand() % 1000) / 1000.0f;
+      orbits[i].height = 0.3f + 2.0f * (rand() % 1000) / 1000.0f;
+      orbits[i].angle = 6.2831853f * (rand() % 1000) / 1000.0f;
+      orbits[i].speed = 0.1f + 0.4f * (rand() % 1000) / 1000.0f;
+      if (rand() & 1)
+         orbits[i].speed = -orbits[i].speed;
+
+      // saturated colors, one channel kept low
+      glm::vec3 color((rand() % 1000) / 1000.0f, (rand() % 1000) / 1000.0f, (rand() % 1000) / 1000.0f);
+      color[rand() % 3] *= 0.2f;
+      lights[i].color = color;
+      lights[i].radius = light_radius;
+      lights[i].intensity = 4.0f;
+   }
+}
+
+inline void update_light_orbits(const std::vector<LightOrbit> &orbits, std::vector<PointLight> &lights,
+                                float time) {
+   for (size_t i = 0; i < orbits.size(); ++i) {
+      float angle = orbits[i].angle + orbits[i].speed * time;
+      lights[i].position = glm::vec3(sinf(angle) * orbits[i].radius, orbits[i].height,
+                                     cosf(angle) * orbits[i].radius);
+   }
+}
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef _MATERIAL_BATCH_HPP_
+#define _MATERIAL_BATCH_HPP_
+
+#include <glad/glad.h>
+
+#include <glm/glm/glm.hpp>
+
+#include <vector>
+#include <iostream>
+#include <cstddef>
+
+#include <shader.hpp>
+#include <mesh.hpp>
+#include <model.hpp>
+
+// index of a vertex's mesh in the material table, a stream next to the vertices
+struct draw_id_vertex {
+   unsigned int draw_id;
+};
+
+VERTEX_LAYOUT(draw_id_vertex,
+              VERTEX_ATTRIBUTE(draw_id_vertex, draw_id, 3, "idraw"));
+
+/**************************** MATERIAL BATCH ****************************/
+/* Draws every mesh of a model with one glMultiDrawElementsBaseVertex call.
+ *
+ * The meshes' vertices and indices are merged into one set of buffers and the
+ * model has to be loaded with MODEL_PACK_TEXTURES, so all of its textures are
+ * layers of one texture array. The material table is a texture buffer with one
+ * (diffuse layer, specular layer) entry per draw. GL 3.3 has no gl_DrawID, so
+ * every vertex carries the index of the draw it belongs to (attribute 3).
+ * Node transforms of the model are baked into the merged vertices.
+ *
+ * Shader interface: `sampler2DArray materials`, `isamplerBuffer material_table`.
+ */
+class MaterialBatch {
+public:
+   unsigned int VAO, VBO, EBO, draw_id_vbo;
+   unsigned int table_buffer, table_texture;
+   std::vector<GLsizei> counts;
+   std::vector<const void *> offsets;
+   std::vector<GLint> base_vertices;
+
+   MaterialBatch(Model &model) : array(model.texture_array.id) {
+      if (!array)
+         std::cerr << "MaterialBatch: model was loaded without MODEL_PACK_TEXTURES" << std::endl;
+
+      std::vector<vertex> vertices;
+      std::vector<unsigned int> indices;
+      std::vector<draw_id_vertex> draw_ids;
+      std::vector<GLint> table;
+      model.nodes.update();
+      for (size_t i = 0; i < model.meshes.size(); ++i) {
+         const Mesh &mesh = model.meshes[i];
+         counts.push_back(mesh.indices.size());
+         offsets.push_back((const void *)(indices.size() * sizeof(unsigned int)));
+         base_vertices.push_back(vertices.size());
+
+         const glm::mat4 &node = model.nodes.world[model.mesh_nodes[i]];
+         glm::mat3 normal_mat = glm::transpose(glm::inverse(glm::mat3(node)));
+         for (size_t j = 0; j < mesh.vertices.size(); ++j) {
+            vertex v = mesh.vertices[j];
+            v.position = glm::vec3(node * glm::vec4(v.position, 1.0f));
+            v.normal = normal_mat * v.normal;
+            vertices.push_back(v);
+         }
+         indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+         draw_id_vertex id = { (unsigned int)i };
+         draw_ids.insert(draw_ids.end(), mesh.vertices.size(), id);
+
+         // same fallback as Mesh::draw: no specular map samples the diffuse one
+         GLint diffuse = -1, specular = -1;
+         for (size_t j = 0; j < mesh.textures.size(); ++j) {
+            if (mesh.textures[j].type == "texture_diffuse" && diffuse < 0)
+               diffuse = mesh.textures[j].layer;
+            else if (mesh.textures[j].type == "texture_specular" && specular < 0)
+               specular = mesh.textures[j].layer;
+         }
+         // no diffuse map samples white, as the material colour alone would
+         if (diffuse < 0)
+            diffuse = model.texture_array.white_layer;
+         if (specular < 0)
+            specular = diffuse;
+         table.push_back(diffuse);
+         table.push_back(specular);
+      }
+
+      glGenVertexArrays(1, &VAO);
+      glGenBuffers(1, &VBO);
+      glGenBuffers(1, &EBO);
+      glGenBuffers(1, &draw_id_vbo);
+
+      glBindVertexArray(VAO);
+      glBindBuffer(GL_ARRAY_BUFFER, VBO);
+      glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vertex), &vertices[0], GL_STATIC_DRAW);
+      setup_attributes<vertex>(VBO);
+
+      glBindBuffer(GL_ARRAY_BUFFER, draw_id_vbo);
+      glBufferData(GL_ARRAY_BUFFER, draw_ids.size() * sizeof(draw_id_vertex), &draw_ids[0], GL_STATIC_DRAW);
+      setup_attributes<draw_id_vertex>(draw_id_vbo);
+
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+      glBindVertexArray(0);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+      glGenBuffers(1, &table_buffer);
+      glBindBuffer(GL_TEXTURE_BUFFER, table_buffer);
+      glBufferData(GL_TEXTURE_BUFFER, table.size() * sizeof(GLint), &table[0], GL_STATIC_DRAW);
+      glGenTextures(1, &table_texture);
+      glBindTexture(GL_TEXTURE_BUFFER, table_texture);
+      glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32I, table_buffer);
+      glBindTexture(GL_TEXTURE_BUFFER, 0);
+      glBindBuffer(GL_TEXTURE_BUFFER, 0);
+   }
+
+   unsigned int draw_count() const { return counts.size(); }
+
+   void draw(Shader &shader, int array_unit = 0, int table_unit = 1) const {
+      bind(shader, array_unit, table_unit);
+      glBindVertexArray(VAO);
+      glMultiDrawElementsBaseVertex(GL_TRIANGLES, &counts[0], GL_UNSIGNED_INT,
+                                    (const void *const *)&offsets[0], counts.size(),
+                                    &base_vertices[0]);
+      glBindVertexArray(0);
+      glActiveTexture(GL_TEXTURE0);
+   }
+
+   /* The same meshes with one draw each, from their own buffers and placed like
+    * `Model::draw(shader, scene, first_node)`: the unbatched reference. Packed
+    * models have no separate textures left, so these sample the array too; the
+    * mesh VAOs have no attribute 3, its constant value is the draw id.
+    */
+   void draw_meshes(Shader &shader, const Model &model, const SceneGraph &scene,
+                    unsigned int first_node, int array_unit = 0, int table_unit = 1) const {
+      bind(shader, array_unit, table_unit);
+      for (size_t i = 0; i < model.meshes.size(); ++i) {
+         shader.setmat4("model", scene.world[first_node + model.mesh_nodes[i]]);
+         glVertexAttribI4ui(3, i, 0, 0, 0);
+         glBindVertexArray(model.meshes[i].VAO);
+         glDrawElements(GL_TRIANGLES, model.meshes[i].indices.size(), GL_UNSIGNED_INT, 0);
+      }
+      glBindVertexArray(0);
+      glActiveTexture(GL_TEXTURE0);
+   }
+
+private:
+   unsigned int array;
+
+   void bind(Shader &shader, int array_unit, int table_unit) const {
+      shader.use();
+      glActiveTexture(GL_TEXTURE0 + array_unit);
+      glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+      glActiveTexture(GL_TEXTURE0 + table_unit);
+      glBindTexture(GL_TEXTURE_BUFFER, table_texture);
+      shader.seti("materials", array_unit);
+      shader.seti("material_table", table_unit);
+   }
+};
+
+#endif
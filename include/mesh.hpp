@@ -15,6 +15,8 @@
 #include <fstream>
 
 #include <shader.hpp>
+#include <bounds.hpp>
+#include <vertex_layout.hpp>
 
 struct vertex {
    glm::vec3 position;
@@ -22,10 +24,48 @@ struct vertex {
    glm::vec2 tex_pos;
 };
 
+VERTEX_LAYOUT(vertex,
+              VERTEX_ATTRIBUTE(vertex, position, 0, "ipos"),
+              VERTEX_ATTRIBUTE(vertex, normal, 1, "inorm"),
+              VERTEX_ATTRIBUTE(vertex, tex_pos, 2, "itex_pos"));
+
+// the position alone, a stream of its own for depth only passes
+struct position_vertex {
+   glm::vec3 position;
+};
+
+VERTEX_LAYOUT(position_vertex,
+              VERTEX_ATTRIBUTE(position_vertex, position, 0, "ipos"));
+
+/* Positions alone, copied out of `count` interleaved vertices of `stride`
+ * floats each (position first), into a buffer and VAO of their own: 12 bytes
+ * a vertex for depth and shadow passes.
+ *
+ *    unsigned int depth_VAO, position_VBO;
+ *    depth_VAO = position_stream(vertices, 36, 8, position_VBO);
+ */
+inline unsigned int position_stream(const float *vertices, unsigned int count,
+                                    unsigned int stride, unsigned int &vbo) {
+   std::vector<position_vertex> positions(count);
+   for (unsigned int i = 0; i < count; ++i)
+      positions[i].position = glm::vec3(vertices[stride * i], vertices[stride * i + 1],
+                                        vertices[stride * i + 2]);
+   unsigned int vao;
+   glGenVertexArrays(1, &vao);
+   glGenBuffers(1, &vbo);
+   glBindVertexArray(vao);
+   glBindBuffer(GL_ARRAY_BUFFER, vbo);
+   glBufferData(GL_ARRAY_BUFFER, count * sizeof(position_vertex), &positions[0], GL_STATIC_DRAW);
+   setup_attributes<position_vertex>(vbo);
+   glBindVertexArray(0);
+   return vao;
+}
+
 struct texture {
    unsigned int id;
    std::string type;
    std::string path;
+   int layer;   // in the model's texture array, -1 when not packed
 };
 
 class Mesh {
@@ -33,6 +73,7 @@ public:
    std::vector<vertex> vertices;
    std::vector<texture> textures;
    std::vector<unsigned int> indices;
+   AABB bounds;
        
    Mesh(std::vector<vertex> vertices,
         std::vector<texture> textures,
@@ -42,6 +83,9 @@ public:
       this->textures = textures;
       this->indices  = indices;
 
+      for (size_t i = 0; i < this->vertices.size(); ++i)
+         bounds.expand(this->vertices[i].position);
+
       this->setup_mesh();
    }
 
@@ -120,17 +164,7 @@ private:
                    GL_STATIC_DRAW
                    );
 
-      glVertexAttribPointer(0, 3, GL_FLOAT, 
-         GL_FALSE, sizeof(vertex), (void *)0);
-      glEnableVertexAttribArray(0);
-      glVertexAttribPointer(1, 3, GL_FLOAT, 
-         GL_FALSE, sizeof(vertex), (void *)offsetof(vertex, normal));
-      glEnableVertexAttribArray(1);
-      glVertexAttribPointer(2, 2, GL_FLOAT, 
-         GL_FALSE, sizeof(vertex), (void *)offsetof(vertex, tex_pos));
-      glEnableVertexAttribArray(2);
-
-      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      setup_attributes<vertex>(VBO);
       glBindVertexArray(0);
 }
 
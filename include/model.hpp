@@ -3,6 +3,9 @@
 
 #include <shader.hpp>
 #include <mesh.hpp>
+#include <texture_array.hpp>
+#include <scene_graph.hpp>
+#include <triangle_bvh.hpp>
 
 #include <string>
 #include <iostream>
@@ -17,6 +20,16 @@
 #include <assimp/postprocess.h>
 
 
+// import options
+enum model_flags {
+   MODEL_DEFAULT = 0,
+   // pack every material texture into one texture array (see MaterialBatch)
+   // instead of one texture each, Mesh::draw then has nothing to bind
+   MODEL_PACK_TEXTURES = 1 << 0,
+   // build a triangle BVH per mesh for `raycast`, cached next to the model file
+   MODEL_RAYCAST = 1 << 1
+};
+
 unsigned int texture_from_file(
    const char *path,
    const std::string &directory,
@@ -30,18 +43,36 @@ private:
    
    void load_model(std::string path);
    void pprint();
-   void process_node(aiNode *node, const aiScene *scene);
+   void process_node(aiNode *node, const aiScene *scene, int parent);
    Mesh process_mesh(aiMesh *mesh, const aiScene *Scene);
    std::vector<texture> load_material_textures(
       aiMaterial *material,
       aiTextureType type,
       std::string type_name
    );
+   void pack_textures();
+   void build_triangle_bvhs(const std::string &cache_path);
 
 public:
    std::vector<Mesh> meshes;
-   Model(const char *path) {
+   AABB bounds;                  // in model space, node transforms applied
+   TextureArray texture_array;   // only with MODEL_PACK_TEXTURES
+
+   // the imported node hierarchy, mesh i hangs below node mesh_nodes[i]
+   SceneGraph nodes;
+   std::vector<unsigned int> mesh_nodes;
+
+   std::vector<TriangleBVH> triangle_bvhs;   // only with MODEL_RAYCAST, one per mesh
+
+   Model(const char *path, unsigned int flags = MODEL_DEFAULT) {
       load_model(path);
+      nodes.update();
+      for (size_t i = 0; i < meshes.size(); ++i)
+         bounds.expand(meshes[i].bounds.transform(nodes.world[mesh_nodes[i]]));
+      if (flags & MODEL_PACK_TEXTURES)
+         pack_textures();
+      if (flags & MODEL_RAYCAST)
+         build_triangle_bvhs(std::string(path) + ".bvh");
       pprint();
    }
    
@@ -50,7 +81,54 @@ public:
          meshes[i].draw(shader);
       }
    }
-   
+
+   // sets `model` per mesh from its node, the model's nodes were appended to
+   // `scene` at `first_node` (see SceneGraph::append)
+   void draw(Shader shader, const SceneGraph &scene, unsigned int first_node) {
+      shader.use();
+      for (size_t i = 0; i < meshes.size(); ++i) {
+         shader.setmat4("model", scene.world[first_node + mesh_nodes[i]]);
+         meshes[i].draw(shader);
+      }
+   }
+
+   // world space box of every mesh, placed like `draw(shader, scene, first_node)`
+   void mesh_bounds(const SceneGraph &scene, unsigned int first_node,
+                    std::vector<AABB> &out) const {
+      out.resize(meshes.size());
+      for (size_t i = 0; i < meshes.size(); ++i)
+         out[i] = meshes[i].bounds.transform(scene.world[first_node + mesh_nodes[i]]);
+   }
+
+   /* Closest triangle along a world space ray, the model placed like
+    * `draw(shader, scene, first_node)`. Meshes are tested in their own space,
+    * the ray direction is not renormalized there so `hit.t` stays in world
+    * units for a unit `ray.dir`. Needs MODEL_RAYCAST.
+    */
+   bool raycast(const Ray &ray, const SceneGraph &scene, unsigned int first_node,
+                RayHit &hit) const {
+      bool found = false;
+      for (size_t i = 0; i < triangle_bvhs.size(); ++i) {
+         const glm::mat4 &world = scene.world[first_node + mesh_nodes[i]];
+         float t_box;
+         if (!intersect(ray, meshes[i].bounds.transform(world), hit.t, t_box))
+            continue;
+         glm::mat4 inv = glm::inverse(world);
+         Ray local(glm::vec3(inv * glm::vec4(ray.origin, 1.0f)),
+                   glm::vec3(inv * glm::vec4(ray.dir, 0.0f)));
+         if (triangle_bvhs[i].raycast(local, hit.t, hit)) {
+            hit.mesh = i;
+            found = true;
+         }
+      }
+      return found;
+   }
+
+   // in model space, through the model's own node transforms
+   bool raycast(const Ray &ray, RayHit &hit) const {
+      return raycast(ray, nodes, 0, hit);
+   }
+
    std::vector<Mesh>& get_meshes() { return this->meshes; }
 };
 
@@ -74,19 +152,29 @@ void Model::load_model(std::string path) {
    }
    directory = path.substr(0, path.find_last_of('/'));
    
-   process_node(scene->mRootNode, scene);
+   process_node(scene->mRootNode, scene, -1);
 }
 
-void Model::process_node(aiNode *node, const aiScene *scene) {
+void Model::process_node(aiNode *node, const aiScene *scene, int parent) {
+   // assimp matrices are row major
+   const aiMatrix4x4 &m = node->mTransformation;
+   glm::mat4 local;
+   local[0] = glm::vec4(m.a1, m.b1, m.c1, m.d1);
+   local[1] = glm::vec4(m.a2, m.b2, m.c2, m.d2);
+   local[2] = glm::vec4(m.a3, m.b3, m.c3, m.d3);
+   local[3] = glm::vec4(m.a4, m.b4, m.c4, m.d4);
+   unsigned int index = nodes.add_node(parent, local, node->mName.C_Str());
+
    // process all the current node's meshes (if any)
    for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
       aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
       meshes.push_back(process_mesh(mesh, scene));
+      mesh_nodes.push_back(index);
    }
 
    // process all the children of the current node
    for (int i = 0; i < node->mNumChildren; ++i) {
-      process_node(node->mChildren[i], scene);
+      process_node(node->mChildren[i], scene, index);
    }
 }
 
@@ -173,6 +261,7 @@ std::vector<texture> Model::load_material_textures(
          t.id = texture_from_file(str.C_Str(), directory);
          t.type = type_name;
          t.path = str.C_Str();
+         t.layer = -1;
          textures.push_back(t);
          textures_loaded.push_back(t);
       }
@@ -181,6 +270,114 @@ std::vector<texture> Model::load_material_textures(
    return textures;
 }
 
+// one layer per distinct texture, in load order
+void Model::pack_textures() {
+   std::vector<std::string> paths;
+   for (size_t i = 0; i < textures_loaded.size(); ++i) {
+      textures_loaded[i].layer = i;
+      paths.push_back(directory + '/' + textures_loaded[i].path);
+   }
+   texture_array.build(paths);
+
+   for (size_t i = 0; i < meshes.size(); ++i) {
+      std::vector<texture> &textures = meshes[i].textures;
+      for (size_t j = 0; j < textures.size(); ++j) {
+         for (size_t k = 0; k < textures_loaded.size(); ++k) {
+            if (textures[j].path == textures_loaded[k].path) {
+               textures[j].layer = textures_loaded[k].layer;
+               break;
+            }
+         }
+      }
+   }
+   // the array holds them all now, the separate textures would only double the memory
+   for (size_t i = 0; i < textures_loaded.size(); ++i) {
+      glDeleteTextures(1, &textures_loaded[i].id);
+      textures_loaded[i].id = 0;
+   }
+   for (size_t i = 0; i < meshes.size(); ++i)
+      for (size_t j = 0; j < meshes[i].textures.size(); ++j)
+         meshes[i].textures[j].id = 0;
+   std::cout << "Packed " << textures_loaded.size() << " textures into a "
+             << texture_array.width << "x" << texture_array.height << " array"
+             << std::endl;
+}
+
+// the cache holds one tree per mesh, each guarded by a hash of the mesh's
+// vertices and indices, so a changed model file is simply rebuilt
+const unsigned int TRIANGLE_BVH_CACHE_MAGIC = 0x48564254;   // "TBVH"
+const unsigned int TRIANGLE_BVH_CACHE_VERSION = 1;
+
+unsigned int mesh_hash(const Mesh &mesh) {
+   // FNV-1a
+   unsigned int hash = 2166136261u;
+   const unsigned char *bytes[2] = {
+      mesh.vertices.empty() ? NULL : (const unsigned char *)&mesh.vertices[0],
+      mesh.indices.empty() ? NULL : (const unsigned char *)&mesh.indices[0]
+   };
+   size_t sizes[2] = { mesh.vertices.size() * sizeof(vertex), mesh.indices.size() * sizeof(unsigned int) };
+   for (int k = 0; k < 2; ++k) {
+      for (size_t i = 0; i < sizes[k]; ++i) {
+         hash ^= bytes[k][i];
+         hash *= 16777619u;
+      }
+   }
+   return hash;
+}
+
+const float *mesh_positions(const Mesh &mesh) {
+   return mesh.vertices.empty() ? NULL : &mesh.vertices[0].position.x;
+}
+
+const unsigned int *mesh_indices(const Mesh &mesh) {
+   return mesh.indices.empty() ? NULL : &mesh.indices[0];
+}
+
+void Model::build_triangle_bvhs(const std::string &cache_path) {
+   const size_t stride = sizeof(vertex) / sizeof(float);
+   triangle_bvhs.resize(meshes.size());
+
+   std::ifstream in(cache_path.c_str(), std::ios::binary);
+   unsigned int header[3] = { 0, 0, 0 };
+   if (in)
+      in.read((char *)header, sizeof(header));
+   bool cached = in && header[0] == TRIANGLE_BVH_CACHE_MAGIC &&
+                 header[1] == TRIANGLE_BVH_CACHE_VERSION && header[2] == meshes.size();
+   for (size_t i = 0; i < meshes.size() && cached; ++i) {
+      const Mesh &mesh = meshes[i];
+      unsigned int hash = 0;
+      in.read((char *)&hash, sizeof(hash));
+      cached = in && hash == mesh_hash(mesh) &&
+               triangle_bvhs[i].read(in, mesh_positions(mesh), stride,
+                                     mesh_indices(mesh), mesh.indices.size());
+   }
+   in.close();
+   if (cached) {
+      std::cout << "Loaded triangle BVHs from " << cache_path << std::endl;
+      return;
+   }
+
+   std::ofstream out(cache_path.c_str(), std::ios::binary);
+   header[0] = TRIANGLE_BVH_CACHE_MAGIC;
+   header[1] = TRIANGLE_BVH_CACHE_VERSION;
+   header[2] = meshes.size();
+   out.write((const char *)header, sizeof(header));
+   size_t n_triangles = 0;
+   for (size_t i = 0; i < meshes.size(); ++i) {
+      const Mesh &mesh = meshes[i];
+      triangle_bvhs[i].build(mesh_positions(mesh), stride,
+                             mesh_indices(mesh), mesh.indices.size());
+      unsigned int hash = mesh_hash(mesh);
+      out.write((const char *)&hash, sizeof(hash));
+      triangle_bvhs[i].write(out);
+      n_triangles += triangle_bvhs[i].triangle_count();
+   }
+   std::cout << "Built triangle BVHs over " << n_triangles << " triangles";
+   if (!out)
+      std::cout << ", couldn't write the cache " << cache_path;
+   std::cout << std::endl;
+}
+
 unsigned int texture_from_file(
    const char *path,
    const std::string &directory,
@@ -0,0 +1,150 @@
+#ifndef _OIT_HPP_
+#define _OIT_HPP_
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+#include <shader.hpp>
+
+/**************************** WEIGHTED BLENDED OIT ****************************/
+/* Weighted blended order independent transparency (McGuire & Bavoil 2013).
+ * Transparent surfaces are accumulated in any order and resolved in one full
+ * screen pass, there is no sort at all.
+ *
+ * GL 3.3 has no per draw buffer blend functions, so the terms are arranged to
+ * work with a single glBlendFuncSeparate(ONE, ONE, ZERO, ONE_MINUS_SRC_ALPHA):
+ *    accum  (RGBA16F) rgb: sum of premultiplied color * weight  (ONE, ONE)
+ *                     a  : revealage, product of (1 - alpha)    (ZERO, 1 - src alpha)
+ *    weight (R16F)    r  : sum of alpha * weight                (ONE, ONE)
+ * The transparent fragment shader writes
+ *    accum = vec4(color.rgb * color.a * w, color.a), weight = color.a * w
+ *
+ * The opaque scene is rendered into `opaque_fbo` first. The accumulation pass
+ * shares its depth buffer, testing against it without writing, and the
+ * composite pass blends the resolved color over the opaque color.
+ *
+ *    oit.begin_opaque();       ... opaque geometry ...
+ *    oit.begin_transparent();  ... transparent geometry, any order ...
+ *    oit.composite(shader);
+ *    oit.present(0);
+ */
+class WeightedOIT {
+public:
+   int width, height;
+   unsigned int opaque_fbo, accum_fbo;
+   unsigned int color, accum, weight;   // textures
+   unsigned int depth;                  // renderbuffer shared by both framebuffers
+
+   WeightedOIT(int width, int height) : width(width), height(height) {
+      color = make_texture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+      accum = make_texture(GL_RGBA16F, GL_RGBA, GL_FLOAT);
+      weight = make_texture(GL_R16F, GL_RED, GL_FLOAT);
+
+      glGenRenderbuffers(1, &depth);
+      glBindRenderbuffer(GL_RENDERBUFFER, depth);
+      glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+      glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+      glGenFramebuffers(1, &opaque_fbo);
+      glBindFramebuffer(GL_FRAMEBUFFER, opaque_fbo);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+      check("opaque");
+
+      glGenFramebuffers(1, &accum_fbo);
+      glBindFramebuffer(GL_FRAMEBUFFER, accum_fbo);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accum, 0);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, weight, 0);
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+      GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+      glDrawBuffers(2, buffers);
+      check("accumulation");
+
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glGenVertexArrays(1, &vao);
+   }
+
+   // binds and clears the opaque target
+   void begin_opaque() {
+      glBindFramebuffer(GL_FRAMEBUFFER, opaque_fbo);
+      glViewport(0, 0, width, height);
+      glDepthMask(GL_TRUE);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+   }
+
+   // binds the accumulation targets and sets up depth and blend state
+   void begin_transparent() {
+      glBindFramebuffer(GL_FRAMEBUFFER, accum_fbo);
+      glViewport(0, 0, width, height);
+      const GLfloat accum_clear[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+      const GLfloat weight_clear[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+      glClearBufferfv(GL_COLOR, 0, accum_clear);
+      glClearBufferfv(GL_COLOR, 1, weight_clear);
+
+      glEnable(GL_DEPTH_TEST);
+      glDepthMask(GL_FALSE);
+      glDisable(GL_CULL_FACE);
+      glEnable(GL_BLEND);
+      glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+   }
+
+   // resolves the transparent surfaces over the opaque color, restores depth and blend state
+   void composite(Shader &shader) {
+      glBindFramebuffer(GL_FRAMEBUFFER, opaque_fbo);
+      glViewport(0, 0, width, height);
+      glDisable(GL_DEPTH_TEST);
+      glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+      shader.use();
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, accum);
+      glActiveTexture(GL_TEXTURE1);
+      glBindTexture(GL_TEXTURE_2D, weight);
+      shader.seti("accum", 0);
+      shader.seti("weight", 1);
+      glBindVertexArray(vao);
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+      glBindVertexArray(0);
+      glActiveTexture(GL_TEXTURE0);
+
+      glEnable(GL_DEPTH_TEST);
+      glDepthMask(GL_TRUE);
+   }
+
+   // copies the final color to `fbo` (0 for the window)
+   void present(unsigned int fbo, int dst_width = 0, int dst_height = 0) {
+      if (dst_width == 0) {
+         dst_width = width;
+         dst_height = height;
+      }
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, opaque_fbo);
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+      glBlitFramebuffer(0, 0, width, height, 0, 0, dst_width, dst_height,
+                        GL_COLOR_BUFFER_BIT, GL_LINEAR);
+      glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+   }
+
+private:
+   unsigned int vao;   // empty, the composite pass draws a full screen triangle
+
+   unsigned int make_texture(GLint internal_format, GLenum format, GLenum type) {
+      unsigned int tex;
+      glGenTextures(1, &tex);
+      glBindTexture(GL_TEXTURE_2D, tex);
+      glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, type, NULL);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glBindTexture(GL_TEXTURE_2D, 0);
+      return tex;
+   }
+
+   void check(const char *name) {
+      if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+         std::cerr << "ERROR: " << name << " framebuffer not complete." << std::endl;
+   }
+};
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef _OUTLINE_HPP_
+#define _OUTLINE_HPP_
+
+#include <glad/glad.h>
+
+#include <glm/glm/glm.hpp>
+
+#include <string>
+#include <iostream>
+
+#include <shader.hpp>
+
+/**************************** SELECTION OUTLINE ****************************/
+/* Outlines selected objects in screen space. The scene is drawn into
+ *    scene (RGBA8)            color
+ *    ids   (R16UI)            selection id, 0 for anything not selected
+ *    depth (DEPTH24_STENCIL8 renderbuffer)
+ * with the selected objects writing their id next to their color
+ * (02_outline_id.fs). `present` then draws the scene into another framebuffer
+ * in one full screen pass (02_outline.fs) that paints a pixel with the outline
+ * color when an id other than its own is within `radius` pixels of it.
+ *
+ * Unlike drawing every selected object a second time, scaled up and stencil
+ * tested, nothing is drawn twice: the cost is the id write in the main pass
+ * plus one pass of (2 * radius + 1)^2 fetches per pixel, however many objects
+ * are selected. Neighbouring selected objects keep distinct outlines as long
+ * as their ids differ.
+ *
+ *    outline.resize(width, height);
+ *    outline.begin();
+ *    ... scene, SelectionOutline::set_id(shader, selected ? id : 0) per object ...
+ *    outline.present(0);
+ */
+class SelectionOutline {
+public:
+   int width, height;
+   glm::vec3 color;
+   int radius;                    // outline width in pixels
+   bool enabled;
+   unsigned int fbo, scene, ids, depth;
+
+   SelectionOutline(const std::string &shader_dir, int width, int height)
+      : width(0), height(0), color(1.0f, 0.6f, 0.1f), radius(3), enabled(true),
+        fbo(0), scene(0), ids(0), depth(0),
+        shader((shader_dir + "05_post.vs").c_str(), (shader_dir + "02_outline.fs").c_str()) {
+      shader.use();
+      shader.seti("scene", 0);
+      shader.seti("ids", 1);
+      glUseProgram(0);
+      glGenVertexArrays(1, &vao);
+      resize(width, height);
+   }
+
+   ~SelectionOutline() {
+      release_targets();
+      glDeleteVertexArrays(1, &vao);
+   }
+
+   // reallocates the targets when the size changed
+   void resize(int w, int h) {
+      if (w == width && h == height)
+         return;
+      release_targets();
+      width = w;
+      height = h;
+
+      scene = make_texture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+      ids = make_texture(GL_R16UI, GL_RED_INTEGER, GL_UNSIGNED_SHORT);
+      glGenRenderbuffers(1, &depth);
+      glBindRenderbuffer(GL_RENDERBUFFER, depth);
+      glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+      glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+      glGenFramebuffers(1, &fbo);
+      glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, scene, 0);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, ids, 0);
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+      GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+      glDrawBuffers(2, buffers);
+      if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+         std::cerr << "ERROR: outline framebuffer not complete." << std::endl;
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+   }
+
+   // binds the targets and clears color to `clear`, ids to 0
+   void begin(const glm::vec4 &clear = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)) {
+      glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+      glViewport(0, 0, width, height);
+      const GLfloat color_clear[] = { clear.x, clear.y, clear.z, clear.w };
+      const GLuint id_clear[] = { 0, 0, 0, 0 };
+      glClearBufferfv(GL_COLOR, 0, color_clear);
+      glClearBufferuiv(GL_COLOR, 1, id_clear);
+      glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+   }
+
+   // `object_id` of the scene shader, 0 for objects that aren't selected
+   static void set_id(Shader &shader, unsigned int id) {
+      glUniform1ui(glGetUniformLocation(shader.id(), "object_id"), id);
+   }
+
+   // the outlined scene into `target`, same size
+   void present(unsigned int target) {
+      glBindFramebuffer(GL_FRAMEBUFFER, target);
+      glViewport(0, 0, width, height);
+      GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+      glDisable(GL_DEPTH_TEST);
+      shader.use();
+      shader.setvec3("outline_color", color);
+      shader.seti("radius", enabled ? radius : 0);
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, scene);
+      glActiveTexture(GL_TEXTURE1);
+      glBindTexture(GL_TEXTURE_2D, ids);
+      glBindVertexArray(vao);
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+      glBindVertexArray(0);
+      glActiveTexture(GL_TEXTURE0);
+      if (depth_test)
+         glEnable(GL_DEPTH_TEST);
+   }
+
+private:
+   Shader shader;
+   unsigned int vao;
+
+   SelectionOutline(const SelectionOutline &);
+   SelectionOutline &operator=(const SelectionOutline &);
+
+   unsigned int make_texture(GLint internal_format, GLenum format, GLenum type) {
+      unsigned int tex;
+      glGenTextures(1, &tex);
+      glBindTexture(GL_TEXTURE_2D, tex);
+      glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, type, NULL);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glBindTexture(GL_TEXTURE_2D, 0);
+      return tex;
+   }
+
+   void release_targets() {
+      if (!fbo)
+         return;
+      glDeleteFramebuffers(1, &fbo);
+      glDeleteTextures(1, &scene);
+      glDeleteTextures(1, &ids);
+      glDeleteRenderbuffers(1, &depth);
+      fbo = scene = ids = depth = 0;
+   }
+};
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef _POST_PROCESS_HPP_
+#define _POST_PROCESS_HPP_
+
+#include <glad/glad.h>
+
+#include <glm/glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+#include <shader.hpp>
+#include <render_target_pool.hpp>
+
+/**************************** POST PROCESSING CHAIN ****************************/
+/* Full screen effects applied in order to a scene texture:
+ *    POST_BLUR       separable gaussian, `param` is the radius in pixels
+ *    POST_SHARPEN    3x3 sharpen kernel, `param` is the strength
+ *    POST_EDGE       3x3 laplacian edge detection
+ *    POST_GRAYSCALE  luminance, `param` blends from color (0) to gray (1)
+ *    POST_FXAA       antialiasing by edge detection on the final colors (05_fxaa.fs),
+ *                    one full screen pass instead of rendering extra samples
+ *
+ * Every pass runs at `scale` times the source size (a half resolution blur is
+ * a quarter of the work and looks the same). Intermediate targets come from a
+ * RenderTargetPool and go back to it as soon as the next pass has read them,
+ * so a chain of any length needs two targets at each resolution. The last
+ * enabled pass draws straight into the destination framebuffer, upscaling
+ * with bilinear filtering, so there's no final copy.
+ *
+ * The blur takes a 2R+1 tap gaussian as two 1D passes (2 * (2R+1) taps instead
+ * of (2R+1)^2) and reads pairs of taps with one bilinear fetch in between the
+ * two texels, weighted by their sum, so each pass is R+1 fetches.
+ *
+ *    PostChain post("../shaders/04.advanced/");
+ *    post.add(POST_BLUR, 0.5f, 4.0f);
+ *    post.add(POST_GRAYSCALE, 1.0f, 1.0f);
+ *    post.run(pool, scene->texture, width, height, 0, width, height);
+ */
+enum PostEffect {
+   POST_BLUR,
+   POST_SHARPEN,
+   POST_EDGE,
+   POST_GRAYSCALE,
+   POST_FXAA
+};
+
+struct PostPass {
+   PostEffect effect;
+   float scale;      // resolution relative to the source
+   float param;
+   bool enabled;
+};
+
+class PostChain {
+public:
+   static const int MAX_BLUR_TAPS = 16;   // bilinear taps on one side, radius up to 31
+
+   std::vector<PostPass> passes;
+   GLenum format;                         // of the intermediate targets
+
+   PostChain(const std::string &shader_dir, GLenum format = GL_RGBA8)
+      : format(format),
+        blur((shader_dir + "05_post.vs").c_str(), (shader_dir + "05_blur.fs").c_str()),
+        kernel((shader_dir + "05_post.vs").c_str(), (shader_dir + "05_screen.fs").c_str()),
+        grayscale((shader_dir + "05_post.vs").c_str(), (shader_dir + "05_grayscale.fs").c_str()),
+        fxaa((shader_dir + "05_post.vs").c_str(), (shader_dir + "05_fxaa.fs").c_str()) {
+      blur.use();
+      blur.seti("texture_sampler", 0);
+      kernel.use();
+      kernel.seti("texture_sampler", 0);
+      grayscale.use();
+      grayscale.seti("texture_sampler", 0);
+      fxaa.use();
+      fxaa.seti("texture_sampler", 0);
+      glUseProgram(0);
+      // the passes take their vertices from gl_VertexID
+      glGenVertexArrays(1, &vao);
+   }
+
+   ~PostChain() {
+      glDeleteVertexArrays(1, &vao);
+   }
+
+   // returns the index of the new pass
+   size_t add(PostEffect effect, float scale = 1.0f, float param = 1.0f) {
+      PostPass pass = { effect, scale, param, true };
+      passes.push_back(pass);
+      return passes.size() - 1;
+   }
+
+   /* Runs the enabled passes on `source` (`width` x `height`) and writes the
+    * result to framebuffer `dst` (0 for the window) of size `dst_width` x
+    * `dst_height`. With no pass enabled the source is just copied over.
+    */
+   void run(RenderTargetPool &pool, unsigned int source, int width, int height,
+            unsigned int dst, int dst_width, int dst_height) {
+      int last = -1;
+      for (size_t i = 0; i < passes.size(); ++i)
+         if (passes[i].enabled)
+            last = i;
+
+      GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+      GLboolean blend = glIsEnabled(GL_BLEND);
+      glDisable(GL_DEPTH_TEST);
+      glDisable(GL_BLEND);
+      glBindVertexArray(vao);
+      glActiveTexture(GL_TEXTURE0);
+
+      if (last < 0) {
+         // nothing enabled, a grayscale of 0 is a plain copy
+         begin_output(NULL, dst, dst_width, dst_height);
+         grayscale.use();
+         grayscale.setf("amount", 0.0f);
+         glBindTexture(GL_TEXTURE_2D, source);
+         glDrawArrays(GL_TRIANGLES, 0, 3);
+      } else {
+         // `current` is the input of the next pass, `owned` the pooled target holding it (if any)
+         unsigned int current = source;
+         RenderTarget *owned = NULL;
+         for (int i = 0; i <= last; ++i) {
+            const PostPass &pass = passes[i];
+            if (!pass.enabled)
+               continue;
+            int w = std::max(1, (int)(width * pass.scale));
+            int h = std::max(1, (int)(height * pass.scale));
+            RenderTarget *out = i == last ? NULL : pool.acquire(w, h, format);
+
+            if (pass.effect == POST_BLUR) {
+               // horizontal into a pooled target at the pass resolution, vertical into the output
+               RenderTarget *tmp = pool.acquire(w, h, format);
+               blur_pass(current, *tmp, glm::vec2(1.0f / w, 0.0f), pass.param);
+               if (owned)
+                  pool.release(owned);
+               owned = tmp;
+               current = tmp->texture;
+               begin_output(out, dst, dst_width, dst_height);
+               blur.use();
+               set_blur_taps(glm::vec2(0.0f, 1.0f / h), pass.param);
+            } else {
+               begin_output(out, dst, dst_width, dst_height);
+               setup_pass(pass);
+            }
+            glBindTexture(GL_TEXTURE_2D, current);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+
+            if (owned)
+               pool.release(owned);
+            owned = out;
+            current = out ? out->texture : 0;
+         }
+      }
+
+      glBindVertexArray(0);
+      glBindTexture(GL_TEXTURE_2D, 0);
+      glBindFramebuffer(GL_FRAMEBUFFER, dst);
+      glViewport(0, 0, dst_width, dst_height);
+      if (depth_test)
+         glEnable(GL_DEPTH_TEST);
+      if (blend)
+         glEnable(GL_BLEND);
+   }
+
+private:
+   Shader blur, kernel, grayscale, fxaa;
+   unsigned int vao;
+
+   void begin_output(RenderTarget *out, unsigned int dst, int dst_width, int dst_height) {
+      if (out) {
+         out->bind();
+      } else {
+         glBindFramebuffer(GL_FRAMEBUFFER, dst);
+         glViewport(0, 0, dst_width, dst_height);
+      }
+   }
+
+   void blur_pass(unsigned int source, const RenderTarget &out, const glm::vec2 &step, float radius) {
+      out.bind();
+      blur.use();
+      set_blur_taps(step, radius);
+      glBindTexture(GL_TEXTURE_2D, source);
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+   }
+
+   // gaussian with sigma = radius / 3, pairs of texels folded into one bilinear tap
+   void set_blur_taps(const glm::vec2 &step, float radius) {
+      int r = std::max(1, std::min((int)(radius + 0.5f), 2 * MAX_BLUR_TAPS - 1));
+      float sigma = std::max(r / 3.0f, 0.5f);
+      float w[2 * MAX_BLUR_TAPS + 1];
+      float sum = 0.0f;
+      for (int i = 0; i <= r; ++i) {
+         w[i] = expf(-0.5f * i * i / (sigma * sigma));
+         sum += i == 0 ? w[i] : 2.0f * w[i];
+      }
+      w[r + 1] = 0.0f;
+
+      float weights[MAX_BLUR_TAPS + 1], offsets[MAX_BLUR_TAPS + 1];
+      weights[0] = w[0] / sum;
+      offsets[0] = 0.0f;
+      int n = 1;
+      for (int i = 1; i <= r; i += 2, ++n) {
+         float pair = w[i] + w[i + 1];
+         weights[n] = pair / sum;
+         offsets[n] = (i * w[i] + (i + 1) * w[i + 1]) / pair;
+      }
+      blur.seti("n_taps", n);
+      blur.setvec2("step", step);
+      glUniform1fv(glGetUniformLocation(blur.id(), "weights"), n, weights);
+      glUniform1fv(glGetUniformLocation(blur.id(), "offsets"), n, offsets);
+   }
+
+   void setup_pass(const PostPass &pass) {
+      if (pass.effect == POST_GRAYSCALE) {
+         grayscale.use();
+         grayscale.setf("amount", pass.param);
+         return;
+      }
+      if (pass.effect == POST_FXAA) {
+         fxaa.use();
+         return;
+      }
+      float s = pass.param;
+      float sharpen[9] = {
+           0.0f,         -s,  0.0f,
+             -s, 1.0f + 4*s,    -s,
+           0.0f,         -s,  0.0f
+      };
+      float edge[9] = {
+           1.0f,  1.0f,  1.0f,
+           1.0f, -8.0f,  1.0f,
+           1.0f,  1.0f,  1.0f
+      };
+      kernel.use();
+      glUniform1fv(glGetUniformLocation(kernel.id(), "kernel"), 9,
+                   pass.effect == POST_SHARPEN ? sharpen : edge);
+   }
+};
+
+#endif
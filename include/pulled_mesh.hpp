@@ -0,0 +1,182 @@
+#ifndef _PULLED_MESH_HPP_
+#define _PULLED_MESH_HPP_
+
+#include <glad/glad.h>
+
+#include <glm/glm/glm.hpp>
+
+#include <vector>
+
+#include <shader.hpp>
+#include <mesh.hpp>
+#include <model.hpp>
+
+/**************************** PULLED MESH ****************************/
+/* A Mesh's data in texture buffers, for vertex shaders that fetch what they
+ * need by gl_VertexID / gl_InstanceID instead of getting it through
+ * attributes ("vertex pulling"). This replaces geometry shaders that only
+ * exist to see a whole triangle or to emit a fixed handful of vertices, which
+ * many drivers run slowly (software ones especially):
+ *
+ *  - per triangle effects draw `3 * n_triangles` vertices without indices,
+ *    vertex v is corner v % 3 of triangle v / 3 (draw_triangles)
+ *  - one line segment per vertex or per face is an instanced GL_LINES draw of
+ *    2 vertices, gl_InstanceID picks the vertex or face and gl_VertexID the
+ *    end of the segment (draw_vertex_lines, draw_face_lines)
+ *
+ * Buffers, bound to consecutive units from `unit` by `bind`:
+ *    samplerBuffer  vertices   2 texels per vertex: (position, tex.x), (normal, tex.y)
+ *    usamplerBuffer indices    one per corner
+ *    samplerBuffer  faces      one per triangle: (normal, 0), object space
+ *
+ *    PulledMesh pulled(mesh);
+ *    pulled.bind(1);
+ *    shader.seti("vertices", 1); shader.seti("indices", 2); shader.seti("faces", 3);
+ *    pulled.draw_triangles();
+ */
+class PulledMesh {
+public:
+   unsigned int n_vertices, n_triangles;
+
+   PulledMesh(const Mesh &mesh)
+      : n_vertices(mesh.vertices.size()), n_triangles(mesh.indices.size() / 3) {
+      std::vector<glm::vec4> vertices(2 * n_vertices);
+      for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+         const vertex &v = mesh.vertices[i];
+         vertices[2 * i] = glm::vec4(v.position, v.tex_pos.x);
+         vertices[2 * i + 1] = glm::vec4(v.normal, v.tex_pos.y);
+      }
+      std::vector<glm::vec4> faces(n_triangles);
+      for (size_t t = 0; t < n_triangles; ++t) {
+         glm::vec3 a = mesh.vertices[mesh.indices[3 * t]].position;
+         glm::vec3 b = mesh.vertices[mesh.indices[3 * t + 1]].position;
+         glm::vec3 c = mesh.vertices[mesh.indices[3 * t + 2]].position;
+         glm::vec3 n = glm::cross(b - a, c - a);
+         float length = glm::length(n);
+         faces[t] = glm::vec4(length > 0.0f ? n / length : glm::vec3(0.0f), 0.0f);
+      }
+
+      glGenBuffers(3, buffers);
+      glGenTextures(3, textures);
+      upload(0, GL_RGBA32F, vertices.size() * sizeof(glm::vec4), vertices.empty() ? NULL : &vertices[0]);
+      upload(1, GL_R32UI, mesh.indices.size() * sizeof(unsigned int),
+             mesh.indices.empty() ? NULL : &mesh.indices[0]);
+      upload(2, GL_RGBA32F, faces.size() * sizeof(glm::vec4), faces.empty() ? NULL : &faces[0]);
+      // the draws take nothing from attributes, but core profile needs a VAO bound
+      glGenVertexArrays(1, &vao);
+   }
+
+   ~PulledMesh() {
+      glDeleteTextures(3, textures);
+      glDeleteBuffers(3, buffers);
+      glDeleteVertexArrays(1, &vao);
+   }
+
+   // vertices, indices and faces on units `unit`, `unit + 1` and `unit + 2`
+   void bind(int unit) const {
+      for (int i = 0; i < 3; ++i) {
+         glActiveTexture(GL_TEXTURE0 + unit + i);
+         glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+      }
+      glActiveTexture(GL_TEXTURE0);
+   }
+
+   void draw_triangles() const {
+      glBindVertexArray(vao);
+      glDrawArrays(GL_TRIANGLES, 0, 3 * n_triangles);
+      glBindVertexArray(0);
+   }
+
+   void draw_vertex_lines() const {
+      glBindVertexArray(vao);
+      glDrawArraysInstanced(GL_LINES, 0, 2, n_vertices);
+      glBindVertexArray(0);
+   }
+
+   void draw_face_lines() const {
+      glBindVertexArray(vao);
+      glDrawArraysInstanced(GL_LINES, 0, 2, n_triangles);
+      glBindVertexArray(0);
+   }
+
+private:
+   unsigned int buffers[3], textures[3];
+   unsigned int vao;
+
+   PulledMesh(const PulledMesh &);
+   PulledMesh &operator=(const PulledMesh &);
+
+   void upload(int i, GLenum format, size_t bytes, const void *data) {
+      glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+      glBufferData(GL_TEXTURE_BUFFER, bytes, data, GL_STATIC_DRAW);
+      glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+      glTexBuffer(GL_TEXTURE_BUFFER, format, buffers[i]);
+      glBindTexture(GL_TEXTURE_BUFFER, 0);
+      glBindBuffer(GL_TEXTURE_BUFFER, 0);
+   }
+};
+
+/**************************** PULLED MODEL ****************************/
+/* PulledMesh for every mesh of a Model. The draws bind the first diffuse
+ * texture of each mesh to unit 0 (`texture_diffuse`) and its buffers to units
+ * 1 - 3 (`vertices`, `indices`, `faces`), the other uniforms are the caller's.
+ */
+class PulledModel {
+public:
+   PulledModel(const Model &model) {
+      for (size_t i = 0; i < model.meshes.size(); ++i) {
+         meshes.push_back(new PulledMesh(model.meshes[i]));
+         diffuse.push_back(0);
+         const std::vector<texture> &textures = model.meshes[i].textures;
+         for (size_t t = 0; t < textures.size() && !diffuse.back(); ++t)
+            if (textures[t].type == "texture_diffuse")
+               diffuse.back() = textures[t].id;
+      }
+   }
+
+   ~PulledModel() {
+      for (size_t i = 0; i < meshes.size(); ++i)
+         delete meshes[i];
+   }
+
+   void draw_triangles(Shader &shader) const {
+      for (size_t i = 0; i < meshes.size(); ++i) {
+         bind(shader, i);
+         meshes[i]->draw_triangles();
+      }
+   }
+
+   void draw_vertex_lines(Shader &shader) const {
+      for (size_t i = 0; i < meshes.size(); ++i) {
+         bind(shader, i);
+         meshes[i]->draw_vertex_lines();
+      }
+   }
+
+   void draw_face_lines(Shader &shader) const {
+      for (size_t i = 0; i < meshes.size(); ++i) {
+         bind(shader, i);
+         meshes[i]->draw_face_lines();
+      }
+   }
+
+private:
+   std::vector<PulledMesh *> meshes;
+   std::vector<unsigned int> diffuse;
+
+   PulledModel(const PulledModel &);
+   PulledModel &operator=(const PulledModel &);
+
+   void bind(Shader &shader, size_t i) const {
+      shader.use();
+      shader.seti("texture_diffuse", 0);
+      shader.seti("vertices", 1);
+      shader.seti("indices", 2);
+      shader.seti("faces", 3);
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, diffuse[i]);
+      meshes[i]->bind(1);
+   }
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef _QUERY_RING_HPP_
+#define _QUERY_RING_HPP_
+
+#include <glad/glad.h>
+
+/**************************** QUERY RING ****************************/
+/* A small ring of `target` queries (GL_TIME_ELAPSED, GL_SAMPLES_PASSED, ...)
+ * so reading a result never waits for the GPU: `result` hands back the oldest
+ * finished one, a few frames old, or returns false. Queries of one target
+ * can't nest, only one ring per target may be running at a time.
+ *
+ *    QueryRing<GL_SAMPLES_PASSED> ring;
+ *    ring.begin();
+ *    ... draw ...
+ *    ring.end();
+ *    GLuint64 samples;
+ *    if (ring.result(samples)) ...
+ */
+template <GLenum target>
+class QueryRing {
+public:
+   QueryRing() : head(0), tail(0) {
+      glGenQueries(RING, queries);
+   }
+
+   ~QueryRing() {
+      glDeleteQueries(RING, queries);
+   }
+
+   void begin() {
+      // ring full: the oldest result is dropped rather than waited for
+      if (head - tail == RING)
+         tail++;
+      glBeginQuery(target, queries[head % RING]);
+   }
+
+   void end() {
+      glEndQuery(target);
+      head++;
+   }
+
+   bool result(GLuint64 &value) {
+      if (tail == head)
+         return false;
+      unsigned int query = queries[tail % RING];
+      GLint available = 0;
+      glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available)
+         return false;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &value);
+      tail++;
+      return true;
+   }
+
+private:
+   static const unsigned int RING = 4;
+
+   unsigned int queries[RING];
+   unsigned int head, tail;
+
+   QueryRing(const QueryRing &);
+   QueryRing &operator=(const QueryRing &);
+};
+
+#endif
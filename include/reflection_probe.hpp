@@ -0,0 +1,223 @@
+#ifndef _REFLECTION_PROBE_HPP_
+#define _REFLECTION_PROBE_HPP_
+
+#include <glad/glad.h>
+
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <algorithm>
+
+#include <gpu_timer.hpp>
+
+/**************************** REFLECTION PROBE ****************************/
+/* A cube map of the scene seen from `position`, for reflections of things
+ * that move. Color is sRGB so shaders read it back in linear space. Both color
+ * and depth are attached layered: one draw reaches all six faces through
+ * gl_Layer.
+ *
+ * The mips come from glGenerateMipmap, a box filter, not the GGX prefilter of
+ * EnvironmentMap::specular. Read at `roughness * max_lod` they only blur with
+ * roughness roughly: the blur is square, it doesn't cross face edges the way a
+ * lobe does and bright spots spread less than they should. Good enough for
+ * things moving past, not a match for the static environment's reflections.
+ */
+struct ReflectionProbe {
+   glm::vec3 position;
+   unsigned int cubemap, depth, fbo;
+   int fresh;                    // faces updated in the current cycle
+   unsigned int n_cycles;        // times all six faces were updated
+
+   bool complete() const { return n_cycles > 0; }
+};
+
+/**************************** PROBE SET ****************************/
+/* Keeps a set of probes up to date a few faces at a time. Every frame
+ * `update` renders the next `faces_per_frame` faces, round robin over all
+ * probes, so a probe is refreshed every 6 * n_probes / faces_per_frame frames
+ * instead of costing six scene renders each frame.
+ *
+ * The faces of one probe due in a frame are rendered by a single call of the
+ * render function with a bit mask of them. The render function draws the
+ * scene once through a geometry shader (06_probe.gs) that sends each triangle
+ * to the faces in the mask it can be seen from, setting gl_Layer.
+ *
+ * With `adapt` on, faces_per_frame follows the GPU time of the updates: the
+ * cost of a face is averaged over the timer results and as many faces as fit
+ * in `budget_ms` are rendered, at least one.
+ *
+ *    probes.add(glm::vec3(0.0f));
+ *    probes.update([&](size_t probe, const glm::mat4 faces[6], int face_mask) {
+ *       glUniformMatrix4fv(..."face_matrices", 6, ...);  shader.seti("face_mask", face_mask);
+ *       ... draw the scene without the object the probe belongs to ...
+ *    });
+ *    ... bind probes.probes[i].cubemap to the reflective object's sampler ...
+ */
+class ProbeSet {
+public:
+   typedef std::function<void(size_t probe, const glm::mat4 faces[6], int face_mask)> render_fn;
+
+   int size;
+   float near_plane, far_plane;
+   float budget_ms;
+   bool adapt;
+   int faces_per_frame;
+   std::vector<ReflectionProbe> probes;
+
+   // stats
+   double last_ms;                // GPU time of the last measured update
+   double face_ms;                // average GPU time of one face
+   unsigned int n_faces;          // faces rendered by the last update
+
+   ProbeSet(int size = 128, float budget_ms = 1.0f, float near_plane = 0.1f, float far_plane = 100.0f)
+      : size(size), near_plane(near_plane), far_plane(far_plane), budget_ms(budget_ms), adapt(true),
+        faces_per_frame(1), last_ms(0.0), face_ms(0.0), n_faces(0), cursor(0), n_results(0) {}
+
+   ~ProbeSet() {
+      release();
+   }
+
+   size_t add(const glm::vec3 &position) {
+      ReflectionProbe p;
+      p.position = position;
+      p.fresh = 0;
+      p.n_cycles = 0;
+
+      glGenTextures(1, &p.cubemap);
+      glBindTexture(GL_TEXTURE_CUBE_MAP, p.cubemap);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      for (int i = 0; i < 6; ++i)
+         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_SRGB8_ALPHA8, size, size, 0,
+                      GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+      glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+      glGenTextures(1, &p.depth);
+      glBindTexture(GL_TEXTURE_CUBE_MAP, p.depth);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      for (int i = 0; i < 6; ++i)
+         glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT24, size, size, 0,
+                      GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+      glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+      glGenFramebuffers(1, &p.fbo);
+      glBindFramebuffer(GL_FRAMEBUFFER, p.fbo);
+      glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, p.cubemap, 0);
+      glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, p.depth, 0);
+      if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+         std::cerr << "ERROR: reflection probe framebuffer not complete." << std::endl;
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+      probes.push_back(p);
+      return probes.size() - 1;
+   }
+
+   // view projection of each face, in GL face order (+X -X +Y -Y +Z -Z)
+   void face_matrices(const glm::vec3 &eye, glm::mat4 faces[6]) const {
+      static const glm::vec3 dirs[6] = {
+         glm::vec3( 1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+         glm::vec3( 0.0f, 1.0f, 0.0f), glm::vec3( 0.0f,-1.0f, 0.0f),
+         glm::vec3( 0.0f, 0.0f, 1.0f), glm::vec3( 0.0f, 0.0f,-1.0f)
+      };
+      static const glm::vec3 ups[6] = {
+         glm::vec3(0.0f,-1.0f, 0.0f), glm::vec3(0.0f,-1.0f, 0.0f),
+         glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f,-1.0f),
+         glm::vec3(0.0f,-1.0f, 0.0f), glm::vec3(0.0f,-1.0f, 0.0f)
+      };
+      glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, near_plane, far_plane);
+      for (int i = 0; i < 6; ++i)
+         faces[i] = projection * glm::lookAt(eye, eye + dirs[i], ups[i]);
+   }
+
+   /* Renders the faces due this frame and rebuilds the (box filtered) mips of
+    * the probes they belong to. Restores the framebuffer and viewport.
+    */
+   void update(const render_fn &render) {
+      if (probes.empty())
+         return;
+      read_timer();
+      int total = 6 * probes.size();
+      int n = std::max(1, std::min(faces_per_frame, total));
+      std::vector<int> masks(probes.size(), 0);
+      for (int i = 0; i < n; ++i) {
+         int slot = (cursor + i) % total;
+         masks[slot / 6] |= 1 << (slot % 6);
+      }
+      cursor = (cursor + n) % total;
+
+      GLint fbo, viewport[4];
+      glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fbo);
+      glGetIntegerv(GL_VIEWPORT, viewport);
+
+      // the timer drops its oldest query when it has too many in flight, so do we
+      if (pending.size() == PENDING)
+         pending.pop_front();
+      timer.begin();
+      for (size_t p = 0; p < probes.size(); ++p) {
+         if (!masks[p])
+            continue;
+         ReflectionProbe &probe = probes[p];
+         glBindFramebuffer(GL_FRAMEBUFFER, probe.fbo);
+         glViewport(0, 0, size, size);
+         glm::mat4 faces[6];
+         face_matrices(probe.position, faces);
+         render(p, faces, masks[p]);
+
+         glBindTexture(GL_TEXTURE_CUBE_MAP, probe.cubemap);
+         glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+         probe.fresh |= masks[p];
+         if (probe.fresh == 0x3f) {
+            probe.fresh = 0;
+            probe.n_cycles++;
+         }
+      }
+      timer.end();
+      pending.push_back(n);
+      n_faces = n;
+
+      glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+      glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+      glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+   }
+
+   // deletes the probes' textures and framebuffers (call before the context goes away)
+   void release() {
+      for (size_t i = 0; i < probes.size(); ++i) {
+         glDeleteFramebuffers(1, &probes[i].fbo);
+         glDeleteTextures(1, &probes[i].cubemap);
+         glDeleteTextures(1, &probes[i].depth);
+      }
+      probes.clear();
+   }
+
+private:
+   static const size_t PENDING = 4;      // GpuTimer's ring
+
+   GpuTimer timer;
+   std::deque<int> pending;               // faces of each update still being timed
+   int cursor;                            // next face, probe * 6 + face
+   unsigned int n_results;
+
+   void read_timer() {
+      double ms;
+      while (!pending.empty() && timer.result(ms)) {
+         double per_face = ms / pending.front();
+         pending.pop_front();
+         face_ms = n_results++ ? face_ms + (per_face - face_ms) * 0.1 : per_face;
+         last_ms = ms;
+      }
+      if (adapt && n_results)
+         faces_per_frame = std::max(1, std::min((int)(budget_ms / std::max(face_ms, 1e-3)),
+                                                6 * (int)probes.size()));
+   }
+};
+
+#endif
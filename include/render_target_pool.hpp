@@ -0,0 +1,230 @@
+#ifndef _RENDER_TARGET_POOL_HPP_
+#define _RENDER_TARGET_POOL_HPP_
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+/**************************** RENDER TARGET ****************************/
+/* A color texture (linear filtering, clamped) in its own framebuffer, with an
+ * optional depth/stencil renderbuffer.
+ *
+ * Multisampled targets (`samples` > 0) keep color in a multisampled
+ * renderbuffer instead: they can't be sampled, only drawn to and resolved into
+ * a single sample target with `resolve`.
+ */
+struct RenderTarget {
+   int width, height;
+   GLenum format;                // internal format of the color texture
+   bool depth;                   // has a DEPTH24_STENCIL8 renderbuffer
+   int samples;                  // 0 for a plain texture
+   unsigned int fbo, texture, color_rb, depth_rb;
+
+   // binds the framebuffer and sets the viewport to the whole target
+   void bind() const {
+      glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+      glViewport(0, 0, width, height);
+   }
+
+   // averages the samples into `dst` (same size), leaves `dst` bound
+   void resolve(const RenderTarget &dst) const {
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dst.fbo);
+      glBlitFramebuffer(0, 0, width, height, 0, 0, dst.width, dst.height,
+                        GL_COLOR_BUFFER_BIT, GL_NEAREST);
+      dst.bind();
+   }
+};
+
+/**************************** RENDER TARGET POOL ****************************/
+/* Hands out render targets keyed by size, format, depth and samples. A released target
+ * goes back to the pool and is handed out again for the next request with the
+ * same key, in the same frame or a later one, so passes that run one after the
+ * other share memory instead of each owning a full screen texture.
+ *
+ * Targets nobody asked for in `max_idle` frames are deleted in `end_frame`,
+ * which is also what cleans up the old sizes after the window is resized:
+ *
+ *    RenderTarget *scene = pool.acquire(width, height, GL_RGBA8, true);
+ *    ... draw into scene, read it ...
+ *    pool.release(scene);
+ *    pool.end_frame();
+ */
+class RenderTargetPool {
+public:
+   // per frame counter
+   unsigned int n_created;
+
+   RenderTargetPool(unsigned int max_idle = 2) : n_created(0), max_idle(max_idle), frame(0) {}
+
+   ~RenderTargetPool() {
+      clear();
+   }
+
+   RenderTarget *acquire(int width, int height, GLenum format, bool depth = false, int samples = 0) {
+      for (size_t i = 0; i < entries.size(); ++i) {
+         Entry &e = entries[i];
+         if (!e.in_use && e.target->width == width && e.target->height == height &&
+             e.target->format == format && e.target->depth == depth && e.target->samples == samples) {
+            e.in_use = true;
+            e.last_used = frame;
+            return e.target;
+         }
+      }
+      Entry e;
+      e.target = create(width, height, format, depth, samples);
+      e.in_use = true;
+      e.last_used = frame;
+      entries.push_back(e);
+      n_created++;
+      return e.target;
+   }
+
+   void release(RenderTarget *target) {
+      for (size_t i = 0; i < entries.size(); ++i) {
+         if (entries[i].target == target) {
+            entries[i].in_use = false;
+            entries[i].last_used = frame;
+            return;
+         }
+      }
+      std::cerr << "ERROR: released a render target the pool doesn't own." << std::endl;
+   }
+
+   // deletes the targets left idle for too long
+   void end_frame() {
+      for (size_t i = 0; i < entries.size(); ) {
+         if (!entries[i].in_use && frame - entries[i].last_used >= max_idle) {
+            destroy(entries[i].target);
+            entries[i] = entries.back();
+            entries.pop_back();
+         } else {
+            ++i;
+         }
+      }
+      frame++;
+      n_created = 0;
+   }
+
+   // deletes every target, none may be in use (call before the context goes away)
+   void clear() {
+      for (size_t i = 0; i < entries.size(); ++i)
+         destroy(entries[i].target);
+      entries.clear();
+   }
+
+   size_t size() const { return entries.size(); }
+
+   // video memory held by the pool, free targets included
+   size_t bytes() const {
+      size_t total = 0;
+      for (size_t i = 0; i < entries.size(); ++i) {
+         const RenderTarget *t = entries[i].target;
+         size_t texels = (size_t)t->width * t->height * std::max(1, t->samples);
+         total += texels * bytes_per_texel(t->format);
+         if (t->depth)
+            total += texels * 4;
+      }
+      return total;
+   }
+
+   // external format and type to allocate `format` with
+   static void transfer_format(GLenum format, GLenum &external, GLenum &type) {
+      switch (format) {
+      case GL_R8:      external = GL_RED;  type = GL_UNSIGNED_BYTE; break;
+      case GL_RG8:     external = GL_RG;   type = GL_UNSIGNED_BYTE; break;
+      case GL_RGB8:    external = GL_RGB;  type = GL_UNSIGNED_BYTE; break;
+      case GL_R16F:    external = GL_RED;  type = GL_FLOAT; break;
+      case GL_RG16F:   external = GL_RG;   type = GL_FLOAT; break;
+      case GL_RGB16F:  external = GL_RGB;  type = GL_FLOAT; break;
+      case GL_RGBA16F: external = GL_RGBA; type = GL_FLOAT; break;
+      case GL_R32F:    external = GL_RED;  type = GL_FLOAT; break;
+      case GL_RGBA32F: external = GL_RGBA; type = GL_FLOAT; break;
+      default:         external = GL_RGBA; type = GL_UNSIGNED_BYTE; break;
+      }
+   }
+
+   static size_t bytes_per_texel(GLenum format) {
+      switch (format) {
+      case GL_R8:      return 1;
+      case GL_RG8:     return 2;
+      case GL_R16F:    return 2;
+      case GL_RG16F:   return 4;
+      case GL_RGB16F:  return 8;   // padded like RGBA16F
+      case GL_RGBA16F: return 8;
+      case GL_R32F:    return 4;
+      case GL_RGBA32F: return 16;
+      default:         return 4;   // RGB8 is padded to 4 bytes by most drivers
+      }
+   }
+
+private:
+   struct Entry {
+      RenderTarget *target;
+      bool in_use;
+      unsigned int last_used;
+   };
+
+   std::vector<Entry> entries;
+   unsigned int max_idle;
+   unsigned int frame;
+
+   static RenderTarget *create(int width, int height, GLenum format, bool depth, int samples) {
+      RenderTarget *t = new RenderTarget();
+      t->width = width;
+      t->height = height;
+      t->format = format;
+      t->depth = depth;
+      t->samples = samples;
+      t->texture = t->color_rb = t->depth_rb = 0;
+
+      glGenFramebuffers(1, &t->fbo);
+      glBindFramebuffer(GL_FRAMEBUFFER, t->fbo);
+      if (samples > 0) {
+         glGenRenderbuffers(1, &t->color_rb);
+         glBindRenderbuffer(GL_RENDERBUFFER, t->color_rb);
+         glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, format, width, height);
+         glBindRenderbuffer(GL_RENDERBUFFER, 0);
+         glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, t->color_rb);
+      } else {
+         GLenum external, type;
+         transfer_format(format, external, type);
+         glGenTextures(1, &t->texture);
+         glBindTexture(GL_TEXTURE_2D, t->texture);
+         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, external, type, NULL);
+         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+         glBindTexture(GL_TEXTURE_2D, 0);
+         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, t->texture, 0);
+      }
+      if (depth) {
+         // depth samples have to match the color samples
+         glGenRenderbuffers(1, &t->depth_rb);
+         glBindRenderbuffer(GL_RENDERBUFFER, t->depth_rb);
+         glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH24_STENCIL8, width, height);
+         glBindRenderbuffer(GL_RENDERBUFFER, 0);
+         glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, t->depth_rb);
+      }
+      if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+         std::cerr << "ERROR: pooled framebuffer not complete." << std::endl;
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      return t;
+   }
+
+   static void destroy(RenderTarget *t) {
+      glDeleteFramebuffers(1, &t->fbo);
+      if (t->texture)
+         glDeleteTextures(1, &t->texture);
+      if (t->color_rb)
+         glDeleteRenderbuffers(1, &t->color_rb);
+      if (t->depth_rb)
+         glDeleteRenderbuffers(1, &t->depth_rb);
+      delete t;
+   }
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef _SAMPLE_COUNTER_HPP_
+#define _SAMPLE_COUNTER_HPP_
+
+#include <glad/glad.h>
+
+#include <query_ring.hpp>
+
+/**************************** SAMPLE COUNTER ****************************/
+/* Counts the samples that pass the depth test in a section with
+ * GL_SAMPLES_PASSED queries, that is how many fragments were shaded and
+ * written (overdraw included). Same ring as GpuTimer: `result` never waits,
+ * it hands back the oldest finished count or returns false. Only one counter
+ * may be running at a time.
+ *
+ *    counter.begin();
+ *    ... draw ...
+ *    counter.end();
+ *    unsigned long long samples;
+ *    if (counter.result(samples)) ...
+ */
+class SampleCounter {
+public:
+   void begin() { ring.begin(); }
+   void end() { ring.end(); }
+
+   bool result(unsigned long long &samples) {
+      GLuint64 n = 0;
+      if (!ring.result(n))
+         return false;
+      samples = n;
+      return true;
+   }
+
+private:
+   QueryRing<GL_SAMPLES_PASSED> ring;
+};
+
+#endif
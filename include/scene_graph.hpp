@@ -0,0 +1,127 @@
+#ifndef _SCENE_GRAPH_HPP_
+#define _SCENE_GRAPH_HPP_
+
+#include <glm/glm/glm.hpp>
+
+#include <vector>
+#include <string>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SCENE_GRAPH_SSE
+#include <xmmintrin.h>
+#endif
+
+/**************************** MATRIX MULTIPLY ****************************/
+// out = a * b for column major 4x4 matrices, `out` may not alias `b`
+inline void mat4_mul(const float *a, const float *b, float *out) {
+#ifdef SCENE_GRAPH_SSE
+   __m128 a0 = _mm_loadu_ps(a);
+   __m128 a1 = _mm_loadu_ps(a + 4);
+   __m128 a2 = _mm_loadu_ps(a + 8);
+   __m128 a3 = _mm_loadu_ps(a + 12);
+   for (int c = 0; c < 4; ++c) {
+      const float *col = b + 4 * c;
+      __m128 r = _mm_mul_ps(a0, _mm_set1_ps(col[0]));
+      r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(col[1])));
+      r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(col[2])));
+      r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(col[3])));
+      _mm_storeu_ps(out + 4 * c, r);
+   }
+#else
+   for (int c = 0; c < 4; ++c)
+      for (int r = 0; r < 4; ++r)
+         out[4 * c + r] = a[r] * b[4 * c] + a[4 + r] * b[4 * c + 1]
+                        + a[8 + r] * b[4 * c + 2] + a[12 + r] * b[4 * c + 3];
+#endif
+}
+
+/**************************** SCENE GRAPH ****************************/
+/* Node hierarchy stored as flat arrays, one entry per node, where a parent
+ * always comes before its children. That order lets `update` resolve world
+ * transforms in a single forward pass without recursion.
+ *
+ * Changing a local transform only marks the node dirty. `update` first
+ * propagates the flags down (a child of a dirty node is dirty) while
+ * collecting the dirty nodes, then recomputes world = parent world * local for
+ * just those, in one tight loop of SIMD matrix multiplies.
+ *
+ *    unsigned int root = scene.add_node(-1, glm::mat4());
+ *    unsigned int arm = scene.add_node(root, arm_local);
+ *    scene.set_local(root, spin);
+ *    scene.update();
+ *    shader.setmat4("model", scene.world[arm]);
+ */
+class SceneGraph {
+public:
+   std::vector<int> parent;              // -1 for roots
+   std::vector<glm::mat4> local;
+   std::vector<glm::mat4> world;
+   std::vector<unsigned char> dirty;
+   std::vector<std::string> names;
+
+   unsigned int size() const { return parent.size(); }
+
+   // `parent_index` has to be an existing node (or -1), which keeps parents first
+   unsigned int add_node(int parent_index, const glm::mat4 &transform,
+                         const std::string &name = "") {
+      unsigned int index = parent.size();
+      if (parent_index >= (int)index)
+         parent_index = -1;
+      parent.push_back(parent_index);
+      local.push_back(transform);
+      world.push_back(transform);
+      dirty.push_back(1);
+      names.push_back(name);
+      return index;
+   }
+
+   // copies all nodes of `other` below `parent_index`, returns where they start
+   unsigned int append(const SceneGraph &other, int parent_index) {
+      unsigned int offset = size();
+      for (unsigned int i = 0; i < other.size(); ++i) {
+         int p = other.parent[i] < 0 ? parent_index : other.parent[i] + (int)offset;
+         add_node(p, other.local[i], other.names[i]);
+      }
+      return offset;
+   }
+
+   void set_local(unsigned int node, const glm::mat4 &transform) {
+      local[node] = transform;
+      dirty[node] = 1;
+   }
+
+   int find(const std::string &name) const {
+      for (unsigned int i = 0; i < names.size(); ++i)
+         if (names[i] == name)
+            return i;
+      return -1;
+   }
+
+   // returns the number of world transforms recomputed
+   unsigned int update() {
+      pending.clear();
+      for (unsigned int i = 0; i < parent.size(); ++i) {
+         if (parent[i] >= 0 && dirty[parent[i]])
+            dirty[i] = 1;
+         if (dirty[i])
+            pending.push_back(i);
+      }
+
+      for (size_t k = 0; k < pending.size(); ++k) {
+         unsigned int i = pending[k];
+         if (parent[i] < 0)
+            world[i] = local[i];
+         else
+            mat4_mul(&world[parent[i]][0][0], &local[i][0][0], &world[i][0][0]);
+      }
+      // cleared afterwards, children test their parent's flag in the first pass
+      for (size_t k = 0; k < pending.size(); ++k)
+         dirty[pending[k]] = 0;
+      return pending.size();
+   }
+
+private:
+   std::vector<unsigned int> pending;
+};
+
+#endif
@@ -18,10 +18,23 @@
 class Shader {
 private:
     unsigned int _id;
+
+    // `defines` go right after the #version line, which has to come first
+    static std::string with_defines(const std::string &code, const char *defines) {
+        if (defines == NULL || code.compare(0, 8, "#version") != 0)
+            return code;
+        size_t eol = code.find('\n');
+        if (eol == std::string::npos)
+            return code + "\n" + defines;
+        return code.substr(0, eol + 1) + defines + code.substr(eol + 1);
+    }
+
 public:
+    // `defines` (e.g. "#define FOO\n") are added to every stage, to build variants of one source
     Shader(const char *v_path, 
            const char *f_path,
-           const char *g_path=NULL) {
+           const char *g_path=NULL,
+           const char *defines=NULL) {
 
         std::string v_code_, f_code_, g_code_;
         std::ifstream v_file, f_file, g_file;
@@ -37,14 +50,14 @@ public:
             v_file.close();
             f_file.close();      
 
-            v_code_ = v_stream.str();
-            f_code_ = f_stream.str();
+            v_code_ = with_defines(v_stream.str(), defines);
+            f_code_ = with_defines(f_stream.str(), defines);
 
             if (g_path != NULL) {
                 g_file.open(g_path);
                 g_stream << g_file.rdbuf();
                 g_file.close();
-                g_code_ = g_stream.str();
+                g_code_ = with_defines(g_stream.str(), defines);
             }
 
         } catch(std::ifstream::failure e) {
@@ -155,6 +168,25 @@ public:
                             binding_point
                             );
     }
+
+    // varyings have to be declared before linking, so this relinks the program
+    void set_feedback_varyings(const char **varyings, int count,
+                               GLenum mode=GL_INTERLEAVED_ATTRIBS) {
+        glTransformFeedbackVaryings(this->_id, count, varyings, mode);
+        glLinkProgram(this->_id);
+
+        int success;
+        char info_log[512];
+        glGetProgramiv(this->_id, GL_LINK_STATUS, &success);
+        if (!success) {
+         glGetProgramInfoLog(this->_id, 512, NULL, info_log);
+         std::cout << "Couldn't link the shaders with feedback varyings"
+                   << info_log
+                   << std::endl;
+        }
+    }
+
+    unsigned int id() const { return this->_id; }
 };
 
 #endif
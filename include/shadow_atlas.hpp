@@ -0,0 +1,493 @@
+#ifndef _SHADOW_ATLAS_HPP_
+#define _SHADOW_ATLAS_HPP_
+
+#include <glad/glad.h>
+
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/matrix_transform.hpp>
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include <shader.hpp>
+#include <bounds.hpp>
+#include <lights.hpp>
+
+/**************************** ATLAS ALLOCATOR ****************************/
+// a square tile of the atlas, in texels
+struct AtlasTile {
+   unsigned int x, y, size;
+};
+
+/* Quadtree buddy allocator over a square atlas. Tiles are powers of two
+ * between `min_tile` and the atlas size; a request takes a free block of its
+ * size or splits the smallest larger one, a release merges four free siblings
+ * back into their parent.
+ */
+class AtlasAllocator {
+public:
+   unsigned int size, min_tile;
+
+   AtlasAllocator(unsigned int size, unsigned int min_tile) : size(size), min_tile(min_tile) {
+      levels = 0;
+      while ((size >> levels) > min_tile)
+         ++levels;
+      free_blocks.resize(levels + 1);
+      clear();
+   }
+
+   // everything free again
+   void clear() {
+      for (size_t l = 0; l < free_blocks.size(); ++l)
+         free_blocks[l].clear();
+      AtlasTile all = { 0, 0, size };
+      free_blocks[0].push_back(all);
+      used = 0;
+   }
+
+   // `tile_size` is rounded up to a power of two
+   bool allocate(unsigned int tile_size, AtlasTile &tile) {
+      unsigned int level = level_of(tile_size);
+      int l = level;
+      while (l >= 0 && free_blocks[l].empty())
+         --l;
+      if (l < 0)
+         return false;
+
+      AtlasTile block = free_blocks[l].back();
+      free_blocks[l].pop_back();
+      // split down, keeping the first quarter and freeing the other three
+      for (; (unsigned int)l < level; ++l) {
+         unsigned int half = block.size / 2;
+         AtlasTile q1 = { block.x + half, block.y, half };
+         AtlasTile q2 = { block.x, block.y + half, half };
+         AtlasTile q3 = { block.x + half, block.y + half, half };
+         free_blocks[l + 1].push_back(q1);
+         free_blocks[l + 1].push_back(q2);
+         free_blocks[l + 1].push_back(q3);
+         block.size = half;
+      }
+      tile = block;
+      used += (size_t)tile.size * tile.size;
+      return true;
+   }
+
+   void release(const AtlasTile &tile) {
+      used -= (size_t)tile.size * tile.size;
+      AtlasTile block = tile;
+      for (unsigned int l = level_of(block.size); ; --l) {
+         if (l == 0) {
+            free_blocks[0].push_back(block);
+            return;
+         }
+         // the three siblings, merged into the parent when all of them are free
+         unsigned int parent_size = block.size * 2;
+         unsigned int px = block.x / parent_size * parent_size, py = block.y / parent_size * parent_size;
+         std::vector<AtlasTile> &blocks = free_blocks[l];
+         size_t found[3];
+         int n_found = 0;
+         for (size_t i = 0; i < blocks.size() && n_found < 3; ++i)
+            if (blocks[i].x / parent_size * parent_size == px && blocks[i].y / parent_size * parent_size == py)
+               found[n_found++] = i;
+         if (n_found < 3) {
+            blocks.push_back(block);
+            return;
+         }
+         for (int k = 2; k >= 0; --k) {
+            blocks[found[k]] = blocks.back();
+            blocks.pop_back();
+         }
+         AtlasTile parent = { px, py, parent_size };
+         block = parent;
+      }
+   }
+
+   float occupancy() const { return (float)used / ((float)size * size); }
+
+private:
+   unsigned int levels;
+   std::vector<std::vector<AtlasTile> > free_blocks;   // per level, level 0 is the whole atlas
+   size_t used;
+
+   unsigned int level_of(unsigned int tile_size) const {
+      unsigned int level = 0;
+      while (level < levels && (size >> (level + 1)) >= tile_size)
+         ++level;
+      return level;
+   }
+};
+
+/**************************** SHADOW ATLAS ****************************/
+/* Shadow maps of many spot and point lights in one depth texture. Every frame
+ * each light visible to the camera asks for a tile sized by its screen size;
+ * a point light takes six tiles, one per cube face. Lights keep their tiles
+ * across frames and are only redrawn when their tiles are new, the light
+ * moved, or a dynamic caster was inside the light's sphere this frame or the
+ * last one, so static lights over static geometry cost nothing.
+ *
+ * The six faces of a point light are drawn in a single pass: a geometry shader
+ * emits every triangle once per face, maps the face's clip space into the
+ * face's tile and clips it there with gl_ClipDistance (GL 3.3 has no viewport
+ * arrays or cube map arrays).
+ *
+ *    atlas.update(lights, n, projection * view, camera.position, ...);
+ *    atlas.begin();
+ *    for (size_t i = 0; i < atlas.pending.size(); ++i) {
+ *       atlas.set_light(depth_shader, atlas.pending[i]);
+ *       ... casters overlapping atlas.light_sphere(pending[i]) ...
+ *    }
+ *    atlas.end(s_width, s_height);
+ *    atlas.bind(shader, atlas_unit, data_unit);
+ *
+ * Per light data for the lighting shader, 8 RGBA32F texels of a texture buffer:
+ *    0      (type: 0 none, 1 spot, 2 point, near, far, texel size in uv)
+ *    spot   1: tile (u0, v0, u1, v1), 2-5: light view projection columns
+ *    point  1-6: tiles of the +x, -x, +y, -y, +z, -z faces
+ */
+class ShadowAtlas {
+public:
+   static const int TEXELS = 8;
+
+   unsigned int size, min_tile, max_tile;
+   float quality;                          // tile size per pixel of screen radius
+   unsigned int depth;
+   std::vector<unsigned int> pending;      // lights to draw this frame
+
+   ShadowAtlas(unsigned int size = 4096, unsigned int min_tile = 64, unsigned int max_tile = 1024,
+               float quality = 1.0f)
+      : size(size), min_tile(min_tile), max_tile(max_tile), quality(quality),
+        allocator(size, min_tile), data_capacity(0), n_releases(0) {
+      glGenTextures(1, &depth);
+      glBindTexture(GL_TEXTURE_2D, depth);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+      glBindTexture(GL_TEXTURE_2D, 0);
+
+      glGenFramebuffers(1, &fbo);
+      glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+      glDrawBuffer(GL_NONE);
+      glReadBuffer(GL_NONE);
+      if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+         std::cerr << "ERROR: shadow atlas framebuffer not complete." << std::endl;
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+      glGenBuffers(1, &data_buffer);
+      glGenTextures(1, &data_texture);
+      glBindBuffer(GL_TEXTURE_BUFFER, data_buffer);
+      glBindTexture(GL_TEXTURE_BUFFER, data_texture);
+      glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, data_buffer);
+      glBindTexture(GL_TEXTURE_BUFFER, 0);
+      glBindBuffer(GL_TEXTURE_BUFFER, 0);
+   }
+
+   /* `fov` in radians. `dynamic` are the boxes of everything that moved this
+    * frame, lights they touch are redrawn.
+    */
+   void update(const SpotLight *lights, unsigned int n, const glm::mat4 &view_projection,
+               const glm::vec3 &camera_position, float fov, int screen_height,
+               const std::vector<AABB> &dynamic) {
+      if (slots.size() < n)
+         slots.resize(n);
+      // lights that went away
+      for (size_t i = n; i < slots.size(); ++i)
+         release(slots[i]);
+      slots.resize(n);
+
+      Frustum frustum(view_projection);
+      float pixels_per_unit = screen_height / (2.0f * tanf(fov * 0.5f));
+
+      // desired tile sizes, invisible lights give their tiles back
+      order.clear();
+      for (unsigned int i = 0; i < n; ++i) {
+         Slot &slot = slots[i];
+         const PointLight &l = lights[i].light;
+         if (!frustum.intersects(Sphere(l.position, l.radius))) {
+            release(slot);
+            continue;
+         }
+         float distance = glm::length(l.position - camera_position);
+         float pixels = distance > l.radius ? l.radius / distance * pixels_per_unit : (float)max_tile;
+         unsigned int wanted = min_tile;
+         while (wanted < max_tile && wanted < pixels * quality)
+            wanted *= 2;
+         // grows whenever there is room for the bigger tiles (below), shrinks
+         // only once it is 4 times too big
+         if (slot.n_tiles && wanted * 4 <= slot.tile_size)
+            release(slot);
+         slot.wanted = wanted;
+         order.push_back(i);
+      }
+
+      // the biggest lights on screen get their tiles first
+      std::sort(order.begin(), order.end(), BySize(slots));
+      pending.clear();
+      for (size_t k = 0; k < order.size(); ++k) {
+         unsigned int i = order[k];
+         Slot &slot = slots[i];
+         const SpotLight &light = lights[i];
+         bool redraw = false;
+         if (!slot.n_tiles) {
+            if (!allocate(slot, light.is_point() ? 6 : 1))
+               continue;
+            redraw = true;
+         } else if (slot.tile_size < slot.wanted && slot.grow_failed_at != n_releases) {
+            // held below its request by a full atlas: tried again once tiles were given back
+            if (grow(slot))
+               redraw = true;
+            else
+               slot.grow_failed_at = n_releases;
+         }
+
+         glm::vec4 position_radius(light.light.position, light.light.radius);
+         glm::vec4 direction_cutoff(light.direction, light.cos_cutoff);
+         if (position_radius != slot.position_radius || direction_cutoff != slot.direction_cutoff) {
+            slot.position_radius = position_radius;
+            slot.direction_cutoff = direction_cutoff;
+            setup_matrices(slot, light);
+            redraw = true;
+         }
+
+         // drawn again once more after a caster leaves, to erase its shadow
+         bool touched = false;
+         Sphere sphere(light.light.position, light.light.radius);
+         for (size_t d = 0; d < dynamic.size() && !touched; ++d)
+            touched = overlaps(sphere, dynamic[d]);
+         if (touched || slot.touched)
+            redraw = true;
+         slot.touched = touched;
+
+         if (redraw)
+            pending.push_back(i);
+      }
+
+      write_data(n);
+   }
+
+   // the atlas as render target, clears the tiles about to be drawn
+   void begin() {
+      glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+      glViewport(0, 0, size, size);
+      glEnable(GL_SCISSOR_TEST);
+      for (size_t k = 0; k < pending.size(); ++k) {
+         const Slot &slot = slots[pending[k]];
+         for (int t = 0; t < slot.n_tiles; ++t) {
+            glScissor(slot.tiles[t].x, slot.tiles[t].y, slot.tiles[t].size, slot.tiles[t].size);
+            glClear(GL_DEPTH_BUFFER_BIT);
+         }
+      }
+      glDisable(GL_SCISSOR_TEST);
+      for (int i = 0; i < 4; ++i)
+         glEnable(GL_CLIP_DISTANCE0 + i);
+   }
+
+   // face matrices and tiles of light `i` for the atlas depth shader
+   void set_light(Shader &shader, unsigned int i) const {
+      const Slot &slot = slots[i];
+      shader.seti("n_faces", slot.n_tiles);
+      for (int f = 0; f < slot.n_tiles; ++f) {
+         std::string index = "[" + std::to_string(f) + "]";
+         shader.setmat4(("face_matrices" + index).c_str(), slot.matrices[f]);
+         // the tile as center and half size in atlas NDC
+         const AtlasTile &tile = slot.tiles[f];
+         float half = (float)tile.size / size;
+         glUniform4f(glGetUniformLocation(shader.id(), ("face_tiles" + index).c_str()),
+                     2.0f * tile.x / size - 1.0f + half, 2.0f * tile.y / size - 1.0f + half, half, half);
+      }
+   }
+
+   Sphere light_sphere(unsigned int i) const {
+      return Sphere(glm::vec3(slots[i].position_radius), slots[i].position_radius.w);
+   }
+
+   void end(int width, int height) {
+      for (int i = 0; i < 4; ++i)
+         glDisable(GL_CLIP_DISTANCE0 + i);
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glViewport(0, 0, width, height);
+   }
+
+   // shadow_atlas on `atlas_unit`, shadow_data (see above) on `data_unit`
+   void bind(Shader &shader, int atlas_unit, int data_unit) const {
+      glActiveTexture(GL_TEXTURE0 + atlas_unit);
+      glBindTexture(GL_TEXTURE_2D, depth);
+      glActiveTexture(GL_TEXTURE0 + data_unit);
+      glBindTexture(GL_TEXTURE_BUFFER, data_texture);
+      glActiveTexture(GL_TEXTURE0);
+      shader.seti("shadow_atlas", atlas_unit);
+      shader.seti("shadow_data", data_unit);
+   }
+
+   float occupancy() const { return allocator.occupancy(); }
+
+private:
+   struct Slot {
+      int n_tiles;
+      AtlasTile tiles[6];
+      unsigned int tile_size, wanted;
+      glm::mat4 matrices[6];
+      float near;
+      glm::vec4 position_radius, direction_cutoff;   // what the tiles were drawn for
+      bool touched;
+      unsigned int grow_failed_at;   // `n_releases` when growing last failed
+
+      Slot() : n_tiles(0), tile_size(0), wanted(0), near(0.05f),
+               position_radius(0.0f, 0.0f, 0.0f, -1.0f), direction_cutoff(0.0f), touched(false),
+               grow_failed_at(~0u) {}
+   };
+
+   struct BySize {
+      const std::vector<Slot> &slots;
+      BySize(const std::vector<Slot> &slots) : slots(slots) {}
+      bool operator()(unsigned int a, unsigned int b) const {
+         if (slots[a].wanted != slots[b].wanted)
+            return slots[a].wanted > slots[b].wanted;
+         return a < b;
+      }
+   };
+
+   AtlasAllocator allocator;
+   std::vector<Slot> slots;
+   std::vector<unsigned int> order;
+   std::vector<glm::vec4> data;
+   unsigned int fbo;
+   unsigned int data_buffer, data_texture;
+   size_t data_capacity;
+   // times tiles were given back: a grow that failed can only succeed after one
+   unsigned int n_releases;
+
+   void release(Slot &slot) {
+      if (slot.n_tiles)
+         n_releases++;
+      for (int t = 0; t < slot.n_tiles; ++t)
+         allocator.release(slot.tiles[t]);
+      slot.n_tiles = 0;
+      slot.tile_size = 0;
+      // drawn again whenever it gets tiles
+      slot.position_radius.w = -1.0f;
+   }
+
+   // all faces get the same size, halved until they fit
+   bool allocate(Slot &slot, int n_tiles) {
+      unsigned int tile_size = allocate_tiles(slot.tiles, n_tiles, slot.wanted, min_tile);
+      if (!tile_size)
+         return false;
+      slot.n_tiles = n_tiles;
+      slot.tile_size = tile_size;
+      slot.position_radius.w = -1.0f;
+      return true;
+   }
+
+   // bigger tiles taken next to the current ones, which are only given back
+   // once the new ones fit: a full atlas leaves the slot as it is
+   bool grow(Slot &slot) {
+      AtlasTile tiles[6];
+      unsigned int tile_size = allocate_tiles(tiles, slot.n_tiles, slot.wanted, slot.tile_size * 2);
+      if (!tile_size)
+         return false;
+      n_releases++;
+      for (int t = 0; t < slot.n_tiles; ++t) {
+         allocator.release(slot.tiles[t]);
+         slot.tiles[t] = tiles[t];
+      }
+      slot.tile_size = tile_size;
+      slot.position_radius.w = -1.0f;
+      return true;
+   }
+
+   // `n_tiles` tiles of one size, from `wanted` halved down to `smallest`, 0 when none fit
+   unsigned int allocate_tiles(AtlasTile *tiles, int n_tiles, unsigned int wanted,
+                               unsigned int smallest) {
+      for (unsigned int tile_size = wanted; tile_size >= smallest && tile_size >= min_tile;
+           tile_size /= 2) {
+         int t = 0;
+         for (; t < n_tiles; ++t)
+            if (!allocator.allocate(tile_size, tiles[t]))
+               break;
+         if (t == n_tiles)
+            return tile_size;
+         while (t > 0)
+            allocator.release(tiles[--t]);
+      }
+      return 0;
+   }
+
+   static void face_basis(int face, glm::vec3 &dir, glm::vec3 &up) {
+      static const glm::vec3 dirs[6] = {
+         glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+         glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+         glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+      };
+      static const glm::vec3 ups[6] = {
+         glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+         glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+         glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+      };
+      dir = dirs[face];
+      up = ups[face];
+   }
+
+   void setup_matrices(Slot &slot, const SpotLight &light) {
+      const glm::vec3 &p = light.light.position;
+      float far = light.light.radius;
+      slot.near = std::max(0.05f, far * 0.002f);
+      if (light.is_point()) {
+         glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, slot.near, far);
+         for (int f = 0; f < 6; ++f) {
+            glm::vec3 dir, up;
+            face_basis(f, dir, up);
+            slot.matrices[f] = projection * glm::lookAt(p, p + dir, up);
+         }
+      } else {
+         // a little wider than the cone so the PCF kernel stays inside at the edge
+         float angle = 2.0f * acosf(std::max(light.cos_cutoff, -0.99f)) + glm::radians(4.0f);
+         glm::mat4 projection = glm::perspective(std::min(angle, glm::radians(170.0f)), 1.0f, slot.near, far);
+         glm::vec3 up = fabsf(light.direction.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+         slot.matrices[0] = projection * glm::lookAt(p, p + light.direction, up);
+      }
+   }
+
+   glm::vec4 tile_rect(const AtlasTile &tile) const {
+      return glm::vec4((float)tile.x / size, (float)tile.y / size,
+                       (float)(tile.x + tile.size) / size, (float)(tile.y + tile.size) / size);
+   }
+
+   void write_data(unsigned int n) {
+      data.assign((size_t)n * TEXELS, glm::vec4(0.0f));
+      for (unsigned int i = 0; i < n; ++i) {
+         const Slot &slot = slots[i];
+         glm::vec4 *texels = &data[(size_t)i * TEXELS];
+         if (!slot.n_tiles)
+            continue;
+         texels[0] = glm::vec4(slot.n_tiles == 6 ? 2.0f : 1.0f, slot.near, slot.position_radius.w,
+                               1.0f / size);
+         if (slot.n_tiles == 6) {
+            for (int f = 0; f < 6; ++f)
+               texels[1 + f] = tile_rect(slot.tiles[f]);
+         } else {
+            texels[1] = tile_rect(slot.tiles[0]);
+            for (int c = 0; c < 4; ++c)
+               texels[2 + c] = slot.matrices[0][c];
+         }
+      }
+
+      size_t bytes = std::max<size_t>(data.size(), 1) * sizeof(glm::vec4);
+      while (data_capacity < bytes)
+         data_capacity = data_capacity ? 2 * data_capacity : 4096;
+      glBindBuffer(GL_TEXTURE_BUFFER, data_buffer);
+      glBufferData(GL_TEXTURE_BUFFER, data_capacity, NULL, GL_STREAM_DRAW);
+      if (!data.empty())
+         glBufferSubData(GL_TEXTURE_BUFFER, 0, data.size() * sizeof(glm::vec4), &data[0]);
+      glBindBuffer(GL_TEXTURE_BUFFER, 0);
+   }
+};
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef _SHADOWS_HPP_
+#define _SHADOWS_HPP_
+
+#include <glad/glad.h>
+
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/matrix_transform.hpp>
+
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include <shader.hpp>
+#include <bounds.hpp>
+
+/**************************** CASCADED SHADOW MAP ****************************/
+/* Directional light shadows split into cascades along the view depth. Each
+ * cascade is a layer of a depth texture array, sampled with hardware
+ * comparison (sampler2DArrayShadow).
+ *
+ * Stable cascades: a cascade covers the bounding sphere of its slice of the
+ * view frustum, whose radius doesn't change when the camera turns, and its
+ * center is snapped to whole shadow texels in light space. The shadow map
+ * only moves in texel steps, so edges don't shimmer, and its matrix stays
+ * bit-identical as long as the camera stays within a texel.
+ *
+ * Static caster cache: static casters are rendered into a second array,
+ * `static_depth`, only when a cascade's matrix changed (or `invalidate_static`
+ * was called). The final layer is a copy of the static layer with the dynamic
+ * casters drawn on top, and is left alone when neither changed:
+ *
+ *    csm.update(view, fov, aspect, near, far, light_direction, scene_bounds);
+ *    for (int c = 0; c < csm.n_cascades; ++c) {
+ *       if (csm.static_stale(c)) {
+ *          csm.begin_static(c);     ... static casters intersecting csm.frustums[c] ...
+ *       }
+ *       if (csm.begin_dynamic(c, n_dynamic_in_cascade > 0)) {
+ *          ...                      dynamic casters intersecting csm.frustums[c] ...
+ *       }
+ *    }
+ *    csm.end(s_width, s_height);
+ */
+class CascadedShadowMap {
+public:
+   static const int MAX_CASCADES = 4;
+
+   int n_cascades, resolution;
+   float split_lambda;                        // 0: uniform splits, 1: logarithmic
+   float splits[MAX_CASCADES + 1];            // view distances, splits[0] is the near plane
+   glm::mat4 light_view_projection[MAX_CASCADES];
+   float texel_size[MAX_CASCADES];            // world size of a shadow texel
+   Frustum frustums[MAX_CASCADES];            // for culling casters per cascade
+   unsigned int depth;                        // final maps, with comparison
+   unsigned int static_depth;                 // static casters only
+
+   // per frame counters
+   unsigned int n_static_renders, n_copies;
+
+   CascadedShadowMap(int n_cascades = 4, int resolution = 2048, float split_lambda = 0.75f)
+      : n_cascades(std::min(n_cascades, (int)MAX_CASCADES)), resolution(resolution),
+        split_lambda(split_lambda), n_static_renders(0), n_copies(0) {
+      depth = make_array(true);
+      static_depth = make_array(false);
+      // depth only, no color buffers to read or draw
+      glGenFramebuffers(1, &fbo);
+      glGenFramebuffers(1, &copy_fbo);
+      unsigned int fbos[] = { fbo, copy_fbo };
+      for (int i = 0; i < 2; ++i) {
+         glBindFramebuffer(GL_FRAMEBUFFER, fbos[i]);
+         glDrawBuffer(GL_NONE);
+         glReadBuffer(GL_NONE);
+      }
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      for (int c = 0; c < MAX_CASCADES; ++c) {
+         static_valid[c] = false;
+         final_is_static[c] = false;
+      }
+   }
+
+   // static casters moved, every cascade re-renders them
+   void invalidate_static() {
+      for (int c = 0; c < n_cascades; ++c)
+         static_valid[c] = false;
+   }
+
+   // `fov` in radians, `light_direction` points from the light into the scene
+   void update(const glm::mat4 &view, float fov, float aspect, float near, float far,
+               const glm::vec3 &light_direction, const AABB &scene) {
+      n_static_renders = n_copies = 0;
+
+      // practical split scheme, a blend of uniform and logarithmic splits
+      splits[0] = near;
+      for (int c = 1; c <= n_cascades; ++c) {
+         float t = (float)c / n_cascades;
+         float uniform = near + (far - near) * t;
+         float logarithmic = near * powf(far / near, t);
+         splits[c] = split_lambda * logarithmic + (1.0f - split_lambda) * uniform;
+      }
+
+      // rotation only, so snapping in light space is snapping in world space
+      glm::vec3 dir = glm::normalize(light_direction);
+      glm::vec3 up = fabsf(dir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+      glm::mat4 light_view = glm::lookAt(glm::vec3(0.0f), dir, up);
+
+      // depth range of the whole scene (all casters and receivers), casters outside the view still cast into it
+      AABB scene_light = scene.transform(light_view);
+
+      glm::mat4 inv_view = glm::inverse(view);
+      float tan_y = tanf(fov * 0.5f), tan_x = tan_y * aspect;
+      for (int c = 0; c < n_cascades; ++c) {
+         // bounding sphere of the slice, centered on the view axis
+         float n = splits[c], f = splits[c + 1];
+         float k = tan_x * tan_x + tan_y * tan_y;
+         float z = std::min(0.5f * (n + f) * (1.0f + k), f);
+         float radius = sqrtf(std::max((f - z) * (f - z) + f * f * k, (z - n) * (z - n) + n * n * k));
+         // rounded up so float noise never changes the cascade size
+         radius = ceilf(radius * 16.0f) / 16.0f;
+         glm::vec3 center = glm::vec3(inv_view * glm::vec4(0.0f, 0.0f, -z, 1.0f));
+
+         // whole texel steps in light space
+         glm::vec3 c_light = glm::vec3(light_view * glm::vec4(center, 1.0f));
+         float texel = 2.0f * radius / resolution;
+         texel_size[c] = texel;
+         c_light.x = floorf(c_light.x / texel) * texel;
+         c_light.y = floorf(c_light.y / texel) * texel;
+
+         // the light looks down -z, depth always spans the whole scene so it never moves the matrix
+         float z_near = -scene_light.max.z - 1.0f;
+         float z_far = -scene_light.min.z + 1.0f;
+         glm::mat4 projection = glm::ortho(c_light.x - radius, c_light.x + radius,
+                                           c_light.y - radius, c_light.y + radius,
+                                           z_near, z_far);
+         glm::mat4 vp = projection * light_view;
+         if (vp != light_view_projection[c]) {
+            light_view_projection[c] = vp;
+            static_valid[c] = false;
+         }
+         frustums[c] = Frustum(vp);
+      }
+   }
+
+   bool static_stale(int c) const { return !static_valid[c]; }
+
+   // clears static layer `c` and binds it for the static casters
+   void begin_static(int c) {
+      bind_layer(static_depth, c);
+      glClear(GL_DEPTH_BUFFER_BIT);
+      static_valid[c] = true;
+      final_is_static[c] = false;
+      n_static_renders++;
+   }
+
+   /* Brings final layer `c` up to date with the static layer. With `dynamic`
+    * set it binds the layer for the dynamic casters and returns true, without
+    * dynamic casters it returns false (nothing to draw).
+    */
+   bool begin_dynamic(int c, bool dynamic) {
+      if (!final_is_static[c]) {
+         glBindFramebuffer(GL_READ_FRAMEBUFFER, copy_fbo);
+         glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, static_depth, 0, c);
+         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+         glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth, 0, c);
+         glBlitFramebuffer(0, 0, resolution, resolution, 0, 0, resolution, resolution,
+                           GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+         n_copies++;
+      }
+      final_is_static[c] = !dynamic;
+      if (!dynamic)
+         return false;
+      bind_layer(depth, c);
+      return true;
+   }
+
+   // back to the window
+   void end(int width, int height) {
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glViewport(0, 0, width, height);
+   }
+
+   // shadow_map, n_cascades, cascade_splits (far end of each cascade), cascade_texels,
+   // shadow_texel and light_view_projection[i]
+   void bind(Shader &shader, int unit) const {
+      glActiveTexture(GL_TEXTURE0 + unit);
+      glBindTexture(GL_TEXTURE_2D_ARRAY, depth);
+      glActiveTexture(GL_TEXTURE0);
+      shader.seti("shadow_map", unit);
+      shader.seti("n_cascades", n_cascades);
+      shader.setf("shadow_texel", 1.0f / resolution);
+      float far_splits[MAX_CASCADES], texels[MAX_CASCADES];
+      for (int c = 0; c < MAX_CASCADES; ++c) {
+         far_splits[c] = c < n_cascades ? splits[c + 1] : splits[n_cascades];
+         texels[c] = c < n_cascades ? texel_size[c] : 0.0f;
+      }
+      glUniform4fv(glGetUniformLocation(shader.id(), "cascade_splits"), 1, far_splits);
+      glUniform4fv(glGetUniformLocation(shader.id(), "cascade_texels"), 1, texels);
+      for (int c = 0; c < n_cascades; ++c) {
+         std::string name = "light_view_projection[" + std::to_string(c) + "]";
+         shader.setmat4(name.c_str(), light_view_projection[c]);
+      }
+   }
+
+private:
+   unsigned int fbo, copy_fbo;
+   bool static_valid[MAX_CASCADES];
+   bool final_is_static[MAX_CASCADES];   // final layer holds exactly the static layer
+
+   unsigned int make_array(bool compare) {
+      unsigned int tex;
+      glGenTextures(1, &tex);
+      glBindTexture(GL_TEXTURE_2D_ARRAY, tex);
+      glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, n_cascades,
+                   0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+      // linear filtering with comparison gives 2x2 PCF per tap
+      GLint filter = compare ? GL_LINEAR : GL_NEAREST;
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      if (compare) {
+         glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+         glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+      }
+      glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+      return tex;
+   }
+
+   void bind_layer(unsigned int texture, int layer) {
+      glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+      glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+      glViewport(0, 0, resolution, resolution);
+      if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+         std::cerr << "ERROR: shadow framebuffer not complete." << std::endl;
+   }
+};
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef _STREAM_BUFFER_HPP_
+#define _STREAM_BUFFER_HPP_
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <iostream>
+
+#include <gl_ext.hpp>
+
+struct StreamStats {
+   unsigned int frames;
+   unsigned int stalls;     // frames where the CPU had to wait for the GPU
+   double wait_ms;          // time spent waiting (or mapping, when orphaning)
+   size_t bytes;
+
+   StreamStats() : frames(0), stalls(0), wait_ms(0.0), bytes(0) {}
+   void reset() { frames = stalls = 0; wait_ms = 0.0; bytes = 0; }
+
+   void pprint(const char *label) const {
+      std::cout << label
+                << " frames: " << frames
+                << " stalls: " << stalls
+                << " wait: " << wait_ms << " ms"
+                << " uploaded: " << bytes / 1024 << " KiB"
+                << std::endl;
+   }
+};
+
+/**************************** STREAMING BUFFER ****************************/
+/* Buffer for data rewritten every frame (uniform blocks, instance data).
+ *
+ * With GL 4.4 / ARB_buffer_storage the storage is immutable and mapped once,
+ * persistently and coherently, and is split into `n_frames` regions used round
+ * robin. The region written in frame N is fenced at `end_frame`, and is only
+ * handed out again after that fence signals, i.e. after the GPU consumed it:
+ * with three regions the CPU can run two frames ahead without ever waiting.
+ *
+ * On plain GL 3.3 there is a single region which is orphaned and mapped at
+ * `begin_frame` and has to be unmapped with `commit` before it is drawn from.
+ *
+ *    stream.begin_frame();
+ *    void *ptr = stream.alloc(size, offset);
+ *    ... write size bytes to ptr ...
+ *    stream.commit();
+ *    ... draw using [offset, offset + size) ...
+ *    stream.end_frame();
+ */
+class StreamBuffer {
+public:
+   unsigned int buffer;
+   GLenum target;
+   size_t frame_size;
+   unsigned int n_frames;
+   bool persistent;
+   StreamStats stats;
+
+   StreamBuffer(GLenum target, size_t frame_size, unsigned int n_frames = 3)
+      : target(target), n_frames(n_frames), persistent(false),
+        region(0), head(0), mapped(NULL), frame_base(NULL) {
+      GLint align = 16;
+      if (target == GL_UNIFORM_BUFFER)
+         glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+      alignment = align;
+      this->frame_size = align_up(frame_size);
+
+      for (unsigned int i = 0; i < MAX_FRAMES; ++i)
+         fences[i] = 0;
+      if (this->n_frames > MAX_FRAMES)
+         this->n_frames = MAX_FRAMES;
+
+      glGenBuffers(1, &buffer);
+      glBindBuffer(target, buffer);
+      if (glext::has_buffer_storage()) {
+         GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+         glext::functions().BufferStorage(target, this->frame_size * this->n_frames, NULL, flags);
+         mapped = (char *)glMapBufferRange(target, 0, this->frame_size * this->n_frames, flags);
+         persistent = mapped != NULL;
+      }
+      if (!persistent) {
+         if (glext::has_buffer_storage()) {
+            // immutable storage can't be respecified, start over with a mutable buffer
+            glBindBuffer(target, 0);
+            glDeleteBuffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+            glBindBuffer(target, buffer);
+         }
+         this->n_frames = 1;
+         glBufferData(target, this->frame_size, NULL, GL_STREAM_DRAW);
+      }
+      glBindBuffer(target, 0);
+   }
+
+   ~StreamBuffer() {
+      for (unsigned int i = 0; i < MAX_FRAMES; ++i)
+         if (fences[i])
+            glDeleteSync(fences[i]);
+      // the persistent mapping, or a GL 3.3 region that was never committed
+      if (mapped || frame_base) {
+         glBindBuffer(target, buffer);
+         glUnmapBuffer(target);
+         glBindBuffer(target, 0);
+      }
+      glDeleteBuffers(1, &buffer);
+   }
+
+   // makes the next region writable, waiting for the GPU if it still uses it
+   void begin_frame() {
+      stats.frames++;
+      head = 0;
+      if (persistent) {
+         region = (region + 1) % n_frames;
+         wait(fences[region]);
+         fences[region] = 0;
+         frame_base = mapped + region * frame_size;
+         return;
+      }
+
+      std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+      glBindBuffer(target, buffer);
+      glBufferData(target, frame_size, NULL, GL_STREAM_DRAW);
+      frame_base = (char *)glMapBufferRange(target, 0, frame_size,
+                                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+      glBindBuffer(target, 0);
+      std::chrono::duration<double, std::milli> elapsed =
+         std::chrono::high_resolution_clock::now() - start;
+      stats.wait_ms += elapsed.count();
+      if (!frame_base)
+         std::cerr << "Couldn't map the stream buffer" << std::endl;
+   }
+
+   // `size` bytes from the current region, `offset` is the byte offset in `buffer`
+   void *alloc(size_t size, size_t &offset) {
+      size_t start = align_up(head);
+      if (!frame_base || start + size > frame_size) {
+         std::cerr << "Stream buffer region overflow: "
+                   << start + size << " > " << frame_size
+                   << std::endl;
+         return NULL;
+      }
+      head = start + size;
+      stats.bytes += size;
+      offset = (persistent ? region * frame_size : 0) + start;
+      return frame_base + start;
+   }
+
+   // must be called before drawing from the buffer
+   void commit() {
+      if (persistent || !frame_base)
+         return;
+      glBindBuffer(target, buffer);
+      glUnmapBuffer(target);
+      glBindBuffer(target, 0);
+      frame_base = NULL;
+   }
+
+   // fences the region, after the last draw that reads it
+   void end_frame() {
+      commit();
+      if (persistent)
+         fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+   }
+
+private:
+   static const unsigned int MAX_FRAMES = 4;
+
+   unsigned int region;
+   size_t head;
+   size_t alignment;
+   char *mapped;
+   char *frame_base;
+   GLsync fences[MAX_FRAMES];
+
+   StreamBuffer(const StreamBuffer &);
+   StreamBuffer &operator=(const StreamBuffer &);
+
+   size_t align_up(size_t v) const {
+      return (v + alignment - 1) / alignment * alignment;
+   }
+
+   void wait(GLsync fence) {
+      if (!fence)
+         return;
+      GLenum status = glClientWaitSync(fence, 0, 0);
+      if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+         stats.stalls++;
+         std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+         do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+         } while (status == GL_TIMEOUT_EXPIRED);
+         std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::high_resolution_clock::now() - start;
+         stats.wait_ms += elapsed.count();
+      }
+      glDeleteSync(fence);
+   }
+};
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef _TEXTURE_ARRAY_HPP_
+#define _TEXTURE_ARRAY_HPP_
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+#include <stb_image.h>
+
+/**************************** RESAMPLE ****************************/
+// bilinear resize of an RGBA8 image
+void resample_rgba(const unsigned char *src, int src_width, int src_height,
+                   unsigned char *dst, int dst_width, int dst_height) {
+   for (int y = 0; y < dst_height; ++y) {
+      float fy = (y + 0.5f) * src_height / dst_height - 0.5f;
+      fy = std::max(0.0f, std::min(fy, (float)(src_height - 1)));
+      int y0 = (int)fy;
+      int y1 = std::min(y0 + 1, src_height - 1);
+      float ty = fy - y0;
+      for (int x = 0; x < dst_width; ++x) {
+         float fx = (x + 0.5f) * src_width / dst_width - 0.5f;
+         fx = std::max(0.0f, std::min(fx, (float)(src_width - 1)));
+         int x0 = (int)fx;
+         int x1 = std::min(x0 + 1, src_width - 1);
+         float tx = fx - x0;
+         for (int c = 0; c < 4; ++c) {
+            float a = src[(y0 * src_width + x0) * 4 + c];
+            float b = src[(y0 * src_width + x1) * 4 + c];
+            float d = src[(y1 * src_width + x0) * 4 + c];
+            float e = src[(y1 * src_width + x1) * 4 + c];
+            float top = a + (b - a) * tx;
+            float bottom = d + (e - d) * tx;
+            dst[(y * dst_width + x) * 4 + c] = (unsigned char)(top + (bottom - top) * ty + 0.5f);
+         }
+      }
+   }
+}
+
+/**************************** TEXTURE ARRAY ****************************/
+/* Packs a set of images into the layers of one GL_TEXTURE_2D_ARRAY, so meshes
+ * using different textures can be drawn without rebinding. Every layer has the
+ * size of the largest image, smaller (or differently shaped) images are
+ * resampled. Images are stored as RGBA8 whatever their channel count. One
+ * white layer follows the images, `white_layer`, for materials without a map.
+ */
+class TextureArray {
+public:
+   unsigned int id;
+   int width, height, layers;
+   int white_layer;   // all white, after the images
+
+   TextureArray() : id(0), width(0), height(0), layers(0), white_layer(-1) {}
+
+   // image i goes to layer i, images that fail to load are left black
+   void build(const std::vector<std::string> &paths) {
+      layers = paths.size() + 1;
+      white_layer = paths.size();
+      width = height = 0;
+      for (size_t i = 0; i < paths.size(); ++i) {
+         int w, h, n;
+         if (stbi_info(paths[i].c_str(), &w, &h, &n)) {
+            width = std::max(width, w);
+            height = std::max(height, h);
+         }
+      }
+      if (paths.empty() || width == 0) {
+         std::cerr << "Texture array: no images to pack" << std::endl;
+         return;
+      }
+
+      glGenTextures(1, &id);
+      glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layers,
+                   0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+      std::vector<unsigned char> resized(width * height * 4);
+      std::vector<unsigned char> black(width * height * 4, 0);
+      for (int i = 0; i < white_layer; ++i) {
+         int w, h, n;
+         unsigned char *data = stbi_load(paths[i].c_str(), &w, &h, &n, 4);
+         const unsigned char *pixels = &black[0];
+         if (!data) {
+            std::cout << "Couldn't load the texture image with path: "
+                      << paths[i]
+                      << std::endl;
+         } else if (w != width || h != height) {
+            resample_rgba(data, w, h, &resized[0], width, height);
+            pixels = &resized[0];
+         } else {
+            pixels = data;
+         }
+         glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, width, height, 1,
+                         GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+         stbi_image_free(data);
+      }
+      std::vector<unsigned char> white(width * height * 4, 255);
+      glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, white_layer, width, height, 1,
+                      GL_RGBA, GL_UNSIGNED_BYTE, &white[0]);
+      glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+      glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+   }
+
+   void bind(int unit) const {
+      glActiveTexture(GL_TEXTURE0 + unit);
+      glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+   }
+};
+
+#endif
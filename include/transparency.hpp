@@ -0,0 +1,218 @@
+#ifndef _TRANSPARENCY_HPP_
+#define _TRANSPARENCY_HPP_
+
+#include <glad/glad.h>
+
+#include <glm/glm/glm.hpp>
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+
+#include <stream_buffer.hpp>
+
+/**************************** TRANSPARENT RUNS ****************************/
+// `count` consecutive sorted objects sharing the same batch (texture, mesh, ...)
+struct TransparentRun {
+   unsigned int batch;
+   unsigned int first;
+   unsigned int count;
+};
+
+/**************************** TRANSPARENCY SORTER ****************************/
+/* Back to front ordering of transparent objects by their distance to the eye.
+ *
+ * The distance is quantised to 24 bits over [0, max_distance] and inverted, so
+ * an ascending sort gives farthest first; the low 8 bits hold the object's
+ * batch so equally distant objects of the same batch end up next to each other.
+ * Keys are sorted with an LSD radix sort (8 bits per pass, passes where every
+ * key shares the digit are skipped). The sort is stable: objects with equal
+ * keys keep their relative order instead of replacing each other.
+ *
+ * All arrays are sized once by `reserve`, sorting never allocates after that.
+ *
+ *    TransparencySorter sorter(n, 100.0f);
+ *    sorter.sort(&positions[0], &batches[0], n, camera.position);
+ *    sorter.gather(&positions[0], instance_data);
+ *    for (size_t i = 0; i < sorter.runs.size(); ++i) ... one instanced draw per run ...
+ */
+class TransparencySorter {
+public:
+   std::vector<unsigned int> order;      // object indices, farthest first
+   std::vector<TransparentRun> runs;     // `order` split by batch
+   size_t count;
+   float max_distance;
+   double sort_ms;                       // time spent in the last `sort`
+
+   TransparencySorter(size_t capacity = 0, float max_distance = 100.0f)
+      : count(0), max_distance(max_distance), sort_ms(0.0) {
+      reserve(capacity);
+   }
+
+   void reserve(size_t capacity) {
+      if (capacity <= order.size())
+         return;
+      order.resize(capacity);
+      order_tmp.resize(capacity);
+      keys.resize(capacity);
+      keys_tmp.resize(capacity);
+      runs.reserve(capacity);
+   }
+
+   // `batches` may be NULL when every object is drawn the same way
+   void sort(const glm::vec3 *positions, const unsigned char *batches,
+             size_t n, const glm::vec3 &eye) {
+      std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+      reserve(n);
+      count = n;
+
+      const float scale = 16777215.0f / (max_distance * max_distance);
+      for (size_t i = 0; i < n; ++i) {
+         glm::vec3 d = positions[i] - eye;
+         // squared distance is monotonic in distance, no sqrt needed
+         float q = std::min(glm::dot(d, d) * scale, 16777215.0f);
+         uint32_t depth = 0xFFFFFFu - (uint32_t)q;
+         keys[i] = (depth << 8) | (batches ? batches[i] : 0u);
+         order[i] = i;
+      }
+      radix_sort(n);
+      build_runs(batches);
+
+      std::chrono::duration<double, std::milli> elapsed =
+         std::chrono::high_resolution_clock::now() - start;
+      sort_ms = elapsed.count();
+   }
+
+   // creation order as a single run, for passes that don't need sorting
+   void identity(size_t n) {
+      reserve(n);
+      count = n;
+      for (size_t i = 0; i < n; ++i)
+         order[i] = i;
+      runs.clear();
+      TransparentRun run = { 0, 0, (unsigned int)n };
+      runs.push_back(run);
+      sort_ms = 0.0;
+   }
+
+   // copies per-object data to `dst` in sorted order
+   template <typename T>
+   void gather(const T *src, T *dst) const {
+      for (size_t i = 0; i < count; ++i)
+         dst[i] = src[order[i]];
+   }
+
+private:
+   std::vector<unsigned int> order_tmp;
+   std::vector<uint32_t> keys;
+   std::vector<uint32_t> keys_tmp;
+
+   void radix_sort(size_t n) {
+      if (n == 0)
+         return;
+      // all four histograms in one pass over the keys
+      unsigned int histogram[4][256];
+      std::fill(&histogram[0][0], &histogram[0][0] + 4 * 256, 0u);
+      for (size_t i = 0; i < n; ++i) {
+         uint32_t k = keys[i];
+         histogram[0][k & 0xFF]++;
+         histogram[1][(k >> 8) & 0xFF]++;
+         histogram[2][(k >> 16) & 0xFF]++;
+         histogram[3][k >> 24]++;
+      }
+
+      uint32_t *src_keys = &keys[0], *dst_keys = &keys_tmp[0];
+      unsigned int *src_order = &order[0], *dst_order = &order_tmp[0];
+      for (unsigned int pass = 0; pass < 4; ++pass) {
+         unsigned int *h = histogram[pass];
+         unsigned int shift = pass * 8;
+         if (h[(src_keys[0] >> shift) & 0xFF] == n)
+            continue;
+
+         unsigned int offsets[256];
+         unsigned int sum = 0;
+         for (unsigned int b = 0; b < 256; ++b) {
+            offsets[b] = sum;
+            sum += h[b];
+         }
+         for (size_t i = 0; i < n; ++i) {
+            unsigned int dst = offsets[(src_keys[i] >> shift) & 0xFF]++;
+            dst_keys[dst] = src_keys[i];
+            dst_order[dst] = src_order[i];
+         }
+         std::swap(src_keys, dst_keys);
+         std::swap(src_order, dst_order);
+      }
+
+      // odd number of passes ran, the result is in the scratch arrays
+      if (src_keys != &keys[0]) {
+         keys.swap(keys_tmp);
+         order.swap(order_tmp);
+      }
+   }
+
+   void build_runs(const unsigned char *batches) {
+      runs.clear();
+      for (size_t i = 0; i < count; ++i) {
+         unsigned int batch = batches ? batches[order[i]] : 0;
+         if (!runs.empty() && runs.back().batch == batch) {
+            runs.back().count++;
+         } else {
+            TransparentRun run = { batch, (unsigned int)i, 1 };
+            runs.push_back(run);
+         }
+      }
+   }
+};
+
+/**************************** TRANSPARENT INSTANCES ****************************/
+/* Sorted per-instance data (xyz position, w scale) streamed every frame. Base
+ * instance draws need GL 4.2, so each run re-points the instance attribute at
+ * its first instance and issues one instanced draw; instances of a draw are
+ * blended in order, which keeps the back to front ordering.
+ */
+class TransparentInstances {
+public:
+   StreamBuffer stream;
+   size_t offset;   // of this frame's instances in `stream.buffer`
+
+   TransparentInstances(size_t capacity)
+      : stream(GL_ARRAY_BUFFER, capacity * sizeof(glm::vec4)), offset(0) {}
+
+   // makes `location` of `vao` a per-instance vec4
+   void setup(unsigned int vao, unsigned int location) const {
+      glBindVertexArray(vao);
+      glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+      glEnableVertexAttribArray(location);
+      glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void *)0);
+      glVertexAttribDivisor(location, 1);
+      glBindVertexArray(0);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+   }
+
+   bool upload(const TransparencySorter &sorter, const glm::vec4 *instances) {
+      stream.begin_frame();
+      glm::vec4 *dst = (glm::vec4 *)stream.alloc(sorter.count * sizeof(glm::vec4), offset);
+      if (dst)
+         sorter.gather(instances, dst);
+      stream.commit();
+      return dst != NULL;
+   }
+
+   // draws `run` with `vao`, which has to be set up for `location`
+   void draw(unsigned int vao, unsigned int location, const TransparentRun &run,
+             GLenum mode, GLint first_vertex, GLsizei n_vertices) const {
+      glBindVertexArray(vao);
+      glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+      glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4),
+                            (void *)(offset + run.first * sizeof(glm::vec4)));
+      glDrawArraysInstanced(mode, first_vertex, n_vertices, run.count);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+   }
+
+   // after the last draw of the frame
+   void end_frame() { stream.end_frame(); }
+};
+
+#endif
@@ -0,0 +1,255 @@
+#ifndef _TRIANGLE_BVH_HPP_
+#define _TRIANGLE_BVH_HPP_
+
+#include <glm/glm/glm.hpp>
+
+#include <vector>
+#include <iostream>
+#include <cfloat>
+#include <cmath>
+
+#include <bounds.hpp>
+#include <bvh.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TRIANGLE_BVH_SSE
+#include <xmmintrin.h>
+#endif
+
+/**************************** RAY HIT ****************************/
+// `barycentric` are the weights of the triangle's second and third vertex
+struct RayHit {
+   int mesh;
+   unsigned int triangle;   // its vertices are indices[3 * triangle + 0, 1, 2]
+   glm::vec2 barycentric;
+   float t;
+
+   RayHit() : mesh(-1), triangle(0), barycentric(0.0f), t(FLT_MAX) {}
+};
+
+/**************************** TRIANGLE BLOCK ****************************/
+/* Four triangles side by side (structure of arrays), the unit the ray kernel
+ * tests at once. Unused lanes are degenerate and never hit.
+ */
+struct TriangleBlock {
+   float v0[3][4];
+   float e1[3][4];   // v1 - v0
+   float e2[3][4];   // v2 - v0
+   unsigned int triangle[4];
+};
+
+/* Moller-Trumbore against the four triangles of a block, both sides count.
+ * On a hit closer than `t`, lowers `t`, sets `uv` and returns the lane,
+ * otherwise returns -1.
+ */
+inline int intersect(const Ray &ray, const TriangleBlock &block, float &t, glm::vec2 &uv) {
+   const float EPSILON = 1e-8f;
+#ifdef TRIANGLE_BVH_SSE
+   __m128 dx = _mm_set1_ps(ray.dir.x), dy = _mm_set1_ps(ray.dir.y), dz = _mm_set1_ps(ray.dir.z);
+   __m128 e1x = _mm_loadu_ps(block.e1[0]), e1y = _mm_loadu_ps(block.e1[1]), e1z = _mm_loadu_ps(block.e1[2]);
+   __m128 e2x = _mm_loadu_ps(block.e2[0]), e2y = _mm_loadu_ps(block.e2[1]), e2z = _mm_loadu_ps(block.e2[2]);
+
+   // p = dir x e2, det = e1 . p
+   __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+   __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+   __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+   __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+   __m128 abs_det = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+   __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+   // s = origin - v0, u = (s . p) / det
+   __m128 sx = _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_loadu_ps(block.v0[0]));
+   __m128 sy = _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_loadu_ps(block.v0[1]));
+   __m128 sz = _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_loadu_ps(block.v0[2]));
+   __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inv_det);
+
+   // q = s x e1, v = (dir . q) / det, t = (e2 . q) / det
+   __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+   __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+   __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+   __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv_det);
+   __m128 tt = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv_det);
+
+   __m128 zero = _mm_setzero_ps();
+   __m128 mask = _mm_cmpgt_ps(abs_det, _mm_set1_ps(EPSILON));
+   mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+   mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+   mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+   mask = _mm_and_ps(mask, _mm_cmpgt_ps(tt, zero));
+   mask = _mm_and_ps(mask, _mm_cmplt_ps(tt, _mm_set1_ps(t)));
+   int bits = _mm_movemask_ps(mask);
+   if (!bits)
+      return -1;
+
+   float ts[4], us[4], vs[4];
+   _mm_storeu_ps(ts, tt);
+   _mm_storeu_ps(us, u);
+   _mm_storeu_ps(vs, v);
+   int lane = -1;
+   for (int i = 0; i < 4; ++i) {
+      if ((bits & (1 << i)) && ts[i] < t) {
+         t = ts[i];
+         uv = glm::vec2(us[i], vs[i]);
+         lane = i;
+      }
+   }
+   return lane;
+#else
+   int lane = -1;
+   for (int i = 0; i < 4; ++i) {
+      glm::vec3 e1(block.e1[0][i], block.e1[1][i], block.e1[2][i]);
+      glm::vec3 e2(block.e2[0][i], block.e2[1][i], block.e2[2][i]);
+      glm::vec3 p = glm::cross(ray.dir, e2);
+      float det = glm::dot(e1, p);
+      if (std::fabs(det) <= EPSILON)
+         continue;
+      float inv_det = 1.0f / det;
+      glm::vec3 s = ray.origin - glm::vec3(block.v0[0][i], block.v0[1][i], block.v0[2][i]);
+      float u = glm::dot(s, p) * inv_det;
+      glm::vec3 q = glm::cross(s, e1);
+      float v = glm::dot(ray.dir, q) * inv_det;
+      float tt = glm::dot(e2, q) * inv_det;
+      if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && tt > 0.0f && tt < t) {
+         t = tt;
+         uv = glm::vec2(u, v);
+         lane = i;
+      }
+   }
+   return lane;
+#endif
+}
+
+/**************************** TRIANGLE BVH ****************************/
+/* BVH over the triangles of one indexed mesh, for ray picking. Leaves hold up
+ * to four triangles, packed into one TriangleBlock so a leaf is a single SIMD
+ * test. The tree (nodes and triangle order) can be written to and read from a
+ * stream; the blocks are rebuilt from the vertices on load.
+ *
+ *    TriangleBVH bvh;
+ *    bvh.build(&positions[0].x, 3, &indices[0], indices.size());
+ *    float t = FLT_MAX;
+ *    if (bvh.raycast(ray, t, hit)) ...
+ */
+class TriangleBVH {
+public:
+   BVH bvh;
+   std::vector<TriangleBlock> blocks;
+   std::vector<unsigned int> leaf_blocks;   // by node, first block of a leaf
+
+   // a node visit costs about as much as a block test, so leaves fill blocks
+   TriangleBVH() : bvh(4, 4.0f) {}
+
+   unsigned int triangle_count() const { return bvh.indices.size(); }
+
+   // `positions` of vertex i at positions[i * stride], `stride` in floats
+   void build(const float *positions, size_t stride, const unsigned int *indices, size_t n_indices) {
+      size_t n = n_indices / 3;
+      std::vector<AABB> boxes(n);
+      for (size_t i = 0; i < n; ++i)
+         for (int k = 0; k < 3; ++k)
+            boxes[i].expand(glm::vec3(positions[indices[3 * i + k] * stride],
+                                      positions[indices[3 * i + k] * stride + 1],
+                                      positions[indices[3 * i + k] * stride + 2]));
+      bvh.build(n ? &boxes[0] : NULL, n);
+      pack(positions, stride, indices);
+   }
+
+   // `t` is the nearest distance so far, `hit.triangle` and `hit.barycentric` are set on a hit
+   bool raycast(const Ray &ray, float &t, RayHit &hit) const {
+      BlockLeaf leaf = { this, &hit };
+      return bvh.traverse(ray, t, leaf);
+   }
+
+   void write(std::ostream &out) const {
+      unsigned int n_nodes = bvh.nodes.size(), n_triangles = bvh.indices.size();
+      out.write((const char *)&n_nodes, sizeof(n_nodes));
+      out.write((const char *)&n_triangles, sizeof(n_triangles));
+      if (n_nodes)
+         out.write((const char *)&bvh.nodes[0], n_nodes * sizeof(BVHNode));
+      if (n_triangles)
+         out.write((const char *)&bvh.indices[0], n_triangles * sizeof(unsigned int));
+   }
+
+   // fails when the stream is short, was written for a different triangle count or
+   // holds a tree the traversal can't handle, the caller then builds the tree again
+   bool read(std::istream &in, const float *positions, size_t stride,
+             const unsigned int *indices, size_t n_indices) {
+      unsigned int n_nodes = 0, n_triangles = 0;
+      in.read((char *)&n_nodes, sizeof(n_nodes));
+      in.read((char *)&n_triangles, sizeof(n_triangles));
+      if (!in || n_triangles != n_indices / 3 || n_nodes > 2 * n_triangles)
+         return false;
+      bvh.nodes.resize(n_nodes);
+      bvh.indices.resize(n_triangles);
+      if (n_nodes)
+         in.read((char *)&bvh.nodes[0], n_nodes * sizeof(BVHNode));
+      if (n_triangles)
+         in.read((char *)&bvh.indices[0], n_triangles * sizeof(unsigned int));
+      if (!in)
+         return false;
+      for (size_t i = 0; i < n_triangles; ++i)
+         if (bvh.indices[i] >= n_triangles)
+            return false;
+      // children after their parent and leaves within the triangles
+      for (size_t n = 0; n < n_nodes; ++n) {
+         const BVHNode &node = bvh.nodes[n];
+         if (node.leaf() ? node.left_first + node.count > n_triangles
+                         : node.left_first <= n || node.left_first + 1 >= n_nodes)
+            return false;
+      }
+      // no deeper than the traversal stacks
+      if (bvh.depth() > BVH::MAX_DEPTH)
+         return false;
+      pack(positions, stride, indices);
+      return true;
+   }
+
+private:
+   struct BlockLeaf {
+      const TriangleBVH *owner;
+      RayHit *hit;
+      bool operator()(const BVHNode &node, const Ray &ray, float &t) {
+         bool found = false;
+         unsigned int first = owner->leaf_blocks[&node - &owner->bvh.nodes[0]];
+         unsigned int n_blocks = (node.count + 3) / 4;
+         for (unsigned int b = 0; b < n_blocks; ++b) {
+            const TriangleBlock &block = owner->blocks[first + b];
+            int lane = intersect(ray, block, t, hit->barycentric);
+            if (lane >= 0) {
+               hit->triangle = block.triangle[lane];
+               found = true;
+            }
+         }
+         return found;
+      }
+   };
+
+   void pack(const float *positions, size_t stride, const unsigned int *indices) {
+      blocks.clear();
+      leaf_blocks.assign(bvh.nodes.size(), 0);
+      for (size_t n = 0; n < bvh.nodes.size(); ++n) {
+         const BVHNode &node = bvh.nodes[n];
+         if (!node.leaf())
+            continue;
+         leaf_blocks[n] = blocks.size();
+         for (unsigned int first = 0; first < node.count; first += 4) {
+            TriangleBlock block = TriangleBlock();
+            for (unsigned int lane = 0; lane < 4 && first + lane < node.count; ++lane) {
+               unsigned int tri = bvh.indices[node.left_first + first + lane];
+               const float *p0 = positions + indices[3 * tri] * stride;
+               const float *p1 = positions + indices[3 * tri + 1] * stride;
+               const float *p2 = positions + indices[3 * tri + 2] * stride;
+               for (int k = 0; k < 3; ++k) {
+                  block.v0[k][lane] = p0[k];
+                  block.e1[k][lane] = p1[k] - p0[k];
+                  block.e2[k][lane] = p2[k] - p0[k];
+               }
+               block.triangle[lane] = tri;
+            }
+            blocks.push_back(block);
+         }
+      }
+   }
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef _VERTEX_LAYOUT_HPP_
+#define _VERTEX_LAYOUT_HPP_
+
+#include <glad/glad.h>
+
+#include <glm/glm/glm.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <type_traits>
+
+/**************************** ATTRIBUTE TYPES ****************************/
+/* What GL needs to know about a C++ type used as a vertex attribute. Only
+ * the types below have a specialization, any other member is a compile error.
+ * Integer types go through glVertexAttribIPointer and stay integers in the
+ * shader.
+ */
+template <typename T> struct AttributeType;
+
+#define ATTRIBUTE_TYPE(T, n, gl_type, is_integer, glsl_name)                 \
+   template <> struct AttributeType<T> {                                      \
+      static constexpr GLint components = n;                                  \
+      static constexpr GLenum type = gl_type;                                 \
+      static constexpr bool integer = is_integer;                             \
+      static const char *glsl() { return glsl_name; }                         \
+   }
+
+ATTRIBUTE_TYPE(float, 1, GL_FLOAT, false, "float");
+ATTRIBUTE_TYPE(glm::vec2, 2, GL_FLOAT, false, "vec2");
+ATTRIBUTE_TYPE(glm::vec3, 3, GL_FLOAT, false, "vec3");
+ATTRIBUTE_TYPE(glm::vec4, 4, GL_FLOAT, false, "vec4");
+ATTRIBUTE_TYPE(int, 1, GL_INT, true, "int");
+ATTRIBUTE_TYPE(unsigned int, 1, GL_UNSIGNED_INT, true, "uint");
+
+#undef ATTRIBUTE_TYPE
+
+/**************************** VERTEX LAYOUT ****************************/
+/* The attributes of a vertex struct, declared once next to the struct:
+ *
+ *    struct vertex { glm::vec3 position; glm::vec3 normal; glm::vec2 tex_pos; };
+ *    VERTEX_LAYOUT(vertex,
+ *                  VERTEX_ATTRIBUTE(vertex, position, 0, "ipos"),
+ *                  VERTEX_ATTRIBUTE(vertex, normal, 1, "inorm"),
+ *                  VERTEX_ATTRIBUTE(vertex, tex_pos, 2, "itex_pos"));
+ *
+ * Component count, GL type, offset and stride all come from the struct, so
+ * they can't drift apart from it. The last argument is the input's name in
+ * the shaders.
+ *
+ * A struct is one stream: `setup_attributes<vertex>(vbo)` points its
+ * attributes at an interleaved buffer of them. Streams can also be split: a
+ * struct holding only a position, in a buffer of its own, feeds depth and
+ * shadow passes with 12 bytes a vertex instead of the whole vertex. Several
+ * streams go into one VAO by calling `setup_attributes` once per buffer, the
+ * locations just have to differ.
+ *
+ * `glsl_inputs<vertex>()` gives the matching `layout (location = N) in ...`
+ * declarations as a macro, to hand to Shader as `defines`. Defines reach every
+ * stage, so the declarations only appear where the vertex shader names the
+ * macro instead of writing its inputs:
+ *
+ *    #version 330 core
+ *    VERTEX_INPUTS
+ */
+struct VertexAttribute {
+   GLuint location;
+   GLint components;
+   GLenum type;
+   bool integer;
+   size_t offset;
+   const char *name;
+   const char *glsl_type;
+};
+
+template <typename T>
+VertexAttribute make_attribute(GLuint location, size_t offset, const char *name) {
+   VertexAttribute a = { location, AttributeType<T>::components, AttributeType<T>::type,
+                         AttributeType<T>::integer, offset, name, AttributeType<T>::glsl() };
+   return a;
+}
+
+template <typename Vertex> struct VertexLayout;
+
+#define VERTEX_ATTRIBUTE(Vertex, member, location, name)                     \
+   make_attribute<decltype(Vertex::member)>(location, offsetof(Vertex, member), name)
+
+#define VERTEX_LAYOUT(Vertex, ...)                                            \
+   template <> struct VertexLayout<Vertex> {                                  \
+      static_assert(std::is_standard_layout<Vertex>::value,                   \
+                    #Vertex " needs a standard layout for offsetof");         \
+      static const std::vector<VertexAttribute> &attributes() {              \
+         static const std::vector<VertexAttribute> a = { __VA_ARGS__ };      \
+         return a;                                                            \
+      }                                                                       \
+   }
+
+// one attribute of a `stride` bytes vertex, from the buffer bound to GL_ARRAY_BUFFER
+inline void point_attribute(const VertexAttribute &a, size_t stride, unsigned int divisor) {
+   if (a.integer)
+      glVertexAttribIPointer(a.location, a.components, a.type, stride, (void *)a.offset);
+   else
+      glVertexAttribPointer(a.location, a.components, a.type, GL_FALSE, stride, (void *)a.offset);
+   glEnableVertexAttribArray(a.location);
+   glVertexAttribDivisor(a.location, divisor);
+}
+
+// points the attributes of `Vertex` at `vbo` in the bound VAO, `divisor` 1 for per instance data
+template <typename Vertex>
+void setup_attributes(unsigned int vbo, unsigned int divisor = 0) {
+   const std::vector<VertexAttribute> &attributes = VertexLayout<Vertex>::attributes();
+   glBindBuffer(GL_ARRAY_BUFFER, vbo);
+   for (size_t i = 0; i < attributes.size(); ++i)
+      point_attribute(attributes[i], sizeof(Vertex), divisor);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// `#define macro` as `layout (location = N) in type name;` for every attribute of `Vertex`
+template <typename Vertex>
+std::string glsl_inputs(const char *macro = "VERTEX_INPUTS") {
+   const std::vector<VertexAttribute> &attributes = VertexLayout<Vertex>::attributes();
+   std::stringstream s;
+   s << "#define " << macro;
+   for (size_t i = 0; i < attributes.size(); ++i)
+      s << " layout (location = " << attributes[i].location << ") in "
+        << attributes[i].glsl_type << " " << attributes[i].name << ";";
+   s << "\n";
+   return s.str();
+}
+
+#endif
@@ -0,0 +1,13 @@
+#version 330 core
+VERTEX_INPUTS   // ipos alone, the position stream (vertex_layout.hpp)
+
+uniform mat4 view;
+uniform mat4 model;
+uniform mat4 projection;
+
+// the lighting pass tests GL_EQUAL against this depth, both have to compute it the same way
+invariant gl_Position;
+
+void main() {
+   gl_Position = projection * view * model * vec4(ipos, 1.0f);
+}
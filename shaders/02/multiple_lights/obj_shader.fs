@@ -6,27 +6,24 @@ struct directional_source {
    vec3 diffuse;
    vec3 specular;  
 };
-struct point_source {
-   vec3 position;
-   
-   float constant;
-   float linear;
-   float quadratic;
-   
-   vec3 ambient;
-   vec3 diffuse;
-   vec3 specular; 
-};
 struct Material {
  sampler2D diffuse;
  sampler2D specular;
  float shininess;
 };
 
-#define N_POINT_SOURCES 4
-uniform point_source _point_sources[N_POINT_SOURCES];
+// point lights, 2 texels each: (position, radius), (color, intensity), see lights.hpp
+uniform samplerBuffer lights;
+// light grid, see light_grid.hpp
+uniform usamplerBuffer cluster_grid;     // offset, count per cluster
+uniform usamplerBuffer cluster_lights;   // light indices
+uniform vec3 grid_dims;
+uniform vec2 grid_z;                     // slice = log(depth) * x + y
+uniform vec2 screen_size;
+
 uniform directional_source _dir_source;
 uniform vec3 view_pos;
+uniform mat4 view;
 uniform Material material;
 
 in vec3 frag_pos;
@@ -56,30 +53,29 @@ vec3 calculate_directional_light(
 }
 
 vec3 calculate_point_light(
-   point_source light,
+   int index,
    vec3 normal,
    vec3 frag_pos,
    vec3 view_dir
 ) {
-   vec3 light_dir = normalize(light.position - frag_pos);
+   vec4 position_radius = texelFetch(lights, 2 * index);
+   vec4 color_intensity = texelFetch(lights, 2 * index + 1);
+   vec3 light_dir = position_radius.xyz - frag_pos;
+   float distance = length(light_dir);
+   light_dir /= distance;
    // diffuse shading
    float diff = max(dot(normal, light_dir), 0.0f);
    // specular shading
    vec3 reflect_dir = reflect(-light_dir, normal);
    float spec = pow(max(dot(reflect_dir, view_dir), 0.0f), material.shininess);
-   // attenuation
-   float distance = length(frag_pos - light.position);
-   float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+   // attenuation, reaches zero at the light's radius
+   float window = clamp(1.0f - pow(distance / position_radius.w, 4.0f), 0.0f, 1.0f);
+   float attenuation = color_intensity.w * window * window / (1.0f + distance * distance);
    // combine results
-   vec3 ambient = light.ambient * vec3(texture(material.diffuse,  tex_pos));
-   vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse,  tex_pos));
-   vec3 specular = light.specular * spec * vec3(texture(material.specular,  tex_pos));
-   
-   ambient *= attenuation;
-   diffuse *= attenuation;
-   specular *= attenuation;
+   vec3 diffuse = diff * vec3(texture(material.diffuse,  tex_pos));
+   vec3 specular = spec * vec3(texture(material.specular,  tex_pos));
 
-   return  (ambient + diffuse + specular);   
+   return attenuation * color_intensity.rgb * (diffuse + specular);
 }
 
 void main() {
@@ -88,10 +84,16 @@ void main() {
    
    // Directional lighting
    vec3 result = calculate_directional_light(_dir_source, n_norm, view_dir);
-   // Point lighting
-   for (int i = 0; i < N_POINT_SOURCES; ++i) {
-      result += calculate_point_light(_point_sources[i], n_norm, frag_pos, view_dir);
+
+   // Point lighting, only the lights of this fragment's cluster
+   float depth = -(view * vec4(frag_pos, 1.0f)).z;
+   ivec3 cluster = ivec3(vec3(gl_FragCoord.xy / screen_size, log(max(depth, 1e-4f)) * grid_z.x + grid_z.y)
+                         * vec3(grid_dims.xy, 1.0f));
+   cluster = clamp(cluster, ivec3(0), ivec3(grid_dims) - 1);
+   uvec2 range = texelFetch(cluster_grid, (cluster.z * int(grid_dims.y) + cluster.y) * int(grid_dims.x) + cluster.x).rg;
+   for (uint i = 0u; i < range.y; ++i) {
+      int index = int(texelFetch(cluster_lights, int(range.x + i)).r);
+      result += calculate_point_light(index, n_norm, frag_pos, view_dir);
    }
    frag_color = vec4(result, 1.0f);
 }
-
@@ -11,10 +11,14 @@ out vec3 frag_pos;
 out vec3 norm;
 out vec2 tex_pos;
 
+// same depth as depth_prepass.vs to the bit, for the GL_EQUAL test after a prepass
+invariant gl_Position;
+
 void main() {
    gl_Position = projection * view * model * vec4(ipos, 1.0f);
    frag_pos = vec3(model * vec4(ipos, 1.0f));
-   norm = vec3(model * vec4(inorm, 1.0f));
+   // direction, no translation (model is a rotation here)
+   norm = mat3(model) * inorm;
    tex_pos = itex_pos;
 }
 
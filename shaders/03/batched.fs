@@ -0,0 +1,99 @@
+#version 330 core 
+out vec4 frag_color;
+
+struct directional_source {
+   vec3 direction;
+   vec3 ambient;
+   vec3 diffuse;
+   vec3 specular;  
+};
+
+struct point_source {
+   vec3 position;
+   
+   float constant;
+   float linear;
+   float quadratic;
+   
+   vec3 ambient;
+   vec3 diffuse;
+   vec3 specular; 
+};
+
+in vec3 frag_pos;
+in vec2 tex_pos;
+in vec3 norm;
+flat in int draw_id;
+
+// every material texture is a layer, the table holds (diffuse, specular) layers per draw
+uniform sampler2DArray materials;
+uniform isamplerBuffer material_table;
+uniform directional_source _dir_source;
+uniform point_source _point_source;
+uniform vec3 view_pos;
+
+vec3 calculate_point_light(
+   point_source light,
+   vec3 normal,
+   vec3 frag_pos,
+   vec3 view_dir,
+   vec3 diffuse_col,
+   vec3 specular_col
+) {
+   vec3 light_dir = normalize(light.position - frag_pos);
+   // diffuse shading
+   float diff = max(dot(normal, light_dir), 0.0f);
+   // specular shading
+   vec3 reflect_dir = reflect(-light_dir, normal);
+   float spec = pow(max(dot(reflect_dir, view_dir), 0.0f), 64.0f);
+   // attenuation
+   float distance = length(frag_pos - light.position);
+   float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+   // combine results
+   vec3 ambient = light.ambient * diffuse_col;
+   vec3 diffuse = light.diffuse * diff * diffuse_col;
+   vec3 specular = light.specular * spec * specular_col;
+   
+   ambient *= attenuation;
+   diffuse *= attenuation;
+   specular *= attenuation;
+
+   return  (ambient + diffuse + specular);   
+}
+
+vec3 calculate_directional_light(
+   directional_source light,
+   vec3 normal,
+   vec3 view_dir,
+   vec3 diffuse_col,
+   vec3 specular_col
+) {
+
+   vec3 light_dir = normalize(-light.direction);
+   // diffuse shading
+   float diff = max(dot(normal, light_dir), 0.0f);
+   // specular shading
+   vec3 reflect_dir = reflect(-light_dir, normal);
+   float spec = pow(max(dot(view_dir, reflect_dir), 0.0f), 64.0f);
+   // combine results
+   vec3 ambient = light.ambient * diffuse_col;
+   vec3 diffuse = light.diffuse * diff * diffuse_col;
+   vec3 specular = light.specular * spec * specular_col;
+
+   return (ambient + diffuse + specular);
+}
+
+void main() {
+   ivec2 layers = texelFetch(material_table, draw_id).xy;
+   vec3 diffuse_col = vec3(texture(materials, vec3(tex_pos, layers.x)));
+   vec3 specular_col = vec3(texture(materials, vec3(tex_pos, layers.y)));
+
+   vec3 n_norm = normalize(norm);
+   vec3 view_dir = normalize(view_pos - frag_pos);
+
+   // Directional lighting
+   vec3 result = calculate_directional_light(_dir_source, n_norm, view_dir, diffuse_col, specular_col);
+   result += calculate_point_light(_point_source, n_norm, frag_pos, view_dir, diffuse_col, specular_col);
+
+   frag_color = vec4(result, 1.0f);
+}
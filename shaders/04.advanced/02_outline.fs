@@ -0,0 +1,31 @@
+#version 330 core
+// scene with an outline around every selected id, whatever the number of
+// selected objects (outline.hpp)
+out vec4 frag_color;
+
+uniform sampler2D scene;
+uniform usampler2D ids;
+uniform vec3 outline_color;
+uniform int radius;   // in pixels, 0 turns the outline off
+
+void main() {
+   ivec2 pos = ivec2(gl_FragCoord.xy);
+   ivec2 last = textureSize(ids, 0) - 1;
+   uint center = texelFetch(ids, pos, 0).r;
+
+   // the closest pixel of another selected id within the disc, soft at the rim
+   float coverage = 0.0f;
+   for (int y = -radius; y <= radius; ++y) {
+      for (int x = -radius; x <= radius; ++x) {
+         float weight = clamp(float(radius) + 0.5f - length(vec2(x, y)), 0.0f, 1.0f);
+         if (weight <= coverage)
+            continue;
+         uint id = texelFetch(ids, clamp(pos + ivec2(x, y), ivec2(0), last), 0).r;
+         if (id != 0u && id != center)
+            coverage = weight;
+      }
+   }
+
+   vec4 color = texelFetch(scene, pos, 0);
+   frag_color = vec4(mix(color.rgb, outline_color, coverage), color.a);
+}
@@ -0,0 +1,14 @@
+#version 330 core
+// shaders/04/shader.fs plus the selection id for the outline pass (outline.hpp)
+in vec2 tex_pos;
+
+layout (location = 0) out vec4 frag_color;
+layout (location = 1) out uint frag_id;
+
+uniform sampler2D texture_sampler;
+uniform uint object_id;   // 0 when not selected
+
+void main() {
+   frag_color = texture(texture_sampler, tex_pos);
+   frag_id = object_id;
+}
@@ -0,0 +1,24 @@
+#version 330 core
+
+in vec2 tex_pos;
+
+out vec4 frag_col;
+
+uniform sampler2D texture_sampler;
+
+// one direction of a separable gaussian, `step` is one texel along it.
+// offsets fall between two texels so bilinear filtering reads both in one fetch
+const int MAX_TAPS = 17;
+uniform int n_taps;
+uniform float weights[MAX_TAPS];
+uniform float offsets[MAX_TAPS];
+uniform vec2 step;
+
+void main() {
+   vec3 col = texture(texture_sampler, tex_pos).rgb * weights[0];
+   for (int i = 1; i < n_taps; ++i) {
+      col += texture(texture_sampler, tex_pos + offsets[i] * step).rgb * weights[i];
+      col += texture(texture_sampler, tex_pos - offsets[i] * step).rgb * weights[i];
+   }
+   frag_col = vec4(col, 1.0f);
+}
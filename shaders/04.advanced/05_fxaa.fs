@@ -0,0 +1,115 @@
+#version 330 core
+
+in vec2 tex_pos;
+
+out vec4 frag_col;
+
+uniform sampler2D texture_sampler;
+
+// FXAA: finds edges by luma contrast, walks along each edge to its ends and
+// blends across it in proportion to where the pixel sits on the edge.
+// expects the input in display (gamma) space
+const float EDGE_THRESHOLD = 0.125;      // contrast relative to the brightest neighbour
+const float EDGE_THRESHOLD_MIN = 0.0312; // ignores dark areas
+const float SUBPIXEL = 0.75;             // blur of single pixel features
+const int SEARCH_STEPS = 10;
+const float STEP[10] = float[](1.0, 1.0, 1.0, 1.0, 1.5, 2.0, 2.0, 2.0, 4.0, 8.0);
+
+float luma(vec3 col) {
+   return dot(col, vec3(0.299f, 0.587f, 0.114f));
+}
+
+float luma_at(vec2 pos) {
+   return luma(texture(texture_sampler, pos).rgb);
+}
+
+void main() {
+   vec2 texel = 1.0f / vec2(textureSize(texture_sampler, 0));
+   vec3 col = texture(texture_sampler, tex_pos).rgb;
+
+   float m = luma(col);
+   float n = luma(textureOffset(texture_sampler, tex_pos, ivec2( 0,  1)).rgb);
+   float s = luma(textureOffset(texture_sampler, tex_pos, ivec2( 0, -1)).rgb);
+   float e = luma(textureOffset(texture_sampler, tex_pos, ivec2( 1,  0)).rgb);
+   float w = luma(textureOffset(texture_sampler, tex_pos, ivec2(-1,  0)).rgb);
+   float lo = min(m, min(min(n, s), min(e, w)));
+   float hi = max(m, max(max(n, s), max(e, w)));
+   float range = hi - lo;
+   if (range < max(EDGE_THRESHOLD_MIN, hi * EDGE_THRESHOLD)) {
+      frag_col = vec4(col, 1.0f);
+      return;
+   }
+
+   float nw = luma(textureOffset(texture_sampler, tex_pos, ivec2(-1,  1)).rgb);
+   float ne = luma(textureOffset(texture_sampler, tex_pos, ivec2( 1,  1)).rgb);
+   float sw = luma(textureOffset(texture_sampler, tex_pos, ivec2(-1, -1)).rgb);
+   float se = luma(textureOffset(texture_sampler, tex_pos, ivec2( 1, -1)).rgb);
+
+   // edge orientation from the second derivative in each direction
+   float ns = n + s, ew = e + w;
+   float edge_h = abs(nw + sw - 2.0f * w) + 2.0f * abs(ns - 2.0f * m) + abs(ne + se - 2.0f * e);
+   float edge_v = abs(nw + ne - 2.0f * n) + 2.0f * abs(ew - 2.0f * m) + abs(sw + se - 2.0f * s);
+   bool horizontal = edge_h >= edge_v;
+
+   // which side of the pixel the edge is on
+   float l1 = horizontal ? s : w;
+   float l2 = horizontal ? n : e;
+   float g1 = l1 - m, g2 = l2 - m;
+   bool side1 = abs(g1) >= abs(g2);
+   float gradient = 0.25f * max(abs(g1), abs(g2));
+   float step_length = horizontal ? texel.y : texel.x;
+   float edge_luma;
+   if (side1) {
+      step_length = -step_length;
+      edge_luma = 0.5f * (l1 + m);
+   } else {
+      edge_luma = 0.5f * (l2 + m);
+   }
+
+   // walk both ways along the edge, half a pixel over, until the luma changes
+   vec2 edge_pos = tex_pos;
+   if (horizontal)
+      edge_pos.y += 0.5f * step_length;
+   else
+      edge_pos.x += 0.5f * step_length;
+   vec2 dir = horizontal ? vec2(texel.x, 0.0f) : vec2(0.0f, texel.y);
+   vec2 pos1 = edge_pos - dir, pos2 = edge_pos + dir;
+   float end1 = 0.0f, end2 = 0.0f;
+   bool done1 = false, done2 = false;
+   for (int i = 0; i < SEARCH_STEPS; ++i) {
+      if (!done1)
+         end1 = luma_at(pos1) - edge_luma;
+      if (!done2)
+         end2 = luma_at(pos2) - edge_luma;
+      done1 = abs(end1) >= gradient;
+      done2 = abs(end2) >= gradient;
+      if (done1 && done2)
+         break;
+      if (!done1)
+         pos1 -= dir * STEP[i];
+      if (!done2)
+         pos2 += dir * STEP[i];
+   }
+
+   float d1 = horizontal ? tex_pos.x - pos1.x : tex_pos.y - pos1.y;
+   float d2 = horizontal ? pos2.x - tex_pos.x : pos2.y - tex_pos.y;
+   bool closer1 = d1 < d2;
+   float offset = 0.5f - min(d1, d2) / (d1 + d2);
+   // only blend if the nearer end goes the same way as the center
+   bool m_darker = m < edge_luma;
+   if (((closer1 ? end1 : end2) < 0.0f) == m_darker)
+      offset = 0.0f;
+
+   // single pixel features get a blur from the 3x3 average
+   float average = (2.0f * (ns + ew) + nw + ne + sw + se) / 12.0f;
+   float sub = clamp(abs(average - m) / range, 0.0f, 1.0f);
+   sub = (3.0f - 2.0f * sub) * sub * sub;
+   offset = max(offset, sub * sub * SUBPIXEL);
+
+   vec2 pos = tex_pos;
+   if (horizontal)
+      pos.y += offset * step_length;
+   else
+      pos.x += offset * step_length;
+   frag_col = vec4(texture(texture_sampler, pos).rgb, 1.0f);
+}
@@ -0,0 +1,15 @@
+#version 330 core
+
+in vec2 tex_pos;
+
+out vec4 frag_col;
+
+uniform sampler2D texture_sampler;
+uniform float amount;   // 0: untouched, 1: fully gray
+
+void main() {
+   vec3 col = texture(texture_sampler, tex_pos).rgb;
+   // weighted grayscale, the eye is most sensitive to green
+   float luma = dot(col, vec3(0.2126f, 0.7152f, 0.0722f));
+   frag_col = vec4(mix(col, vec3(luma), amount), 1.0f);
+}
@@ -0,0 +1,10 @@
+#version 330 core
+
+out vec2 tex_pos;
+
+// one triangle covering the whole viewport, no vertex buffer needed
+void main() {
+   vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+   gl_Position = vec4(pos * 2.0f - 1.0f, 0.0f, 1.0f);
+   tex_pos = pos;
+}
@@ -6,10 +6,42 @@ in vec3 position;
 out vec4 frag_col;
 
 uniform vec3 cam_pos;
-uniform samplerCube skybox;
+// level = roughness * max_lod. GGX prefiltered for EnvironmentMap::specular; a
+// reflection probe only has box filtered mips, its rough reflections are approximate
+uniform samplerCube environment;
+uniform float max_lod;
+uniform vec3 sh[9];   // irradiance / pi, see environment_map.hpp
+
+uniform vec3 albedo;
+uniform float roughness;
+uniform float metallic;
+
+vec3 ambient(vec3 n) {
+	return sh[0] + sh[1] * n.y + sh[2] * n.z + sh[3] * n.x
+	     + sh[4] * n.x * n.y + sh[5] * n.y * n.z + sh[6] * (3.0f * n.z * n.z - 1.0f)
+	     + sh[7] * n.x * n.z + sh[8] * (n.x * n.x - n.y * n.y);
+}
+
+// fit of the integrated GGX BRDF (scale, bias for F0), saves a lookup texture
+vec2 env_brdf(float roughness, float n_dot_v) {
+	const vec4 c0 = vec4(-1.0f, -0.0275f, -0.572f, 0.022f);
+	const vec4 c1 = vec4(1.0f, 0.0425f, 1.04f, -0.04f);
+	vec4 r = roughness * c0 + c1;
+	float a = min(r.x * r.x, exp2(-9.28f * n_dot_v)) * r.x + r.y;
+	return vec2(-1.04f, 1.04f) * a + r.zw;
+}
 
 void main() {
-	vec3 I = normalize(position - cam_pos);
-	vec3 R = reflect(I, normalize(normal));
-	frag_col = vec4(texture(skybox, R).rgb, 1.0f);
+	vec3 N = normalize(normal);
+	vec3 V = normalize(cam_pos - position);
+	vec3 R = reflect(-V, N);
+	float n_dot_v = max(dot(N, V), 1e-4f);
+
+	vec3 f0 = mix(vec3(0.04f), albedo, metallic);
+	vec2 ab = env_brdf(roughness, n_dot_v);
+	vec3 specular = textureLod(environment, R, roughness * max_lod).rgb * (f0 * ab.x + ab.y);
+	vec3 diffuse = max(ambient(N), 0.0f) * albedo * (1.0f - metallic);
+
+	// lighting is linear, the skybox faces are sRGB
+	frag_col = vec4(pow(diffuse + specular, vec3(1.0f / 2.2f)), 1.0f);
 }
@@ -0,0 +1,32 @@
+#version 330 core
+
+in VS_OUT {
+   vec3 world_pos;
+   vec3 world_normal;
+} fs_in;
+
+out vec4 frag_col;
+
+uniform bool sky;   // draw the skybox seen from `eye` instead
+uniform samplerCube skybox;
+uniform vec3 eye;
+
+uniform vec3 color;
+uniform vec3 sh[9];   // irradiance / pi, see environment_map.hpp
+uniform vec3 sun_dir;
+
+vec3 ambient(vec3 n) {
+	return sh[0] + sh[1] * n.y + sh[2] * n.z + sh[3] * n.x
+	     + sh[4] * n.x * n.y + sh[5] * n.y * n.z + sh[6] * (3.0f * n.z * n.z - 1.0f)
+	     + sh[7] * n.x * n.z + sh[8] * (n.x * n.x - n.y * n.y);
+}
+
+void main() {
+	if (sky) {
+		frag_col = texture(skybox, fs_in.world_pos - eye);
+		return;
+	}
+	vec3 N = normalize(fs_in.world_normal);
+	vec3 light = max(ambient(N), 0.0f) + max(dot(N, sun_dir), 0.0f);
+	frag_col = vec4(pow(color * light, vec3(1.0f / 2.2f)), 1.0f);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+layout (location = 0) in vec3 ipos;
+layout (location = 1) in vec3 inormal;
+
+uniform mat4 model;
+uniform mat4 view_projection;   // unused when 06_probe.gs places the vertices
+
+out VS_OUT {
+   vec3 world_pos;
+   vec3 world_normal;
+} vs_out;
+
+void main() {
+   vec4 world = model * vec4(ipos, 1.0f);
+   vs_out.world_pos = world.xyz;
+   vs_out.world_normal = mat3(transpose(inverse(model))) * inormal;
+   gl_Position = view_projection * world;
+}
@@ -0,0 +1,52 @@
+#version 330 core
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+
+in VS_OUT {
+   vec3 world_pos;
+   vec3 world_normal;
+} gs_in[];
+
+out VS_OUT {
+   vec3 world_pos;
+   vec3 world_normal;
+} gs_out;
+
+uniform mat4 face_matrices[6];
+uniform int face_mask;   // faces of the cube map to draw into
+uniform bool sky;        // put the vertices on the far plane
+
+// all three vertices beyond the same clip plane
+bool outside(vec4 c[3]) {
+   for (int axis = 0; axis < 3; ++axis) {
+      if (c[0][axis] >  c[0].w && c[1][axis] >  c[1].w && c[2][axis] >  c[2].w)
+         return true;
+      if (c[0][axis] < -c[0].w && c[1][axis] < -c[1].w && c[2][axis] < -c[2].w)
+         return true;
+   }
+   return false;
+}
+
+void main() {
+   for (int face = 0; face < 6; ++face) {
+      if ((face_mask & (1 << face)) == 0)
+         continue;
+      vec4 c[3];
+      for (int i = 0; i < 3; ++i) {
+         c[i] = face_matrices[face] * vec4(gs_in[i].world_pos, 1.0f);
+         if (sky)
+            c[i].z = c[i].w;
+      }
+      // most triangles are seen from one or two faces, skip the rest here rather than clipping them
+      if (outside(c))
+         continue;
+      for (int i = 0; i < 3; ++i) {
+         gl_Layer = face;
+         gl_Position = c[i];
+         gs_out.world_pos = gs_in[i].world_pos;
+         gs_out.world_normal = gs_in[i].world_normal;
+         EmitVertex();
+      }
+      EndPrimitive();
+   }
+}
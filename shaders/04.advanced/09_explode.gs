@@ -9,18 +9,22 @@ out vec2 texf;
 // } gs_in[];
 in vec2 tex[];
 
+uniform mat4 projection;
+uniform mat4 view;
 uniform float time;
 
+// corners are in world space, so triangles move up to `magnitude` world units
+// whatever the model scale (same as 09_explode_pull.vs)
 vec3 get_normal(vec4 pt0, vec4 pt1, vec4 pt2) {
-    vec3 a = vec3(pt0) - vec3(pt1);
-    vec3 b = vec3(pt2) - vec3(pt1);
+    vec3 a = vec3(pt1) - vec3(pt0);
+    vec3 b = vec3(pt2) - vec3(pt0);
     return normalize(cross(a, b));
 }
 
 vec4 explode(vec4 position, vec3 normal) {
     float magnitude = 2.0f;
     vec3 direction = normal * ((sin(time) + 1.0f) / 2.0f) * magnitude;
-    return position + vec4(direction, 0.0f);
+    return projection * view * (position + vec4(direction, 0.0f));
 }
 
 void main() {
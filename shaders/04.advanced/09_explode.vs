@@ -3,8 +3,6 @@ layout (location = 0) in vec3 ipos;
 layout (location = 1) in vec3 inorm;
 layout (location = 2) in vec2 itex_pos;
 
-uniform mat4 projection;
-uniform mat4 view;
 uniform mat4 model;
 
 // out VS_OUT {
@@ -14,7 +12,8 @@ uniform mat4 model;
 out vec2 tex;
 
 void main() {
-   gl_Position = projection * view * model * vec4(ipos, 1.0f);
+   // world space, the geometry shader moves the triangle and projects it
+   gl_Position = model * vec4(ipos, 1.0f);
    // vs_out.tex = itex_pos;
    tex = itex_pos;
 }
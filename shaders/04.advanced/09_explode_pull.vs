@@ -0,0 +1,29 @@
+#version 330 core
+// 09_explode.gs without the geometry shader: the mesh is drawn unindexed, each
+// vertex fetches its corner and the normal of its triangle (pulled_mesh.hpp)
+
+uniform samplerBuffer vertices;
+uniform usamplerBuffer indices;
+uniform samplerBuffer faces;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+uniform mat4 normal_model;   // transpose(inverse(model))
+uniform float time;
+
+out vec2 texf;
+
+void main() {
+   int index = int(texelFetch(indices, gl_VertexID).r);
+   vec4 position = texelFetch(vertices, 2 * index);
+   float tex_y = texelFetch(vertices, 2 * index + 1).w;
+   vec3 normal = texelFetch(faces, gl_VertexID / 3).xyz;
+
+   // along the world space face normal, the same distance as 09_explode.gs
+   // whatever the model scale
+   float magnitude = 2.0f;
+   vec3 direction = normalize(mat3(normal_model) * normal) * ((sin(time) + 1.0f) / 2.0f) * magnitude;
+   gl_Position = projection * view * (model * vec4(position.xyz, 1.0f) + vec4(direction, 0.0f));
+   texf = vec2(position.w, tex_y);
+}
@@ -0,0 +1,18 @@
+#version 330 core
+// 09_house.gs as an instanced triangle strip: one instance per point, the
+// corner offsets indexed by gl_VertexID
+layout (location = 0) in vec2 ipos;   // per instance
+layout (location = 1) in vec3 icol;   // per instance
+
+out vec3 col;
+
+const vec2 corners[5] = vec2[](
+  vec2(-0.2f, -0.2f), vec2( 0.2f, -0.2f),
+  vec2(-0.2f,  0.2f), vec2( 0.2f,  0.2f),
+  vec2( 0.0f,  0.4f)
+);
+
+void main() {
+  gl_Position = vec4(ipos + corners[gl_VertexID], 0.0f, 1.0f);
+  col = gl_VertexID == 4 ? vec3(1.0f) : icol;
+}
@@ -0,0 +1,27 @@
+#version 330 core
+// 10_normals.gs as instanced line segments: instance i is the normal of vertex i
+// (or of face i with FACE_NORMALS), gl_VertexID 0 / 1 its base and tip
+
+uniform samplerBuffer vertices;
+uniform usamplerBuffer indices;
+uniform samplerBuffer faces;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+uniform mat4 normal_model;   // transpose(inverse(model)), once per draw rather than per vertex
+
+void main() {
+#ifdef FACE_NORMALS
+   vec3 base = vec3(0.0f);
+   for (int i = 0; i < 3; ++i)
+      base += texelFetch(vertices, 2 * int(texelFetch(indices, 3 * gl_InstanceID + i).r)).xyz / 3.0f;
+   vec3 normal = texelFetch(faces, gl_InstanceID).xyz;
+#else
+   vec3 base = texelFetch(vertices, 2 * gl_InstanceID).xyz;
+   vec3 normal = texelFetch(vertices, 2 * gl_InstanceID + 1).xyz;
+#endif
+   vec3 world = vec3(model * vec4(base, 1.0f));
+   world += 0.1f * float(gl_VertexID) * normalize(mat3(normal_model) * normal);
+   gl_Position = projection * view * vec4(world, 1.0f);
+}
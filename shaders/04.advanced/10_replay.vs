@@ -0,0 +1,15 @@
+#version 330 core
+// geometry captured in world space by FeedbackCache (feedback_cache.hpp),
+// drawn from any view without running the stages that made it again
+layout (location = 0) in vec4 ipos;
+layout (location = 1) in vec2 itex_pos;   // not captured by every pass
+
+uniform mat4 projection;
+uniform mat4 view;
+
+out vec2 texf;
+
+void main() {
+   gl_Position = projection * view * ipos;
+   texf = itex_pos;
+}
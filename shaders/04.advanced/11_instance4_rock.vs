@@ -2,7 +2,18 @@
 layout (location = 0) in vec3 ipos;
 layout (location = 1) in vec3 inorm;
 layout (location = 2) in vec2 itex_pos;
+
+// instance encoding, see instance_buffer.hpp (mat4 when nothing is defined)
+#if defined(INSTANCE_QUAT)
+layout (location = 3) in vec4 pos_scale;
+layout (location = 4) in vec4 rotation;
+#elif defined(INSTANCE_AFFINE)
+layout (location = 3) in vec4 row0;
+layout (location = 4) in vec4 row1;
+layout (location = 5) in vec4 row2;
+#else
 layout (location = 3) in mat4 trans_mat;
+#endif
 
 uniform mat4 projection;
 uniform mat4 view;
@@ -11,7 +22,20 @@ out VS_OUT {
     vec2 tex;
 } vs_out;
 
+vec3 instance_position(vec3 p) {
+#if defined(INSTANCE_QUAT)
+   p *= pos_scale.w;
+   vec3 t = 2.0f * cross(rotation.xyz, p);
+   return pos_scale.xyz + p + rotation.w * t + cross(rotation.xyz, t);
+#elif defined(INSTANCE_AFFINE)
+   vec4 h = vec4(p, 1.0f);
+   return vec3(dot(row0, h), dot(row1, h), dot(row2, h));
+#else
+   return vec3(trans_mat * vec4(p, 1.0f));
+#endif
+}
+
 void main() {
-   gl_Position = projection * view * trans_mat * vec4(ipos, 1.0f);
+   gl_Position = projection * view * vec4(instance_position(ipos), 1.0f);
    vs_out.tex = itex_pos;
 }
@@ -0,0 +1,7 @@
+#version 330 core
+out vec4 frag_color;
+
+// never runs, the culling pass is drawn with GL_RASTERIZER_DISCARD
+void main() {
+   frag_color = vec4(1.0f);
+}
@@ -0,0 +1,19 @@
+#version 330 core
+layout (points) in;
+layout (points, max_vertices = 1) out;
+
+in VS_OUT {
+    mat4 trans;
+    flat int visible;
+} gs_in[];
+
+// captured with transform feedback
+out mat4 visible_trans;
+
+void main() {
+    if (gs_in[0].visible == 1) {
+        visible_trans = gs_in[0].trans;
+        EmitVertex();
+        EndPrimitive();
+    }
+}
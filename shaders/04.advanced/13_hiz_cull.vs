@@ -0,0 +1,59 @@
+#version 330 core
+layout (location = 0) in mat4 itrans;
+layout (location = 4) in vec3 ibox_min;
+layout (location = 5) in vec3 ibox_max;
+
+uniform mat4 view_projection;
+uniform sampler2D hiz;
+uniform vec2 hiz_size;
+uniform int hiz_levels;
+
+out VS_OUT {
+    mat4 trans;
+    flat int visible;
+} vs_out;
+
+bool is_visible(vec3 bmin, vec3 bmax) {
+    vec3 lo = vec3( 1.0e9f);
+    vec3 hi = vec3(-1.0e9f);
+    for (int i = 0; i < 8; ++i) {
+        vec3 corner = vec3((i & 1) != 0 ? bmax.x : bmin.x,
+                           (i & 2) != 0 ? bmax.y : bmin.y,
+                           (i & 4) != 0 ? bmax.z : bmin.z);
+        vec4 clip = view_projection * vec4(corner, 1.0f);
+        // crosses the near plane, keep it
+        if (clip.w <= 0.0f)
+            return true;
+        vec3 ndc = clip.xyz / clip.w;
+        lo = min(lo, ndc);
+        hi = max(hi, ndc);
+    }
+
+    // frustum
+    if (hi.x < -1.0f || lo.x > 1.0f || hi.y < -1.0f || lo.y > 1.0f || lo.z > 1.0f)
+        return false;
+
+    // occlusion: pick the level where the rect spans at most 2x2 texels
+    vec2 uv_lo = clamp(lo.xy * 0.5f + 0.5f, 0.0f, 1.0f);
+    vec2 uv_hi = clamp(hi.xy * 0.5f + 0.5f, 0.0f, 1.0f);
+    float depth = lo.z * 0.5f + 0.5f;
+
+    vec2 extent = (uv_hi - uv_lo) * hiz_size;
+    int level = int(ceil(log2(max(max(extent.x, extent.y), 1.0f))));
+    level = clamp(level, 0, hiz_levels - 1);
+
+    ivec2 size = max(ivec2(hiz_size) >> level, ivec2(1));
+    ivec2 t0 = min(ivec2(uv_lo * vec2(size)), size - 1);
+    ivec2 t1 = min(ivec2(uv_hi * vec2(size)), size - 1);
+
+    float max_depth = max(max(texelFetch(hiz, t0, level).r,
+                              texelFetch(hiz, ivec2(t1.x, t0.y), level).r),
+                          max(texelFetch(hiz, ivec2(t0.x, t1.y), level).r,
+                              texelFetch(hiz, t1, level).r));
+    return depth <= max_depth;
+}
+
+void main() {
+    vs_out.trans = itrans;
+    vs_out.visible = is_visible(ibox_min, ibox_max) ? 1 : 0;
+}
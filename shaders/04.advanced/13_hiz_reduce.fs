@@ -0,0 +1,21 @@
+#version 330 core
+out float max_depth;
+
+uniform sampler2D src;
+uniform vec2 src_size;
+uniform vec2 dst_size;
+
+void main() {
+   // footprint of this texel in the source level, it is 2x2 texels between
+   // pyramid levels and up to 3x3 when resampling the depth buffer
+   ivec2 dst = ivec2(gl_FragCoord.xy);
+   vec2 ratio = src_size / dst_size;
+   ivec2 lo = ivec2(floor(vec2(dst) * ratio));
+   ivec2 hi = min(ivec2(ceil(vec2(dst + 1) * ratio)), ivec2(src_size)) - 1;
+
+   float depth = 0.0f;
+   for (int y = lo.y; y <= hi.y; ++y)
+      for (int x = lo.x; x <= hi.x; ++x)
+         depth = max(depth, texelFetch(src, ivec2(x, y), 0).r);
+   max_depth = depth;
+}
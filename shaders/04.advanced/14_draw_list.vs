@@ -0,0 +1,27 @@
+#version 330 core
+layout (location = 0) in vec3 ipos;
+layout (location = 1) in vec3 inorm;
+layout (location = 2) in vec2 itex_pos;
+
+layout (std140) uniform matrices {
+    mat4 projection;
+    mat4 view;
+};
+
+// model matrices of every recorded instance, four texels each
+uniform samplerBuffer transforms;
+uniform int base_instance;
+
+out VS_OUT {
+    vec2 tex;
+} vs_out;
+
+void main() {
+   int i = (base_instance + gl_InstanceID) * 4;
+   mat4 model = mat4(texelFetch(transforms, i),
+                     texelFetch(transforms, i + 1),
+                     texelFetch(transforms, i + 2),
+                     texelFetch(transforms, i + 3));
+   gl_Position = projection * view * model * vec4(ipos, 1.0f);
+   vs_out.tex = itex_pos;
+}
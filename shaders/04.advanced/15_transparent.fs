@@ -0,0 +1,11 @@
+#version 330 core
+
+in vec2 tex_pos;
+in vec3 tint;
+out vec4 frag_col;
+uniform sampler2D texture_sampler;
+
+void main() {
+   vec4 col = texture(texture_sampler, tex_pos);
+   frag_col = vec4(col.rgb * tint, col.a);
+}
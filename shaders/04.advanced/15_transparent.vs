@@ -0,0 +1,21 @@
+#version 330 core
+layout (location = 0) in vec3 ipos;
+layout (location = 1) in vec2 itex_pos;
+layout (location = 2) in vec4 iinstance;   // xyz position, w scale
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float tint_amount;   // 0: untinted
+
+out vec2 tex_pos;
+out vec3 tint;
+
+void main() {
+   vec3 world = iinstance.xyz + ipos * iinstance.w;
+   gl_Position = projection * view * vec4(world, 1.0f);
+   tex_pos = itex_pos;
+
+   // the instance order changes every frame, so the tint comes from the position
+   vec3 hue = 0.5f + 0.5f * cos(6.2831f * (fract(iinstance.xyz * 0.0173f) + vec3(0.0f, 0.33f, 0.67f)));
+   tint = mix(vec3(1.0f), hue, tint_amount);
+}
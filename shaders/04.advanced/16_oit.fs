@@ -0,0 +1,21 @@
+#version 330 core
+
+in vec2 tex_pos;
+in vec3 tint;
+
+layout (location = 0) out vec4 accum;
+layout (location = 1) out float weight;
+
+uniform sampler2D texture_sampler;
+
+void main() {
+   vec4 col = texture(texture_sampler, tex_pos);
+   col.rgb *= tint;
+
+   // closer and more opaque surfaces weigh more (McGuire & Bavoil, eq. 10)
+   float z = 1.0f - gl_FragCoord.z;
+   float w = clamp(col.a * max(1e-2f, 3e3f * z * z * z), 1e-2f, 3e3f);
+
+   accum = vec4(col.rgb * col.a * w, col.a);
+   weight = col.a * w;
+}
@@ -0,0 +1,18 @@
+#version 330 core
+
+out vec4 frag_col;
+
+uniform sampler2D accum;
+uniform sampler2D weight;
+
+void main() {
+   ivec2 texel = ivec2(gl_FragCoord.xy);
+   vec4 a = texelFetch(accum, texel, 0);
+   float revealage = a.a;
+   // nothing transparent covers this pixel
+   if (revealage >= 1.0f)
+      discard;
+
+   vec3 average = a.rgb / max(texelFetch(weight, texel, 0).r, 1e-5f);
+   frag_col = vec4(average, 1.0f - revealage);
+}
@@ -0,0 +1,39 @@
+#version 330 core
+out vec4 frag_col;
+
+uniform sampler2D g_albedo_spec;
+uniform sampler2D g_normal;
+uniform sampler2D g_depth;
+uniform vec2 screen_size;
+uniform mat4 inv_view_projection;
+
+uniform vec3 view_pos;
+uniform vec3 sun_direction;
+uniform vec3 sun_color;
+uniform vec3 ambient;
+uniform vec3 clear_color;
+
+const float shininess = 64.0f;
+
+// full screen: ambient and the directional light, the point lights are added on top
+void main() {
+   ivec2 texel = ivec2(gl_FragCoord.xy);
+   float depth = texelFetch(g_depth, texel, 0).r;
+   if (depth == 1.0f) {
+      frag_col = vec4(clear_color, 1.0f);
+      return;
+   }
+   vec4 clip = vec4(gl_FragCoord.xy / screen_size * 2.0f - 1.0f, depth * 2.0f - 1.0f, 1.0f);
+   vec4 world = inv_view_projection * clip;
+   vec3 frag_pos = world.xyz / world.w;
+
+   vec4 albedo_spec = texelFetch(g_albedo_spec, texel, 0);
+   vec3 n = texelFetch(g_normal, texel, 0).xyz;
+   vec3 v = normalize(view_pos - frag_pos);
+   vec3 l = -sun_direction;
+   vec3 h = normalize(l + v);
+   vec3 color = ambient * albedo_spec.rgb
+              + sun_color * (max(dot(n, l), 0.0f) * albedo_spec.rgb
+                             + pow(max(dot(n, h), 0.0f), shininess) * albedo_spec.a);
+   frag_col = vec4(color, 1.0f);
+}
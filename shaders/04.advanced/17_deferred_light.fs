@@ -0,0 +1,39 @@
+#version 330 core
+out vec4 frag_col;
+
+flat in vec4 position_radius;
+flat in vec4 color_intensity;
+
+uniform sampler2D g_albedo_spec;
+uniform sampler2D g_normal;
+uniform sampler2D g_depth;
+uniform vec2 screen_size;
+uniform mat4 inv_view_projection;
+uniform vec3 view_pos;
+
+const float shininess = 64.0f;
+
+// one light volume, only runs on pixels the volume covers
+void main() {
+   ivec2 texel = ivec2(gl_FragCoord.xy);
+   float depth = texelFetch(g_depth, texel, 0).r;
+   vec4 clip = vec4(gl_FragCoord.xy / screen_size * 2.0f - 1.0f, depth * 2.0f - 1.0f, 1.0f);
+   vec4 world = inv_view_projection * clip;
+   vec3 frag_pos = world.xyz / world.w;
+
+   vec3 d = position_radius.xyz - frag_pos;
+   float dist = length(d);
+   if (dist >= position_radius.w)
+      discard;
+
+   vec4 albedo_spec = texelFetch(g_albedo_spec, texel, 0);
+   vec3 n = texelFetch(g_normal, texel, 0).xyz;
+   vec3 v = normalize(view_pos - frag_pos);
+   vec3 l = d / dist;
+   vec3 h = normalize(l + v);
+   float window = clamp(1.0f - pow(dist / position_radius.w, 4.0f), 0.0f, 1.0f);
+   float attenuation = color_intensity.w * window * window / (1.0f + dist * dist);
+   frag_col = vec4(attenuation * color_intensity.rgb
+                   * (max(dot(n, l), 0.0f) * albedo_spec.rgb
+                      + pow(max(dot(n, h), 0.0f), shininess) * albedo_spec.a), 0.0f);
+}
@@ -0,0 +1,16 @@
+#version 330 core
+layout (location = 0) in vec3 ipos;   // unit sphere
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform samplerBuffer lights;   // 2 texels per light, see lights.hpp
+
+flat out vec4 position_radius;
+flat out vec4 color_intensity;
+
+void main() {
+   position_radius = texelFetch(lights, 2 * gl_InstanceID);
+   color_intensity = texelFetch(lights, 2 * gl_InstanceID + 1);
+   vec3 world = position_radius.xyz + ipos * position_radius.w;
+   gl_Position = projection * view * vec4(world, 1.0f);
+}
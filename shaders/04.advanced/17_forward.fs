@@ -0,0 +1,47 @@
+#version 330 core
+out vec4 frag_col;
+
+in vec3 frag_pos;
+in vec3 normal;
+in vec2 tex_pos;
+
+uniform sampler2D diffuse;
+uniform sampler2D specular;
+uniform samplerBuffer lights;   // 2 texels per light, see lights.hpp
+uniform int n_lights;
+
+uniform vec3 view_pos;
+uniform vec3 sun_direction;
+uniform vec3 sun_color;
+uniform vec3 ambient;
+
+const float shininess = 64.0f;
+
+void main() {
+   vec3 albedo = texture(diffuse, tex_pos).rgb;
+   float spec = texture(specular, tex_pos).r;
+   vec3 n = normalize(normal);
+   vec3 v = normalize(view_pos - frag_pos);
+
+   vec3 l = -sun_direction;
+   vec3 h = normalize(l + v);
+   vec3 color = ambient * albedo
+              + sun_color * (max(dot(n, l), 0.0f) * albedo + pow(max(dot(n, h), 0.0f), shininess) * spec);
+
+   // every light is looked at by every fragment
+   for (int i = 0; i < n_lights; ++i) {
+      vec4 position_radius = texelFetch(lights, 2 * i);
+      vec4 color_intensity = texelFetch(lights, 2 * i + 1);
+      vec3 d = position_radius.xyz - frag_pos;
+      float dist = length(d);
+      if (dist >= position_radius.w)
+         continue;
+      l = d / dist;
+      h = normalize(l + v);
+      float window = clamp(1.0f - pow(dist / position_radius.w, 4.0f), 0.0f, 1.0f);
+      float attenuation = color_intensity.w * window * window / (1.0f + dist * dist);
+      color += attenuation * color_intensity.rgb
+             * (max(dot(n, l), 0.0f) * albedo + pow(max(dot(n, h), 0.0f), shininess) * spec);
+   }
+   frag_col = vec4(color, 1.0f);
+}
@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) out vec4 g_albedo_spec;
+layout (location = 1) out vec3 g_normal;
+
+in vec3 frag_pos;
+in vec3 normal;
+in vec2 tex_pos;
+
+uniform sampler2D diffuse;
+uniform sampler2D specular;
+
+void main() {
+   g_albedo_spec = vec4(texture(diffuse, tex_pos).rgb, texture(specular, tex_pos).r);
+   g_normal = normalize(normal);
+}
@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) in vec3 ipos;
+layout (location = 1) in vec3 inorm;
+layout (location = 2) in vec2 itex_pos;
+layout (location = 3) in vec3 ioffset;   // per instance
+layout (location = 4) in vec3 iscale;    // per instance
+
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec3 frag_pos;
+out vec3 normal;
+out vec2 tex_pos;
+
+void main() {
+   vec3 world = ioffset + ipos * iscale;
+   gl_Position = projection * view * vec4(world, 1.0f);
+   frag_pos = world;
+   // inverse transpose of a scale is the inverse scale
+   normal = normalize(inorm / iscale);
+   // the floor is a flattened cube, repeat the texture instead of stretching it
+   tex_pos = itex_pos * max(iscale.x, iscale.z);
+}
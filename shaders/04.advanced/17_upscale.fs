@@ -0,0 +1,42 @@
+#version 330 core
+
+in vec2 tex_pos;
+
+out vec4 frag_col;
+
+uniform sampler2D source;
+uniform vec2 texture_size;   // allocated size of `source`
+uniform vec2 source_size;    // the rendered corner of it, stretched over the viewport
+
+// Catmull-Rom: the two middle taps of each axis are folded into one bilinear
+// fetch, which leaves 3x3 fetches for the 4x4 footprint
+void main() {
+   vec2 pos = tex_pos * source_size;
+   vec2 center = floor(pos - 0.5f) + 0.5f;
+   vec2 f = pos - center;
+
+   vec2 w0 = f * (-0.5f + f * (1.0f - 0.5f * f));
+   vec2 w1 = 1.0f + f * f * (-2.5f + 1.5f * f);
+   vec2 w2 = f * (0.5f + f * (2.0f - 1.5f * f));
+   vec2 w3 = f * f * (-0.5f + 0.5f * f);
+   vec2 w12 = w1 + w2;
+
+   // clamped to the rendered corner, whatever is beyond it is stale
+   vec2 lo = vec2(0.5f), hi = source_size - 0.5f;
+   vec2 p0 = clamp(center - 1.0f, lo, hi) / texture_size;
+   vec2 p12 = clamp(center + w2 / w12, lo, hi) / texture_size;
+   vec2 p3 = clamp(center + 2.0f, lo, hi) / texture_size;
+
+   vec3 col =
+        (texture(source, vec2(p0.x,  p0.y)).rgb * w0.x
+       + texture(source, vec2(p12.x, p0.y)).rgb * w12.x
+       + texture(source, vec2(p3.x,  p0.y)).rgb * w3.x) * w0.y
+      + (texture(source, vec2(p0.x,  p12.y)).rgb * w0.x
+       + texture(source, vec2(p12.x, p12.y)).rgb * w12.x
+       + texture(source, vec2(p3.x,  p12.y)).rgb * w3.x) * w12.y
+      + (texture(source, vec2(p0.x,  p3.y)).rgb * w0.x
+       + texture(source, vec2(p12.x, p3.y)).rgb * w12.x
+       + texture(source, vec2(p3.x,  p3.y)).rgb * w3.x) * w3.y;
+   // the negative lobes can overshoot below zero next to bright edges
+   frag_col = vec4(max(col, vec3(0.0f)), 1.0f);
+}
@@ -0,0 +1,9 @@
+#version 330 core
+VERTEX_INPUTS   // ipos alone, the position stream (vertex_layout.hpp)
+
+uniform mat4 model;
+uniform mat4 light_view_projection;
+
+void main() {
+   gl_Position = light_view_projection * model * vec4(ipos, 1.0f);
+}
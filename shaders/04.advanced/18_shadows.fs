@@ -0,0 +1,87 @@
+#version 330 core
+
+struct directional_source {
+   vec3 direction;
+   vec3 ambient;
+   vec3 diffuse;
+   vec3 specular;  
+};
+struct Material {
+ sampler2D diffuse;
+ sampler2D specular;
+ float shininess;
+};
+
+#define MAX_CASCADES 4
+uniform sampler2DArrayShadow shadow_map;
+uniform mat4 light_view_projection[MAX_CASCADES];
+uniform vec4 cascade_splits;   // far end of each cascade, view distance
+uniform int n_cascades;
+uniform vec4 cascade_texels;   // world size of a shadow texel in each cascade
+uniform float shadow_texel;    // 1 / shadow map resolution
+uniform bool show_cascades;
+
+uniform directional_source _dir_source;
+uniform vec3 view_pos;
+uniform Material material;
+
+in vec3 frag_pos;
+in vec3 norm;
+in vec2 tex_pos;
+in float view_depth;
+
+out vec4 frag_color;
+
+const vec3 cascade_colors[MAX_CASCADES] = vec3[](
+   vec3(1.0f, 0.4f, 0.4f), vec3(0.4f, 1.0f, 0.4f), vec3(0.4f, 0.4f, 1.0f), vec3(1.0f, 1.0f, 0.4f)
+);
+
+int select_cascade() {
+   for (int c = 0; c < n_cascades - 1; ++c)
+      if (view_depth < cascade_splits[c])
+         return c;
+   return n_cascades - 1;
+}
+
+// 1: lit, 0: in shadow
+float shadow(int cascade, vec3 normal, vec3 light_dir) {
+   // pushed along the normal by about a texel, more at grazing angles
+   float n_dot_l = dot(normal, light_dir);
+   vec3 offset = normal * (1.5f * cascade_texels[cascade] * clamp(1.0f - n_dot_l, 0.2f, 1.0f));
+   vec4 p = light_view_projection[cascade] * vec4(frag_pos + offset, 1.0f);
+   vec3 uvz = p.xyz / p.w * 0.5f + 0.5f;
+   if (uvz.z > 1.0f)
+      return 1.0f;
+
+   // 3x3 taps, each one a bilinear 2x2 comparison
+   float lit = 0.0f;
+   for (int x = -1; x <= 1; ++x)
+      for (int y = -1; y <= 1; ++y)
+         lit += texture(shadow_map, vec4(uvz.xy + vec2(x, y) * shadow_texel, cascade, uvz.z));
+   return lit / 9.0f;
+}
+
+void main() {
+   vec3 n_norm = normalize(norm);
+   vec3 view_dir = normalize(view_pos - frag_pos);
+   vec3 light_dir = normalize(-_dir_source.direction);
+
+   // diffuse shading
+   float diff = max(dot(n_norm, light_dir), 0.0f);
+   // specular shading
+   vec3 reflect_dir = reflect(-light_dir, n_norm);
+   float spec = pow(max(dot(view_dir, reflect_dir), 0.0f), material.shininess);
+
+   int cascade = select_cascade();
+   float lit = diff > 0.0f ? shadow(cascade, n_norm, light_dir) : 0.0f;
+
+   vec3 albedo = vec3(texture(material.diffuse, tex_pos));
+   vec3 ambient = _dir_source.ambient * albedo;
+   vec3 diffuse = _dir_source.diffuse * diff * albedo;
+   vec3 specular = _dir_source.specular * spec * vec3(texture(material.specular, tex_pos));
+
+   vec3 result = ambient + lit * (diffuse + specular);
+   if (show_cascades)
+      result *= cascade_colors[cascade];
+   frag_color = vec4(result, 1.0f);
+}
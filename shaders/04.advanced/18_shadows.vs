@@ -0,0 +1,22 @@
+#version 330 core
+VERTEX_INPUTS   // ipos, inorm, itex_pos from the vertex layout (vertex_layout.hpp)
+
+uniform mat4 view;
+uniform mat4 model;
+uniform mat4 projection;
+uniform vec2 tex_scale;
+
+out vec3 frag_pos;
+out vec3 norm;
+out vec2 tex_pos;
+out float view_depth;
+
+void main() {
+   vec4 world = model * vec4(ipos, 1.0f);
+   vec4 view_pos = view * world;
+   gl_Position = projection * view_pos;
+   frag_pos = world.xyz;
+   norm = transpose(inverse(mat3(model))) * inorm;
+   tex_pos = itex_pos * tex_scale;
+   view_depth = -view_pos.z;
+}
@@ -0,0 +1,110 @@
+#version 330 core
+
+struct Material {
+ sampler2D diffuse;
+ sampler2D specular;
+ float shininess;
+};
+
+// 3 texels per light: (position, radius), (color, intensity), (direction, cos cutoff)
+uniform samplerBuffer lights;
+uniform int n_lights;
+// 8 texels per light, see shadow_atlas.hpp
+uniform samplerBuffer shadow_data;
+uniform sampler2DShadow shadow_atlas;
+uniform bool shadows;
+
+uniform vec3 view_pos;
+uniform vec3 ambient;
+uniform Material material;
+
+in vec3 frag_pos;
+in vec3 norm;
+in vec2 tex_pos;
+
+out vec4 frag_color;
+
+// same face order and orientation as the cube faces in shadow_atlas.hpp
+const vec3 face_dirs[6] = vec3[](
+   vec3(1.0f, 0.0f, 0.0f), vec3(-1.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f),
+   vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 0.0f, -1.0f)
+);
+const vec3 face_ups[6] = vec3[](
+   vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f),
+   vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f)
+);
+
+// 3x3 comparisons around `ndc` in `tile`, kept inside the tile
+float pcf(vec4 tile, vec3 ndc, float texel) {
+   vec2 uv = mix(tile.xy, tile.zw, ndc.xy * 0.5f + 0.5f);
+   float depth = ndc.z * 0.5f + 0.5f;
+   vec2 lo = tile.xy + 1.5f * texel, hi = tile.zw - 1.5f * texel;
+   float lit = 0.0f;
+   for (int x = -1; x <= 1; ++x)
+      for (int y = -1; y <= 1; ++y)
+         lit += texture(shadow_atlas, vec3(clamp(uv + vec2(x, y) * texel, lo, hi), depth));
+   return lit / 9.0f;
+}
+
+// 1: lit, 0: in shadow
+float shadow(int light, vec3 position, vec3 normal) {
+   vec4 header = texelFetch(shadow_data, 8 * light);
+   if (header.x == 0.0f)
+      return 1.0f;
+   float near = header.y, far = header.z, texel = header.w;
+   // pushed along the normal, shadow texels grow with the distance to the light
+   vec4 world = vec4(frag_pos + normal * 0.02f * length(frag_pos - position), 1.0f);
+
+   if (header.x == 1.0f) {
+      mat4 m = mat4(texelFetch(shadow_data, 8 * light + 2), texelFetch(shadow_data, 8 * light + 3),
+                    texelFetch(shadow_data, 8 * light + 4), texelFetch(shadow_data, 8 * light + 5));
+      vec4 p = m * world;
+      return pcf(texelFetch(shadow_data, 8 * light + 1), p.xyz / p.w, texel);
+   }
+
+   // point light: the face is the major axis of the light to fragment vector
+   vec3 v = world.xyz - position;
+   vec3 a = abs(v);
+   int face = a.x >= a.y && a.x >= a.z ? (v.x > 0.0f ? 0 : 1)
+            : a.y >= a.z ? (v.y > 0.0f ? 2 : 3) : (v.z > 0.0f ? 4 : 5);
+   vec3 d = face_dirs[face];
+   vec3 right = normalize(cross(d, face_ups[face]));
+   vec3 up = cross(right, d);
+   float ma = dot(v, d);
+   // what a 90 degree perspective projection looking down `d` gives
+   float z = (far + near) / (far - near) - 2.0f * far * near / ((far - near) * ma);
+   vec3 ndc = vec3(dot(v, right) / ma, dot(v, up) / ma, z);
+   return pcf(texelFetch(shadow_data, 8 * light + 1 + face), ndc, texel);
+}
+
+void main() {
+   vec3 n_norm = normalize(norm);
+   vec3 view_dir = normalize(view_pos - frag_pos);
+   vec3 albedo = vec3(texture(material.diffuse, tex_pos));
+   vec3 spec_col = vec3(texture(material.specular, tex_pos));
+
+   vec3 result = ambient * albedo;
+   for (int i = 0; i < n_lights; ++i) {
+      vec4 position_radius = texelFetch(lights, 3 * i);
+      vec4 color_intensity = texelFetch(lights, 3 * i + 1);
+      vec4 direction_cutoff = texelFetch(lights, 3 * i + 2);
+      vec3 light_dir = position_radius.xyz - frag_pos;
+      float distance = length(light_dir);
+      if (distance >= position_radius.w)
+         continue;
+      light_dir /= distance;
+      // soft cone edge
+      float cone = smoothstep(direction_cutoff.w, direction_cutoff.w + 0.05f, dot(-light_dir, direction_cutoff.xyz));
+      if (direction_cutoff.w <= -1.0f)
+         cone = 1.0f;
+      float diff = max(dot(n_norm, light_dir), 0.0f);
+      if (cone * diff == 0.0f)
+         continue;
+      float spec = pow(max(dot(view_dir, reflect(-light_dir, n_norm)), 0.0f), material.shininess);
+      float window = clamp(1.0f - pow(distance / position_radius.w, 4.0f), 0.0f, 1.0f);
+      float attenuation = color_intensity.w * window * window / (1.0f + distance * distance);
+      float lit = shadows ? shadow(i, position_radius.xyz, n_norm) : 1.0f;
+      result += lit * cone * attenuation * color_intensity.rgb * (diff * albedo + spec * spec_col);
+   }
+   frag_color = vec4(result, 1.0f);
+}
@@ -0,0 +1,34 @@
+#version 330 core
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+
+// 1 for a spot light, 6 for a point light
+uniform int n_faces;
+uniform mat4 face_matrices[6];
+uniform vec4 face_tiles[6];   // tile center and half size in atlas NDC
+
+// each face is drawn into its own tile of the atlas: the face's clip space is
+// scaled into the tile and clipped to the tile's edges
+void main() {
+   for (int f = 0; f < n_faces; ++f) {
+      vec4 clip[3], edges[3];
+      for (int i = 0; i < 3; ++i) {
+         clip[i] = face_matrices[f] * gl_in[i].gl_Position;
+         edges[i] = vec4(clip[i].w - clip[i].x, clip[i].w + clip[i].x,
+                         clip[i].w - clip[i].y, clip[i].w + clip[i].y);
+      }
+      // all three vertices outside the same edge, the face doesn't see the triangle
+      if (any(lessThan(max(max(edges[0], edges[1]), edges[2]), vec4(0.0f))))
+         continue;
+
+      for (int i = 0; i < 3; ++i) {
+         gl_ClipDistance[0] = edges[i].x;
+         gl_ClipDistance[1] = edges[i].y;
+         gl_ClipDistance[2] = edges[i].z;
+         gl_ClipDistance[3] = edges[i].w;
+         gl_Position = vec4(clip[i].xy * face_tiles[f].zw + face_tiles[f].xy * clip[i].w, clip[i].zw);
+         EmitVertex();
+      }
+      EndPrimitive();
+   }
+}
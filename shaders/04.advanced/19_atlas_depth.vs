@@ -0,0 +1,9 @@
+#version 330 core
+VERTEX_INPUTS   // ipos alone, the position stream (vertex_layout.hpp)
+
+uniform mat4 model;
+
+// world space, the geometry shader projects it once per face
+void main() {
+   gl_Position = model * vec4(ipos, 1.0f);
+}